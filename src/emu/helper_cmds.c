@@ -50,6 +50,7 @@
 #include "uffs/uffs_fd.h"
 #include "uffs/uffs_mtb.h"
 #include "uffs_fileem.h"
+#include "uffs/uffs_trace.h"
 
 #define PFX "cmd : "
 
@@ -337,14 +338,22 @@ static int cmd_st(int argc, char *argv[])
 
 	MSG("----------- basic info -----------" TENDSTR);
 	MSG("TreeNode size:         %d" TENDSTR, sizeof(TreeNode));
+	MSG("Tree nodes RAM:        %d x %d = %d bytes" TENDSTR,
+			(dev->par.end - dev->par.start + 1), TREE_NODE_BUF_SIZE,
+			(dev->par.end - dev->par.start + 1) * TREE_NODE_BUF_SIZE);
+#ifdef CONFIG_UFFS_COMPACT_TREE_NODE
+	MSG("File length table RAM: %d x %d = %d bytes" TENDSTR,
+			dev->tree.file_len_num, (int)sizeof(u32),
+			dev->tree.file_len_num * (int)sizeof(u32));
+#endif
 	MSG("TagStore size:         %d" TENDSTR, sizeof(struct uffs_TagStoreSt));
 	MSG("MaxCachedBlockInfo:    %d" TENDSTR, dev->cfg.bc_caches);
 	MSG("MaxPageBuffers:        %d" TENDSTR, dev->cfg.page_buffers);
 	MSG("MaxDirtyPagesPerBlock: %d" TENDSTR, dev->cfg.dirty_pages);
 	MSG("MaxPathLength:         %d" TENDSTR, MAX_PATH_LENGTH);
-	MSG("MaxObjectHandles:      %d" TENDSTR, MAX_OBJECT_HANDLE);
+	MSG("MaxObjectHandles:      %d (limit %d)" TENDSTR, uffs_GetObjectPool()->num_bufs, MAX_OBJECT_HANDLE_LIMIT);
 	MSG("FreeObjectHandles:     %d" TENDSTR, uffs_GetFreeObjectHandlers());
-	MSG("MaxDirHandles:         %d" TENDSTR, MAX_DIR_HANDLE);
+	MSG("MaxDirHandles:         %d (limit %d)" TENDSTR, uffs_DirEntryBufGetPool()->num_bufs, MAX_DIR_HANDLE_LIMIT);
 	MSG("FreeDirHandles:        %d" TENDSTR, uffs_PoolGetFreeCount(uffs_DirEntryBufGetPool()));
 
 	MSG("----------- statistics for '%s' -----------" TENDSTR, mount);
@@ -355,8 +364,18 @@ static int cmd_st(int argc, char *argv[])
 	MSG("Read Page:             %d" TENDSTR, s->page_read_count - s->page_header_read_count);
 	MSG("Read Header:           %d" TENDSTR, s->page_header_read_count);
 	MSG("Read Spare:            %d" TENDSTR, s->spare_read_count);
+	MSG("Read Spare Batch:      %d" TENDSTR, s->spare_batch_read_count);
 	MSG("I/O Read:              %lu" TENDSTR, s->io_read);
 	MSG("I/O Write:             %lu" TENDSTR, s->io_write);
+	MSG("Page Buffer Hit/Miss:  %d/%d (%d%%)" TENDSTR, s->page_buf_hit, s->page_buf_miss,
+			s->page_buf_hit + s->page_buf_miss > 0 ?
+			s->page_buf_hit * 100 / (s->page_buf_hit + s->page_buf_miss) : 0);
+#ifdef CONFIG_UFFS_INFO_CACHE
+	MSG("Info Cache Hit/Miss:   %d/%d" TENDSTR, dev->info_cache.hit, dev->info_cache.miss);
+#endif
+#ifdef CONFIG_UFFS_DENTRY_CACHE
+	MSG("Dentry Cache Hit/Miss: %d/%d" TENDSTR, dev->dentry_cache.hit, dev->dentry_cache.miss);
+#endif
 
 	MSG("--------- partition info for '%s' ---------" TENDSTR, mount);
 	MSG("Space total:           %d" TENDSTR, uffs_GetDeviceTotal(dev));
@@ -372,7 +391,7 @@ static int cmd_st(int argc, char *argv[])
 		node = dev->tree.bad;
 		while(node) {
 			MSG("%d, ", node->u.list.block);
-			node = node->u.list.next;
+			node = LIST_NEXT(dev, node);
 		}
 		MSG(TENDSTR);
 	}
@@ -606,6 +625,44 @@ static int cmd_inspb(int argc, char *argv[])
 
 }
 
+/** list dir entries with stat, in on-flash block order
+ *		ll [<dir>]
+ */
+static int cmd_ll(int argc, char *argv[])
+{
+	uffs_DIR *dirp;
+	struct uffs_direntplus ents[8];
+	const char *name = "/";
+	int count = 0;
+	int i, n;
+
+	CHK_ARGC(1, 2);
+
+	if (argc > 1)
+		name = argv[1];
+
+	dirp = uffs_opendir(name);
+	if (dirp == NULL) {
+		MSGLN("Can't open '%s' for list", name);
+		return -1;
+	}
+
+	MSG("------name-----------size---------serial-----mtime----" TENDSTR);
+	while ((n = uffs_readdirplus(dirp, ents, ARRAY_SIZE(ents), UFFS_READDIR_BLOCK_ORDER)) > 0) {
+		for (i = 0; i < n; i++) {
+			MSG("%9s%c  \t %8ld \t%6d \t%u" TENDSTR, ents[i].d.d_name,
+					(ents[i].st.st_mode & US_IFDIR) ? '/' : ' ',
+					ents[i].st.st_size, ents[i].st.st_ino, ents[i].st.st_mtime);
+		}
+		count += n;
+	}
+	uffs_closedir(dirp);
+
+	MSG("Total: %d objects." TENDSTR, count);
+
+	return (n < 0 ? -1 : 0);
+}
+
 /** print block wear-leveling information
  *		wl [<mount>]
  */
@@ -663,6 +720,114 @@ static int cmd_wl(int argc, char *argv[])
 	return 0;
 }
 
+/** process pending bad/refresh blocks
+ *		pending [<mount>] [<budget_ms>]
+ */
+static int cmd_pending(int argc, char *argv[])
+{
+	const char *mount = "/";
+	int budget_ms = 0;
+	int remain;
+
+	CHK_ARGC(1, 3);
+
+	if (argc > 1)
+		mount = argv[1];
+	if (argc > 2)
+		budget_ms = strtol(argv[2], NULL, 10);
+
+	remain = uffs_process_pending(mount, budget_ms);
+	if (remain < 0) {
+		MSGLN("Can't process pending blocks of %s", mount);
+		return -1;
+	}
+	MSGLN("%d block(s) still pending", remain);
+
+	return 0;
+}
+
+#ifdef CONFIG_UFFS_TRACE
+
+#define TRACE_RING_SIZE		256
+
+static uffs_TraceRecord m_trace_recs[TRACE_RING_SIZE];
+static uffs_TraceRing m_trace_ring;
+
+/** capture and dump trace records
+ *		trace on|off
+ *		trace dump [<min duration>]
+ *		trace save <host file>
+ */
+static int cmd_trace(int argc, char *argv[])
+{
+	static const char *ev_names[] = UFFS_TRACE_EV_NAME_STRING;
+	uffs_TraceRecord rec;
+	u32 min = 0;
+	int n = 0, shown = 0;
+	FILE *fp;
+
+	CHK_ARGC(2, 3);
+
+	if (strcmp(argv[1], "on") == 0) {
+		uffs_TraceSetHook(NULL, NULL);
+		uffs_TraceRingRelease(&m_trace_ring);
+		if (uffs_TraceRingInit(&m_trace_ring, m_trace_recs, TRACE_RING_SIZE) != U_SUCC) {
+			MSGLN("Can't init trace ring buffer.");
+			return -1;
+		}
+		uffs_TraceSetHook(uffs_TraceRingHook, &m_trace_ring);
+		MSGLN("Trace started, ring buffer %d records.", TRACE_RING_SIZE);
+	}
+	else if (strcmp(argv[1], "off") == 0) {
+		uffs_TraceSetHook(NULL, NULL);
+		MSGLN("Trace stopped, %d records in ring buffer, %d lost.",
+				m_trace_ring.count, m_trace_ring.lost);
+	}
+	else if (strcmp(argv[1], "dump") == 0) {
+		if (argc > 2 && sscanf(argv[2], "%u", &min) != 1)
+			return CLI_INVALID_ARG;
+
+		MSG("   start(us) duration(us) event    dev  block  page serial arg result\n");
+		while (uffs_TraceRingRead(&m_trace_ring, &rec, 1) == 1) {
+			n++;
+			if (rec.duration < min)
+				continue;
+			MSG("%12u %12u %-8s %3d %6d %5d %6d %3d %s\n",
+				rec.start, rec.duration,
+				rec.event <= UFFS_TRACE_EV_BADBLOCK_RECOVER ? ev_names[rec.event] : "?",
+				rec.dev, rec.block, rec.page, rec.serial, rec.arg,
+				rec.result == UFFS_TRACE_OK ? "ok" : "fail");
+			shown++;
+		}
+		MSG("%d records read, %d shown, %d lost.\n", n, shown, m_trace_ring.lost);
+	}
+	else if (strcmp(argv[1], "save") == 0) {
+		if (argc < 3)
+			return CLI_INVALID_ARG;
+
+		fp = fopen(argv[2], "wb");
+		if (fp == NULL) {
+			MSGLN("Can't create host file %s", argv[2]);
+			return -1;
+		}
+		while (uffs_TraceRingRead(&m_trace_ring, &rec, 1) == 1) {
+			if (fwrite(&rec, sizeof(rec), 1, fp) != 1) {
+				MSGLN("Write host file %s fail.", argv[2]);
+				break;
+			}
+			n++;
+		}
+		fclose(fp);
+		MSGLN("%d records (%d bytes each) saved to %s", n, (int)sizeof(rec), argv[2]);
+	}
+	else {
+		return CLI_INVALID_ARG;
+	}
+
+	return 0;
+}
+#endif
+
 static const struct cli_command helper_cmds[] = 
 {
     { cmd_format,	"format",		"[<mount>]",		"Format device" },
@@ -679,8 +844,13 @@ static const struct cli_command helper_cmds[] =
     { cmd_mount,	"mount",		"[<mount>]",		"mount partition or list mounted partitions" },
     { cmd_unmount,	"umount",		"[<mount>]",		"unmount partition" },
 	{ cmd_dump,		"dump",			"[<mount>]",		"dump file system", },
+	{ cmd_ll,		"ll",			"[<dir>]",			"list dirs and files with stat", },
 	{ cmd_wl,		"wl",			"[<mount>]",		"show block wear-leveling info", },
 	{ cmd_inspb,	"inspb",		"[<mount>]",		"inspect buffer", },
+	{ cmd_pending,	"pending",		"[<mount>] [<ms>]",	"process pending bad/refresh blocks", },
+#ifdef CONFIG_UFFS_TRACE
+	{ cmd_trace,	"trace",		"on|off|dump [<min>]|save <file>",	"capture trace records", },
+#endif
     { NULL, NULL, NULL, NULL }
 };
 
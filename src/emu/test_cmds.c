@@ -47,6 +47,7 @@
 #include "uffs/uffs_find.h"
 #include "uffs/uffs_badblock.h"
 #include "uffs/uffs_tree.h"
+#include "uffs/uffs_aio.h"
 #include "cmdline.h"
 #include "api_test.h"
 
@@ -297,7 +298,9 @@ exit_test:
 static int cmd_t2(int argc, char *argv[])
 {
 	URET ret;
-	MSGLN("Test return: %s !", (ret = DoTest2()) == U_SUCC ? "succ" : "failed");
+
+	ret = DoTest2();
+	MSGLN("Test return: %s !", ret == U_SUCC ? "succ" : "failed");
 
 	return (ret == U_SUCC) ? 0 : -1;
 }
@@ -637,7 +640,7 @@ static int cmd_TestPageReadWrite(int argc, char *argv[])
 	uffs_Tags local_tag;
 	uffs_Tags *tag = &local_tag;
 	int ret;
-	u16 block;
+	uffs_BlockNum block;
 	u16 page;
 	uffs_Buf *buf = NULL;
 
@@ -667,7 +670,7 @@ static int cmd_TestPageReadWrite(int argc, char *argv[])
 
 	TAG_DIRTY_BIT(tag) = TAG_DIRTY;
 	TAG_VALID_BIT(tag) = TAG_VALID;
-	TAG_DATA_LEN(tag) = dev->com.pg_data_size;
+	TAG_SET_DATA_LEN(tag, dev->com.pg_data_size);
 	TAG_TYPE(tag) = UFFS_TYPE_DATA;
 	TAG_PAGE_ID(tag) = 3;
 	TAG_PARENT(tag) = 100;
@@ -933,6 +936,330 @@ ext:
 
 }
 
+/**
+ * Open <n> files and dirs at the same time, check fds are all usable
+ * and closed or never opened fds are rejected.
+ *
+ *		t_mfd [<n> [<dir>]]
+ */
+static int cmd_TestManyFds(int argc, char *argv[])
+{
+	const char *start = "/";
+	int count = 8;
+	int fds[200];
+	uffs_DIR *dirs[200];
+	int i, fd, opened = 0, dir_opened = 0;
+	char name[128];
+	char buf[32];
+	UBOOL succ = U_TRUE;
+
+	if (argc > 1) {
+		count = strtol(argv[1], NULL, 10);
+		if (argc > 2)
+			start = argv[2];
+	}
+	if (count > ARRAY_SIZE(fds))
+		count = ARRAY_SIZE(fds);
+
+	for (opened = 0; opened < count; opened++) {
+		sprintf(name, "%sfd%03d", start, opened);
+		fds[opened] = uffs_open(name, UO_RDWR|UO_CREATE|UO_TRUNC);
+		if (fds[opened] < 0) {
+			MSGLN("Open file %s failed, %d files opened", name, opened);
+			succ = U_FALSE;
+			break;
+		}
+		if (uffs_write(fds[opened], name, strlen(name)) != strlen(name)) {
+			MSGLN("Write file %s failed", name);
+			opened++;
+			succ = U_FALSE;
+			break;
+		}
+	}
+
+	// only our files are open now, the slot after the highest fd is free
+	for (i = 0, fd = -1; i < opened; i++) {
+		if (fds[i] > fd)
+			fd = fds[i];
+	}
+	if (opened > 0 && uffs_read(fd + 1, buf, sizeof(buf)) >= 0) {
+		MSGLN("Read a not opened fd %d success ?", fd + 1);
+		succ = U_FALSE;
+	}
+
+	for (dir_opened = 0; succ && dir_opened < count; dir_opened++) {
+		dirs[dir_opened] = uffs_opendir(start);
+		if (dirs[dir_opened] == NULL) {
+			MSGLN("Open dir %s failed, %d dirs opened", start, dir_opened);
+			succ = U_FALSE;
+			break;
+		}
+	}
+
+	for (i = 0; succ && i < opened; i++) {
+		sprintf(name, "%sfd%03d", start, i);
+		memset(buf, 0, sizeof(buf));
+		if (uffs_seek(fds[i], 0, USEEK_SET) != 0 ||
+			uffs_read(fds[i], buf, sizeof(buf)) != strlen(name) ||
+			memcmp(buf, name, strlen(name)) != 0) {
+			MSGLN("Read back file %s (fd %d) failed", name, fds[i]);
+			succ = U_FALSE;
+		}
+	}
+
+	for (i = 0; i < dir_opened; i++)
+		uffs_closedir(dirs[i]);
+	for (i = 0; i < opened; i++)
+		uffs_close(fds[i]);
+
+	// closed fd/dir can't be used any more
+	if (opened > 0 && uffs_read(fds[0], buf, sizeof(buf)) >= 0) {
+		MSGLN("Read a closed fd %d success ?", fds[0]);
+		succ = U_FALSE;
+	}
+	if (dir_opened > 0 && uffs_readdir(dirs[0]) != NULL) {
+		MSGLN("Read a closed dir success ?");
+		succ = U_FALSE;
+	}
+
+	for (i = 0; i < opened; i++) {
+		sprintf(name, "%sfd%03d", start, i);
+		uffs_remove(name);
+	}
+
+	MSGLN("Many fds test %s !", succ ? "SUCC" : "FAILED");
+	return succ ? 0 : -1;
+}
+
+#define MT_MAX_TASKS	8
+#define MT_FILE_SIZE	2000
+
+struct mt_task_arg {
+	OSTASK task;
+	const char *mount;
+	int rounds;
+	int task_id;
+	UBOOL succ;
+};
+
+static void mt_task_main(void *p)
+{
+	struct mt_task_arg *arg = (struct mt_task_arg *)p;
+	u8 wbuf[MT_FILE_SIZE], rbuf[MT_FILE_SIZE];
+	char name[128];
+	int i, j, fd;
+
+	arg->task_id = uffs_OSGetTaskId();
+	sprintf(name, "%smt_test", arg->mount);
+
+	for (i = 0; arg->succ && i < arg->rounds; i++) {
+		for (j = 0; j < MT_FILE_SIZE; j++)
+			wbuf[j] = (u8)(j + i + arg->task_id);
+
+		fd = uffs_open(name, UO_RDWR|UO_CREATE|UO_TRUNC);
+		if (fd < 0 ||
+			uffs_write(fd, wbuf, MT_FILE_SIZE) != MT_FILE_SIZE ||
+			uffs_seek(fd, 0, USEEK_SET) != 0 ||
+			uffs_read(fd, rbuf, MT_FILE_SIZE) != MT_FILE_SIZE ||
+			memcmp(wbuf, rbuf, MT_FILE_SIZE) != 0) {
+			MSGLN("task %d: write/read %s failed at round %d", arg->task_id, name, i);
+			arg->succ = U_FALSE;
+		}
+		if (fd >= 0)
+			uffs_close(fd);
+
+		// error code must not be changed by other tasks
+		sprintf(name, "%smt_none", arg->mount);
+		if (uffs_open(name, UO_RDONLY) >= 0 || uffs_get_error() != -UENOENT) {
+			MSGLN("task %d: expect UENOENT, got %d", arg->task_id, uffs_get_error());
+			arg->succ = U_FALSE;
+		}
+		sprintf(name, "%smt_test", arg->mount);
+	}
+
+	uffs_remove(name);
+}
+
+static int cmd_TestMultiTask(int argc, char *argv[])
+{
+	struct mt_task_arg args[MT_MAX_TASKS];
+	uffs_MountTable *mtb;
+	int rounds = 10;
+	int i, n = 0;
+	UBOOL succ = U_TRUE;
+
+	if (argc > 1)
+		rounds = strtol(argv[1], NULL, 10);
+
+	for (mtb = uffs_MtbGetMounted(); mtb && n < MT_MAX_TASKS; mtb = mtb->next, n++) {
+		args[n].mount = mtb->mount;
+		args[n].rounds = rounds;
+		args[n].task_id = UFFS_TASK_ID_NOT_EXIST;
+		args[n].succ = U_TRUE;
+		args[n].task = OSTASK_NOT_CREATED;
+	}
+
+	for (i = 0; i < n; i++) {
+		if (uffs_OSTaskCreate(&args[i].task, mt_task_main, &args[i]) != 0) {
+			MSGLN("Create task for %s failed", args[i].mount);
+			args[i].succ = U_FALSE;
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		if (args[i].task != OSTASK_NOT_CREATED)
+			uffs_OSTaskJoin(&args[i].task);
+		MSGLN("%s: task %d %s", args[i].mount, args[i].task_id, args[i].succ ? "succ" : "failed");
+		if (!args[i].succ)
+			succ = U_FALSE;
+	}
+
+	MSGLN("Multi task test on %d partitions %s !", n, succ ? "SUCC" : "FAILED");
+	return succ ? 0 : -1;
+}
+
+#ifdef CONFIG_UFFS_AIO
+#define AIO_MAX_REQS	32
+#define AIO_SEG_SIZE	100
+
+static void aio_test_done(struct uffs_aiocb *cb)
+{
+	uffs_EventSignal((OSEVENT)cb->user);
+}
+
+/** test asynchronous write/flush/read/close of a file */
+static int cmd_TestAio(int argc, char *argv[])
+{
+	static struct uffs_aiocb cbs[AIO_MAX_REQS + 4];
+	static u8 wbuf[AIO_MAX_REQS * AIO_SEG_SIZE], rbuf[AIO_MAX_REQS * AIO_SEG_SIZE];
+	struct uffs_aiocb *cb;
+	uffs_AioQueue q;
+	OSEVENT ev = OSEVENT_NOT_INITED;
+	const char *name = "/aio_test";
+	int n = 16;
+	int i, fd;
+	UBOOL succ = U_TRUE;
+
+	if (argc > 1)
+		n = strtol(argv[1], NULL, 10);
+	if (n <= 0 || n > AIO_MAX_REQS)
+		n = AIO_MAX_REQS;
+
+	if (uffs_aio_queue_init(&q) < 0 || uffs_EventCreate(&ev) < 0) {
+		MSGLN("Can't create aio queue or event");
+		return -1;
+	}
+
+	fd = uffs_open(name, UO_RDWR|UO_CREATE|UO_TRUNC);
+	if (fd < 0) {
+		MSGLN("Can't open %s", name);
+		succ = U_FALSE;
+		goto ext;
+	}
+
+	for (i = 0; i < n * AIO_SEG_SIZE; i++)
+		wbuf[i] = (u8)(i + i / AIO_SEG_SIZE);
+	memset(rbuf, 0, sizeof(rbuf));
+
+	// adjacent writes followed by repeated flushes, completed on queue
+	memset(cbs, 0, sizeof(cbs));
+	for (i = 0; i < n + 3; i++) {
+		cbs[i].fd = fd;
+		cbs[i].cq = &q;
+		if (i < n) {
+			cbs[i].op = UFFS_AIO_WRITE;
+			cbs[i].offset = i * AIO_SEG_SIZE;
+			cbs[i].buf = wbuf + i * AIO_SEG_SIZE;
+			cbs[i].len = AIO_SEG_SIZE;
+		}
+		else {
+			cbs[i].op = UFFS_AIO_FLUSH;
+		}
+		if (uffs_aio_submit(&cbs[i]) < 0) {
+			MSGLN("Submit request %d failed, err = %d", i, uffs_get_error());
+			succ = U_FALSE;
+			goto ext;
+		}
+	}
+	for (i = 0; i < n + 3; i++) {
+		cb = uffs_aio_queue_get(&q, U_TRUE);
+		if (cb->result != (cb->op == UFFS_AIO_WRITE ? AIO_SEG_SIZE : 0) || cb->error != UENOERR) {
+			MSGLN("Request %d (op %d) result %d, err %d", (int)(cb - cbs), cb->op, cb->result, cb->error);
+			succ = U_FALSE;
+		}
+	}
+
+	// adjacent reads and one past end of file, completed by callback
+	memset(cbs, 0, sizeof(cbs));
+	for (i = 0; i < n + 1; i++) {
+		cbs[i].op = UFFS_AIO_READ;
+		cbs[i].fd = fd;
+		cbs[i].offset = i * AIO_SEG_SIZE;
+		cbs[i].buf = (i < n ? rbuf + i * AIO_SEG_SIZE : wbuf);	// wbuf: nothing to read
+		cbs[i].len = AIO_SEG_SIZE;
+		cbs[i].done = aio_test_done;
+		cbs[i].user = ev;
+		if (uffs_aio_submit(&cbs[i]) < 0) {
+			MSGLN("Submit read %d failed, err = %d", i, uffs_get_error());
+			succ = U_FALSE;
+			goto ext;
+		}
+	}
+	for (i = 0; i < n + 1; i++)
+		uffs_EventWait(ev);
+
+	for (i = 0; i < n + 1; i++) {
+		if (cbs[i].result != (i < n ? AIO_SEG_SIZE : 0) || cbs[i].error != UENOERR) {
+			MSGLN("Read %d result %d, err %d", i, cbs[i].result, cbs[i].error);
+			succ = U_FALSE;
+		}
+	}
+	if (memcmp(wbuf, rbuf, n * AIO_SEG_SIZE) != 0) {
+		MSGLN("Read back data mismatch");
+		succ = U_FALSE;
+	}
+
+	// close, completion polled from queue
+	memset(cbs, 0, sizeof(cbs));
+	cbs[0].op = UFFS_AIO_CLOSE;
+	cbs[0].fd = fd;
+	cbs[0].cq = &q;
+	if (uffs_aio_submit(&cbs[0]) < 0) {
+		MSGLN("Submit close failed, err = %d", uffs_get_error());
+		succ = U_FALSE;
+		goto ext;
+	}
+	while ((cb = uffs_aio_queue_get(&q, U_FALSE)) == NULL)
+		;
+	if (cb->result != 0) {
+		MSGLN("Close result %d, err %d", cb->result, cb->error);
+		succ = U_FALSE;
+	}
+	else {
+		fd = -1;
+	}
+
+	// request on closed fd is rejected
+	cbs[1].op = UFFS_AIO_FLUSH;
+	cbs[1].fd = cbs[0].fd;
+	cbs[1].cq = &q;
+	if (uffs_aio_submit(&cbs[1]) == 0 || uffs_get_error() != -UEBADF) {
+		MSGLN("Submit to closed fd accepted ?");
+		succ = U_FALSE;
+	}
+
+ext:
+	if (fd >= 0)
+		uffs_close(fd);
+	uffs_remove(name);
+	uffs_EventDelete(&ev);
+	uffs_aio_queue_release(&q);
+
+	MSGLN("Aio test %s !", succ ? "SUCC" : "FAILED");
+	return succ ? 0 : -1;
+}
+#endif
+
 /**
  * Open <file> with <oflag>, save fd to $1
  *
@@ -1147,6 +1474,282 @@ static int cmd_truncate(int argc, char *argv[])
 	return (ret < 0 ? -1 : 0);
 }
 
+/**
+ * reserve blocks for appending <len> bytes to <fd>,
+ * number of reserved blocks on the device save to $1
+ *	t_fallocate <fd> <len> [<mount>]
+ */
+static int cmd_tfallocate(int argc, char *argv[])
+{
+	int fd;
+	long len;
+	const char *mount = "/";
+	uffs_Device *dev;
+	int ret = 0;
+
+	CHK_ARGC(3, 4);
+	if (sscanf(argv[1], "%d", &fd) != 1 ||
+		sscanf(argv[2], "%ld", &len) != 1) {
+		return -1;
+	}
+
+	if (argc > 3)
+		mount = argv[3];
+
+	if (uffs_fallocate(fd, len) < 0) {
+		MSGLN("fallocate fail! fd = %d, len = %ld, err = %d", fd, len, uffs_get_error());
+		ret = -1;
+	}
+
+	dev = uffs_GetDeviceFromMountPoint(mount);
+	if (dev == NULL) {
+		MSGLN("Can't get device from mount point %s", mount);
+		return -1;
+	}
+	cli_env_set('1', dev->tree.prealloc_count);
+	uffs_PutDevice(dev);
+
+	return ret;
+}
+
+/**
+ * get serial (inode number) of <obj>, save to $1
+ *	t_serial <obj>
+ */
+static int cmd_tserial(int argc, char *argv[])
+{
+	struct uffs_stat st;
+
+	CHK_ARGC(2, 2);
+
+	if (uffs_stat(argv[1], &st) < 0) {
+		MSGLN("stat %s fail, err = %d", argv[1], uffs_get_error());
+		return -1;
+	}
+	cli_env_set('1', st.st_ino);
+
+	return 0;
+}
+
+/**
+ * get used space of partition, save to $1
+ *	t_used <mount>
+ */
+static int cmd_tused(int argc, char *argv[])
+{
+	unsigned long used;
+
+	CHK_ARGC(2, 2);
+
+	if (uffs_space_used(argv[1], &used) < 0) {
+		MSGLN("get used space of %s fail, err = %d", argv[1], uffs_get_error());
+		return -1;
+	}
+	cli_env_set('1', (int)used);
+
+	return 0;
+}
+
+/**
+ * get bad blocks of partition: number of bad blocks to $1,
+ * sum of bad block numbers to $2
+ *	t_bad <mount>
+ */
+static int cmd_tbad(int argc, char *argv[])
+{
+	uffs_Device *dev;
+	TreeNode *node;
+	int sum = 0;
+
+	CHK_ARGC(2, 2);
+
+	dev = uffs_GetDeviceFromMountPoint(argv[1]);
+	if (dev == NULL) {
+		MSGLN("Can't get device from mount point %s", argv[1]);
+		return -1;
+	}
+
+	for (node = dev->tree.bad; node != NULL; node = LIST_NEXT(dev, node))
+		sum += node->u.list.block;
+
+	cli_env_set('1', dev->tree.bad_count);
+	cli_env_set('2', sum);
+	uffs_PutDevice(dev);
+
+	return 0;
+}
+
+#ifdef CONFIG_UFFS_BBT
+static uffs_Device *m_bbt_fail_dev = NULL;
+static struct uffs_FlashOpsSt *m_bbt_fail_ops_orig = NULL;
+static struct uffs_FlashOpsSt m_bbt_fail_ops;
+
+static UBOOL _IsBbtBlock(uffs_Device *dev, u32 block)
+{
+	int i;
+
+	for (i = 0; i < UFFS_BBT_BLOCKS; i++) {
+		if (dev->bbt.count > 0 && dev->bbt.blocks[i] == block)
+			return U_TRUE;
+	}
+	return U_FALSE;
+}
+
+static int bbt_fail_WritePage(uffs_Device *dev, u32 block, u32 page,
+							const u8 *data, int data_len, const u8 *spare, int spare_len)
+{
+	if (_IsBbtBlock(dev, block))
+		return UFFS_FLASH_IO_ERR;
+	return m_bbt_fail_ops_orig->WritePage(dev, block, page, data, data_len, spare, spare_len);
+}
+
+static int bbt_fail_WritePageWithLayout(uffs_Device *dev, u32 block, u32 page,
+							const u8 *data, int data_len, const u8 *ecc, const uffs_TagStore *ts)
+{
+	if (_IsBbtBlock(dev, block))
+		return UFFS_FLASH_IO_ERR;
+	return m_bbt_fail_ops_orig->WritePageWithLayout(dev, block, page, data, data_len, ecc, ts);
+}
+#endif
+
+/**
+ * take an erased block of partition and retire it as a bad block,
+ * the block number is saved to $1. With <fail_bbt> 1, writing BBT pages
+ * fails from now on, until t_markbad is called again.
+ *	t_markbad <mount> [<fail_bbt>]
+ */
+static int cmd_tmarkbad(int argc, char *argv[])
+{
+	uffs_Device *dev;
+	TreeNode *node;
+	int fail_bbt = 0;
+
+	CHK_ARGC(2, 3);
+	if (argc > 2 && sscanf(argv[2], "%d", &fail_bbt) != 1)
+		return -1;
+
+#ifdef CONFIG_UFFS_BBT
+	if (m_bbt_fail_dev) {
+		m_bbt_fail_dev->ops = m_bbt_fail_ops_orig;
+		m_bbt_fail_dev = NULL;
+	}
+#endif
+
+	dev = uffs_GetDeviceFromMountPoint(argv[1]);
+	if (dev == NULL) {
+		MSGLN("Can't get device from mount point %s", argv[1]);
+		return -1;
+	}
+
+#ifdef CONFIG_UFFS_BBT
+	if (fail_bbt) {
+		m_bbt_fail_ops_orig = dev->ops;
+		m_bbt_fail_ops = *dev->ops;
+		if (m_bbt_fail_ops.WritePage)
+			m_bbt_fail_ops.WritePage = bbt_fail_WritePage;
+		if (m_bbt_fail_ops.WritePageWithLayout)
+			m_bbt_fail_ops.WritePageWithLayout = bbt_fail_WritePageWithLayout;
+		dev->ops = &m_bbt_fail_ops;
+		m_bbt_fail_dev = dev;
+	}
+#endif
+
+	uffs_DeviceLock(dev);
+	node = uffs_TreeGetErasedNode(dev);
+	if (node)
+		uffs_BadBlockProcessNode(dev, node);
+	uffs_DeviceUnLock(dev);
+
+	if (node == NULL) {
+		MSGLN("no erased block");
+		uffs_PutDevice(dev);
+		return -1;
+	}
+
+	MSGLN("block %d is marked bad", node->u.list.block);
+	cli_env_set('1', node->u.list.block);
+	uffs_PutDevice(dev);
+
+	return 0;
+}
+
+/**
+ * read <dir> by uffs_readdirplus() while information of file <serial> can't
+ * be loaded, the error must be reported and no other entry is lost.
+ * Number of entries read saved to $1.
+ *	t_bulk <dir> <serial> [<flags>]
+ */
+static int cmd_tbulk(int argc, char *argv[])
+{
+	uffs_Device *dev;
+	uffs_DIR *dirp;
+	TreeNode *node;
+	struct uffs_direntplus ents[32];
+	uffs_BlockNum block;
+	int serial, n, i, round;
+	int flags = 0;
+	int total = 0, errors = 0, ret = 0;
+
+	CHK_ARGC(3, 4);
+	if (sscanf(argv[2], "%d", &serial) != 1)
+		return -1;
+	if (argc > 3 && sscanf(argv[3], "%d", &flags) != 1)
+		return -1;
+
+	dev = uffs_GetDeviceFromMountPoint("/");
+	if (dev == NULL) {
+		MSGLN("Can't get device from mount point /");
+		return -1;
+	}
+
+	node = uffs_TreeFindFileNode(dev, (u16)serial);
+	if (node == NULL || dev->tree.erased == NULL) {
+		MSGLN("file %d not found, or no erased block", serial);
+		uffs_PutDevice(dev);
+		return -1;
+	}
+
+	dirp = uffs_opendir(argv[1]);
+	if (dirp == NULL) {
+		MSGLN("Can't open dir %s, err = %d", argv[1], uffs_get_error());
+		uffs_PutDevice(dev);
+		return -1;
+	}
+
+	// point the file to an erased block, so that its information can't be loaded
+	block = node->u.file.block;
+	node->u.file.block = dev->tree.erased->u.list.block;
+
+	for (round = 0; round < 100; round++) {
+		n = uffs_readdirplus(dirp, ents, ARRAY_SIZE(ents), flags);
+		if (uffs_get_error() != UENOERR)
+			errors++;
+		if (n == 0)
+			break;
+		for (i = 0; i < n; i++) {
+			if (ents[i].st.st_ino == serial) {
+				MSGLN("file %d is reported without information ?", serial);
+				ret = -1;
+			}
+		}
+		if (n > 0)
+			total += n;
+	}
+
+	node->u.file.block = block;
+	uffs_closedir(dirp);
+	uffs_PutDevice(dev);
+
+	MSGLN("%d entries read, %d error(s) reported", total, errors);
+	if (errors == 0) {
+		MSGLN("error is not reported ?");
+		ret = -1;
+	}
+	cli_env_set('1', total);
+
+	return ret;
+}
+
 /**
  * write random seq to file
  *	t_write_seq <fd> <size>
@@ -1225,6 +1828,148 @@ static int cmd_tread(int argc, char *argv[])
 }
 
 
+/**
+ * write <txt> to <fd> at <offset>, file pointer is not changed.
+ *	t_pwrite <fd> <offset> <txt>
+ */
+static int cmd_tpwrite(int argc, char *argv[])
+{
+	int fd;
+	long offset;
+	int len;
+
+	CHK_ARGC(4, 4);
+
+	if (sscanf(argv[1], "%d", &fd) != 1 ||
+		sscanf(argv[2], "%ld", &offset) != 1) {
+		return -1;
+	}
+
+	len = strlen(argv[3]);
+	if (uffs_pwrite(fd, argv[3], len, offset) != len)
+		return -1;
+
+	cli_env_set('1', len);
+
+	return 0;
+}
+
+/**
+ * read <fd> at <offset> and check against <txt>, file pointer is not changed.
+ *	t_pread <fd> <offset> <txt>
+ */
+static int cmd_tpread(int argc, char *argv[])
+{
+	int fd;
+	long offset;
+	int len, n;
+	char buf[64];
+	char *p;
+
+	CHK_ARGC(4, 4);
+
+	if (sscanf(argv[1], "%d", &fd) != 1 ||
+		sscanf(argv[2], "%ld", &offset) != 1) {
+		return -1;
+	}
+
+	len = strlen(argv[3]);
+	p = argv[3];
+	while (len > 0) {
+		n = (len > sizeof(buf) ? sizeof(buf) : len);
+		if (uffs_pread(fd, buf, n, offset) != n ||
+			memcmp(buf, p, n) != 0) {
+			return -1;
+		}
+		len -= n;
+		p += n;
+		offset += n;
+	}
+
+	return 0;
+}
+
+#define MAX_TEST_IOV	8
+
+/**
+ * write all <txt> segments to <fd> with one uffs_writev() call.
+ *	t_writev <fd> <txt> [...]
+ */
+static int cmd_twritev(int argc, char *argv[])
+{
+	int fd;
+	int i, len = 0;
+	struct uffs_iovec iov[MAX_TEST_IOV];
+
+	CHK_ARGC(3, MAX_TEST_IOV + 2);
+
+	if (sscanf(argv[1], "%d", &fd) != 1) {
+		return -1;
+	}
+
+	for (i = 2; i < argc; i++) {
+		iov[i - 2].iov_base = argv[i];
+		iov[i - 2].iov_len = strlen(argv[i]);
+		len += iov[i - 2].iov_len;
+	}
+
+	if (uffs_writev(fd, iov, argc - 2) != len)
+		return -1;
+
+	cli_env_set('1', len);
+
+	return 0;
+}
+
+/**
+ * read <fd> into segments sized as <txt> with one uffs_readv() call, and check.
+ *	t_readv <fd> <txt> [...]
+ */
+static int cmd_treadv(int argc, char *argv[])
+{
+	int fd;
+	int i, len = 0;
+	int ret = 0;
+	struct uffs_iovec iov[MAX_TEST_IOV];
+
+	CHK_ARGC(3, MAX_TEST_IOV + 2);
+
+	if (sscanf(argv[1], "%d", &fd) != 1) {
+		return -1;
+	}
+
+	memset(iov, 0, sizeof(iov));
+	for (i = 2; i < argc; i++) {
+		iov[i - 2].iov_len = strlen(argv[i]);
+		iov[i - 2].iov_base = malloc(iov[i - 2].iov_len + 1);
+		if (iov[i - 2].iov_base == NULL) {
+			ret = -1;
+			goto ext;
+		}
+		len += iov[i - 2].iov_len;
+	}
+
+	if (uffs_readv(fd, iov, argc - 2) != len) {
+		ret = -1;
+		goto ext;
+	}
+
+	for (i = 2; i < argc; i++) {
+		if (memcmp(iov[i - 2].iov_base, argv[i], iov[i - 2].iov_len) != 0) {
+			ret = -1;
+			break;
+		}
+	}
+
+ext:
+	for (i = 0; i < MAX_TEST_IOV; i++) {
+		if (iov[i].iov_base)
+			free(iov[i].iov_base);
+	}
+
+	return ret;
+}
+
 static void do_dump_page(uffs_Device *dev, uffs_Buf *buf)
 {
 	int i, j;
@@ -1253,7 +1998,7 @@ static void do_dump_tag(uffs_Device *dev, uffs_Tags *tag)
 			MSG("    page_id = %d\n", tag->s.page_id);
 			MSG("    serial = %d\n", tag->s.serial);
 			MSG("    parent = %d\n", tag->s.parent);
-			MSG("    data_len = %d\n", tag->s.data_len);
+			MSG("    data_len = %d\n", TAG_DATA_LEN(tag));
 		}
 		else {
 			MSG("  tag is GOOD but NOT DIRTY !!!???\n");
@@ -1341,12 +2086,27 @@ static const struct cli_command test_cmds[] =
     { cmd_TestFormat,			"t_format",		NULL,				"test format file system" },
 	{ cmd_TestPopulateFiles,	"t_pfs",		"[<start> [<n>]]",	"test populate <n> files under <start>" },
 	{ cmd_VerifyFile,			"t_vf",			"<file> [<noecc>]", "verify file" },
+	{ cmd_TestManyFds,			"t_mfd",		"[<n> [<dir>]]",	"test open <n> files and dirs at the same time" },
+	{ cmd_TestMultiTask,		"t_mt",			"[<rounds>]",		"test file I/O on all partitions, one task per partition" },
+#ifdef CONFIG_UFFS_AIO
+	{ cmd_TestAio,				"t_aio",		"[<n>]",			"test asynchronous write/flush/read/close with <n> requests" },
+#endif
 
 	{ cmd_topen,				"t_open",		"<oflg> <file>",	"open file, fd save to $1", },
 	{ cmd_tread,				"t_read",		"<fd> <txt>",		"read <fd> and check against <txt>", },
 	{ cmd_tcheck_seq,			"t_check_seq",	"<fd> <size>",		"read seq file <fd> and check", },
+	{ cmd_tpread,				"t_pread",		"<fd> <offset> <txt>",	"read <fd> at <offset> and check against <txt>", },
+	{ cmd_treadv,				"t_readv",		"<fd> <txt> [...]",	"readv <fd> and check against <txt> segments", },
 	{ cmd_twrite,				"t_write",		"<fd> <txt> [...]",	"write <fd>", },
+	{ cmd_tfallocate,			"t_fallocate",	"<fd> <len> [<mount>]",	"reserve blocks for appending <len> bytes to <fd>", },
+	{ cmd_tserial,				"t_serial",		"<obj>",				"get serial of <obj>", },
+	{ cmd_tused,				"t_used",		"<mount>",				"get used space of <mount>", },
+	{ cmd_tbad,					"t_bad",		"<mount>",				"get number of bad blocks of <mount>", },
+	{ cmd_tmarkbad,				"t_markbad",	"<mount> [<fail_bbt>]",	"retire an erased block of <mount> as bad block", },
+	{ cmd_tbulk,				"t_bulk",		"<dir> <serial> [<flags>]",		"read <dir> in bulk while file <serial> can't be loaded", },
 	{ cmd_twrite_seq,			"t_write_seq",	"<fd> <size>",	"write seq file <fd>", },
+	{ cmd_twritev,				"t_writev",		"<fd> <txt> [...]",	"writev <txt> segments to <fd>", },
+	{ cmd_tpwrite,				"t_pwrite",		"<fd> <offset> <txt>",	"write <fd> at <offset>", },
 	{ cmd_tseek,				"t_seek",		"<fd> <offset> [<origin>]",	"seek <fd> file pointer to <offset> from <origin>", },
 	{ cmd_tclose,				"t_close",		"<fd>",				"close <fd>", },
 	{ cmd_truncate,				"t_truncate",	"<fd> <remain>",	"change <fd> size to <remain>", },
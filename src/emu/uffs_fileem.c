@@ -70,10 +70,13 @@ URET femu_InitDevice(uffs_Device *dev)
 	uffs_FileEmu *emu = femu_GetPrivate();
 
 	// setup device storage attr and private data structure.
-	// all femu partition share one storage attribute
+	// all femu partition share one storage attribute, attach private data
+	// only once: with parallel mount, the partitions initialized earlier
+	// are already being scanned by their tasks.
 
 	dev->attr = femu_GetStorage();
-	dev->attr->_private = (void *) emu;
+	if (dev->attr->_private == NULL)
+		dev->attr->_private = (void *) emu;
 
 	// setup flash driver operations, according to the ecc option.
 	switch(dev->attr->ecc_opt) {
@@ -100,6 +103,13 @@ URET femu_InitDevice(uffs_Device *dev)
 	}
 #endif
 
+	// all partitions share one emulation file, serialize flash operations
+	// so that partitions can be mounted and accessed by different tasks.
+	if (!emu->lock_inited) {
+		femu_setup_lock_functions(dev);
+		emu->lock_inited = U_TRUE;
+	}
+
 	return U_SUCC;
 }
 
@@ -66,6 +66,9 @@ typedef struct uffs_FileEmuSt {
 	struct uffs_FlashOpsSt ops_orig;
 	UBOOL wrap_inited;
 #endif
+	OSSEM lock;							// serialize access to the emulation file
+	struct uffs_FlashOpsSt ops_unlocked;
+	UBOOL lock_inited;
 } uffs_FileEmu;
 
 /* file emulator device init/release entry */
@@ -78,6 +81,7 @@ struct uffs_FileEmuSt * femu_GetPrivate(void);
 #ifdef UFFS_FEMU_ENABLE_INJECTION
 void femu_setup_wrapper_functions(uffs_Device *dev);
 #endif
+void femu_setup_lock_functions(uffs_Device *dev);
 
 /* internal used functions, shared by all ecc option implementations */
 int femu_InitFlash(uffs_Device *dev);
@@ -85,7 +85,7 @@ static int femu_hw_WritePageWithLayout(uffs_Device *dev, u32 block, u32 page,
 			goto err;
 		}
 		
-		fseek(emu->fp, abs_page * full_page_size, SEEK_SET);
+		fseek(emu->fp, (long)abs_page * full_page_size, SEEK_SET);
 
 		written = fwrite(data, 1, data_len, emu->fp);
 		
@@ -114,7 +114,7 @@ static int femu_hw_WritePageWithLayout(uffs_Device *dev, u32 block, u32 page,
 		uffs_FlashMakeSpare(dev, ts, ecc_buf, spare);
 		spare_len = dev->mem.spare_data_size;
 		
-		fseek(emu->fp, abs_page * full_page_size + attr->page_data_size, SEEK_SET);
+		fseek(emu->fp, (long)abs_page * full_page_size + attr->page_data_size, SEEK_SET);
 		written = fwrite(spare, 1, spare_len, emu->fp);
 		if (written != spare_len) {
 			MSG("write spare I/O error ?");
@@ -127,7 +127,7 @@ static int femu_hw_WritePageWithLayout(uffs_Device *dev, u32 block, u32 page,
 
 	if (data == NULL && ts == NULL) {
 		// mark bad block
-		fseek(emu->fp, abs_page * full_page_size + attr->page_data_size + attr->block_status_offs, SEEK_SET);
+		fseek(emu->fp, (long)abs_page * full_page_size + attr->page_data_size + attr->block_status_offs, SEEK_SET);
 		written = fwrite("\0", 1, 1, emu->fp);
 		if (written != 1) {
 			MSG("write bad block mark I/O error ?");
@@ -169,7 +169,7 @@ static URET femu_hw_ReadPageWithLayout(uffs_Device *dev, u32 block, u32 page, u8
 		if (data_len > attr->page_data_size)
 			goto err;
 
-		fseek(emu->fp, abs_page * full_page_size, SEEK_SET);
+		fseek(emu->fp, (long)abs_page * full_page_size, SEEK_SET);
 		nread = fread(data, 1, data_len, emu->fp);
 
 		if (nread != data_len) {
@@ -188,7 +188,7 @@ static URET femu_hw_ReadPageWithLayout(uffs_Device *dev, u32 block, u32 page, u8
 	if (ts) {
 
 		spare_len = dev->mem.spare_data_size;
-		fseek(emu->fp, abs_page * full_page_size + attr->page_data_size, SEEK_SET);
+		fseek(emu->fp, (long)abs_page * full_page_size + attr->page_data_size, SEEK_SET);
 		nread = fread(spare, 1, spare_len, emu->fp);
 
 		if (nread != spare_len) {
@@ -205,7 +205,7 @@ static URET femu_hw_ReadPageWithLayout(uffs_Device *dev, u32 block, u32 page, u8
 
 	if (data == NULL && ts == NULL) {
 		// read bad block mark
-		fseek(emu->fp, abs_page * full_page_size + attr->page_data_size + attr->block_status_offs, SEEK_SET);
+		fseek(emu->fp, (long)abs_page * full_page_size + attr->page_data_size + attr->block_status_offs, SEEK_SET);
 		nread = fread(&status, 1, 1, emu->fp);
 
 		if (nread != 1) {
@@ -118,7 +118,7 @@ static int load_sdata(uffs_Device *dev, int block, int page)
 
 	abs_page = attr->pages_per_block * block + page;
 
-	fseek(emu->fp, abs_page * PAGE_FULL_SIZE, SEEK_SET);
+	fseek(emu->fp, (long)abs_page * PAGE_FULL_SIZE, SEEK_SET);
 	nread = fread(g_sdata_buf, 1, PAGE_FULL_SIZE, emu->fp);
 	g_sdata_buf_pointer = 0;
 
@@ -162,7 +162,7 @@ static int program_sdata(uffs_Device *dev, int block, int page)
 
 	abs_page = attr->pages_per_block * block + page;
 
-	fseek(emu->fp, abs_page * PAGE_FULL_SIZE, SEEK_SET);
+	fseek(emu->fp, (long)abs_page * PAGE_FULL_SIZE, SEEK_SET);
 	writtern = fwrite(g_sdata_buf, 1, PAGE_FULL_SIZE, emu->fp);
 ext:
 	return (writtern == PAGE_FULL_SIZE) ? UFFS_FLASH_NO_ERR : UFFS_FLASH_IO_ERR;
@@ -63,7 +63,7 @@ static u8 g_page_buf[UFFS_MAX_PAGE_SIZE + UFFS_MAX_SPARE_SIZE];
 int femu_InitFlash(uffs_Device *dev)
 {
 	int i;
-	int fSize;
+	long fSize;
 	int written;
 	u8 * p = g_page_buf;
 	uffs_FileEmu *emu;
@@ -112,7 +112,7 @@ int femu_InitFlash(uffs_Device *dev)
 		fseek(emu->fp, 0, SEEK_END);
 		fSize = ftell(emu->fp);
 		
-		if (fSize < total_pages * full_page_size)	{
+		if (fSize < (long)total_pages * full_page_size)	{
 			printf("Creating uffs emulation file\n");
 			fseek(emu->fp, 0, SEEK_SET);
 			memset(p, 0xff, full_page_size);
@@ -212,7 +212,7 @@ int femu_EraseBlock(uffs_Device *dev, u32 blockNumber)
 		
 		memset(pg, 0xff, (pgd_size + sp_size));
 		
-		fseek(emu->fp, blockNumber * blk_pgs * (pgd_size + sp_size), SEEK_SET);
+		fseek(emu->fp, (long)blockNumber * blk_pgs * (pgd_size + sp_size), SEEK_SET);
 		
 		for (i = 0; i < blk_pgs; i++)	{
 			fwrite(pg, 1, (pgd_size + sp_size), emu->fp);
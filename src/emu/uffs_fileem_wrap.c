@@ -93,6 +93,8 @@ static int femu_ReadPage_wrap(uffs_Device *dev, u32 block, u32 page, u8 *data, i
 							u8 *spare, int spare_len);
 static int femu_ReadPageWithLayout_wrap(uffs_Device *dev, u32 block, u32 page, u8* data, int data_len, u8 *ecc,
 									uffs_TagStore *ts, u8 *ecc_store);
+static int femu_ReadPageSpares_wrap(uffs_Device *dev, u32 block, u32 page, int n_pages,
+							u8 *spares, int spare_len, int *results);
 static int femu_WritePage_wrap(uffs_Device *dev, u32 block, u32 page,
 							const u8 *data, int data_len, const u8 *spare, int spare_len);
 static int femu_WritePageWithLayout_wrap(uffs_Device *dev, u32 block, u32 page, const u8* data, int data_len, const u8 *ecc,
@@ -119,6 +121,8 @@ void femu_setup_wrapper_functions(uffs_Device *dev)
 		dev->ops->ReadPage = femu_ReadPage_wrap;
 	if (dev->ops->ReadPageWithLayout)
 		dev->ops->ReadPageWithLayout = femu_ReadPageWithLayout_wrap;
+	if (dev->ops->ReadPageSpares)
+		dev->ops->ReadPageSpares = femu_ReadPageSpares_wrap;
 	if (dev->ops->WritePage)
 		dev->ops->WritePage = femu_WritePage_wrap;
 	if (dev->ops->WritePageWithLayout)
@@ -146,7 +150,7 @@ static int femu_InitFlash_wrap(uffs_Device *dev)
 			for (j = 0; j < ARRAY_SIZE(bad_blocks); j++) {
 				if (bad_blocks[j] < dev->attr->total_blocks) {
 					printf(" --- manufacture bad block %d ---\n", bad_blocks[j]);
-					fseek(emu->fp, bad_blocks[j] * blk_size + attr->page_data_size + dev->attr->block_status_offs, SEEK_SET);
+					fseek(emu->fp, (long)bad_blocks[j] * blk_size + attr->page_data_size + dev->attr->block_status_offs, SEEK_SET);
 					fwrite(&x, 1, 1, emu->fp);
 				}
 			}
@@ -196,6 +200,17 @@ static int femu_ReadPageWithLayout_wrap(uffs_Device *dev, u32 block, u32 page, u
 	return emu->ops_orig.ReadPageWithLayout(dev, block, page, data, data_len, ecc, ts, ecc_store);
 }
 
+static int femu_ReadPageSpares_wrap(uffs_Device *dev, u32 block, u32 page, int n_pages,
+							u8 *spares, int spare_len, int *results)
+{
+	uffs_FileEmu *emu = (uffs_FileEmu *)(dev->attr->_private);
+
+#ifdef UFFS_FEMU_SHOW_FLASH_IO
+	MSG(PFX " Read block %d page %d - %d SPARE[%d]" TENDSTR, block, page, page + n_pages - 1, spare_len);
+#endif
+	return emu->ops_orig.ReadPageSpares(dev, block, page, n_pages, spares, spare_len, results);
+}
+
 
 ////////////////////// wraper functions ///////////////////////////
 
@@ -210,7 +225,7 @@ static void InjectBitFlip(uffs_Device *dev, u32 block, u32 page)
 	u8 *spare = buf + dev->attr->page_data_size;
 	int full_page_size = dev->attr->page_data_size + dev->attr->spare_size;
 	int blk_size = full_page_size * dev->attr->pages_per_block;
-	int page_offset = block * blk_size + full_page_size * page;
+	long page_offset = (long)block * blk_size + full_page_size * page;
 
 	int i;
 	u8 *p;
@@ -359,4 +374,182 @@ static int femu_EraseBlock_wrap(uffs_Device *dev, u32 blockNumber)
 
 #endif // UFFS_FEMU_ENABLE_INJECTION
 
+/////////////////////// serialized flash operations //////////////////////////////
+
+#define EMU_LOCK(emu)	uffs_SemWait((emu)->lock)
+#define EMU_UNLOCK(emu)	uffs_SemSignal((emu)->lock)
+
+static int femu_InitFlash_lock(uffs_Device *dev)
+{
+	uffs_FileEmu *emu = (uffs_FileEmu *)(dev->attr->_private);
+	int ret;
+
+	EMU_LOCK(emu);
+	ret = emu->ops_unlocked.InitFlash(dev);
+	EMU_UNLOCK(emu);
+
+	return ret;
+}
+
+static int femu_ReleaseFlash_lock(uffs_Device *dev)
+{
+	uffs_FileEmu *emu = (uffs_FileEmu *)(dev->attr->_private);
+	int ret;
+
+	EMU_LOCK(emu);
+	ret = emu->ops_unlocked.ReleaseFlash(dev);
+	EMU_UNLOCK(emu);
+
+	return ret;
+}
+
+static int femu_ReadPage_lock(uffs_Device *dev, u32 block, u32 page, u8 *data, int data_len, u8 *ecc,
+							u8 *spare, int spare_len)
+{
+	uffs_FileEmu *emu = (uffs_FileEmu *)(dev->attr->_private);
+	int ret;
+
+	EMU_LOCK(emu);
+	ret = emu->ops_unlocked.ReadPage(dev, block, page, data, data_len, ecc, spare, spare_len);
+	EMU_UNLOCK(emu);
+
+	return ret;
+}
+
+static int femu_ReadPageWithLayout_lock(uffs_Device *dev, u32 block, u32 page, u8* data, int data_len, u8 *ecc,
+									uffs_TagStore *ts, u8 *ecc_store)
+{
+	uffs_FileEmu *emu = (uffs_FileEmu *)(dev->attr->_private);
+	int ret;
+
+	EMU_LOCK(emu);
+	ret = emu->ops_unlocked.ReadPageWithLayout(dev, block, page, data, data_len, ecc, ts, ecc_store);
+	EMU_UNLOCK(emu);
+
+	return ret;
+}
+
+static int femu_ReadPageSpares_lock(uffs_Device *dev, u32 block, u32 page, int n_pages,
+							u8 *spares, int spare_len, int *results)
+{
+	uffs_FileEmu *emu = (uffs_FileEmu *)(dev->attr->_private);
+	int ret;
+
+	EMU_LOCK(emu);
+	ret = emu->ops_unlocked.ReadPageSpares(dev, block, page, n_pages, spares, spare_len, results);
+	EMU_UNLOCK(emu);
+
+	return ret;
+}
+
+static int femu_WritePage_lock(uffs_Device *dev, u32 block, u32 page,
+							const u8 *data, int data_len, const u8 *spare, int spare_len)
+{
+	uffs_FileEmu *emu = (uffs_FileEmu *)(dev->attr->_private);
+	int ret;
+
+	EMU_LOCK(emu);
+	ret = emu->ops_unlocked.WritePage(dev, block, page, data, data_len, spare, spare_len);
+	EMU_UNLOCK(emu);
+
+	return ret;
+}
+
+static int femu_WritePageWithLayout_lock(uffs_Device *dev, u32 block, u32 page, const u8* data, int data_len, const u8 *ecc,
+									const uffs_TagStore *ts)
+{
+	uffs_FileEmu *emu = (uffs_FileEmu *)(dev->attr->_private);
+	int ret;
+
+	EMU_LOCK(emu);
+	ret = emu->ops_unlocked.WritePageWithLayout(dev, block, page, data, data_len, ecc, ts);
+	EMU_UNLOCK(emu);
+
+	return ret;
+}
+
+static int femu_IsBadBlock_lock(uffs_Device *dev, u32 block)
+{
+	uffs_FileEmu *emu = (uffs_FileEmu *)(dev->attr->_private);
+	int ret;
+
+	EMU_LOCK(emu);
+	ret = emu->ops_unlocked.IsBadBlock(dev, block);
+	EMU_UNLOCK(emu);
+
+	return ret;
+}
+
+static int femu_MarkBadBlock_lock(uffs_Device *dev, u32 block)
+{
+	uffs_FileEmu *emu = (uffs_FileEmu *)(dev->attr->_private);
+	int ret;
+
+	EMU_LOCK(emu);
+	ret = emu->ops_unlocked.MarkBadBlock(dev, block);
+	EMU_UNLOCK(emu);
+
+	return ret;
+}
+
+static int femu_EraseBlock_lock(uffs_Device *dev, u32 block)
+{
+	uffs_FileEmu *emu = (uffs_FileEmu *)(dev->attr->_private);
+	int ret;
+
+	EMU_LOCK(emu);
+	ret = emu->ops_unlocked.EraseBlock(dev, block);
+	EMU_UNLOCK(emu);
+
+	return ret;
+}
+
+static int femu_CheckErasedBlock_lock(uffs_Device *dev, u32 block)
+{
+	uffs_FileEmu *emu = (uffs_FileEmu *)(dev->attr->_private);
+	int ret;
+
+	EMU_LOCK(emu);
+	ret = emu->ops_unlocked.CheckErasedBlock(dev, block);
+	EMU_UNLOCK(emu);
+
+	return ret;
+}
+
+/*
+ * Serialize all flash operations with one lock, partitions share the
+ * emulation file (and file position) so they can't access it at the same time.
+ */
+void femu_setup_lock_functions(uffs_Device *dev)
+{
+	uffs_FileEmu *emu;
+	emu = (uffs_FileEmu *)(dev->attr->_private);
+
+	uffs_SemCreate(&emu->lock);
+	memcpy(&emu->ops_unlocked, dev->ops, sizeof(struct uffs_FlashOpsSt));
+
+	if (dev->ops->InitFlash)
+		dev->ops->InitFlash = femu_InitFlash_lock;
+	if (dev->ops->ReleaseFlash)
+		dev->ops->ReleaseFlash = femu_ReleaseFlash_lock;
+	if (dev->ops->ReadPage)
+		dev->ops->ReadPage = femu_ReadPage_lock;
+	if (dev->ops->ReadPageWithLayout)
+		dev->ops->ReadPageWithLayout = femu_ReadPageWithLayout_lock;
+	if (dev->ops->ReadPageSpares)
+		dev->ops->ReadPageSpares = femu_ReadPageSpares_lock;
+	if (dev->ops->WritePage)
+		dev->ops->WritePage = femu_WritePage_lock;
+	if (dev->ops->WritePageWithLayout)
+		dev->ops->WritePageWithLayout = femu_WritePageWithLayout_lock;
+	if (dev->ops->IsBadBlock)
+		dev->ops->IsBadBlock = femu_IsBadBlock_lock;
+	if (dev->ops->MarkBadBlock)
+		dev->ops->MarkBadBlock = femu_MarkBadBlock_lock;
+	if (dev->ops->EraseBlock)
+		dev->ops->EraseBlock = femu_EraseBlock_lock;
+	if (dev->ops->CheckErasedBlock)
+		dev->ops->CheckErasedBlock = femu_CheckErasedBlock_lock;
+}
+
 /////////////////////////////////////////////////////////////////////////////////
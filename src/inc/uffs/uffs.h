@@ -79,6 +79,7 @@ extern "C"{
 #define UENOTDIR 12		/** Not a directory */
 #define UEISDIR 13		/** Is a directory */    
 #define UERANGE 14  /** Read data out of page range */
+#define UEBUSY	15		/** resource is held by others, e.g. blocks reserved by another file */
 
 #define UEUNINITIALIZED	99	/** uninitialized uffs device */
 #define UEUNKNOWN_ERR	100	/** unknown error */
@@ -93,6 +94,12 @@ extern "C"{
 #define USEEK_SET		_SEEK_SET
 #define USEEK_END		_SEEK_END
 
+/** data segment for uffs_readv()/uffs_writev() */
+struct uffs_iovec {
+	void *iov_base;		/** segment start address */
+	int iov_len;		/** segment length in bytes */
+};
+
 
 #ifdef __cplusplus
 }
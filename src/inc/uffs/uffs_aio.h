@@ -0,0 +1,133 @@
+/*
+  This file is part of UFFS, the Ultra-low-cost Flash File System.
+  
+  Copyright (C) 2005-2009 Ricky Zheng <ricky_gz_zheng@yahoo.co.nz>
+
+  UFFS is free software; you can redistribute it and/or modify it under
+  the GNU Library General Public License as published by the Free Software 
+  Foundation; either version 2 of the License, or (at your option) any
+  later version.
+
+  UFFS is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+  or GNU Library General Public License, as applicable, for more details.
+ 
+  You should have received a copy of the GNU General Public License
+  and GNU Library General Public License along with UFFS; if not, write
+  to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA  02110-1301, USA.
+
+  As a special exception, if other files instantiate templates or use
+  macros or inline functions from this file, or you compile this file
+  and link it with other works to produce a work based on this file,
+  this file does not by itself cause the resulting work to be covered
+  by the GNU General Public License. However the source code for this
+  file must still be made available in accordance with section (3) of
+  the GNU General Public License v2.
+ 
+  This exception does not invalidate any other reasons why a work based
+  on this file might be covered by the GNU General Public License.
+*/
+
+
+
+/**
+ * \file uffs_aio.h
+ * \brief asynchronous I/O on file descriptors
+ * \author Ricky Zheng
+ */
+
+#ifndef _UFFS_AIO_H_
+#define _UFFS_AIO_H_
+
+#include "uffs_config.h"
+#include "uffs/uffs_types.h"
+#include "uffs/uffs_os.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#ifdef CONFIG_UFFS_AIO
+
+/*
+ * Each device has an I/O worker task. uffs_aio_submit() puts the request
+ * on the worker's list and returns, the worker takes all pending requests
+ * at once and runs them through the fd APIs:
+ *
+ *  - requests are grouped by fd, the order of requests on the same fd is
+ *    kept, requests on different fds may be reordered.
+ *  - consecutive READ (or WRITE) requests where each one starts at the
+ *    end of the previous one are done by one uffs_preadv() (uffs_pwritev()),
+ *    up to UFFS_AIO_MAX_MERGE requests.
+ *  - consecutive FLUSH requests are done by one uffs_flush().
+ *
+ * When a request is done, #result and #error are set and the request is
+ * completed by calling #done (in the worker task), or, if #done is NULL,
+ * by putting it on the completion queue #cq.
+ */
+
+#define UFFS_AIO_READ		0	//!< read #len bytes at #offset to #buf
+#define UFFS_AIO_WRITE		1	//!< write #len bytes from #buf to #offset
+#define UFFS_AIO_FLUSH		2	//!< flush the file
+#define UFFS_AIO_CLOSE		3	//!< close the file
+
+struct uffs_aiocb;
+
+/**
+ * \struct uffs_AioQueueSt
+ * \brief completion queue, done requests are got by uffs_aio_queue_get()
+ */
+typedef struct uffs_AioQueueSt {
+	OSSEM lock;
+	OSEVENT ev;						//!< signaled once for each request put on the queue
+	struct uffs_aiocb *head;
+	struct uffs_aiocb *tail;
+} uffs_AioQueue;
+
+/**
+ * \struct uffs_aiocb
+ * \brief asynchronous I/O request, must be kept until it's completed
+ */
+struct uffs_aiocb {
+	int op;							//!< UFFS_AIO_READ, UFFS_AIO_WRITE, UFFS_AIO_FLUSH or UFFS_AIO_CLOSE
+	int fd;							//!< file descriptor
+	long offset;					//!< file offset for READ/WRITE, file pointer is not used nor changed
+	void *buf;						//!< data buffer for READ/WRITE
+	int len;						//!< data length for READ/WRITE
+	void (*done)(struct uffs_aiocb *cb);	//!< completion callback, called in worker task
+	uffs_AioQueue *cq;				//!< completion queue, used when #done is NULL
+	void *user;						//!< user data, not used by uffs
+	int result;						//!< result, as return value of the synchronous API
+	int error;						//!< error code, as uffs_get_error() of the synchronous API
+	struct uffs_aiocb *next;		//!< private
+};
+
+/**
+ * \struct uffs_AioWorkerSt
+ * \brief per device I/O worker
+ */
+struct uffs_AioWorkerSt {
+	OSTASK task;
+	uffs_AioQueue req;				//!< submitted requests
+	UBOOL quit;						//!< worker is stopping, no more requests accepted
+};
+
+int uffs_aio_submit(struct uffs_aiocb *cb);
+
+int uffs_aio_queue_init(uffs_AioQueue *q);
+int uffs_aio_queue_release(uffs_AioQueue *q);
+struct uffs_aiocb * uffs_aio_queue_get(uffs_AioQueue *q, UBOOL wait);
+
+URET uffs_AioWorkerStart(struct uffs_DeviceSt *dev);
+URET uffs_AioWorkerStop(struct uffs_DeviceSt *dev);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
@@ -55,9 +55,20 @@ void uffs_BadBlockInit(uffs_Device *dev);
 	mark it as 'bad' and put it to bad block list */
 void uffs_BadBlockProcessNode(uffs_Device *dev, TreeNode *node);
 
+/** release bad block management resources */
+void uffs_BadBlockRelease(uffs_Device *dev);
+
 /** try to recover data from a new discovered bad block */
 void uffs_BadBlockRecover(uffs_Device *dev);
 
+/** process pending blocks except deferred refresh blocks,
+	at most CONFIG_PENDING_REFRESH_PER_OP refresh blocks are processed */
+void uffs_BadBlockRecoverUrgent(uffs_Device *dev);
+
+/** process pending blocks by priority for up to budget_ms milli-seconds,
+	return the number of blocks still pending */
+int uffs_BadBlockRecoverStep(uffs_Device *dev, int budget_ms);
+
 /** put a new block to the bad block waiting list */
 void uffs_BadBlockAdd(uffs_Device *dev, int block, u8 mark);
 
@@ -0,0 +1,125 @@
+/*
+  This file is part of UFFS, the Ultra-low-cost Flash File System.
+  
+  Copyright (C) 2005-2009 Ricky Zheng <ricky_gz_zheng@yahoo.co.nz>
+
+  UFFS is free software; you can redistribute it and/or modify it under
+  the GNU Library General Public License as published by the Free Software 
+  Foundation; either version 2 of the License, or (at your option) any
+  later version.
+
+  UFFS is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+  or GNU Library General Public License, as applicable, for more details.
+ 
+  You should have received a copy of the GNU General Public License
+  and GNU Library General Public License along with UFFS; if not, write
+  to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA  02110-1301, USA.
+
+  As a special exception, if other files instantiate templates or use
+  macros or inline functions from this file, or you compile this file
+  and link it with other works to produce a work based on this file,
+  this file does not by itself cause the resulting work to be covered
+  by the GNU General Public License. However the source code for this
+  file must still be made available in accordance with section (3) of
+  the GNU General Public License v2.
+ 
+  This exception does not invalidate any other reasons why a work based
+  on this file might be covered by the GNU General Public License.
+*/
+
+
+
+/**
+ * \file uffs_bbt.h
+ * \brief on-flash bad block table
+ * \author Ricky Zheng
+ */
+
+#ifndef _UFFS_BBT_H_
+#define _UFFS_BBT_H_
+
+#include "uffs_config.h"
+#include "uffs/uffs_types.h"
+#include "uffs/uffs_core.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/*
+ * The bad block table (BBT) is kept in the last UFFS_BBT_BLOCKS good blocks
+ * of the partition, each block holds a mirror of the table. The BBT blocks
+ * are taken out of the partition (dev->par.end is moved down) when the
+ * table is in use.
+ *
+ * Each version of the table is a one page record, appended to the next free
+ * page of every BBT block (the block is erased when it's full):
+ *
+ *   page data: struct uffs_BbtHeaderSt followed by the bitmap,
+ *              bit n set if block (start + n) is bad.
+ *   tag: type UFFS_TYPE_PACK, serial and parent all '1', page_id: page.
+ *
+ * The valid record with the highest version wins.
+ */
+
+/** BBT record magic: 'UBBT' */
+#define UFFS_BBT_MAGIC		0x54424255
+
+/**
+ * \struct uffs_BbtHeaderSt
+ * \brief header of the BBT record
+ */
+struct uffs_BbtHeaderSt {
+	u32 magic;				//!< #UFFS_BBT_MAGIC
+	u32 version;			//!< table version, increased on every update
+	u32 start;				//!< first block covered by the table
+	u32 count;				//!< number of blocks covered by the table
+	u16 crc;				//!< crc16 of the header (up to crc) and the bitmap
+	u16 reserved;
+};
+
+/**
+ * \struct uffs_BbtSt
+ * \brief bad block table of device
+ */
+struct uffs_BbtSt {
+	u8 *map;								//!< bad block bitmap
+	uffs_BlockNum start;					//!< first block in the map
+	uffs_BlockNum count;					//!< blocks in the map, 0 if BBT is not in use
+	uffs_BlockNum blocks[UFFS_BBT_BLOCKS];	//!< BBT blocks
+	u16 next_page[UFFS_BBT_BLOCKS];			//!< next free page of BBT blocks
+	u32 version;							//!< version of the table in map
+	UBOOL unsaved;							//!< the table failed to be saved, bad block marks are still read
+};
+
+/** is BBT in use and covers the block ? */
+#define UFFS_BBT_COVERS(dev, block) \
+			((dev)->bbt.count > 0 && \
+			 (block) >= (dev)->bbt.start && (block) < (dev)->bbt.start + (dev)->bbt.count)
+
+/** load (or create) the BBT, take BBT blocks out of the partition */
+URET uffs_BbtInit(uffs_Device *dev);
+
+/** release BBT memory */
+void uffs_BbtRelease(uffs_Device *dev);
+
+/** is the block bad by BBT ? */
+UBOOL uffs_BbtIsBad(uffs_Device *dev, int block);
+
+/** add a new bad block to BBT, and update the table on flash */
+URET uffs_BbtMarkBad(uffs_Device *dev, int block);
+
+/** save the table again if it failed to be saved before */
+URET uffs_BbtSync(uffs_Device *dev);
+
+/** is the tag a BBT record tag ? */
+UBOOL uffs_BbtIsTableTag(uffs_Tags *tag);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -62,10 +62,12 @@ struct uffs_PageSpareSt {
 struct uffs_BlockInfoSt {
 	struct uffs_BlockInfoSt *next;
 	struct uffs_BlockInfoSt *prev;
-	u16 block;							//!< block number
+	uffs_BlockNum block;					//!< block number
 	struct uffs_PageSpareSt *spares;	//!< page spare info array
 	int expired_count;					//!< how many pages expired in this block ? 
 	int ref_count;						//!< reference counter, it's safe to reuse this block memory when the counter is 0.
+	u16 *page_map;						//!< page_id -> newest page with the page_id
+	u16 map_pages;						//!< pages [0, map_pages) are in #page_map, UFFS_INVALID_PAGE if the map is not built
 };
 
 /** get tag from block info */
@@ -81,6 +83,9 @@ URET uffs_BlockInfoReleaseCache(uffs_Device *dev);
 /** find first free page in block */
 URET uffs_BlockInfoFindFirstFreePage(uffs_Device *dev, uffs_BlockInfo *work, u16 first_page, u16 page_after_last, u16 *first_free_page);
 
+/** find the newest page with given page_id */
+u16 uffs_BlockInfoFindPageById(uffs_Device *dev, uffs_BlockInfo *work, u16 page_id);
+
 /** load a range of page's spares to block info cache */
 URET uffs_BlockInfoLoadPageRange(uffs_Device *dev, uffs_BlockInfo *work, u16 first_page, u16 page_after_last);
 
@@ -55,6 +55,10 @@ extern "C"{
 #define UFFS_BUF_VALID		1			//!< buffer is holding valid data
 #define UFFS_BUF_DIRTY		2			//!< buffer data is modified
 
+/** for uffs_BufSt::seg */
+#define UFFS_BUF_SEG_A1		0	//!< new pages, FIFO, not promoted by re-access
+#define UFFS_BUF_SEG_AM		1	//!< hot pages and DIR/FILE header pages, LRU
+
 /** for uffs_BufSt::ext_mark */
 #define UFFS_BUF_EXT_MARK_TRUNC_TAIL 1	//!< the last page of file (when truncating a file)
 
@@ -66,6 +70,9 @@ struct uffs_BufSt{
 	struct uffs_BufSt *prev_dirty;		//!< link to previous dirty buffer
 	u8 type;							//!< #UFFS_TYPE_DIR or #UFFS_TYPE_FILE or #UFFS_TYPE_DATA
 	u8 ext_mark;						//!< extension mark. 
+#ifdef CONFIG_UFFS_BUF_2Q
+	u8 seg;								//!< 2Q segment, #UFFS_BUF_SEG_A1 or #UFFS_BUF_SEG_AM
+#endif
 	u16 parent;							//!< parent serial
 	u16 serial;							//!< serial 
 	u16 page_id;						//!< page id 
@@ -33,6 +33,9 @@
 #ifndef _UFFS_CORE_H_
 #define _UFFS_CORE_H_
 
+#include "uffs_config.h"
+#include "uffs/uffs_types.h"
+
 #ifdef __cplusplus
 extern "C"{
 #endif
@@ -49,6 +52,14 @@ typedef struct uffs_TagStoreSt      uffs_TagStore;  //!< UFFS page tags physical
 
 typedef struct uffs_BufSt uffs_Buf;
 
+#ifdef CONFIG_UFFS_WIDE_BLOCK_ADDR
+typedef u32 uffs_BlockNum;		//!< block number
+typedef u32 uffs_NodeIndex;		//!< tree node index, one tree node per block
+#else
+typedef u16 uffs_BlockNum;		//!< block number
+typedef u16 uffs_NodeIndex;		//!< tree node index, one tree node per block
+#endif
+
 typedef struct uffs_DeviceMountStatusSt
 {
     /** Overall device mount status */
@@ -0,0 +1,129 @@
+/*
+  This file is part of UFFS, the Ultra-low-cost Flash File System.
+  
+  Copyright (C) 2005-2009 Ricky Zheng <ricky_gz_zheng@yahoo.co.nz>
+
+  UFFS is free software; you can redistribute it and/or modify it under
+  the GNU Library General Public License as published by the Free Software 
+  Foundation; either version 2 of the License, or (at your option) any
+  later version.
+
+  UFFS is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+  or GNU Library General Public License, as applicable, for more details.
+ 
+  You should have received a copy of the GNU General Public License
+  and GNU Library General Public License along with UFFS; if not, write
+  to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA  02110-1301, USA.
+
+  As a special exception, if other files instantiate templates or use
+  macros or inline functions from this file, or you compile this file
+  and link it with other works to produce a work based on this file,
+  this file does not by itself cause the resulting work to be covered
+  by the GNU General Public License. However the source code for this
+  file must still be made available in accordance with section (3) of
+  the GNU General Public License v2.
+ 
+  This exception does not invalidate any other reasons why a work based
+  on this file might be covered by the GNU General Public License.
+*/
+
+
+/**
+ * \file uffs_dentry.h
+ * \brief path component lookup cache (dentry cache)
+ * \author Ricky Zheng
+ */
+
+#ifndef _UFFS_DENTRY_H_
+#define _UFFS_DENTRY_H_
+
+#include "uffs_config.h"
+#include "uffs/uffs_types.h"
+#include "uffs/uffs_public.h"
+#include "uffs/uffs_core.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/*
+ * The dentry cache maps (parent serial, name) to the serial of the
+ * DIR/FILE object with that name, so resolving a path doesn't need to
+ * search the tree for every path component.
+ *
+ * Negative entries record names known not to exist (per object type).
+ * Entries are added on lookup and create, and dropped when the object is
+ * deleted or renamed. Names longer than UFFS_DENTRY_NAME_MAX are not cached.
+ */
+
+/** hash table size, must be power of 2 */
+#define UFFS_DENTRY_HASH_SIZE	16
+#define UFFS_DENTRY_HASH(parent, sum) \
+			(((parent) ^ (sum)) & (UFFS_DENTRY_HASH_SIZE - 1))
+
+/** for uffs_DentryCacheLookup() result */
+#define UFFS_DENTRY_MISS		0	//!< name not in cache
+#define UFFS_DENTRY_HIT			1	//!< name found, serial returned
+#define UFFS_DENTRY_NEGATIVE	2	//!< name known not exist
+
+/**
+ * \struct uffs_DentryEntrySt
+ * \brief dentry cache entry
+ */
+typedef struct uffs_DentryEntrySt {
+	struct uffs_DentryEntrySt *prev;		//!< previous entry in LRU list (more recently used)
+	struct uffs_DentryEntrySt *next;		//!< next entry in LRU list (less recently used)
+	struct uffs_DentryEntrySt *hash_next;	//!< next entry in hash bucket
+	u16 parent;								//!< parent dir serial
+	u16 sum;								//!< name sum
+	u16 serial;								//!< serial of the object, for positive entry
+	u8 type;								//!< UFFS_TYPE_DIR/UFFS_TYPE_FILE, UFFS_TYPE_INVALID if negative or free
+	u8 absent;								//!< for negative entry, (1 << type) of types known not exist
+	u8 name_len;							//!< name length, 0 if free
+	char name[UFFS_DENTRY_NAME_MAX];		//!< name, not null terminated
+} uffs_DentryEntry;
+
+/**
+ * \struct uffs_DentryCacheSt
+ * \brief dentry cache of device
+ */
+struct uffs_DentryCacheSt {
+	uffs_DentryEntry *head;					//!< most recently used entry
+	uffs_DentryEntry *tail;					//!< least recently used entry
+	uffs_DentryEntry *hash[UFFS_DENTRY_HASH_SIZE];	//!< hash buckets
+	int hit;								//!< lookups served from cache (positive or negative)
+	int miss;								//!< lookups need to search tree
+};
+
+/** init dentry cache */
+URET uffs_DentryCacheInit(uffs_Device *dev);
+
+/** release dentry cache memory */
+void uffs_DentryCacheRelease(uffs_Device *dev);
+
+/** drop all entries */
+void uffs_DentryCacheClear(uffs_Device *dev);
+
+/** lookup name of given type under parent dir */
+int uffs_DentryCacheLookup(uffs_Device *dev, u16 parent, const char *name,
+							int len, u16 sum, int type, u16 *serial);
+
+/** name under parent is found (or created) as object of type/serial */
+void uffs_DentryCacheAdd(uffs_Device *dev, u16 parent, const char *name,
+							int len, u16 sum, int type, u16 serial);
+
+/** name under parent is not found as object of type */
+void uffs_DentryCacheAddNegative(uffs_Device *dev, u16 parent, const char *name,
+							int len, u16 sum, int type);
+
+/** object is deleted or renamed, drop entries of the object and its children */
+void uffs_DentryCacheDrop(uffs_Device *dev, u16 serial);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
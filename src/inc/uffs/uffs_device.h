@@ -45,6 +45,11 @@
 #include "uffs/uffs_blockinfo.h"
 #include "uffs/uffs_pool.h"
 #include "uffs/uffs_tree.h"
+#include "uffs/uffs_pack.h"
+#include "uffs/uffs_bbt.h"
+#include "uffs/uffs_infocache.h"
+#include "uffs/uffs_dentry.h"
+#include "uffs/uffs_aio.h"
 #include "uffs/uffs_mem.h"
 #include "uffs/uffs_core.h"
 #include "uffs/uffs_flash.h"
@@ -75,8 +80,8 @@ struct uffs_BlockInfoCacheSt {
  * \brief partition basic information
  */
 struct uffs_PartitionSt {
-	u16 start;		//!< start block number of partition
-	u16 end;		//!< end block number of partition
+	uffs_BlockNum start;	//!< start block number of partition
+	uffs_BlockNum end;		//!< end block number of partition
 };
 
 /** 
@@ -99,6 +104,19 @@ struct uffs_DirtyGroupSt {
 	uffs_Buf *dirty;			//!< dirty buffer list
 };
 
+/** max number of pages remembered after recycled from 2Q A1 segment */
+#define UFFS_BUF_GHOST_MAX		(MAX_PAGE_BUFFERS / 2)
+
+/** 
+ * \struct uffs_BufGhostSt
+ * \brief page recently recycled from 2Q A1 segment ('A1out')
+ */
+struct uffs_BufGhostSt {
+	u16 parent;
+	u16 serial;
+	u16 page_id;
+};
+
 /** 
  * \struct uffs_PageBufDescSt
  * \brief uffs page buffers descriptor
@@ -111,6 +129,13 @@ struct uffs_PageBufDescSt {
 	int buf_max;			//!< maximum buffers
 	int dirty_buf_max;		//!< maximum dirty buffer allowed
 	void *pool;				//!< memory pool for buffers
+#ifdef CONFIG_UFFS_BUF_2Q
+	int a1_count;			//!< buffers in A1 segment
+	int a1_max;				//!< A1 segment size, recycle A1 buffers first when it's over
+	struct uffs_BufGhostSt ghost[UFFS_BUF_GHOST_MAX];	//!< pages recently recycled from A1
+	int ghost_max;			//!< ghost entries in use
+	int ghost_next;			//!< next ghost entry to be overwritten
+#endif
 };
 
 
@@ -138,6 +163,9 @@ typedef struct uffs_FlashStatSt {
 	int page_header_read_count;
 	int spare_write_count;
 	int spare_read_count;
+	int spare_batch_read_count;
+	int page_buf_hit;			//!< page found in page buffers
+	int page_buf_miss;			//!< page loaded from flash to page buffers
 	unsigned long io_read;
 	unsigned long io_write;
 } uffs_FlashStat;
@@ -171,7 +199,7 @@ typedef struct uffs_ConfigSt {
  * \brief Pending block descriptor
  */
 typedef struct uffs_PendingBlockSt {
-	u16 block;			//!< pending block number
+	uffs_BlockNum block;	//!< pending block number
 	u8 mark;			//!< pending block mark
 } uffs_PendingBlock;
 
@@ -181,8 +209,10 @@ typedef struct uffs_PendingBlockSt {
  */
 struct uffs_PendingListSt {
 	int count;											//!< pending block counter
-	uffs_PendingBlock list[CONFIG_MAX_PENDING_BLOCKS];	//!< pending block list
-	u16 block_in_recovery;                              //!< pending block being recovered
+	int size;											//!< capacity of pending block list
+	uffs_PendingBlock *list;							//!< pending block list, ordered by mark, highest priority at the tail
+	uffs_PendingBlock static_list[CONFIG_MAX_PENDING_BLOCKS];	//!< initial storage of pending block list
+	uffs_BlockNum block_in_recovery;                    //!< pending block being recovered
 };
 
 /** 
@@ -203,7 +233,22 @@ struct uffs_DeviceSt {
 	struct uffs_PageBufDescSt		buf;			//!< page buffers
 	struct uffs_PageCommInfoSt		com;			//!< common information
 	struct uffs_TreeSt				tree;			//!< tree list of block
+#ifdef CONFIG_UFFS_SMALL_FILE_PACK
+	struct uffs_PackSt				pack;			//!< small file packing
+#endif
 	struct uffs_PendingListSt		pending;		//!< pending block list, to be recover/mark 'bad'/refresh
+#ifdef CONFIG_UFFS_BBT
+	struct uffs_BbtSt				bbt;			//!< bad block table
+#endif
+#ifdef CONFIG_UFFS_INFO_CACHE
+	struct uffs_InfoCacheSt			info_cache;		//!< file/dir info cache
+#endif
+#ifdef CONFIG_UFFS_DENTRY_CACHE
+	struct uffs_DentryCacheSt		dentry_cache;	//!< path component lookup cache
+#endif
+#ifdef CONFIG_UFFS_AIO
+	struct uffs_AioWorkerSt			aio;			//!< asynchronous I/O worker
+#endif
 	struct uffs_FlashStatSt			st;				//!< statistic (counters)
 	struct uffs_memAllocatorSt		mem;			//!< uffs memory allocator
 	struct uffs_ConfigSt			cfg;			//!< uffs config
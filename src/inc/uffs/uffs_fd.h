@@ -104,6 +104,17 @@ struct uffs_stat {
     unsigned int	st_ctime;   /* time of last status change */
 };
 
+/**
+ * \brief entry of uffs_readdirplus(): dir entry with stat
+ */
+struct uffs_direntplus {
+    struct uffs_dirent d;		/* dir entry */
+    struct uffs_stat st;		/* stat of the entry */
+};
+
+/** uffs_readdirplus() flags: return entries in on-flash block order */
+#define UFFS_READDIR_BLOCK_ORDER	(1 << 0)
+
 struct uffs_DeviceSt;
 typedef struct uffs_DeviceSt uffs_Device;
 
@@ -114,6 +125,13 @@ int uffs_openbyserial(int serial, uffs_Device* dev, int oflag);
 int uffs_close(int fd);
 int uffs_read(int fd, void *data, int len);
 int uffs_write(int fd, const void *data, int len);
+int uffs_pread(int fd, void *data, int len, long offset);
+int uffs_pwrite(int fd, const void *data, int len, long offset);
+int uffs_readv(int fd, const struct uffs_iovec *iov, int iovcnt);
+int uffs_writev(int fd, const struct uffs_iovec *iov, int iovcnt);
+int uffs_preadv(int fd, const struct uffs_iovec *iov, int iovcnt, long offset);
+int uffs_pwritev(int fd, const struct uffs_iovec *iov, int iovcnt, long offset);
+int uffs_fallocate(int fd, long len);
 long uffs_seek(int fd, long offset, int origin);
 long uffs_tell(int fd);
 int uffs_eof(int fd);
@@ -133,6 +151,7 @@ int uffs_fstat(int fd, struct uffs_stat *buf);
 int uffs_closedir(uffs_DIR *dirp);
 uffs_DIR * uffs_opendir(const char *path);
 struct uffs_dirent * uffs_readdir(uffs_DIR *dirp);
+int uffs_readdirplus(uffs_DIR *dirp, struct uffs_direntplus *ents, int count, int flags);
 
 void uffs_rewinddir(uffs_DIR *dirp);
 
@@ -153,6 +172,13 @@ int uffs_space_free(const char *mount_point, unsigned long *result);
 
 void uffs_flush_all(const char *mount_point);
 
+/**
+ * process pending bad/refresh blocks of the partition for up to budget_ms milli-seconds,
+ * can be called periodically from a background task.
+ * \return number of blocks still pending, or -1 on error.
+ */
+int uffs_process_pending(const char *mount_point, int budget_ms);
+
 #ifdef __cplusplus
 }
 #endif
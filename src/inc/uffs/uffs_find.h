@@ -56,6 +56,14 @@ typedef struct uffs_FindInfoSt {
 	int pos;						//!< current position
 } uffs_FindInfo;
 
+/**
+ * callback of uffs_FindObjectBulk(), called with device locked.
+ * \param[in] info object information
+ * \param[in] pos finding position of the object
+ * \param[in] arg argument passed to uffs_FindObjectBulk()
+ */
+typedef void (*uffs_FindObjectCB)(uffs_ObjectInfo *info, int pos, void *arg);
+
 
 URET uffs_GetObjectInfo(uffs_Object *obj, uffs_ObjectInfo *info, int *err);
 URET uffs_FindObjectOpen(uffs_FindInfo *find_handle, uffs_Object *dir);
@@ -64,6 +72,8 @@ URET uffs_FindObjectFirst(uffs_ObjectInfo *info, uffs_FindInfo *find_handle);
 URET uffs_FindObjectNext(uffs_ObjectInfo *info, uffs_FindInfo *find_handle);
 URET uffs_FindObjectRewind(uffs_FindInfo *find_handle);
 URET uffs_FindObjectClose(uffs_FindInfo * find_handle);
+int uffs_FindObjectBulk(uffs_FindInfo *f, uffs_ObjectInfo *info, int count,
+						UBOOL block_order, uffs_FindObjectCB cb, void *arg, int *err);
 
 
 #ifdef __cplusplus
@@ -108,7 +108,7 @@ struct uffs_StorageAttrSt {
 	u32 total_blocks;		//!< total blocks in this chip
 	u16 page_data_size;		//!< page data size (physical page data size, e.g. 512)
 	u16 pages_per_block;	//!< pages per block
-	u8 spare_size;			//!< page spare size (physical page spare size, e.g. 16)
+	u16 spare_size;			//!< page spare size (physical page spare size, e.g. 16)
 	u8 block_status_offs;	//!< block status byte offset in spare
 	int ecc_opt;			//!< ecc option ( #UFFS_ECC_[NONE|SOFT|HW|HW_AUTO] )
 	int layout_opt;			//!< layout option (#UFFS_LAYOUT_UFFS or #UFFS_LAYOUT_FLASH)
@@ -270,8 +270,31 @@ struct uffs_FlashOpsSt {
 	 * \return 0 if all pages are clean, otherwise return -1.
 	 */
 	int (*CheckErasedBlock)(uffs_Device *dev, u32 block);
+
+	/**
+	 * Read spare areas of a range of pages in one call, UFFS do the layout.
+	 *
+	 * \param[out] spares buffer of n_pages * spare_len bytes,
+	 *			spare of page (page + i) goes to (spares + i * spare_len).
+	 * \param[out] results read result of each page, same as 'ReadPage()' returns.
+	 *
+	 * \note This function is optional, and only used when 'ReadPageWithLayout()' is not provided.
+	 *       If it's not implemented, UFFS reads spares by calling 'ReadPage()' page by page.
+	 *
+	 * \return 0 if spares are read (check results[] for each page),
+	 *		-1 if the range can't be read in batch, UFFS then falls back to 'ReadPage()'.
+	 */
+	int (*ReadPageSpares)(uffs_Device *dev, u32 block, u32 page, int n_pages,
+							u8 *spares, int spare_len, int *results);
 };
 
+/** max pages of a batched tag read, see uffs_FlashReadPageTags() */
+#define UFFS_TAG_BATCH_PAGES	16
+
+/** is flash driver able to read spares in batch ? */
+#define UFFS_FLASH_CAN_BATCH_READ_SPARE(dev) \
+			((dev)->ops->ReadPageSpares != NULL && (dev)->ops->ReadPageWithLayout == NULL)
+
 /** performs tag ecc correction */
 int TagEccCorrect(struct uffs_TagStoreSt *ts);
 
@@ -284,6 +307,9 @@ void uffs_FlashUnloadSpare(uffs_Device *dev, const u8 *spare, struct uffs_TagSto
 /** read page spare and fill to tag */
 int uffs_FlashReadPageTag(uffs_Device *dev, int block, int page, uffs_Tags *tag);
 
+/** read spares of a range of pages and fill to tags */
+int uffs_FlashReadPageTags(uffs_Device *dev, int block, int page, int n_pages, uffs_Tags **tags, int *results);
+
 /** read page data to page buf and do ECC correct */
 int uffs_FlashReadPage(uffs_Device *dev, int block, int page, uffs_Buf *buf, UBOOL skip_ecc);
 
@@ -312,6 +338,11 @@ u32 uffs_FlashGetPageInfo(uffs_Device *dev, int block, int page);
 /** load uffs_FileInfo from flash storage */
 URET uffs_FlashReadFileinfoPhy(uffs_Device *dev, int block, int page, uffs_FileInfo *info);
 
+/**
+ * Check storage attributes and set up spare layout
+ */
+URET uffs_FlashInitLayout(uffs_Device *dev);
+
 /**
  * Initialize UFFS flash interface
  */
@@ -78,6 +78,9 @@ struct uffs_ObjectSt {
 	UBOOL attr_loaded;					//!< attributes loaded ?
 	UBOOL open_succ;					//!< U_TRUE or U_FALSE
 
+#ifdef CONFIG_UFFS_OBJ_FDN_MAP
+	struct uffs_FdnMapSt *fdn_map;		//!< fdn -> DATA node map, got on first DATA node lookup
+#endif
 };
 
 typedef struct uffs_ObjectSt uffs_Object;
@@ -119,6 +122,13 @@ URET uffs_CreateObject(uffs_Object *obj, const char *fullname, int oflag);
 URET uffs_CloseObject(uffs_Object *obj);
 int uffs_WriteObject(uffs_Object *obj, const void *data, int len);
 int uffs_ReadObject(uffs_Object *obj, void *data, int len);
+int uffs_WriteObjectAt(uffs_Object *obj, u32 ofs, const void *data, int len);
+int uffs_ReadObjectAt(uffs_Object *obj, u32 ofs, void *data, int len);
+int uffs_WriteObjectV(uffs_Object *obj, const struct uffs_iovec *iov, int iovcnt);
+int uffs_ReadObjectV(uffs_Object *obj, const struct uffs_iovec *iov, int iovcnt);
+int uffs_WriteObjectAtV(uffs_Object *obj, u32 ofs, const struct uffs_iovec *iov, int iovcnt);
+int uffs_ReadObjectAtV(uffs_Object *obj, u32 ofs, const struct uffs_iovec *iov, int iovcnt);
+URET uffs_PreallocObject(uffs_Object *obj, u32 len);
 long uffs_SeekObject(uffs_Object *obj, long offset, int origin);
 int uffs_GetCurOffset(uffs_Object *obj);
 int uffs_EndOfFile(uffs_Object *obj);
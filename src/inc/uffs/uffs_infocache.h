@@ -0,0 +1,112 @@
+/*
+  This file is part of UFFS, the Ultra-low-cost Flash File System.
+  
+  Copyright (C) 2005-2009 Ricky Zheng <ricky_gz_zheng@yahoo.co.nz>
+
+  UFFS is free software; you can redistribute it and/or modify it under
+  the GNU Library General Public License as published by the Free Software 
+  Foundation; either version 2 of the License, or (at your option) any
+  later version.
+
+  UFFS is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+  or GNU Library General Public License, as applicable, for more details.
+ 
+  You should have received a copy of the GNU General Public License
+  and GNU Library General Public License along with UFFS; if not, write
+  to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA  02110-1301, USA.
+
+  As a special exception, if other files instantiate templates or use
+  macros or inline functions from this file, or you compile this file
+  and link it with other works to produce a work based on this file,
+  this file does not by itself cause the resulting work to be covered
+  by the GNU General Public License. However the source code for this
+  file must still be made available in accordance with section (3) of
+  the GNU General Public License v2.
+ 
+  This exception does not invalidate any other reasons why a work based
+  on this file might be covered by the GNU General Public License.
+*/
+
+
+
+/**
+ * \file uffs_infocache.h
+ * \brief in-RAM cache of file/dir info (uffs_FileInfo)
+ * \author Ricky Zheng
+ */
+
+#ifndef _UFFS_INFOCACHE_H_
+#define _UFFS_INFOCACHE_H_
+
+#include "uffs_config.h"
+#include "uffs/uffs_types.h"
+#include "uffs/uffs_public.h"
+#include "uffs/uffs_core.h"
+#include "uffs/uffs_tree.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/*
+ * The info cache keeps uffs_FileInfo (name, attr and time stamps) of
+ * recently used DIR/FILE objects, keyed by (type, serial), so that stat,
+ * readdir and name lookup don't need to read page 0 of object's block.
+ *
+ * Entries are filled when the info is loaded from flash, and updated
+ * whenever the info is written (create, rename, modify time).
+ * The least recently used entry is reused when cache is full.
+ */
+
+/**
+ * \struct uffs_InfoCacheEntrySt
+ * \brief info cache entry
+ */
+typedef struct uffs_InfoCacheEntrySt {
+	struct uffs_InfoCacheEntrySt *prev;		//!< previous entry in LRU list (more recently used)
+	struct uffs_InfoCacheEntrySt *next;		//!< next entry in LRU list (less recently used)
+	u16 serial;								//!< object serial
+	u8 type;								//!< UFFS_TYPE_DIR/UFFS_TYPE_FILE, UFFS_TYPE_INVALID if free
+	uffs_FileInfo info;						//!< cached info
+} uffs_InfoCacheEntry;
+
+/**
+ * \struct uffs_InfoCacheSt
+ * \brief info cache of device
+ */
+struct uffs_InfoCacheSt {
+	uffs_InfoCacheEntry *head;				//!< most recently used entry
+	uffs_InfoCacheEntry *tail;				//!< least recently used entry
+	int hit;								//!< lookups served from cache
+	int miss;								//!< lookups load from flash
+};
+
+/** init info cache */
+URET uffs_InfoCacheInit(uffs_Device *dev);
+
+/** release info cache memory */
+void uffs_InfoCacheRelease(uffs_Device *dev);
+
+/** drop all cached info */
+void uffs_InfoCacheClear(uffs_Device *dev);
+
+/**
+ * get info of DIR/FILE object, load it from flash if not in cache.
+ * the returned info is only valid before next info cache operation.
+ */
+const uffs_FileInfo * uffs_InfoCacheGet(uffs_Device *dev, int type, TreeNode *node);
+
+/** info of the object is changed, update the cache */
+void uffs_InfoCacheUpdate(uffs_Device *dev, int type, u16 serial, const uffs_FileInfo *fi);
+
+/** object is deleted, drop it from cache */
+void uffs_InfoCacheDrop(uffs_Device *dev, int type, u16 serial);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -51,11 +51,41 @@ typedef struct uffs_memAllocatorSt {
 	void * pagebuf_pool_buf;			//!< page buffers
 	void * tree_nodes_pool_buf;			//!< tree nodes buffer
 	void * spare_pool_buf;				//!< spare buffers
+#ifdef CONFIG_UFFS_OBJ_FDN_MAP
+	void * fdn_map_pool_buf;			//!< fdn maps of opened files
+#endif
+#ifdef CONFIG_UFFS_COMPACT_TREE_NODE
+	void * file_len_pool_buf;			//!< file length table
+#endif
+#ifdef CONFIG_UFFS_BBT
+	void * bbt_pool_buf;				//!< bad block table
+#endif
+#ifdef CONFIG_UFFS_INFO_CACHE
+	void * info_cache_pool_buf;			//!< file/dir info cache
+#endif
+#ifdef CONFIG_UFFS_DENTRY_CACHE
+	void * dentry_cache_pool_buf;		//!< dentry cache
+#endif
 
 	int blockinfo_pool_size;			//!< block info cache buffers size
 	int pagebuf_pool_size;				//!< page buffers size
 	int tree_nodes_pool_size;			//!< tree nodes buffer size
 	int spare_pool_size;				//!< spare buffer pool size
+#ifdef CONFIG_UFFS_OBJ_FDN_MAP
+	int fdn_map_pool_size;				//!< fdn maps buffer size
+#endif
+#ifdef CONFIG_UFFS_COMPACT_TREE_NODE
+	int file_len_pool_size;				//!< file length table buffer size
+#endif
+#ifdef CONFIG_UFFS_BBT
+	int bbt_pool_size;					//!< bad block table buffer size
+#endif
+#ifdef CONFIG_UFFS_INFO_CACHE
+	int info_cache_pool_size;			//!< info cache buffer size
+#endif
+#ifdef CONFIG_UFFS_DENTRY_CACHE
+	int dentry_cache_pool_size;			//!< dentry cache buffer size
+#endif
 
 	uffs_Pool tree_pool;
 	uffs_Pool spare_pool;
@@ -42,6 +42,7 @@
 #include "uffs/uffs_types.h"
 #include "uffs/uffs_core.h"
 #include "uffs/uffs.h"
+#include "uffs/uffs_os.h"
 
 #ifdef __cplusplus
 extern "C"{
@@ -55,6 +56,10 @@ typedef struct uffs_MountTableEntrySt {
 	const char *mount;		// mount point
 	struct uffs_MountTableEntrySt *prev;
 	struct uffs_MountTableEntrySt *next;
+#ifdef CONFIG_UFFS_PARALLEL_MOUNT
+	OSTASK task;			// mount task, used by uffs_MountAll()
+	uffs_DeviceMountStatus status;	// mount result of the task
+#endif
 } uffs_MountTable;
 
 /** Register mount entry, will be put at 'unmounted' list */
@@ -66,6 +71,9 @@ int uffs_UnRegisterMountTable(uffs_MountTable *mtb);
 /** mount partition */
 uffs_DeviceMountStatus uffs_Mount(const char *mount);
 
+/** mount all registered partitions */
+int uffs_MountAll(void);
+
 /** unmount parttion */
 int uffs_UnMount(const char *mount);
 
@@ -87,6 +95,9 @@ uffs_Device * uffs_GetDeviceFromMountPointEx(const char *mount, int len);
 /** get mount point name from uffs device */
 const char * uffs_GetDeviceMountPoint(uffs_Device *dev);		
 
+/** increase uffs device references, for a device already got by uffs_GetDeviceXXX() */
+void uffs_GetDevice(uffs_Device *dev);
+
 /** down crease uffs device references by uffs_GetDeviceXXX() */
 void uffs_PutDevice(uffs_Device *dev);							
 
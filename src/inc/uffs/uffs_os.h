@@ -44,6 +44,12 @@ extern "C"{
 typedef void * OSSEM;
 #define OSSEM_NOT_INITED	(NULL)
 
+typedef void * OSTASK;
+#define OSTASK_NOT_CREATED	(NULL)
+
+typedef void * OSEVENT;
+#define OSEVENT_NOT_INITED	(NULL)
+
 struct uffs_DebugMsgOutputSt {
 	void (*output)(const char *msg);
 	void (*vprintf)(const char *fmt, va_list args);
@@ -57,8 +63,18 @@ int uffs_SemWait(OSSEM sem);
 int uffs_SemSignal(OSSEM sem);
 int uffs_SemDelete(OSSEM *sem);
 
+int uffs_OSTaskCreate(OSTASK *task, void (*entry)(void *arg), void *arg);	//create a task running entry(arg)
+int uffs_OSTaskJoin(OSTASK *task);	//wait for the task to finish and free it
+
+int uffs_EventCreate(OSEVENT *ev);	//counting event, initially not signaled
+int uffs_EventWait(OSEVENT ev);		//block until the event is signaled, consume one signal
+int uffs_EventSignal(OSEVENT ev);	//signal the event, wake up one waiter
+int uffs_EventDelete(OSEVENT *ev);
+
 int uffs_OSGetTaskId(void);	//get current task id
+int * uffs_OSGetTaskErrno(void);	//get errno storage of current task, required by CONFIG_UFFS_PER_TASK_ERRNO
 unsigned int uffs_GetCurDateTime(void);
+unsigned int uffs_OSGetTick(void);	//get a free running tick for measuring elapsed time, e.g. micro-seconds
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,104 @@
+/*
+  This file is part of UFFS, the Ultra-low-cost Flash File System.
+  
+  Copyright (C) 2005-2009 Ricky Zheng <ricky_gz_zheng@yahoo.co.nz>
+
+  UFFS is free software; you can redistribute it and/or modify it under
+  the GNU Library General Public License as published by the Free Software 
+  Foundation; either version 2 of the License, or (at your option) any
+  later version.
+
+  UFFS is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+  or GNU Library General Public License, as applicable, for more details.
+ 
+  You should have received a copy of the GNU General Public License
+  and GNU Library General Public License along with UFFS; if not, write
+  to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA  02110-1301, USA.
+
+  As a special exception, if other files instantiate templates or use
+  macros or inline functions from this file, or you compile this file
+  and link it with other works to produce a work based on this file,
+  this file does not by itself cause the resulting work to be covered
+  by the GNU General Public License. However the source code for this
+  file must still be made available in accordance with section (3) of
+  the GNU General Public License v2.
+ 
+  This exception does not invalidate any other reasons why a work based
+  on this file might be covered by the GNU General Public License.
+*/
+
+
+/**
+ * \file uffs_pack.h
+ * \brief small file packing: many small files share one 'pack' block
+ * \author Ricky Zheng
+ */
+
+#ifndef _UFFS_PACK_H_
+#define _UFFS_PACK_H_
+
+#include "uffs_config.h"
+#include "uffs/uffs_types.h"
+#include "uffs/uffs_core.h"
+#include "uffs/uffs_tree.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/*
+ * A packed file is a FILE node on the tree, but node->u.file.block is a
+ * pack block shared with other packed files. Each version of the file is
+ * a one page record: uffs_FileInfo followed by the file data, the tag is:
+ *
+ *   type: UFFS_TYPE_PACK, parent: parent dir, serial: file serial,
+ *   page_id: page number in the pack block, data_len: record length,
+ *   block_ts: pack block time stamp.
+ *
+ * The last record of the file in the pack block wins, a record with
+ * data_len == 0 is a 'tombstone' (file deleted or moved out of the pack).
+ * When the pack block is full, live records are copied to a new block
+ * (compaction). Page buffers of a packed file are page_id 0 (file info)
+ * and page_id 1 (data), just like a regular file.
+ */
+
+/**
+ * \struct uffs_PackSt
+ * \brief small file packing data of device
+ */
+struct uffs_PackSt {
+	TreeNode *list;					//!< pack block list, node->u.list.u.live: live files in the block
+	int count;						//!< number of packed files
+	u16 max_size;					//!< file data size limit of packed file
+	u32 map[FSN_MAP_WORDS];			//!< packed file bitmap, indexed by file serial
+};
+
+/** is the file #serial a packed file ? */
+#define IS_PACKED_FILE(dev, serial) \
+	(((dev)->pack.map[(serial) / 32] >> ((serial) % 32)) & 1)
+
+/** can a file with #len bytes data be packed ? */
+#define FIT_IN_PACK(dev, len)	((u32)(len) <= (dev)->pack.max_size)
+
+void uffs_PackInit(uffs_Device *dev);
+void uffs_PackInsertBlock(uffs_Device *dev, TreeNode *node);
+TreeNode * uffs_PackFindBlockNode(uffs_Device *dev, uffs_BlockNum block);
+void uffs_PackMoveFiles(uffs_Device *dev, uffs_BlockNum from, uffs_BlockNum to);
+void uffs_PackCheckPendingBlock(uffs_Device *dev, uffs_BlockInfo *bc);
+URET uffs_PackLoad(uffs_Device *dev);
+
+UBOOL uffs_PackCanAddFile(uffs_Device *dev);
+URET uffs_PackLoadBuf(uffs_Device *dev, uffs_BlockNum block, uffs_Buf *buf);
+URET uffs_PackWriteFile(uffs_Device *dev, TreeNode *node, u16 parent, u16 serial,
+						uffs_Buf *info, uffs_Buf *data);
+URET uffs_PackDeleteFile(uffs_Device *dev, TreeNode *node);
+URET uffs_PackPromoteFile(uffs_Device *dev, TreeNode *node);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
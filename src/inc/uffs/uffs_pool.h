@@ -55,6 +55,12 @@ typedef struct uffs_PoolEntrySt {
     struct uffs_PoolEntrySt *next;
 } uffs_PoolEntry;
 
+/** maximum memory chunks of a pool, see uffs_PoolGrow() */
+#define UFFS_POOL_MAX_CHUNKS	32
+
+/** number of u32 words of allocation bitmap for num_bufs buffers */
+#define UFFS_POOL_MAP_SIZE(num_bufs)	(((num_bufs) + 31) / 32)
+
 /**
  * \struct uffs_PoolSt
  * \brief Memory pool.
@@ -65,10 +71,21 @@ typedef struct uffs_PoolSt {
 	u32 num_bufs;				//!< number of buffers in the pool
 	uffs_PoolEntry *free_list;	//!< linked list of free buffers
 	OSSEM sem;					//!< buffer lock
+	u32 chunk_bufs;				//!< number of buffers in a chunk
+	u32 num_chunks;				//!< number of memory chunks, the first one is #mem
+	u8 *chunks[UFFS_POOL_MAX_CHUNKS];	//!< memory chunks
+	u32 *maps[UFFS_POOL_MAX_CHUNKS];	//!< allocation bitmap of each chunk, NULL if not used
 } uffs_Pool;
 
 URET uffs_PoolInit(uffs_Pool *pool, void *mem, u32 mem_size, u32 buf_size, u32 num_bufs, UBOOL lock);
 URET uffs_PoolRelease(uffs_Pool *pool);
+URET uffs_PoolSetAllocMap(uffs_Pool *pool, u32 *map, u32 map_size);
+URET uffs_PoolGrow(uffs_Pool *pool, void *mem, u32 mem_size, u32 *map);
+
+#ifdef CONFIG_UFFS_GROWABLE_HANDLES
+void * uffs_PoolGetGrow(uffs_Pool *pool, u32 max_bufs);
+void uffs_PoolReleaseGrown(uffs_Pool *pool);
+#endif
 
 UBOOL uffs_PoolVerify(uffs_Pool *pool, void *p);
 
@@ -107,10 +107,18 @@ typedef struct uffs_ObjectInfoSt {
 /**
  * \def UFFS_TAG_DATA_LEN_BITS
  * \brief the number of bits used to store length of data in page. 
- * Defaults to 12, which imposes 4 KB limit on page length.
+ * Defaults to 12 (4 KB page) and grows with UFFS_MAX_PAGE_SIZE:
+ * 13 for 8 KB and 14 for 16 KB page. The low 12 bits are in the first
+ * word of tag, bits above 12 take the reserved bits of the second word.
  */
 #ifndef UFFS_TAG_DATA_LEN_BITS
+#  if UFFS_MAX_PAGE_SIZE > 8192
+#    define UFFS_TAG_DATA_LEN_BITS 14
+#  elif UFFS_MAX_PAGE_SIZE > 4096
+#    define UFFS_TAG_DATA_LEN_BITS 13
+#  else
 #    define UFFS_TAG_DATA_LEN_BITS 12
+#  endif
 #endif
 
 /**
@@ -118,10 +126,17 @@ typedef struct uffs_ObjectInfoSt {
  * \brief define number of bits used for page_id in tag,
  *        this defines the maximum pages per block you can have.
  *        e.g. '9' ==> maximum 512 pages per block
+ * Defaults to 6 (64 pages per block), can be overridden in uffs_config.h.
  **/
-#define UFFS_TAG_PAGE_ID_SIZE_BITS  6
+#ifndef UFFS_TAG_PAGE_ID_SIZE_BITS
+#  define UFFS_TAG_PAGE_ID_SIZE_BITS  6
+#endif
+
+#if UFFS_TAG_DATA_LEN_BITS < 12
+#error "UFFS_TAG_DATA_LEN_BITS cannot be less than 12 !"
+#endif
 
-#if UFFS_TAG_RESERVED_BITS + UFFS_TAG_DATA_LEN_BITS > 22
+#if UFFS_TAG_PAGE_ID_SIZE_BITS + UFFS_TAG_DATA_LEN_BITS > 22
 #error "UFFS_TAG_PAGE_ID_SIZE_BITS + UFFS_TAG_DATA_LEN_BITS cannot be bigger than 22 !"
 #endif
 
@@ -135,6 +150,20 @@ typedef struct uffs_ObjectInfoSt {
  **/
 #define UFFS_TAG_RESERVED_BITS (22 - UFFS_TAG_PAGE_ID_SIZE_BITS - UFFS_TAG_DATA_LEN_BITS)
 
+/**
+ * \def UFFS_TAG_PARENT_BITS
+ * \brief the number of bits of uffs_TagStoreSt#parent, limits the number of dir|file serials.
+ *        With CONFIG_UFFS_WIDE_SERIAL, the reserved bits are used for parent.
+ **/
+#ifdef CONFIG_UFFS_WIDE_SERIAL
+#  if UFFS_TAG_RESERVED_BITS == 0
+#    error "CONFIG_UFFS_WIDE_SERIAL needs reserved tag bits, reduce UFFS_TAG_PAGE_ID_SIZE_BITS or UFFS_TAG_DATA_LEN_BITS"
+#  endif
+#  define UFFS_TAG_PARENT_BITS (10 + UFFS_TAG_RESERVED_BITS)
+#else
+#  define UFFS_TAG_PARENT_BITS 10
+#endif
+
 /**
  * \struct uffs_TagStoreSt
  * \brief uffs tag, 8 bytes, will be store in page spare area.
@@ -144,12 +173,15 @@ struct uffs_TagStoreSt {
 	u32 valid:1;		//!< 0: valid, 1: invalid
 	u32 type:2;			//!< block type: #UFFS_TYPE_DIR, #UFFS_TYPE_FILE, #UFFS_TYPE_DATA
 	u32 block_ts:2;		//!< time stamp of block;
-	u32 data_len:UFFS_TAG_DATA_LEN_BITS;	//!< length of page data
+	u32 data_len:12;	//!< length of page data (low 12 bits)
 	u32 serial:14;		//!< serial number
 
-	u32 parent:10;		//!< parent's serial number
+	u32 parent:UFFS_TAG_PARENT_BITS;		//!< parent's serial number
 	u32 page_id:UFFS_TAG_PAGE_ID_SIZE_BITS;		//!< page id
-#if UFFS_TAG_RESERVED_BITS != 0
+#if UFFS_TAG_DATA_LEN_BITS > 12
+	u32 data_len_hi:(UFFS_TAG_DATA_LEN_BITS - 12);	//!< length of page data (bits above 12)
+#endif
+#if UFFS_TAG_RESERVED_BITS != 0 && !defined(CONFIG_UFFS_WIDE_SERIAL)
 	u32 reserved:UFFS_TAG_RESERVED_BITS;		//!< reserved, for UFFS2
 #endif
 	u32 tag_ecc:12;		//!< tag ECC
@@ -201,7 +233,14 @@ struct uffs_MiniHeaderSt {
 #define TAG_SERIAL(tag) (tag)->s.serial
 #define TAG_PARENT(tag) (tag)->s.parent
 #define TAG_PAGE_ID(tag) (tag)->s.page_id
+#if UFFS_TAG_DATA_LEN_BITS > 12
+#define TAG_DATA_LEN(tag) ((tag)->s.data_len | ((u32)(tag)->s.data_len_hi << 12))
+#define TAG_SET_DATA_LEN(tag, len) \
+	do { (tag)->s.data_len = (len) & 0xfff; (tag)->s.data_len_hi = (u32)(len) >> 12; } while (0)
+#else
 #define TAG_DATA_LEN(tag) (tag)->s.data_len
+#define TAG_SET_DATA_LEN(tag, len) (tag)->s.data_len = (len)
+#endif
 #define TAG_TYPE(tag) (tag)->s.type
 #define TAG_BLOCK_TS(tag) (tag)->s.block_ts
 #define SEAL_TAG(tag) (tag)->seal_byte = 0
@@ -224,6 +263,19 @@ UBOOL uffs_IsSrcNewerThanObj(int src, int obj);
 
 #define TENDSTR "\n"
 
+/**
+ * messages below the compile time threshold are removed by compiler,
+ * including the evaluation of arguments. If debug message is disabled,
+ * all messages are removed.
+ */
+#ifndef CONFIG_ENABLE_UFFS_DEBUG_MSG
+# define UFFS_MIN_MSG_LEVEL	UFFS_MSG_NOMSG
+#elif defined(CONFIG_UFFS_MIN_MSG_LEVEL)
+# define UFFS_MIN_MSG_LEVEL	CONFIG_UFFS_MIN_MSG_LEVEL
+#else
+# define UFFS_MIN_MSG_LEVEL	UFFS_MSG_NOISY
+#endif
+
 struct uffs_DebugMsgOutputSt;
 URET uffs_InitDebugMessageOutput(struct uffs_DebugMsgOutputSt *ops, int msg_level);
 void uffs_DebugSetMessageLevel(int msg_level);
@@ -239,10 +291,12 @@ UBOOL uffs_Assert(UBOOL expr, const char *fmt, ...);
 #else
 
 #define uffs_Perror(level, fmt, ... ) \
-	uffs_DebugMessage(level, PFX, TENDSTR, __LINE__, fmt, ## __VA_ARGS__)
+	((level) >= UFFS_MIN_MSG_LEVEL ? \
+		uffs_DebugMessage(level, PFX, TENDSTR, __LINE__, fmt, ## __VA_ARGS__) : (void)0)
 
 #define uffs_PerrorRaw(level, fmt, ... ) \
-	uffs_DebugMessage(level, NULL, NULL, -1, fmt, ## __VA_ARGS__)
+	((level) >= UFFS_MIN_MSG_LEVEL ? \
+		uffs_DebugMessage(level, NULL, NULL, -1, fmt, ## __VA_ARGS__) : (void)0)
 
 #define uffs_Assert(expr, msg, ...) \
 	((expr) ? U_TRUE : (uffs_AssertCall(__FILE__, __LINE__, msg, ## __VA_ARGS__), U_FALSE))
@@ -279,11 +333,15 @@ UBOOL uffs_IsBlockBad(uffs_Device *dev, uffs_BlockInfo *bc);
  * \def UFFS_INVALID_BLOCK
  * \brief macro for invalid block number
  */
+#ifdef CONFIG_UFFS_WIDE_BLOCK_ADDR
+#define UFFS_INVALID_BLOCK	(0xfffffffe)
+#else
 #define UFFS_INVALID_BLOCK	(0xfffe)
+#endif
 
 
-URET uffs_NewBlock(uffs_Device *dev, u16 block, uffs_Tags *tag, uffs_Buf *buf);
-URET uffs_BlockRecover(uffs_Device *dev, uffs_BlockInfo *old, u16 newBlock);
+URET uffs_NewBlock(uffs_Device *dev, uffs_BlockNum block, uffs_Tags *tag, uffs_Buf *buf);
+URET uffs_BlockRecover(uffs_Device *dev, uffs_BlockInfo *old, uffs_BlockNum newBlock);
 URET uffs_PageRecover(uffs_Device *dev, 
 					  uffs_BlockInfo *bc, 
 					  u16 oldPage, 
@@ -320,6 +378,7 @@ URET uffs_DirEntryBufInit(void);
 URET uffs_DirEntryBufRelease(void);
 uffs_Pool * uffs_DirEntryBufGetPool(void);
 int uffs_DirEntryBufPutAll(uffs_Device *dev);
+uffs_Device * uffs_GetDeviceFromFd(int fd);
 
 
 /************************************************************************/
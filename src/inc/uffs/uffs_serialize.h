@@ -12,11 +12,11 @@ extern "C"
 
 #define UFFS_SERIALIZATION_SIZE(block_count)                                      \
 	(                                                                             \
-		block_count * 18 +        /* block_count * size of largest node entity */ \
-		3 * 2 +                   /* Terminating indices */                       \
-		DIR_NODE_ENTRY_LEN * 2 +  /* Directory node entries hashes */             \
-		FILE_NODE_ENTRY_LEN * 2 + /* File node entries hashes */                  \
-		DATA_NODE_ENTRY_LEN * 2   /* Data node entries hashes */                  \
+		block_count * (12 + 3 * UFFS_NODE_INDEX_SIZE) + /* size of largest node entity */ \
+		3 * UFFS_NODE_INDEX_SIZE +                      /* Terminating indices */        \
+		DIR_NODE_ENTRY_LEN * UFFS_NODE_INDEX_SIZE +     /* Directory node entries hashes */ \
+		FILE_NODE_ENTRY_LEN * UFFS_NODE_INDEX_SIZE +    /* File node entries hashes */   \
+		DATA_NODE_ENTRY_LEN * UFFS_NODE_INDEX_SIZE      /* Data node entries hashes */   \
 	)
 
 /*
@@ -100,8 +100,17 @@ extern "C"
  * | Serial        | 16          |
  * | Length        | 32          |
  * +---------------+-------------+
+ *
+ * With CONFIG_UFFS_WIDE_BLOCK_ADDR, indices, node counts, hashes and block numbers
+ * are 32-bit values and the terminator is 0xffffffff.
  */
 
+#ifdef CONFIG_UFFS_WIDE_BLOCK_ADDR
+#define UFFS_NODE_INDEX_SIZE	4		//!< bytes of a serialized index or block number
+#else
+#define UFFS_NODE_INDEX_SIZE	2		//!< bytes of a serialized index or block number
+#endif
+
 typedef struct uffs_SerializeOpsSt
 {
 	/**
@@ -185,10 +194,16 @@ typedef struct uffs_SerializeOpsSt
 	int (*ReadU8)(uffs_Device* dev, u8* value);
 } uffs_SerializeOps;
 
-/** Serialize state using operations stored in dev */
+/**
+ * Serialize state using operations stored in dev
+ * \note always fails with CONFIG_UFFS_SMALL_FILE_PACK, packed files are not serialized.
+ */
 URET uffs_SerializeState(uffs_Device* dev);
 
-/** Deserialize state using operations stored in dev */
+/**
+ * Deserialize state using operations stored in dev
+ * \note always fails with CONFIG_UFFS_SMALL_FILE_PACK, the tree is built from flash instead.
+ */
 URET uffs_DeserializeState(uffs_Device* dev);
 
 #ifdef __cplusplus
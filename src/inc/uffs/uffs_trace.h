@@ -0,0 +1,163 @@
+/*
+  This file is part of UFFS, the Ultra-low-cost Flash File System.
+  
+  Copyright (C) 2005-2009 Ricky Zheng <ricky_gz_zheng@yahoo.co.nz>
+
+  UFFS is free software; you can redistribute it and/or modify it under
+  the GNU Library General Public License as published by the Free Software 
+  Foundation; either version 2 of the License, or (at your option) any
+  later version.
+
+  UFFS is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+  or GNU Library General Public License, as applicable, for more details.
+ 
+  You should have received a copy of the GNU General Public License
+  and GNU Library General Public License along with UFFS; if not, write
+  to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA  02110-1301, USA.
+
+  As a special exception, if other files instantiate templates or use
+  macros or inline functions from this file, or you compile this file
+  and link it with other works to produce a work based on this file,
+  this file does not by itself cause the resulting work to be covered
+  by the GNU General Public License. However the source code for this
+  file must still be made available in accordance with section (3) of
+  the GNU General Public License v2.
+ 
+  This exception does not invalidate any other reasons why a work based
+  on this file might be covered by the GNU General Public License.
+*/
+
+
+/**
+ * \file uffs_trace.h
+ * \brief low overhead tracepoints for buffer flush and block recovery
+ * \author Ricky Zheng
+ */
+
+#ifndef _UFFS_TRACE_H_
+#define _UFFS_TRACE_H_
+
+#include "uffs_config.h"
+#include "uffs/uffs_types.h"
+#include "uffs/uffs_core.h"
+#include "uffs/uffs_os.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/** trace event ids (uffs_TraceRecordSt.event) */
+#define UFFS_TRACE_EV_BUF_FLUSH			1	//!< a dirty group flushed to flash (_BufFlush)
+#define UFFS_TRACE_EV_BLOCK_RECOVER		2	//!< a dirty group flushed by copying to a new block
+#define UFFS_TRACE_EV_BADBLOCK_RECOVER	3	//!< a pending bad/refresh block processed
+
+#define UFFS_TRACE_EV_NAME_STRING \
+	{ "none", "flush", "recover", "badblock" }	// index is the event id.
+
+/** trace result (uffs_TraceRecordSt.result) */
+#define UFFS_TRACE_OK		0
+#define UFFS_TRACE_FAIL		1
+
+/**
+ * \struct uffs_TraceRecordSt
+ * \brief fixed size binary trace record, passed to the trace hook
+ */
+struct uffs_TraceRecordSt {
+	u32 start;			//!< start time stamp, in uffs_OSGetTick() units
+	u32 duration;		//!< elapsed time, in uffs_OSGetTick() units
+	u32 block;			//!< flash block, UFFS_INVALID_BLOCK if not known
+	u16 page;			//!< number of dirty pages for flush events, UFFS_INVALID_PAGE for others
+	u16 serial;			//!< object serial, INVALID_UFFS_SERIAL if not known
+	u8 event;			//!< event id, UFFS_TRACE_EV_XXX
+	u8 dev;				//!< device number (uffs_DeviceSt.dev_num)
+	u8 arg;				//!< event argument: object type for flush events, pending mark for bad block events
+	u8 result;			//!< #UFFS_TRACE_OK or #UFFS_TRACE_FAIL
+};
+
+typedef struct uffs_TraceRecordSt uffs_TraceRecord;
+
+/**
+ * trace hook, called with the device lock held.
+ * \note with CONFIG_USE_PER_DEVICE_LOCK, the hook may be called from
+ *		 different devices at the same time. Keep it short !
+ */
+typedef void (*uffs_TraceHook)(const uffs_TraceRecord *rec, void *ctx);
+
+/**
+ * \struct uffs_TraceSinkSt
+ * \brief installed trace hook with its ctx, published as one pointer
+ */
+struct uffs_TraceSinkSt {
+	uffs_TraceHook hook;
+	void *ctx;
+};
+
+typedef struct uffs_TraceSinkSt uffs_TraceSink;
+
+/**
+ * \struct uffs_TraceRingSt
+ * \brief a ring buffer trace consumer, keeps the latest records
+ */
+struct uffs_TraceRingSt {
+	OSSEM lock;				//!< protects the ring, hook may run on several devices at once
+	uffs_TraceRecord *recs;	//!< record buffer, provided by caller
+	u32 size;				//!< number of records the buffer can hold
+	u32 head;				//!< next record to write
+	u32 count;				//!< number of valid records
+	u32 lost;				//!< records overwritten before been read
+};
+
+typedef struct uffs_TraceRingSt uffs_TraceRing;
+
+#ifdef CONFIG_UFFS_TRACE
+
+/** current trace sink, NULL when tracing is off. Only a hint outside the trace lock. */
+extern uffs_TraceSink *uffs_trace_sink;
+
+/** install trace hook, pass NULL to stop tracing */
+void uffs_TraceSetHook(uffs_TraceHook hook, void *ctx);
+
+/** build a record and deliver it to the trace hook */
+void uffs_TraceEmit(uffs_Device *dev, u8 event, u32 block, u16 page,
+					u16 serial, u8 arg, URET ret, u32 start);
+
+/** initialize ring buffer consumer with caller's record buffer */
+URET uffs_TraceRingInit(uffs_TraceRing *ring, uffs_TraceRecord *recs, int size);
+
+/**
+ * release ring buffer consumer, the ring hook must be uninstalled and
+ * tasks which may be running the hook quiesced before.
+ */
+void uffs_TraceRingRelease(uffs_TraceRing *ring);
+
+/** trace hook storing records to ring buffer, ctx is the (uffs_TraceRing *) */
+void uffs_TraceRingHook(const uffs_TraceRecord *rec, void *ctx);
+
+/**
+ * read the oldest records from ring buffer
+ * \return number of records copied to recs
+ */
+int uffs_TraceRingRead(uffs_TraceRing *ring, uffs_TraceRecord *recs, int max);
+
+#define UFFS_TRACE_START(t)		(t) = (uffs_trace_sink ? uffs_OSGetTick() : 0)
+#define UFFS_TRACE(dev, event, block, page, serial, arg, ret, t) \
+	do { \
+		if (uffs_trace_sink) \
+			uffs_TraceEmit(dev, event, block, page, serial, arg, ret, t); \
+	} while (0)
+
+#else
+
+#define UFFS_TRACE_START(t)
+#define UFFS_TRACE(dev, event, block, page, serial, arg, ret, t)
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -35,6 +35,7 @@
 
 #include "uffs/uffs_types.h"
 #include "uffs/uffs_pool.h"
+#include "uffs/uffs_public.h"
 #include "uffs/uffs_device.h"
 #include "uffs/uffs_core.h"
 
@@ -45,7 +46,8 @@ extern "C"{
 #define UFFS_TYPE_DIR		0
 #define UFFS_TYPE_FILE		1
 #define UFFS_TYPE_DATA		2
-#define UFFS_TYPE_RESV		3
+#define UFFS_TYPE_PACK		3		//!< small file pack block, see uffs_pack.h
+#define UFFS_TYPE_RESV		UFFS_TYPE_PACK	//!< old name of type 3, kept for compatibility
 #define UFFS_TYPE_INVALID	0xFF
 
 struct uffs_NodeTypeNameMapSt {
@@ -57,22 +59,66 @@ struct uffs_NodeTypeNameMapSt {
 	{UFFS_TYPE_DIR, "DIR"}, \
 	{UFFS_TYPE_FILE, "FILE"}, \
 	{UFFS_TYPE_DATA, "DATA"}, \
-	{UFFS_TYPE_RESV, "RESV"}, \
+	{UFFS_TYPE_PACK, "PACK"}, \
 	{UFFS_TYPE_INVALID, "INVALID"} \
 }
 
+#ifdef CONFIG_UFFS_COMPACT_TREE_NODE
+
+/*
+ * Compact tree node: list links are tree pool indexes instead of pointers,
+ * file length is kept in uffs_TreeSt#file_len[] indexed by file serial
+ * (allocated from dev->mem, see FILE_LEN_TABLE_LEN()),
+ * data block length is only needed for summing up file length when
+ * building tree so it's not kept.
+ */
+
+struct BlockListSt {	/* 8 bytes */
+	uffs_NodeIndex next;	/* index of next node, EMPTY_NODE for the end of list */
+	uffs_NodeIndex prev;	/* index of prev node, EMPTY_NODE for the head of list */
+	uffs_BlockNum block;
+	union {
+		u16 serial;			/* for suspended block list */
+		u8 need_check;		/* for erased block list */
+		u16 live;			/* for pack block list: files live in this block */
+	} u;
+};
+
+struct DirhSt {		/* 8 bytes */
+	uffs_BlockNum block;
+	u16 checksum;	/* check sum of dir name */
+	u16 parent;
+	u16 serial;
+};
+
+struct FilehSt {	/* 8 bytes */
+	uffs_BlockNum block;
+	u16 checksum;	/* check sum of file name */
+	u16 parent;
+	u16 serial;
+};
+
+struct FdataSt {	/* 6 bytes */
+	uffs_BlockNum block;
+	u16 parent;
+	u16 serial;
+};
+
+#else
+
 struct BlockListSt {	/* 12 bytes */
 	struct uffs_TreeNodeSt * next;
 	struct uffs_TreeNodeSt * prev;
-	u16 block;
+	uffs_BlockNum block;
 	union {
 		u16 serial;			/* for suspended block list */
 		u8 need_check;		/* for erased block list */
+		u16 live;			/* for pack block list: files live in this block */
 	} u;
 };
 
 struct DirhSt {		/* 8 bytes */
-	u16 block;
+	uffs_BlockNum block;
 	u16 checksum;	/* check sum of dir name */
 	u16 parent;
 	u16 serial;
@@ -80,7 +126,7 @@ struct DirhSt {		/* 8 bytes */
 
 
 struct FilehSt {	/* 12 bytes */
-	u16 block;
+	uffs_BlockNum block;
 	u16 checksum;	/* check sum of file name */
 	u16 parent;
 	u16 serial;
@@ -88,13 +134,15 @@ struct FilehSt {	/* 12 bytes */
 };
 
 struct FdataSt {	/* 10 bytes */
-	u16 block;
+	uffs_BlockNum block;
 	u16 parent;
 	u32 len;		/* file data length on this block */
 	u16 serial;
 };
 
-//UFFS TreeNode (14 or 16 bytes)
+#endif
+
+//UFFS TreeNode (14 or 16 bytes, 12 bytes if CONFIG_UFFS_COMPACT_TREE_NODE, larger with CONFIG_UFFS_WIDE_BLOCK_ADDR)
 typedef struct uffs_TreeNodeSt {
 	union {
 		struct BlockListSt list;
@@ -102,48 +150,34 @@ typedef struct uffs_TreeNodeSt {
 		struct FilehSt file;
 		struct FdataSt data;
 	} u;
-	u16 hash_next;		
-	u16 hash_prev;			
+	uffs_NodeIndex hash_next;		
+	uffs_NodeIndex hash_prev;			
 } TreeNode;
 
+//tree pool buffer size per node: TreeNode rounded up to pointer size (required by uffs_Pool)
+#define TREE_NODE_BUF_SIZE \
+	((sizeof(TreeNode) + sizeof(void *) - 1) / sizeof(void *) * sizeof(void *))
 
-//TODO: UFFS2 Tree structures
 /*
-struct FdataSt {
-	u32 len;
-};
-
-struct filebSt {
-	u16 bls;		//how many blocks this file contents ...
-	u8 offs;		//the offset of this file header on FILE block
-	u8 sum;			//short sum of file name
-};
-
-//Extra data structure for storing file length information
-struct FilehSt {
-	u32 len;
-};
-
-//UFFS2 TreeNode (12 bytes)
-typedef struct uffs_TreeNodeSt {
-	u16 nextIdx;
-	u16 block;
-	u16 parent;
-	u16 serial;
-	union {
-		struct FilehSt h;
-		struct filedSt file;
-		struct data;
-	} u;
-} TreeNode;
-
-*/
+ * entries of file length table for #n_blocks blocks (CONFIG_UFFS_COMPACT_TREE_NODE).
+ * Images written by other builds or on other geometry may use any serial
+ * up to MAX_UFFS_FSN, so the table covers all of them whatever the partition size.
+ */
+#define FILE_LEN_TABLE_LEN(n_blocks)	(MAX_UFFS_FSN + 1)
 
 
+#ifdef CONFIG_UFFS_WIDE_BLOCK_ADDR
+#define EMPTY_NODE 0xffffffff			//!< special index num of empty node.
+#else
 #define EMPTY_NODE 0xffff				//!< special index num of empty node.
+#endif
 
 #define ROOT_DIR_SERIAL	0				//!< serial num of root dir
-#define MAX_UFFS_FSN			0x3ff	//!< maximum dir|file serial number (uffs_TagStore#parent: 10 bits)
+#if UFFS_TAG_PARENT_BITS > 14
+#define MAX_UFFS_FSN			0x3fff	//!< maximum dir|file serial number (uffs_TagStore#serial: 14 bits)
+#else
+#define MAX_UFFS_FSN			((1 << UFFS_TAG_PARENT_BITS) - 1)	//!< maximum dir|file serial number (uffs_TagStore#parent)
+#endif
 #define MAX_UFFS_FDN			0x3fff	//!< maximum file data block serial numbers (uffs_TagStore#serial: 14 bits)
 #define PARENT_OF_ROOT			0xfffd	//!< parent of ROOT ? kidding me ...
 #define INVALID_UFFS_SERIAL		0xffff	//!< invalid serial num
@@ -157,28 +191,83 @@ typedef struct uffs_TreeNodeSt {
 #define DATA_NODE_HASH_MASK		0x1ff
 #define DATA_NODE_ENTRY_LEN		(DATA_NODE_HASH_MASK + 1)
 #define FROM_IDX(idx, pool)		((TreeNode *)uffs_PoolGetBufByIndex(pool, idx))
-#define TO_IDX(p, pool)			((u16)uffs_PoolGetIndex(pool, (void *) p))
+#define TO_IDX(p, pool)			((uffs_NodeIndex)uffs_PoolGetIndex(pool, (void *) p))
 
 
 #define GET_FILE_HASH(serial)			(serial & FILE_NODE_HASH_MASK)
 #define GET_DIR_HASH(serial)			(serial & DIR_NODE_HASH_MASK)
 #define GET_DATA_HASH(parent, serial)	((parent + serial) & DATA_NODE_HASH_MASK)
 
+#ifdef CONFIG_UFFS_COMPACT_TREE_NODE
+#define NODE_TO_LIST_IDX(dev, node) \
+	((node) == NULL ? EMPTY_NODE : TO_IDX(node, &((dev)->mem.tree_pool)))
+#define LIST_IDX_TO_NODE(dev, idx) \
+	((idx) == EMPTY_NODE ? NULL : FROM_IDX(idx, &((dev)->mem.tree_pool)))
+
+#define LIST_NEXT(dev, node)			LIST_IDX_TO_NODE(dev, (node)->u.list.next)
+#define LIST_PREV(dev, node)			LIST_IDX_TO_NODE(dev, (node)->u.list.prev)
+#define LIST_SET_NEXT(dev, node, p)		((node)->u.list.next = NODE_TO_LIST_IDX(dev, p))
+#define LIST_SET_PREV(dev, node, p)		((node)->u.list.prev = NODE_TO_LIST_IDX(dev, p))
+
+#define FILE_NODE_LEN(dev, node)		((dev)->tree.file_len[(node)->u.file.serial])
+#else
+#define LIST_NEXT(dev, node)			((node)->u.list.next)
+#define LIST_PREV(dev, node)			((node)->u.list.prev)
+#define LIST_SET_NEXT(dev, node, p)		((node)->u.list.next = (p))
+#define LIST_SET_PREV(dev, node, p)		((node)->u.list.prev = (p))
+
+#define FILE_NODE_LEN(dev, node)		((node)->u.file.len)
+#endif
+
+#define FSN_MAP_WORDS	((MAX_UFFS_FSN + 32) / 32)	//!< words of uffs_TreeSt#fsn_map
+
+#define HAVE_PREALLOC_BLOCK(dev, owner) \
+	((dev)->tree.prealloc_count > 0 && (dev)->tree.prealloc_owner == (owner))
+
+
+#ifdef CONFIG_UFFS_OBJ_FDN_MAP
+/** fdn -> DATA node map of an opened file, see uffs_TreeFdnMapGet() */
+struct uffs_FdnMapSt {
+	u16 serial;							//!< file serial, INVALID_UFFS_SERIAL if the map is free
+	u16 ref_count;						//!< objects using this map
+	u32 gen;							//!< uffs_TreeSt#data_gen when the map was filled
+	uffs_NodeIndex *idx;				//!< idx[fdn - 1]: DATA node index, EMPTY_NODE if not resolved yet
+};
+#endif
 
 struct uffs_TreeSt {
 	TreeNode *erased;					//!< erased block list head
 	TreeNode *erased_tail;				//!< erased block list tail
 	int erased_count;					//!< erased block counter
 
+	TreeNode *prealloc;					//!< erased and checked blocks reserved by uffs_TreePreallocBlocks()
+	int prealloc_count;					//!< reserved block counter
+	u16 prealloc_owner;					//!< serial of the file which owns the reserved blocks
+	const void *prealloc_holder;		//!< object which made the reservation, released when it's closed
+
 	TreeNode *suspend;					//!< suspended block list, this is just a staging zone
 										//   that prevent the serial number of the block be re-used.
 	TreeNode *bad;						//!< bad block list
 	int bad_count;						//!< bad block counter
 
-	u16 dir_entry[DIR_NODE_ENTRY_LEN];
-	u16 file_entry[FILE_NODE_ENTRY_LEN];
-	u16 data_entry[DATA_NODE_ENTRY_LEN];
+	uffs_NodeIndex dir_entry[DIR_NODE_ENTRY_LEN];
+	uffs_NodeIndex file_entry[FILE_NODE_ENTRY_LEN];
+	uffs_NodeIndex data_entry[DATA_NODE_ENTRY_LEN];
 	u16 max_serial;
+
+	u32 fsn_map[FSN_MAP_WORDS];			//!< dir|file serial allocation bitmap, bit set: serial in use
+	int fsn_free_word;					//!< lowest #fsn_map word which may have a free serial
+
+#ifdef CONFIG_UFFS_COMPACT_TREE_NODE
+	u32 *file_len;						//!< file length, indexed by file serial
+	int file_len_num;					//!< entries of #file_len (MAX_UFFS_FSN + 1)
+#endif
+
+#ifdef CONFIG_UFFS_OBJ_FDN_MAP
+	struct uffs_FdnMapSt fdn_map[UFFS_FDN_MAP_NUM];	//!< fdn maps of opened files
+	int fdn_map_len;					//!< entries per fdn map, 0 if maps are not available
+	u32 data_gen;						//!< bumped whenever a DATA node leaves the tree
+#endif
 };
 
 
@@ -186,6 +275,7 @@ URET uffs_TreeInit(uffs_Device *dev);
 URET uffs_TreeRelease(uffs_Device *dev);
 URET uffs_BuildTree(uffs_Device *dev);
 u16 uffs_FindFreeFsnSerial(uffs_Device *dev);
+void uffs_TreeResetFsnMap(uffs_Device *dev);
 TreeNode * uffs_TreeFindFileNode(uffs_Device *dev, u16 serial);
 TreeNode * uffs_TreeFindFileNodeWithParent(uffs_Device *dev, u16 parent);
 TreeNode * uffs_TreeFindDirNode(uffs_Device *dev, u16 serial);
@@ -194,12 +284,18 @@ TreeNode * uffs_TreeFindFileNodeByName(uffs_Device *dev, const char *name, u32 l
 TreeNode * uffs_TreeFindDirNodeByName(uffs_Device *dev, const char *name, u32 len, u16 sum, u16 parent);
 TreeNode * uffs_TreeFindDataNode(uffs_Device *dev, u16 parent, u16 serial);
 
+#ifdef CONFIG_UFFS_OBJ_FDN_MAP
+struct uffs_FdnMapSt * uffs_TreeFdnMapGet(uffs_Device *dev, u16 serial);
+void uffs_TreeFdnMapPut(uffs_Device *dev, struct uffs_FdnMapSt *map);
+TreeNode * uffs_TreeFindDataNodeByMap(uffs_Device *dev, struct uffs_FdnMapSt *map, u16 parent, u16 serial);
+#endif
+
 
-TreeNode * uffs_TreeFindDirNodeByBlock(uffs_Device *dev, u16 block);
-TreeNode * uffs_TreeFindFileNodeByBlock(uffs_Device *dev, u16 block);
-TreeNode * uffs_TreeFindDataNodeByBlock(uffs_Device *dev, u16 block);
-TreeNode * uffs_TreeFindErasedNodeByBlock(uffs_Device *dev, u16 block);
-TreeNode * uffs_TreeFindBadNodeByBlock(uffs_Device *dev, u16 block);
+TreeNode * uffs_TreeFindDirNodeByBlock(uffs_Device *dev, uffs_BlockNum block);
+TreeNode * uffs_TreeFindFileNodeByBlock(uffs_Device *dev, uffs_BlockNum block);
+TreeNode * uffs_TreeFindDataNodeByBlock(uffs_Device *dev, uffs_BlockNum block);
+TreeNode * uffs_TreeFindErasedNodeByBlock(uffs_Device *dev, uffs_BlockNum block);
+TreeNode * uffs_TreeFindBadNodeByBlock(uffs_Device *dev, uffs_BlockNum block);
 
 void uffs_TreeSuspendAdd(uffs_Device *dev, TreeNode *node);
 TreeNode * uffs_TreeFindSuspendNode(uffs_Device *dev, u16 serial);
@@ -210,13 +306,18 @@ void uffs_TreeRemoveSuspendNode(uffs_Device *dev, TreeNode *node);
 #define SEARCH_REGION_DATA		4
 #define SEARCH_REGION_BAD		8
 #define SEARCH_REGION_ERASED	16
-TreeNode * uffs_TreeFindNodeByBlock(uffs_Device *dev, u16 block, int *region);
+#define SEARCH_REGION_PACK		32
+TreeNode * uffs_TreeFindNodeByBlock(uffs_Device *dev, uffs_BlockNum block, int *region);
 
 
 
 UBOOL uffs_TreeCompareFileName(uffs_Device *dev, const char *name, u32 len, u16 sum, TreeNode *node, int type);
 
 TreeNode * uffs_TreeGetErasedNode(uffs_Device *dev);
+TreeNode * uffs_TreeGetErasedNodeFor(uffs_Device *dev, u16 owner);
+void uffs_TreePutErasedNodeFor(uffs_Device *dev, u16 owner, TreeNode *node);
+URET uffs_TreePreallocBlocks(uffs_Device *dev, u16 owner, int count);
+void uffs_TreeReleasePrealloc(uffs_Device *dev);
 URET uffs_TreeEraseNode(uffs_Device *dev, TreeNode *node);
 
 void uffs_InsertNodeToTree(uffs_Device *dev, u8 type, TreeNode *node);
@@ -227,7 +328,7 @@ void uffs_TreeInsertToBadBlockList(uffs_Device *dev, TreeNode *node);
 
 void uffs_BreakFromEntry(uffs_Device *dev, u8 type, TreeNode *node);
 
-void uffs_TreeSetNodeBlock(u8 type, TreeNode *node, u16 block);
+void uffs_TreeSetNodeBlock(u8 type, TreeNode *node, uffs_BlockNum block);
 
 
 #ifdef __cplusplus
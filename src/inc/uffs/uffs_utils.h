@@ -50,6 +50,18 @@ void uffs_ReleaseGlobalFsLock(void);
 int uffs_GlobalFsLockLock(void);
 void uffs_GlobalFsLockUnlock(void);
 
+/* object and dir handle pools are shared by all devices,
+   without global lock they are protected by their own pool lock */
+#ifdef CONFIG_USE_GLOBAL_FS_LOCK
+#define UFFS_HANDLE_POOL_LOCK		U_FALSE
+#define uffs_HandlePoolGet(pool)	uffs_PoolGet(pool)
+#define uffs_HandlePoolPut(pool, p)	uffs_PoolPut(pool, p)
+#else
+#define UFFS_HANDLE_POOL_LOCK		U_TRUE
+#define uffs_HandlePoolGet(pool)	uffs_PoolGetLocked(pool)
+#define uffs_HandlePoolPut(pool, p)	uffs_PoolPutLocked(pool, p)
+#endif
+
 URET uffs_FormatDevice(uffs_Device *dev, UBOOL force);
 URET uffs_FormatDeviceEx(uffs_Device *dev, UBOOL force, UBOOL lock);
 #ifdef __cplusplus
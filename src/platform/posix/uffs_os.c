@@ -90,12 +90,149 @@ int uffs_SemDelete(OSSEM *sem)
 	return ret;
 }
 
-int uffs_OSGetTaskId(void)
+struct posix_event {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	int count;
+};
+
+int uffs_EventCreate(OSEVENT *ev)
 {
-	//TODO: ... return current task ID ...
+	struct posix_event *e = (struct posix_event *) malloc(sizeof(struct posix_event));
+
+	if (e == NULL)
+		return -1;
+
+	if (pthread_mutex_init(&e->mutex, NULL) != 0) {
+		free(e);
+		return -1;
+	}
+	if (pthread_cond_init(&e->cond, NULL) != 0) {
+		pthread_mutex_destroy(&e->mutex);
+		free(e);
+		return -1;
+	}
+	e->count = 0;
+	*ev = (OSEVENT)e;
+
 	return 0;
 }
 
+int uffs_EventWait(OSEVENT ev)
+{
+	struct posix_event *e = (struct posix_event *)ev;
+
+	pthread_mutex_lock(&e->mutex);
+	while (e->count == 0)
+		pthread_cond_wait(&e->cond, &e->mutex);
+	e->count--;
+	pthread_mutex_unlock(&e->mutex);
+
+	return 0;
+}
+
+int uffs_EventSignal(OSEVENT ev)
+{
+	struct posix_event *e = (struct posix_event *)ev;
+
+	pthread_mutex_lock(&e->mutex);
+	e->count++;
+	pthread_cond_signal(&e->cond);
+	pthread_mutex_unlock(&e->mutex);
+
+	return 0;
+}
+
+int uffs_EventDelete(OSEVENT *ev)
+{
+	struct posix_event *e = (struct posix_event *) (*ev);
+
+	if (e) {
+		pthread_cond_destroy(&e->cond);
+		pthread_mutex_destroy(&e->mutex);
+		free(e);
+		*ev = OSEVENT_NOT_INITED;
+	}
+
+	return 0;
+}
+
+struct posix_task {
+	pthread_t thread;
+	void (*entry)(void *arg);
+	void *arg;
+};
+
+static void * posix_task_main(void *p)
+{
+	struct posix_task *task = (struct posix_task *)p;
+
+	task->entry(task->arg);
+
+	return NULL;
+}
+
+int uffs_OSTaskCreate(OSTASK *task, void (*entry)(void *arg), void *arg)
+{
+	struct posix_task *t = (struct posix_task *) malloc(sizeof(struct posix_task));
+	int ret = -1;
+
+	if (t) {
+		t->entry = entry;
+		t->arg = arg;
+		ret = pthread_create(&t->thread, NULL, posix_task_main, t);
+		if (ret == 0) {
+			*task = (OSTASK)t;
+		}
+		else {
+			free(t);
+		}
+	}
+
+	return ret;
+}
+
+int uffs_OSTaskJoin(OSTASK *task)
+{
+	struct posix_task *t = (struct posix_task *) (*task);
+	int ret = -1;
+
+	if (t) {
+		ret = pthread_join(t->thread, NULL);
+		if (ret == 0) {
+			free(t);
+			*task = OSTASK_NOT_CREATED;
+		}
+	}
+
+	return ret;
+}
+
+static pthread_mutex_t _task_id_lock = PTHREAD_MUTEX_INITIALIZER;
+static int _next_task_id = 0;
+static __thread int _task_id = UFFS_TASK_ID_NOT_EXIST;
+
+/* task id is assigned on first call, ids are never reused */
+int uffs_OSGetTaskId(void)
+{
+	if (_task_id == UFFS_TASK_ID_NOT_EXIST) {
+		pthread_mutex_lock(&_task_id_lock);
+		_task_id = _next_task_id++;
+		pthread_mutex_unlock(&_task_id_lock);
+	}
+
+	return _task_id;
+}
+
+#ifdef CONFIG_UFFS_PER_TASK_ERRNO
+static __thread int _task_errno = 0;
+
+int * uffs_OSGetTaskErrno(void)
+{
+	return &_task_errno;
+}
+#endif
+
 unsigned int uffs_GetCurDateTime(void)
 {
 	// FIXME: return system time, please modify this for your platform ! 
@@ -107,6 +244,15 @@ unsigned int uffs_GetCurDateTime(void)
 	return (unsigned int)tvalue;
 }
 
+unsigned int uffs_OSGetTick(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (unsigned int)(ts.tv_sec * 1000000 + ts.tv_nsec / 1000);	// micro-seconds
+}
+
 #if CONFIG_USE_SYSTEM_MEMORY_ALLOCATOR > 0
 static void * sys_malloc(struct uffs_DeviceSt *dev, unsigned int size)
 {
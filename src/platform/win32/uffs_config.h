@@ -41,20 +41,35 @@
 
 /**
  * \def UFFS_MAX_PAGE_SIZE
- * \note maximum page size UFFS support
+ * \note maximum page size UFFS support, up to 16384.
+ *       Page size above 4096 enlarges the tag data length field,
+ *       see UFFS_TAG_DATA_LEN_BITS.
  */
 #define UFFS_MAX_PAGE_SIZE		2048
 
 /**
  * \def UFFS_MAX_SPARE_SIZE
+ * \note maximum page spare size, spare size of the NAND chip
+ *       (uffs_StorageAttrSt#spare_size) should not exceed this value.
  */
 #define UFFS_MAX_SPARE_SIZE ((UFFS_MAX_PAGE_SIZE / 256) * 8)
 
 /**
  * \def UFFS_MAX_ECC_SIZE
+ * \note maximum page data ECC size, soft ECC takes 3 bytes per 256 bytes.
  */
 #define UFFS_MAX_ECC_SIZE  ((UFFS_MAX_PAGE_SIZE / 256) * 5)
 
+/**
+ * \def UFFS_TAG_PAGE_ID_SIZE_BITS
+ * \note number of bits of page id in tag, defines the maximum pages per block:
+ *       6 => 64, 7 => 128, 8 => 256 pages per block. Page id bits plus tag
+ *       data length bits can't exceed 22, so 256 pages per block works with
+ *       page size up to 16384. Default is 6 if not defined here.
+ *       Changing this value changes the tag layout, the flash must be re-formatted.
+ */
+//#define UFFS_TAG_PAGE_ID_SIZE_BITS	8
+
 /**
  * \def MAX_CACHED_BLOCK_INFO
  * \note uffs cache the block info for opened directories and files,
@@ -70,6 +85,25 @@
  */
 #define MAX_PAGE_BUFFERS		40
 
+/**
+ * \def CONFIG_UFFS_BUF_2Q
+ * \note Use 2Q replacement policy for page buffers instead of plain LRU.
+ *       New pages enter a FIFO segment (A1) which is recycled first once
+ *       it's over UFFS_BUF_A1_PERCENT of page buffers. A page accessed again
+ *       while still in A1 is not promoted, since sequential read/write
+ *       touches the same page several times in a row. Pages accessed again
+ *       shortly after being recycled from A1 (ghost entries), and
+ *       DIR/FILE header pages (page_id 0), are kept in the LRU segment (Am),
+ *       so a large sequential read/write doesn't flush the hot pages.
+ */
+#define CONFIG_UFFS_BUF_2Q
+
+/**
+ * \def UFFS_BUF_A1_PERCENT
+ * \note size of 2Q A1 segment, in percent of page buffers.
+ */
+#define UFFS_BUF_A1_PERCENT		25
+
 
 /** 
  * \def CLONE_BUFFER_THRESHOLD
@@ -89,11 +123,30 @@
  * \def CONFIG_MAX_PENDING_BLOCKS
  * \note When a new bad block or ECC error is discovered during reading flash,
  *       the block will be put in a 'pending' list and will be processed later.
- *       This config the maximum pending blocks before being processed, 4 should
- *       be enough.
+ *       This config the initial size of the pending list, 4 should be enough.
+ *       The list grows on demand if the memory allocator is able to free memory
+ *       (system memory allocator), otherwise it's the maximum pending blocks.
  */
 #define CONFIG_MAX_PENDING_BLOCKS	4
 
+/**
+ * \def CONFIG_PENDING_REFRESH_PER_OP
+ * \note Pending blocks are processed by priority: mark bad, cleanup, recover
+ *       and then refresh. File operations process all pending blocks except
+ *       refresh blocks, of which at most CONFIG_PENDING_REFRESH_PER_OP blocks
+ *       are refreshed per operation, so a burst of ECC corrected reads doesn't
+ *       stall the reader. The remaining refresh blocks are processed by
+ *       uffs_process_pending() or when the partition is unmounted.
+ */
+#define CONFIG_PENDING_REFRESH_PER_OP	1
+
+/**
+ * \def UFFS_OS_TICKS_PER_MS
+ * \note number of uffs_OSGetTick() ticks per milli-second,
+ *       used by uffs_process_pending() to honor the time budget.
+ */
+#define UFFS_OS_TICKS_PER_MS	1000
+
 
 /**
  * \def MAX_DIRTY_PAGES_IN_A_BLOCK 
@@ -111,6 +164,15 @@
  */
 #define CONFIG_ENABLE_UFFS_DEBUG_MSG
 
+/**
+ * \def CONFIG_UFFS_MIN_MSG_LEVEL
+ * \note Debug messages below this level (UFFS_MSG_NOISY, UFFS_MSG_NORMAL,
+ *       UFFS_MSG_SERIOUS, UFFS_MSG_DEAD) are removed at compile time, arguments
+ *       are not evaluated. Messages at or above this level are still filtered by
+ *       the runtime message level. Use UFFS_MSG_SERIOUS for release build.
+ */
+#define CONFIG_UFFS_MIN_MSG_LEVEL	UFFS_MSG_NOISY
+
 /**
  * \def CONFIG_USE_GLOBAL_FS_LOCK
  * \note use global lock instead of per-device lock.
@@ -123,9 +185,49 @@
  * \def CONFIG_USE_PER_DEVICE_LOCK
  * \note use per-device lock.
  *		 this is required if you use fs APIs in multi-thread environment.
+ *		 fd APIs on different devices then run concurrently, only the
+ *		 shared object/dir handle pools and mount table have a short lock.
  */
 //#define CONFIG_USE_PER_DEVICE_LOCK
 
+/**
+ * \def CONFIG_UFFS_PER_TASK_ERRNO
+ * \note keep uffs_get_error()/uffs_set_error() error code per task
+ *		 instead of one global error code, so that multiple tasks can call
+ *		 fd APIs concurrently and check their own error.
+ *		 the platform must provide uffs_OSGetTaskErrno(), e.g. by
+ *		 thread local storage.
+ */
+//#define CONFIG_UFFS_PER_TASK_ERRNO
+
+/**
+ * \def CONFIG_UFFS_PARALLEL_MOUNT
+ * \note uffs_MountAll() scans all registered partitions in parallel,
+ *		 one task per partition, instead of one after another.
+ *		 the platform must provide uffs_OSTaskCreate()/uffs_OSTaskJoin(),
+ *		 and flash drivers shared by partitions must be thread safe.
+ *		 storage attributes must be set up before uffs_MountAll(), not in
+ *		 InitFlash(), as partitions sharing them are scanned at the same time.
+ */
+//#define CONFIG_UFFS_PARALLEL_MOUNT
+
+/**
+ * \def CONFIG_UFFS_AIO
+ * \note asynchronous fd API, see uffs_aio.h. requests are submitted with
+ *		 uffs_aio_submit() and done by an I/O worker task of the device,
+ *		 which merges adjacent reads/writes and repeated flushes of a file.
+ *		 completion is reported by callback or through a completion queue.
+ *		 the platform must provide uffs_OSTaskCreate()/uffs_OSTaskJoin()
+ *		 and uffs_EventXXX(), and CONFIG_UFFS_PER_TASK_ERRNO is required.
+ */
+//#define CONFIG_UFFS_AIO
+
+/**
+ * \def UFFS_AIO_MAX_MERGE
+ * \note max number of adjacent read or write requests merged into one I/O.
+ */
+#define UFFS_AIO_MAX_MERGE	8
+
 
 
 /**
@@ -165,13 +267,20 @@
 //#define CONFIG_UFFS_AUTO_LAYOUT_USE_MTD_SCHEME
 
 
+/**
+ * \def CONFIG_UFFS_GROWABLE_HANDLES
+ * \note Enable this to let object and uffs_DIR handle tables grow from system
+ *       memory (in chunks of MAX_OBJECT_HANDLE/MAX_DIR_HANDLE) when all
+ *       handles are in use, up to MAX_OBJECT_HANDLE_LIMIT/MAX_DIR_HANDLE_LIMIT.
+ *       Requires CONFIG_USE_SYSTEM_MEMORY_ALLOCATOR.
+ */
+//#define CONFIG_UFFS_GROWABLE_HANDLES
+
 /** 
  * \def MAX_OBJECT_HANDLE
  * maximum number of object handle 
  */
 #define MAX_OBJECT_HANDLE	50
-#define FD_SIGNATURE_SHIFT	6
-
 
 /**
  * \def MAX_DIR_HANDLE
@@ -179,6 +288,16 @@
  */
 #define MAX_DIR_HANDLE	10
 
+#ifdef CONFIG_UFFS_GROWABLE_HANDLES
+#define MAX_OBJECT_HANDLE_LIMIT	1000	//!< object handles can grow up to this
+#define MAX_DIR_HANDLE_LIMIT	200		//!< uffs_DIR handles can grow up to this
+#define FD_SIGNATURE_SHIFT	10
+#else
+#define MAX_OBJECT_HANDLE_LIMIT	MAX_OBJECT_HANDLE
+#define MAX_DIR_HANDLE_LIMIT	MAX_DIR_HANDLE
+#define FD_SIGNATURE_SHIFT	6
+#endif
+
 /**
  * \def MINIMUN_ERASED_BLOCK
  *  UFFS will not allow appending or creating new files when the free/erased block
@@ -247,6 +366,156 @@
 //#define CONFIG_ENABLE_PAGE_DATA_CRC
 
 
+/**
+ * \def CONFIG_UFFS_TRACE
+ * \note If this is enabled, UFFS emits a small binary trace record to the hook installed
+ *       by uffs_TraceSetHook() on buffer flush and block recovery events.
+ *		 Platform must provide uffs_OSGetTick() for measuring the duration.
+ */
+//#define CONFIG_UFFS_TRACE
+
+
+/**
+ * \def CONFIG_UFFS_COMPACT_TREE_NODE
+ * \note If this is enabled, UFFS uses a 12 bytes tree node (instead of 16 bytes,
+ *       or 32 bytes on 64-bit hosts): list links are stored as tree pool indexes,
+ *       file length is kept in a per-device table indexed by file serial
+ *       and data block length is not kept. The table is allocated from
+ *       the device memory allocator, 4 bytes for each serial up to
+ *       MAX_UFFS_FSN (see UFFS_FILE_LEN_BUFFER_SIZE), as a valid image may
+ *       use any of them: 64KB with CONFIG_UFFS_WIDE_SERIAL.
+ *		 Enable this on large NAND where the tree nodes dominate RAM usage.
+ */
+//#define CONFIG_UFFS_COMPACT_TREE_NODE
+
+
+/**
+ * \def CONFIG_UFFS_WIDE_BLOCK_ADDR
+ * \note By default block numbers and tree node indexes are 16 bits, which limits
+ *       a partition to 65533 blocks. Enable this to use 32 bits block numbers
+ *       for large NAND with small erase blocks. Tree nodes, block info cache,
+ *       pending block list and the serialized tree state get larger.
+ *       The on-flash layout is not changed.
+ */
+//#define CONFIG_UFFS_WIDE_BLOCK_ADDR
+
+
+/**
+ * \def CONFIG_UFFS_WIDE_SERIAL
+ * \note By default the page tag stores parent serial in 10 bits, which limits
+ *       the number of dirs and files to 1023. Enable this to use the reserved
+ *       tag bits for parent serial as well (14 bits with default tag layout),
+ *       raising the limit to 16383.
+ *       This changes the on-flash tag layout, the flash must be re-formatted.
+ */
+//#define CONFIG_UFFS_WIDE_SERIAL
+
+/**
+ * \def CONFIG_UFFS_SMALL_FILE_PACK
+ * \note Enable this to store small files in shared 'pack' blocks: a file
+ *       whose data fits in one page (together with its file info) is kept
+ *       as a single page record in a pack block instead of occupying a
+ *       whole block. The file is moved to its own block once it grows over
+ *       UFFS_PACK_FILE_MAX_SIZE. Each packed file takes one extra tree node.
+ *       Tree state serialization is not supported when this is enabled:
+ *       uffs_SerializeState()/uffs_DeserializeState() always fail, so leave
+ *       dev->serial_ops NULL (the tree is then built from flash on mount).
+ */
+//#define CONFIG_UFFS_SMALL_FILE_PACK
+
+/**
+ * \def UFFS_PACK_MAX_FILES
+ * \note maximum number of packed files (extra tree nodes are allocated for them)
+ */
+#define UFFS_PACK_MAX_FILES		256
+
+/**
+ * \def UFFS_PACK_FILE_MAX_SIZE
+ * \note maximum file size for a packed file.
+ *       Also limited by page data size minus sizeof(uffs_FileInfo).
+ */
+#define UFFS_PACK_FILE_MAX_SIZE	1024
+
+/**
+ * \def UFFS_PACK_SPARSE_PERCENT
+ * \note a pack block is sparse when its live files drop below this percentage
+ *       of pages per block, live records of a sparse block are then merged to
+ *       another pack block and the sparse block is released. 0 disables merging.
+ */
+#define UFFS_PACK_SPARSE_PERCENT	25
+
+/**
+ * \def CONFIG_UFFS_OBJ_FDN_MAP
+ * \note Enable this to give opened files a map from data block number (fdn)
+ *       to DATA tree node, filled in lazily on read/write, so that random
+ *       access into a big file does not walk the DATA node hash chains.
+ *       Each map takes sizeof(uffs_NodeIndex) bytes per block of the partition.
+ */
+//#define CONFIG_UFFS_OBJ_FDN_MAP
+
+/**
+ * \def UFFS_FDN_MAP_NUM
+ * \note number of fdn maps per device. Objects of the same file share one map,
+ *       objects fall back to DATA node hash lookup when all maps are taken.
+ */
+#define UFFS_FDN_MAP_NUM		4
+
+/**
+ * \def CONFIG_UFFS_BBT
+ * \note Enable this to keep a bad block table (BBT) on flash, so that mount
+ *       does not read the bad block mark of every block. The table is stored
+ *       in the last UFFS_BBT_BLOCKS good blocks of the partition, which are
+ *       taken out of the partition. If those blocks are used (flash formatted
+ *       without BBT), the table is created on the next mount after format.
+ *       BBT records are tagged as UFFS_TYPE_PACK with parent and serial all
+ *       '1'. A build without CONFIG_UFFS_BBT erases such blocks on mount
+ *       (the table is lost, bad block marks on flash are kept).
+ */
+//#define CONFIG_UFFS_BBT
+
+/**
+ * \def UFFS_BBT_BLOCKS
+ * \note number of BBT blocks, each block holds a mirror of the table.
+ */
+#define UFFS_BBT_BLOCKS			2
+
+/**
+ * \def CONFIG_UFFS_INFO_CACHE
+ * \note Enable this to cache file/dir info (name, attr and time stamps) in RAM,
+ *       so that stat, readdir and name lookup don't need to read page 0 of
+ *       the object's block through page buffers.
+ */
+//#define CONFIG_UFFS_INFO_CACHE
+
+/**
+ * \def UFFS_INFO_CACHE_ENTRIES
+ * \note number of cached file/dir info per device,
+ *       each entry takes about sizeof(uffs_FileInfo) bytes.
+ */
+#define UFFS_INFO_CACHE_ENTRIES	32
+
+/**
+ * \def CONFIG_UFFS_DENTRY_CACHE
+ * \note Enable this to cache name lookups (parent dir, name) -> serial,
+ *       including names known not to exist, so that opening a deep path
+ *       doesn't search the tree for every directory in the path, and
+ *       repeated open/stat of a missing file doesn't search all files.
+ */
+//#define CONFIG_UFFS_DENTRY_CACHE
+
+/**
+ * \def UFFS_DENTRY_CACHE_ENTRIES
+ * \note number of cached path components per device.
+ */
+#define UFFS_DENTRY_CACHE_ENTRIES	32
+
+/**
+ * \def UFFS_DENTRY_NAME_MAX
+ * \note longest name kept in dentry cache, longer names are not cached.
+ */
+#define UFFS_DENTRY_NAME_MAX	32
+
+
 /** micros for calculating buffer sizes */
 
 /**
@@ -257,7 +526,8 @@
 			(											\
 				(										\
 					sizeof(uffs_BlockInfo) +			\
-					sizeof(uffs_PageSpare) * n_pages_per_block \
+					sizeof(uffs_PageSpare) * n_pages_per_block + \
+					sizeof(u16) * n_pages_per_block \
 				 ) * MAX_CACHED_BLOCK_INFO				\
 			)
 
@@ -276,10 +546,76 @@
  *	\def UFFS_TREE_BUFFER_SIZE
  *	\brief calculate memory bytes for tree nodes
  */
-#define UFFS_TREE_BUFFER_SIZE(n_blocks) (sizeof(TreeNode) * n_blocks)
+#ifdef CONFIG_UFFS_SMALL_FILE_PACK
+#define UFFS_TREE_BUFFER_SIZE(n_blocks) (TREE_NODE_BUF_SIZE * (n_blocks + UFFS_PACK_MAX_FILES))
+#else
+#define UFFS_TREE_BUFFER_SIZE(n_blocks) (TREE_NODE_BUF_SIZE * n_blocks)
+#endif
 
+/**
+ *	\def UFFS_FILE_LEN_BUFFER_SIZE
+ *	\brief calculate memory bytes for file length table
+ */
+#ifdef CONFIG_UFFS_COMPACT_TREE_NODE
+#define UFFS_FILE_LEN_BUFFER_SIZE(n_blocks) (sizeof(u32) * FILE_LEN_TABLE_LEN(n_blocks))
+#else
+#define UFFS_FILE_LEN_BUFFER_SIZE(n_blocks) 0
+#endif
+
+/**
+ *	\def UFFS_FDN_MAP_BUFFER_SIZE
+ *	\brief calculate memory bytes for fdn maps of opened files
+ */
+#ifdef CONFIG_UFFS_OBJ_FDN_MAP
+#define UFFS_FDN_MAP_BUFFER_SIZE(n_blocks) (sizeof(uffs_NodeIndex) * n_blocks * UFFS_FDN_MAP_NUM)
+#else
+#define UFFS_FDN_MAP_BUFFER_SIZE(n_blocks) 0
+#endif
+
+/**
+ *	\def UFFS_BBT_BUFFER_SIZE
+ *	\brief calculate memory bytes for bad block table
+ */
+#ifdef CONFIG_UFFS_BBT
+#define UFFS_BBT_BUFFER_SIZE(n_blocks) ((n_blocks + 7) / 8)
+#else
+#define UFFS_BBT_BUFFER_SIZE(n_blocks) 0
+#endif
+
+/**
+ *	\def UFFS_INFO_CACHE_BUFFER_SIZE
+ *	\brief calculate memory bytes for file/dir info cache
+ */
+#ifdef CONFIG_UFFS_INFO_CACHE
+#define UFFS_INFO_CACHE_BUFFER_SIZE (sizeof(uffs_InfoCacheEntry) * UFFS_INFO_CACHE_ENTRIES)
+#else
+#define UFFS_INFO_CACHE_BUFFER_SIZE 0
+#endif
 
-#define UFFS_SPARE_BUFFER_SIZE (MAX_SPARE_BUFFERS * UFFS_MAX_SPARE_SIZE)
+/**
+ *	\def UFFS_DENTRY_CACHE_BUFFER_SIZE
+ *	\brief calculate memory bytes for dentry cache
+ */
+#ifdef CONFIG_UFFS_DENTRY_CACHE
+#define UFFS_DENTRY_CACHE_BUFFER_SIZE (sizeof(uffs_DentryEntry) * UFFS_DENTRY_CACHE_ENTRIES)
+#else
+#define UFFS_DENTRY_CACHE_BUFFER_SIZE 0
+#endif
+
+
+/**
+ *	\def UFFS_SPARE_BUFFER_UNIT_SIZE
+ *	\brief memory bytes of a spare buffer: the spare plus ECC scratch for
+ *		   page data (calculated and stored ECC), aligned to 8 bytes.
+ */
+#define UFFS_SPARE_BUFFER_UNIT_SIZE \
+			((UFFS_MAX_SPARE_SIZE + UFFS_MAX_ECC_SIZE * 2 + 7) & ~7)
+
+/**
+ *	\def UFFS_SPARE_BUFFER_SIZE
+ *	\brief calculate memory bytes for spare buffers
+ */
+#define UFFS_SPARE_BUFFER_SIZE (MAX_SPARE_BUFFERS * UFFS_SPARE_BUFFER_UNIT_SIZE)
 
 
 /**
@@ -291,6 +627,11 @@
 				UFFS_BLOCK_INFO_BUFFER_SIZE(n_pages_per_block) + \
 				UFFS_PAGE_BUFFER_SIZE(n_page_size) + \
 				UFFS_TREE_BUFFER_SIZE(n_blocks) + \
+				UFFS_FILE_LEN_BUFFER_SIZE(n_blocks) + \
+				UFFS_FDN_MAP_BUFFER_SIZE(n_blocks) + \
+				UFFS_BBT_BUFFER_SIZE(n_blocks) + \
+				UFFS_INFO_CACHE_BUFFER_SIZE + \
+				UFFS_DENTRY_CACHE_BUFFER_SIZE + \
 				UFFS_SPARE_BUFFER_SIZE \
 			 )
 
@@ -325,10 +666,26 @@
 #error "enable either CONFIG_USE_GLOBAL_FS_LOCK or CONFIG_USE_PER_DEVICE_LOCK, not both"
 #endif
 
-#if (MAX_OBJECT_HANDLE > (1 << FD_SIGNATURE_SHIFT))
+#if (MAX_OBJECT_HANDLE_LIMIT > (1 << FD_SIGNATURE_SHIFT))
 #error "Please increase FD_SIGNATURE_SHIFT !"
 #endif
 
+#if defined(CONFIG_UFFS_GROWABLE_HANDLES) && CONFIG_USE_SYSTEM_MEMORY_ALLOCATOR == 0
+#error "CONFIG_UFFS_GROWABLE_HANDLES requires CONFIG_USE_SYSTEM_MEMORY_ALLOCATOR"
+#endif
+
+#if defined(CONFIG_UFFS_AIO) && !defined(CONFIG_UFFS_PER_TASK_ERRNO)
+#error "CONFIG_UFFS_AIO requires CONFIG_UFFS_PER_TASK_ERRNO"
+#endif
+
+#if defined(CONFIG_UFFS_AIO) && UFFS_AIO_MAX_MERGE < 1
+#error "UFFS_AIO_MAX_MERGE should >= 1"
+#endif
+
+#if defined(CONFIG_UFFS_SMALL_FILE_PACK) && (UFFS_PACK_SPARSE_PERCENT < 0 || UFFS_PACK_SPARSE_PERCENT > 50)
+#error "UFFS_PACK_SPARSE_PERCENT should be 0 ~ 50"
+#endif
+
 #if CONFIG_MAX_PENDING_BLOCKS < 2
 #error "Please increase CONFIG_MAX_PENDING_BLOCKS, normally 4"
 #endif
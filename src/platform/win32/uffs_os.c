@@ -91,11 +91,103 @@ int uffs_SemDelete(OSSEM *sem)
 		return -1;
 }
 
-int uffs_OSGetTaskId(void)
+int uffs_EventCreate(OSEVENT *ev)
+{
+	HANDLE h = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+
+	if (h == NULL)
+		return -1;
+
+	*ev = (OSEVENT)h;
+
+	return 0;
+}
+
+int uffs_EventWait(OSEVENT ev)
+{
+	return WaitForSingleObject((HANDLE)ev, INFINITE) == WAIT_OBJECT_0 ? 0 : -1;
+}
+
+int uffs_EventSignal(OSEVENT ev)
+{
+	return ReleaseSemaphore((HANDLE)ev, 1, NULL) ? 0 : -1;
+}
+
+int uffs_EventDelete(OSEVENT *ev)
 {
+	if (*ev && CloseHandle((HANDLE)(*ev))) {
+		*ev = OSEVENT_NOT_INITED;
+		return 0;
+	}
+	else
+		return -1;
+}
+
+struct win32_task {
+	void (*entry)(void *arg);
+	void *arg;
+};
+
+static DWORD WINAPI win32_task_main(LPVOID p)
+{
+	struct win32_task *task = (struct win32_task *)p;
+
+	task->entry(task->arg);
+	free(task);
+
 	return 0;
 }
 
+int uffs_OSTaskCreate(OSTASK *task, void (*entry)(void *arg), void *arg)
+{
+	struct win32_task *t = (struct win32_task *) malloc(sizeof(struct win32_task));
+	HANDLE h;
+
+	if (t == NULL)
+		return -1;
+
+	t->entry = entry;
+	t->arg = arg;
+	h = CreateThread(NULL, 0, win32_task_main, t, 0, NULL);
+	if (h == NULL) {
+		free(t);
+		return -1;
+	}
+
+	*task = (OSTASK)h;
+
+	return 0;
+}
+
+int uffs_OSTaskJoin(OSTASK *task)
+{
+	if (WaitForSingleObject((HANDLE)(*task), INFINITE) != WAIT_OBJECT_0)
+		return -1;
+
+	CloseHandle((HANDLE)(*task));
+	*task = OSTASK_NOT_CREATED;
+
+	return 0;
+}
+
+int uffs_OSGetTaskId(void)
+{
+	return (int)GetCurrentThreadId();
+}
+
+#ifdef CONFIG_UFFS_PER_TASK_ERRNO
+#ifdef _MSC_VER
+static __declspec(thread) int _task_errno = 0;
+#else
+static __thread int _task_errno = 0;
+#endif
+
+int * uffs_OSGetTaskErrno(void)
+{
+	return &_task_errno;
+}
+#endif
+
 unsigned int uffs_GetCurDateTime(void)
 {
 	// FIXME: return system time, please modify this for your platform ! 
@@ -107,6 +199,16 @@ unsigned int uffs_GetCurDateTime(void)
 	return (unsigned int)tvalue;
 }
 
+unsigned int uffs_OSGetTick(void)
+{
+	LARGE_INTEGER freq, count;
+
+	if (!QueryPerformanceFrequency(&freq) || !QueryPerformanceCounter(&count))
+		return (unsigned int)GetTickCount() * 1000;
+
+	return (unsigned int)(count.QuadPart * 1000000 / freq.QuadPart);	// micro-seconds
+}
+
 #if CONFIG_USE_SYSTEM_MEMORY_ALLOCATOR > 0
 static void * sys_malloc(struct uffs_DeviceSt *dev, unsigned int size)
 {
@@ -628,6 +628,62 @@ static int process_cmd(int sock, struct uffs_ApiSrvMsgSt *msg, struct uffs_ApiSt
 		}
 		break;
 	}
+	case UFFS_API_PREAD_CMD:
+	{
+		int fd, r, len;
+		i32 offset;
+		void *buf = NULL;
+
+		ret = apisrv_unload_params(msg, -1, 0, &fd, sizeof(fd), -1, 0, &len, sizeof(len), &offset, sizeof(offset), NULL);
+		if (ret == 0) {
+			if (len > 0) {
+				buf = malloc(len);
+				if (buf == NULL) {
+					printf("malloc %d bytes failed.\n", len);
+					ret = -1;
+				}
+			}
+
+			if (ret == 0) {
+				r = api->uffs_pread(fd, buf, len, (long)offset);
+				DBG("uffs_pread(fd = %d, buf = {...}, len = %d, offset = %d) = %d\n", fd, len, offset, r);
+				ret = apisrv_make_message(msg, &r, sizeof(r),
+											-1, 0,	/* fd */
+											buf ? buf : (void *)-1, buf ? len : 0,	/* buf */
+											-1, 0,	/* len */
+											-1, 0,	/* offset */
+											NULL);
+			}
+		}
+
+		if (buf)
+			free(buf);
+
+		break;
+	}
+	case UFFS_API_PWRITE_CMD:
+	{
+		int fd, r, len;
+		i32 offset;
+		void *buf = NULL;
+
+		buf = malloc(header->data_len);
+		if (buf == NULL) {
+			printf("malloc %d failed.\n", header->data_len);
+			ret = -1;
+		}
+		else {
+			ret = apisrv_unload_params(msg, -1, 0, &fd, sizeof(fd), buf, header->data_len, &len, sizeof(len), &offset, sizeof(offset), NULL);
+			if (ret == 0) {
+				r = api->uffs_pwrite(fd, buf, len, (long)offset);
+				DBG("uffs_pwrite(fd = %d, buf = {...}, len = %d, offset = %d) = %d\n", fd, len, offset, r);
+				ret = apisrv_make_message(msg, &r, sizeof(r), -1, 0, -1, 0, -1, 0, -1, 0, NULL);
+			}
+			free(buf);
+		}
+
+		break;
+	}
     default:
         printf("Unknown command %x\n", header->cmd);
         ret = -1;
@@ -1130,6 +1186,41 @@ static void _uffs_flush_all(const char *mount)
 }
 
 
+static int _uffs_pread(int fd, void *buf, int len, long offset)
+{
+	int r = -1, ret = -1;
+	i32 offset_32bit = (i32)offset;
+
+	if (buf) {
+		ret = call_remote(UFFS_API_PREAD_CMD, &r, 0, sizeof(r),
+						&fd, sizeof(fd), 0,
+						buf, 0, len,
+						&len, sizeof(len), 0,
+						&offset_32bit, sizeof(offset_32bit), 0,	// only send 32bit over the network
+						NULL);
+	}
+
+	return ret < 0 ? ret : r;
+}
+
+static int _uffs_pwrite(int fd, const void *buf, int len, long offset)
+{
+	int r = -1, ret = -1;
+	i32 offset_32bit = (i32)offset;
+
+	if (buf) {
+		ret = call_remote(UFFS_API_PWRITE_CMD, &r, 0, sizeof(r),
+						&fd, sizeof(fd), 0,
+						buf, len, 0,
+						&len, sizeof(len), 0,
+						&offset_32bit, sizeof(offset_32bit), 0,	// only send 32bit over the network
+						NULL);
+	}
+
+	return ret < 0 ? ret : r;
+}
+
+
 static struct uffs_ApiSt m_client_api = {
 	_uffs_version,
 	_uffs_open,
@@ -1159,6 +1250,8 @@ static struct uffs_ApiSt m_client_api = {
 	_uffs_space_used,
 	_uffs_space_free,
 	_uffs_flush_all,
+	_uffs_pread,
+	_uffs_pwrite,
 };
 
 struct uffs_ApiSt * apisrv_get_client(void)
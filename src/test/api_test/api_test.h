@@ -71,8 +71,10 @@
 #define UFFS_API_SPACE_FREE_CMD         25
 #define UFFS_API_SPACE_USED_CMD         26
 #define UFFS_API_FLUSH_ALL_CMD          27
+#define UFFS_API_PREAD_CMD              28
+#define UFFS_API_PWRITE_CMD             29
 
-#define UFFS_API_CMD_LAST				27		// last test command id
+#define UFFS_API_CMD_LAST				29		// last test command id
 
 #define UFFS_API_CMD(header)            ((header)->cmd & 0xFF)
 #define UFFS_API_ACK_BIT                (1 << 31)
@@ -128,6 +130,8 @@ struct uffs_ApiSt {
 	long (*uffs_space_used)(const char *mount_point);
 	long (*uffs_space_free)(const char *mount_point);
 	void (*uffs_flush_all)(const char *mount_point);
+	int (*uffs_pread)(int fd, void *data, int len, long offset);
+	int (*uffs_pwrite)(int fd, const void *data, int len, long offset);
 };
 
 struct uffs_ApiSrvMsgSt {
@@ -57,6 +57,8 @@ W(int, uffs_close, (int fd), (fd))
 W(int, uffs_read, (int fd, void *data, int len), (fd, data, len))
 W(int, uffs_write, (int fd, const void *data, int len), (fd, data, len))
 W(int, uffs_flush, (int fd), (fd))
+W(int, uffs_pread, (int fd, void *data, int len, long offset), (fd, data, len, offset))
+W(int, uffs_pwrite, (int fd, const void *data, int len, long offset), (fd, data, len, offset))
 W(long, uffs_seek, (int fd, long offset, int origin), (fd, offset, origin))
 W(long, uffs_tell, (int fd), (fd))
 W(int, uffs_eof, (int fd), (fd))
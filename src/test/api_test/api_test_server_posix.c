@@ -155,6 +155,8 @@ static struct uffs_ApiSt m_api = {
     uffs_space_used,
     uffs_space_free,
 	uffs_flush_all,
+	uffs_pread,
+	uffs_pwrite,
 };
 
 static void * worker_thread_fn(void *param)
@@ -106,6 +106,8 @@ static struct uffs_ApiSt m_api = {
     uffs_space_used,
     uffs_space_free,
 	uffs_flush_all,
+	uffs_pread,
+	uffs_pwrite,
 };
 
 int api_server_start(void)
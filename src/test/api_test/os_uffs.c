@@ -466,16 +466,67 @@ int os_lseek(int fd, long offset, int origin)
 
 int os_pread(int fd, void *buf, int count, long offset)
 {
-	DBG("pread(fd = %d, buf = {...}, count = %d, offset = %ld)\n", fd, count, offset);
-	assert(0);
-	return pread(fd, buf, count, offset);
+	int uffs_fd = -1, uffs_ret = -1, bak_fd = -1, bak_ret = -1;
+	int ret = -1;
+	void *uffs_buf = NULL;
+	void *bak_buf = NULL;
+
+	if (fd >= 0) {
+		unix2uffs(fd, &uffs_fd, &bak_fd);
+		if (uffs_fd >= 0) {
+			uffs_buf = malloc(count);
+			bak_buf = malloc(count);
+			ASSERT(uffs_buf != NULL && bak_buf != NULL, "malloc(%d) failed.\n", count);
+			uffs_ret = uffs_pread(uffs_fd, uffs_buf, count, offset);
+			bak_ret = pread(bak_fd, bak_buf, count, offset);
+		}
+		ret = pread(fd, buf, count, offset);
+		if (uffs_fd >= 0) {
+			ASSERT(ret == uffs_ret && uffs_ret == bak_ret,
+					"pread(fd=%d/%d/%d,buf,count=%d,offset=%ld), unix return %d, uffs return %d, bak return %d\n",
+					fd, uffs_fd, bak_fd, count, offset, ret, uffs_ret, bak_ret);
+			if (ret > 0) {
+				ASSERT(memcmp(buf, uffs_buf, ret) == 0,
+						"pread result different! from fd = %d/%d, count = %d, offset = %ld, ret = %d\n",
+						fd, uffs_fd, count, offset, ret);
+			}
+		}
+	}
+
+	if (uffs_buf)
+		free(uffs_buf);
+
+	if (bak_buf)
+		free(bak_buf);
+
+	DBG("pread(fd = %d, buf = {...}, count = %d, offset = %ld) = %d %s\n", fd, count, offset, ret, uffs_fd >= 0 ? "U" : "");
+
+	return ret;
 }
 
 int os_pwrite(int fd, const void *buf, int count, long offset)
 {
-	DBG("pwrite(fd = %d, buf = {..}, count = %d, offset = %ld)\n", fd, count, offset);
-	assert(0);
-	return pwrite(fd, buf, count, offset);
+	int uffs_fd = -1, uffs_ret = -1, bak_fd = -1, bak_ret = -1;
+	int ret = -1;
+
+	if (fd >= 0) {
+		unix2uffs(fd, &uffs_fd, &bak_fd);
+		if (uffs_fd >= 0) {
+			uffs_ret = uffs_pwrite(uffs_fd, buf, count, offset);
+			ASSERT(bak_fd >= 0, "uffs_fd = %d, bak_fd = %d\n", uffs_fd, bak_fd);
+			bak_ret = pwrite(bak_fd, buf, count, offset);
+		}
+		ret = pwrite(fd, buf, count, offset);
+		if (uffs_fd >= 0) {
+			ASSERT(ret == uffs_ret && ret == bak_ret,
+					"pwrite(fd=%d/%d/%d,buf,count=%d,offset=%ld), unix return %d, uffs return %d, bak return %d\n",
+					fd, uffs_fd, bak_fd, count, offset, ret, uffs_ret, bak_ret);
+		}
+	}
+
+	DBG("pwrite(fd = %d, buf = {..}, count = %d, offset = %ld) = %d %s\n", fd, count, offset, ret, uffs_fd >= 0 ? "U" : "");
+
+	return ret;
 }
 
 int os_ftruncate(int fd, long length)
@@ -0,0 +1,110 @@
+# bad block list must be the same after umount/mount
+# (loaded from BBT with CONFIG_UFFS_BBT, by scanning block marks without)
+
+rm /test_bbt1.bin
+rm /test_bbt2.bin
+
+# write files over many blocks, new bad blocks may be discovered on the way
+t_open wc /test_bbt1.bin
+! abort ---- create file 1 failed ----
+set 9 $1
+t_write_seq $9 300000
+! abort ---- write file 1 failed ----
+t_close $9
+! abort ---- close file 1 failed ----
+
+t_open wc /test_bbt2.bin
+! abort ---- create file 2 failed ----
+set 9 $1
+t_write_seq $9 100000
+! abort ---- write file 2 failed ----
+t_close $9
+! abort ---- close file 2 failed ----
+
+t_bad /
+! abort ---- get bad blocks failed ----
+set 8 $1
+set 7 $2
+
+umount /
+! abort ---- umount failed ----
+mount /
+! abort ---- mount failed ----
+
+t_bad /
+test $1 == $8
+! abort ---- number of bad blocks changed after mount ----
+test $2 == $7
+! abort ---- bad block list changed after mount ----
+
+# rewrite and delete, blocks are erased and reused
+rm /test_bbt1.bin
+! abort ---- delete file 1 failed ----
+t_open w /test_bbt2.bin
+! abort ---- open file 2 failed ----
+set 9 $1
+t_write_seq $9 300000
+! abort ---- rewrite file 2 failed ----
+t_close $9
+
+t_bad /
+set 8 $1
+set 7 $2
+
+umount /
+! abort ---- umount failed ----
+mount /
+! abort ---- mount failed ----
+
+t_bad /
+test $1 == $8
+! abort ---- number of bad blocks changed after second mount ----
+test $2 == $7
+! abort ---- bad block list changed after second mount ----
+
+t_open r /test_bbt2.bin
+! abort ---- open file 2 after mount failed ----
+set 9 $1
+t_check_seq $9 300000
+! abort ---- check file 2 after mount failed ----
+t_close $9
+rm /test_bbt2.bin
+
+# a new bad block must be known after mount even if saving BBT failed
+t_markbad / 1
+! abort ---- mark bad block failed ----
+set 6 $1
+t_bad /
+set 8 $1
+set 7 $2
+
+umount /
+! abort ---- umount failed ----
+mount /
+! abort ---- mount failed ----
+
+t_bad /
+test $1 == $8
+! abort ---- bad block lost after mount, BBT was not saved ----
+test $2 == $7
+! abort ---- bad block list changed after mount, BBT was not saved ----
+
+# the table is saved again with the next bad block
+t_markbad /
+! abort ---- mark bad block failed ----
+t_bad /
+set 8 $1
+set 7 $2
+
+umount /
+! abort ---- umount failed ----
+mount /
+! abort ---- mount failed ----
+
+t_bad /
+test $1 == $8
+! abort ---- number of bad blocks changed after third mount ----
+test $2 == $7
+! abort ---- bad block list changed after third mount ----
+
+echo === test bbt success ===
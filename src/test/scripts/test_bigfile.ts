@@ -0,0 +1,68 @@
+rm /test_bigfile.bin
+
+# create a file spanning many data blocks
+t_open wc /test_bigfile.bin
+! abort ---- create file failed ----
+set 9 $1
+
+t_write_seq $9 200000
+! abort ---- write big file failed ----
+t_seek $9 0 e
+test $1 == 200000
+! abort ---- file length is not 200000 ----
+
+# random access, backward and forward across data blocks
+t_seek $9 190000 s
+t_check_seq $9 5000
+! abort ---- check at 190000 failed ----
+t_seek $9 17000 s
+t_check_seq $9 3000
+! abort ---- check at 17000 failed ----
+t_seek $9 120000 s
+t_check_seq $9 10000
+! abort ---- check at 120000 failed ----
+t_seek $9 33000 s
+t_check_seq $9 1000
+! abort ---- check at 33000 failed ----
+
+# a second handle on the same file
+t_open r /test_bigfile.bin
+! abort ---- open file again failed ----
+set 8 $1
+t_seek $8 150000 s
+t_check_seq $8 2000
+! abort ---- check by second handle failed ----
+
+# overwrite in the middle then read it back
+t_seek $9 100000 s
+t_write_seq $9 40000
+! abort ---- overwrite failed ----
+t_seek $8 99000 s
+t_check_seq $8 42000
+! abort ---- check overwritten range failed ----
+
+# shrink and grow again, data blocks are dropped and re-created
+t_truncate $9 60000
+! abort ---- truncate failed ----
+t_seek $9 0 e
+test $1 == 60000
+! abort ---- file length is not 60000 after truncate ----
+t_seek $8 50000 s
+t_check_seq $8 10000
+! abort ---- check after truncate failed ----
+t_seek $9 60000 s
+t_write_seq $9 80000
+! abort ---- grow file failed ----
+t_seek $8 58000 s
+t_check_seq $8 30000
+! abort ---- check after grow failed ----
+t_seek $9 130000 s
+t_check_seq $9 10000
+! abort ---- check at file end failed ----
+
+t_close $8
+t_close $9
+! abort ---- close file failed ----
+rm /test_bigfile.bin
+! abort ---- delete file failed ----
+echo === test bigfile success ===
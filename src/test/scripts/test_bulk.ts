@@ -0,0 +1,89 @@
+# uffs_readdirplus() with an entry whose information can't be loaded
+
+mkdir /test_bulk
+! abort ---- create dir failed ----
+mkfile /test_bulk/f01
+! abort ---- create /test_bulk/f01 failed ----
+mkfile /test_bulk/f02
+! abort ---- create /test_bulk/f02 failed ----
+mkfile /test_bulk/f03
+! abort ---- create /test_bulk/f03 failed ----
+mkfile /test_bulk/f04
+! abort ---- create /test_bulk/f04 failed ----
+mkfile /test_bulk/f05
+! abort ---- create /test_bulk/f05 failed ----
+mkfile /test_bulk/f06
+! abort ---- create /test_bulk/f06 failed ----
+mkfile /test_bulk/f07
+! abort ---- create /test_bulk/f07 failed ----
+mkfile /test_bulk/f08
+! abort ---- create /test_bulk/f08 failed ----
+mkfile /test_bulk/f09
+! abort ---- create /test_bulk/f09 failed ----
+mkfile /test_bulk/f10
+! abort ---- create /test_bulk/f10 failed ----
+mkfile /test_bulk/f11
+! abort ---- create /test_bulk/f11 failed ----
+mkfile /test_bulk/f12
+! abort ---- create /test_bulk/f12 failed ----
+mkfile /test_bulk/f13
+! abort ---- create /test_bulk/f13 failed ----
+mkfile /test_bulk/f14
+! abort ---- create /test_bulk/f14 failed ----
+mkfile /test_bulk/f15
+! abort ---- create /test_bulk/f15 failed ----
+mkfile /test_bulk/f16
+! abort ---- create /test_bulk/f16 failed ----
+mkfile /test_bulk/f17
+! abort ---- create /test_bulk/f17 failed ----
+mkfile /test_bulk/f18
+! abort ---- create /test_bulk/f18 failed ----
+mkfile /test_bulk/f19
+! abort ---- create /test_bulk/f19 failed ----
+mkfile /test_bulk/f20
+! abort ---- create /test_bulk/f20 failed ----
+
+t_serial /test_bulk/f05
+! abort ---- get serial failed ----
+set 9 $1
+
+# start with empty buffers, so the information is loaded from flash
+umount /
+! abort ---- umount failed ----
+mount /
+! abort ---- mount failed ----
+
+t_bulk /test_bulk $9
+! abort ---- read dir in bulk failed ----
+test $1 == 19
+! abort ---- entries lost after a failed entry ----
+
+# again in block order (flags = UFFS_READDIR_BLOCK_ORDER)
+t_bulk /test_bulk $9 1
+! abort ---- read dir in bulk (block order) failed ----
+test $1 == 19
+! abort ---- entries lost after a failed entry (block order) ----
+
+rm /test_bulk/f01
+rm /test_bulk/f02
+rm /test_bulk/f03
+rm /test_bulk/f04
+rm /test_bulk/f05
+rm /test_bulk/f06
+rm /test_bulk/f07
+rm /test_bulk/f08
+rm /test_bulk/f09
+rm /test_bulk/f10
+rm /test_bulk/f11
+rm /test_bulk/f12
+rm /test_bulk/f13
+rm /test_bulk/f14
+rm /test_bulk/f15
+rm /test_bulk/f16
+rm /test_bulk/f17
+rm /test_bulk/f18
+rm /test_bulk/f19
+rm /test_bulk/f20
+rm /test_bulk
+
+echo === test bulk success ===
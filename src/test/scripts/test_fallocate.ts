@@ -0,0 +1,92 @@
+rm /test_fallocate.bin
+
+# create a new file
+t_open wc /test_fallocate.bin
+
+! abort ---- create file failed ----
+set 9 $1  # opened fd => $9
+
+# reserve blocks for a stream crossing several block boundaries
+t_fallocate $9 100000
+! abort --- fallocate failed ---
+test $1 > 0
+! abort --- no block reserved ---
+set 8 $1	# reserved blocks => $8
+
+# reserve again for the same length is a no-op
+t_fallocate $9 100000
+test $1 == $8
+! abort --- reserved blocks changed ---
+
+# appending consumes the reserved blocks,
+# the last block is still in page buffers so may not be consumed yet.
+t_write_seq $9 100000
+! abort --- write seq file failed ---
+t_fallocate $9 0
+test $1 <= 1
+! abort --- reserved blocks not consumed ---
+
+t_seek $9 0 s
+t_check_seq $9 100000
+! abort --- check seq file failed ---
+
+# unused reserved blocks are returned on close
+t_fallocate $9 50000
+test $1 > 0
+! abort --- no block reserved ---
+t_close $9
+! abort --- close file failed ---
+t_open w /test_fallocate.bin
+set 9 $1
+t_fallocate $9 0
+test $1 == 0
+! abort --- reserved blocks not returned on close ---
+t_close $9
+
+# only one file can hold reserved blocks, reserving for another file
+# fails and doesn't take away the holder's reservation.
+t_open wc /test_fallocate2.bin
+! abort ---- create file failed ----
+set 7 $1
+t_open w /test_fallocate.bin
+set 9 $1
+t_fallocate $9 50000
+! abort --- fallocate failed ---
+set 8 $1
+t_fallocate $7 50000
+test $? == -1
+! abort --- blocks reserved for two files ---
+test $1 == $8
+! abort --- reservation of the holder dropped ---
+t_close $9
+t_fallocate $7 50000
+! abort --- fallocate failed after holder closed ---
+test $1 > 0
+! abort --- no block reserved ---
+t_close $7
+rm /test_fallocate2.bin
+
+# the reservation belongs to the handle which made it,
+# closing another handle of the same file keeps it.
+t_open w /test_fallocate.bin
+set 9 $1
+t_fallocate $9 50000
+! abort --- fallocate failed ---
+set 8 $1
+t_open r /test_fallocate.bin
+! abort ---- open file again failed ----
+set 7 $1
+t_close $7
+t_fallocate $9 0
+test $1 == $8
+! abort --- reservation dropped by closing another handle ---
+
+# appending past the maximum file size is rejected
+t_fallocate $9 2000000000
+test $? == -1
+! abort --- fallocate beyond maximum file size succeeded ---
+test $1 == $8
+! abort --- reservation changed by a rejected fallocate ---
+t_close $9
+
+echo === test fallocate success ===
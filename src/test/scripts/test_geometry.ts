@@ -0,0 +1,47 @@
+# large page/block geometry test, run on a large page image, e.g.:
+#   mkuffs -p 4096 -s 128 -b 128 -t 64 -f geo.img -e test_geometry.ts
+#   mkuffs -p 16384 -s 512 -b 256 -t 16 -f geo.img -e test_geometry.ts
+# 16384 page size needs UFFS_MAX_PAGE_SIZE 16384 and 256 pages per
+# block needs UFFS_TAG_PAGE_ID_SIZE_BITS 8 in uffs_config.h.
+
+format /
+! abort ---- format failed ----
+
+# a file spans several blocks
+t_open wc /test_geometry.bin
+! abort ---- create file failed ----
+set 9 $1  # opened fd => $9
+
+t_write_seq $9 10000000
+! abort --- write seq file failed ---
+t_seek $9 0 s
+t_check_seq $9 10000000
+! abort --- check seq file failed ---
+
+# rewrite bytes across a page boundary
+t_pwrite $9 16380 abcdefgh
+! abort --- pwrite failed ---
+t_pread $9 16380 abcdefgh
+! abort --- pread check failed ---
+t_close $9
+! abort --- close file failed ---
+
+# remount and check again
+umount /
+! abort --- umount failed ---
+mount /
+! abort --- mount failed ---
+t_open r /test_geometry.bin
+! abort ---- open file failed ----
+set 9 $1
+t_seek $9 0 e
+test $1 == 10000000
+! abort --- file length changed ---
+t_pread $9 16380 abcdefgh
+! abort --- pread check after remount failed ---
+t_close $9
+
+rm /test_geometry.bin
+! abort --- delete file failed ---
+
+echo === test geometry success ===
@@ -0,0 +1,28 @@
+rm /test_iov.bin
+
+# create a new file
+t_open wc /test_iov.bin
+
+! abort ---- create file failed ----
+set 9 $1  # opened fd => $9
+
+# write header, payload and trailer in one call
+t_writev $9 [hdr] hello-world [end]
+! abort ---- writev failed ----
+test $1 == 21
+! abort ---- writev length not match ----
+t_seek $9 0 c
+test $1 == 21
+! abort --- file pointer not moved by writev ---
+
+# read back into segments of different size
+t_seek $9 0 s
+t_readv $9 [hdr]hel lo-world[ end]
+! abort --- readv check file failed ---
+t_seek $9 0 c
+test $1 == 21
+! abort --- file pointer not moved by readv ---
+
+t_close $9
+! abort --- close file failed ---
+echo === test iov success ===
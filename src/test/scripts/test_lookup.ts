@@ -0,0 +1,77 @@
+#
+# test name lookup after create/rename/delete,
+# names probed before (negative lookup) must be found once created.
+#
+rm /lk/d2/f
+rm /lk/d2
+rm /lk/d1/f
+rm /lk/d1
+rm /lk/f
+rm /lk
+
+mkdir /lk
+! abort --- can't create /lk ---
+
+#####################################
+echo == test create after failed open ==
+#####################################
+
+t_open r /lk/d1/f
+test $? == -1
+! abort --- open non-exist file success ?? ---
+mkdir /lk/d1
+! abort --- can't create /lk/d1 ---
+t_open r /lk/d1/f
+test $? == -1
+! abort --- open non-exist file success ?? ---
+t_open wc /lk/d1/f
+! abort --- can't create /lk/d1/f ---
+t_close $1
+! abort --- close file failed ---
+t_open r /lk/d1/f
+! abort --- can't open /lk/d1/f after create ---
+t_close $1
+
+#####################################
+echo == test rename to probed name ==
+#####################################
+
+t_open r /lk/d2/f
+test $? == -1
+! abort --- open non-exist file success ?? ---
+mv /lk/d1 /lk/d2
+! abort --- can't rename /lk/d1 to /lk/d2 ---
+t_open r /lk/d2/f
+! abort --- can't open /lk/d2/f after rename ---
+t_close $1
+t_open r /lk/d1/f
+test $? == -1
+! abort --- open renamed file with old name success ?? ---
+
+#####################################
+echo == test lookup after delete ==
+#####################################
+
+rm /lk/d2/f
+! abort --- can't delete /lk/d2/f ---
+t_open r /lk/d2/f
+test $? == -1
+! abort --- open deleted file success ?? ---
+rm /lk/d2
+! abort --- can't delete /lk/d2 ---
+mkdir /lk/d2/x
+test $? == -1
+! abort --- create dir under deleted dir success ?? ---
+mkdir /lk/f
+! abort --- can't create /lk/f ---
+t_open wc /lk/f
+test $? == -1
+! abort --- create file with the same name of dir success ?? ---
+rm /lk/f
+! abort --- can't delete /lk/f ---
+rm /lk
+! abort --- can't delete /lk ---
+
+echo ##################################
+echo -------- ALL TEST SUCCESS --------
+echo ##################################
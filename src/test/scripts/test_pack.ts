@@ -0,0 +1,244 @@
+rm /test_pack1.bin
+rm /test_pack2.bin
+rm /test_pack3.bin
+
+# small files (packed with CONFIG_UFFS_SMALL_FILE_PACK)
+t_open wc /test_pack1.bin
+! abort ---- create file 1 failed ----
+set 9 $1
+t_write $9 hello-world
+! abort ---- write file 1 failed ----
+t_close $9
+! abort ---- close file 1 failed ----
+
+t_open wc /test_pack2.bin
+! abort ---- create file 2 failed ----
+set 8 $1
+t_write $8 small-file-two
+! abort ---- write file 2 failed ----
+t_close $8
+! abort ---- close file 2 failed ----
+
+# rewrite file 1
+t_open w /test_pack1.bin
+! abort ---- open file 1 failed ----
+set 9 $1
+t_pwrite $9 5 &
+! abort ---- rewrite file 1 failed ----
+t_pread $9 0 hello&world
+! abort ---- check rewritten file 1 failed ----
+t_close $9
+
+# rename file 2
+mv /test_pack2.bin /test_pack3.bin
+! abort ---- rename file 2 failed ----
+
+# remount, check the files again
+umount /
+! abort ---- umount failed ----
+mount /
+! abort ---- mount failed ----
+
+t_open r /test_pack1.bin
+! abort ---- open file 1 after mount failed ----
+set 9 $1
+t_read $9 hello&world
+! abort ---- check file 1 after mount failed ----
+t_close $9
+
+t_open r /test_pack3.bin
+! abort ---- open renamed file after mount failed ----
+set 8 $1
+t_read $8 small-file-two
+! abort ---- check renamed file after mount failed ----
+t_close $8
+
+# grow file 1 out of the pack block
+t_open w /test_pack1.bin
+! abort ---- open file 1 failed ----
+set 9 $1
+t_pwrite $9 2000 tail
+! abort ---- grow file 1 failed ----
+t_seek $9 0 e
+test $1 == 2004
+! abort ---- file 1 length is not 2004 ----
+t_pread $9 0 hello&world
+! abort ---- file 1 head changed after growing ----
+t_pread $9 2000 tail
+! abort ---- file 1 tail check failed ----
+
+# truncate it back
+t_truncate $9 5
+! abort ---- truncate file 1 failed ----
+t_seek $9 0 e
+test $1 == 5
+! abort ---- file 1 length is not 5 after truncate ----
+t_close $9
+
+# truncate small file
+t_open w /test_pack3.bin
+! abort ---- open renamed file failed ----
+set 8 $1
+t_truncate $8 5
+! abort ---- truncate small file failed ----
+t_pread $8 0 small
+! abort ---- small file check after truncate failed ----
+t_close $8
+
+umount /
+! abort ---- umount failed ----
+mount /
+! abort ---- mount failed ----
+
+t_open r /test_pack1.bin
+! abort ---- open file 1 after mount failed ----
+set 9 $1
+t_read $9 hello
+! abort ---- check file 1 after mount failed ----
+t_close $9
+
+rm /test_pack1.bin
+! abort ---- delete file 1 failed ----
+rm /test_pack3.bin
+! abort ---- delete file 3 failed ----
+
+umount /
+mount /
+t_open r /test_pack3.bin
+test $? == -1
+! abort ---- deleted file still exists ----
+
+# sparse pack block: delete most of the small files, used space should drop
+mkfile /test_sp01.bin
+! abort ---- create /test_sp01.bin failed ----
+mkfile /test_sp02.bin
+! abort ---- create /test_sp02.bin failed ----
+mkfile /test_sp03.bin
+! abort ---- create /test_sp03.bin failed ----
+mkfile /test_sp04.bin
+! abort ---- create /test_sp04.bin failed ----
+mkfile /test_sp05.bin
+! abort ---- create /test_sp05.bin failed ----
+mkfile /test_sp06.bin
+! abort ---- create /test_sp06.bin failed ----
+mkfile /test_sp07.bin
+! abort ---- create /test_sp07.bin failed ----
+mkfile /test_sp08.bin
+! abort ---- create /test_sp08.bin failed ----
+mkfile /test_sp09.bin
+! abort ---- create /test_sp09.bin failed ----
+mkfile /test_sp10.bin
+! abort ---- create /test_sp10.bin failed ----
+mkfile /test_sp11.bin
+! abort ---- create /test_sp11.bin failed ----
+mkfile /test_sp12.bin
+! abort ---- create /test_sp12.bin failed ----
+mkfile /test_sp13.bin
+! abort ---- create /test_sp13.bin failed ----
+mkfile /test_sp14.bin
+! abort ---- create /test_sp14.bin failed ----
+mkfile /test_sp15.bin
+! abort ---- create /test_sp15.bin failed ----
+mkfile /test_sp16.bin
+! abort ---- create /test_sp16.bin failed ----
+mkfile /test_sp17.bin
+! abort ---- create /test_sp17.bin failed ----
+mkfile /test_sp18.bin
+! abort ---- create /test_sp18.bin failed ----
+mkfile /test_sp19.bin
+! abort ---- create /test_sp19.bin failed ----
+mkfile /test_sp20.bin
+! abort ---- create /test_sp20.bin failed ----
+t_used /
+! abort ---- get used space failed ----
+set 7 $1
+rm /test_sp01.bin
+! abort ---- delete /test_sp01.bin failed ----
+rm /test_sp02.bin
+! abort ---- delete /test_sp02.bin failed ----
+rm /test_sp03.bin
+! abort ---- delete /test_sp03.bin failed ----
+rm /test_sp04.bin
+! abort ---- delete /test_sp04.bin failed ----
+rm /test_sp05.bin
+! abort ---- delete /test_sp05.bin failed ----
+rm /test_sp06.bin
+! abort ---- delete /test_sp06.bin failed ----
+rm /test_sp07.bin
+! abort ---- delete /test_sp07.bin failed ----
+rm /test_sp08.bin
+! abort ---- delete /test_sp08.bin failed ----
+rm /test_sp09.bin
+! abort ---- delete /test_sp09.bin failed ----
+rm /test_sp10.bin
+! abort ---- delete /test_sp10.bin failed ----
+rm /test_sp11.bin
+! abort ---- delete /test_sp11.bin failed ----
+rm /test_sp12.bin
+! abort ---- delete /test_sp12.bin failed ----
+t_used /
+! abort ---- get used space failed ----
+test $1 < $7
+! abort ---- used space not released after deleting small files ----
+set 6 $1
+
+# rewrite a file moved by merge, the old record must not come back after mount
+t_open wt /test_sp13.bin
+! abort ---- open /test_sp13.bin for rewrite failed ----
+set 9 $1
+t_write_seq $9 100
+! abort ---- rewrite /test_sp13.bin failed ----
+t_close $9
+
+umount /
+! abort ---- umount failed ----
+mount /
+! abort ---- mount failed ----
+
+t_used /
+test $1 == $6
+! abort ---- used space changed after mount ----
+t_open r /test_sp05.bin
+test $? == -1
+! abort ---- deleted small file still exists ----
+t_open r /test_sp13.bin
+! abort ---- open /test_sp13.bin after mount failed ----
+set 9 $1
+t_seek $9 0 e
+test $1 == 100
+! abort ---- rewritten /test_sp13.bin has wrong length after mount ----
+t_seek $9 0 s
+t_check_seq $9 100
+! abort ---- rewritten /test_sp13.bin has wrong data after mount ----
+t_close $9
+t_open r /test_sp14.bin
+! abort ---- open /test_sp14.bin after mount failed ----
+t_close $1
+t_open r /test_sp15.bin
+! abort ---- open /test_sp15.bin after mount failed ----
+t_close $1
+t_open r /test_sp16.bin
+! abort ---- open /test_sp16.bin after mount failed ----
+t_close $1
+t_open r /test_sp17.bin
+! abort ---- open /test_sp17.bin after mount failed ----
+t_close $1
+t_open r /test_sp18.bin
+! abort ---- open /test_sp18.bin after mount failed ----
+t_close $1
+t_open r /test_sp19.bin
+! abort ---- open /test_sp19.bin after mount failed ----
+t_close $1
+t_open r /test_sp20.bin
+! abort ---- open /test_sp20.bin after mount failed ----
+t_close $1
+rm /test_sp13.bin
+rm /test_sp14.bin
+rm /test_sp15.bin
+rm /test_sp16.bin
+rm /test_sp17.bin
+rm /test_sp18.bin
+rm /test_sp19.bin
+rm /test_sp20.bin
+
+echo === test pack success ===
@@ -0,0 +1,37 @@
+rm /test_pread.bin
+
+# create a new file
+t_open wc /test_pread.bin
+
+! abort ---- create file failed ----
+set 9 $1  # opened fd => $9
+
+t_write $9 hello-world
+! abort ---- write file failed ----
+
+# positional write does not move the file pointer
+t_pwrite $9 5 &
+! abort --- pwrite '&' at position 5 failed ---
+t_seek $9 0 c
+test $1 == 11
+! abort --- file pointer moved by pwrite ---
+
+# positional read does not move the file pointer
+t_pread $9 0 hello&world
+! abort --- pread check file failed ---
+t_pread $9 6 world
+! abort --- pread at position 6 failed ---
+t_seek $9 0 c
+test $1 == 11
+! abort --- file pointer moved by pread ---
+
+# pwrite passed over the end of file fills the gap
+t_pwrite $9 20 a
+! abort --- pwrite passed over file length failed ---
+t_seek $9 0 e
+test $1 == 21
+! abort -- file new length not filling the gap --
+
+t_close $9
+! abort --- close file failed ---
+echo === test pread success ===
@@ -0,0 +1,38 @@
+rm /test_serial_a
+rm /test_serial_b
+rm /test_serial_c
+
+# create two files
+t_open wc /test_serial_a
+! abort ---- create file failed ----
+t_close $1
+t_open wc /test_serial_b
+! abort ---- create file failed ----
+t_close $1
+
+t_serial /test_serial_a
+! abort --- get serial failed ---
+set 9 $1	# serial of a => $9
+t_serial /test_serial_b
+set 8 $1	# serial of b => $8
+test $9 != $8
+! abort --- duplicated serial ---
+
+# serial of a deleted object is free for reuse,
+# new serial is always allocated from the lowest free one
+rm /test_serial_a
+t_open wc /test_serial_c
+! abort ---- create file failed ----
+t_close $1
+t_serial /test_serial_c
+test $1 <= $9
+! abort --- free serial not reused ---
+test $1 != $8
+! abort --- duplicated serial ---
+
+mkdir /test_serial_d
+t_serial /test_serial_d
+test $1 != $8
+! abort --- duplicated serial ---
+
+echo === test serial success ===
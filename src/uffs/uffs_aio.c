@@ -0,0 +1,389 @@
+/*
+  This file is part of UFFS, the Ultra-low-cost Flash File System.
+  
+  Copyright (C) 2005-2009 Ricky Zheng <ricky_gz_zheng@yahoo.co.nz>
+
+  UFFS is free software; you can redistribute it and/or modify it under
+  the GNU Library General Public License as published by the Free Software 
+  Foundation; either version 2 of the License, or (at your option) any
+  later version.
+
+  UFFS is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+  or GNU Library General Public License, as applicable, for more details.
+ 
+  You should have received a copy of the GNU General Public License
+  and GNU Library General Public License along with UFFS; if not, write
+  to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA  02110-1301, USA.
+
+  As a special exception, if other files instantiate templates or use
+  macros or inline functions from this file, or you compile this file
+  and link it with other works to produce a work based on this file,
+  this file does not by itself cause the resulting work to be covered
+  by the GNU General Public License. However the source code for this
+  file must still be made available in accordance with section (3) of
+  the GNU General Public License v2.
+ 
+  This exception does not invalidate any other reasons why a work based
+  on this file might be covered by the GNU General Public License.
+*/
+
+
+
+/**
+ * \file uffs_aio.c
+ * \brief asynchronous I/O on file descriptors, done by per device I/O worker
+ * \author Ricky Zheng
+ */
+
+#include "uffs_config.h"
+#include "uffs/uffs_public.h"
+#include "uffs/uffs_device.h"
+#include "uffs/uffs_fd.h"
+#include "uffs/uffs_mtb.h"
+#include "uffs/uffs_aio.h"
+
+#define PFX "aio : "
+
+#ifdef CONFIG_UFFS_AIO
+
+/** append request to the queue, caller holds the queue lock */
+static void _QueuePut(uffs_AioQueue *q, struct uffs_aiocb *cb)
+{
+	cb->next = NULL;
+	if (q->tail)
+		q->tail->next = cb;
+	else
+		q->head = cb;
+	q->tail = cb;
+}
+
+/**
+ * initialize a completion queue
+ * \return 0 on success, -1 on failure
+ */
+int uffs_aio_queue_init(uffs_AioQueue *q)
+{
+	q->head = q->tail = NULL;
+	q->lock = OSSEM_NOT_INITED;
+	q->ev = OSEVENT_NOT_INITED;
+
+	if (uffs_SemCreate(&q->lock) < 0)
+		return -1;
+
+	if (uffs_EventCreate(&q->ev) < 0) {
+		uffs_SemDelete(&q->lock);
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * release a completion queue.
+ * \note all requests to be completed on this queue must be done.
+ */
+int uffs_aio_queue_release(uffs_AioQueue *q)
+{
+	if (q->head)
+		uffs_Perror(UFFS_MSG_NORMAL, "release queue with completed requests not taken");
+
+	uffs_EventDelete(&q->ev);
+	uffs_SemDelete(&q->lock);
+	q->head = q->tail = NULL;
+
+	return 0;
+}
+
+/**
+ * get a completed request from the queue
+ * \param[in] q completion queue
+ * \param[in] wait U_TRUE: block until a request is completed,
+ *					U_FALSE: return NULL if queue is empty (polling)
+ * \return completed request, or NULL
+ */
+struct uffs_aiocb * uffs_aio_queue_get(uffs_AioQueue *q, UBOOL wait)
+{
+	struct uffs_aiocb *cb;
+
+	do {
+		// a polling get doesn't consume the event, so a blocking get
+		// may find the queue empty after the event, wait again then.
+		if (wait)
+			uffs_EventWait(q->ev);
+
+		uffs_SemWait(q->lock);
+		cb = q->head;
+		if (cb) {
+			q->head = cb->next;
+			if (q->head == NULL)
+				q->tail = NULL;
+			cb->next = NULL;
+		}
+		uffs_SemSignal(q->lock);
+	} while (cb == NULL && wait);
+
+	return cb;
+}
+
+/** complete the request, #cb may be freed by user after this */
+static void _Complete(struct uffs_aiocb *cb)
+{
+	uffs_AioQueue *q;
+
+	if (cb->done) {
+		cb->done(cb);
+	}
+	else if (cb->cq) {
+		q = cb->cq;
+		uffs_SemWait(q->lock);
+		_QueuePut(q, cb);
+		uffs_SemSignal(q->lock);
+		uffs_EventSignal(q->ev);
+	}
+}
+
+/** do merged requests batch[0 .. n-1], all have the same op and fd */
+static void _DoBatch(struct uffs_aiocb **batch, int n)
+{
+	struct uffs_iovec iov[UFFS_AIO_MAX_MERGE];
+	struct uffs_aiocb *cb = batch[0];
+	int ret = -1;
+	int remain;
+	int err;
+	int i;
+
+	switch (cb->op) {
+	case UFFS_AIO_READ:
+	case UFFS_AIO_WRITE:
+		for (i = 0; i < n; i++) {
+			iov[i].iov_base = batch[i]->buf;
+			iov[i].iov_len = batch[i]->len;
+		}
+		if (cb->op == UFFS_AIO_READ)
+			ret = uffs_preadv(cb->fd, iov, n, cb->offset);
+		else
+			ret = uffs_pwritev(cb->fd, iov, n, cb->offset);
+		break;
+	case UFFS_AIO_FLUSH:
+		ret = uffs_flush(cb->fd);
+		break;
+	case UFFS_AIO_CLOSE:
+		ret = uffs_close(cb->fd);
+		break;
+	}
+	err = uffs_get_error();
+
+	if (n > 1)
+		uffs_Perror(UFFS_MSG_NOISY, "fd %d: %d requests (op %d) merged", cb->fd, n, cb->op);
+
+	// split bytes done to the merged requests in order
+	remain = ret;
+	for (i = 0; i < n; i++) {
+		cb = batch[i];
+		if ((cb->op == UFFS_AIO_READ || cb->op == UFFS_AIO_WRITE) && ret >= 0) {
+			cb->result = (remain > cb->len ? cb->len : remain);
+			remain -= cb->result;
+		}
+		else {
+			cb->result = ret;
+		}
+		cb->error = err;
+		_Complete(cb);
+	}
+}
+
+/** can #next be merged to batch ending with #prev ? */
+static UBOOL _CanMerge(struct uffs_aiocb *prev, struct uffs_aiocb *next)
+{
+	if (next->op != prev->op)
+		return U_FALSE;
+
+	switch (next->op) {
+	case UFFS_AIO_READ:
+	case UFFS_AIO_WRITE:
+		return (next->offset == prev->offset + prev->len) ? U_TRUE : U_FALSE;
+	case UFFS_AIO_FLUSH:
+		return U_TRUE;
+	default:
+		return U_FALSE;
+	}
+}
+
+/** do requests of the same fd in order, merge where possible */
+static void _DoFile(struct uffs_aiocb *list)
+{
+	struct uffs_aiocb *batch[UFFS_AIO_MAX_MERGE];
+	int n;
+
+	while (list) {
+		n = 0;
+		batch[n++] = list;
+		list = list->next;
+		while (list && n < UFFS_AIO_MAX_MERGE && _CanMerge(batch[n - 1], list)) {
+			batch[n++] = list;
+			list = list->next;
+		}
+		_DoBatch(batch, n);
+	}
+}
+
+/** do all requests taken from worker, grouped by fd */
+static void _DoRequests(struct uffs_aiocb *list)
+{
+	struct uffs_aiocb *file, **file_tail;
+	struct uffs_aiocb *rest, **rest_tail;
+	struct uffs_aiocb *cb, *next;
+	int fd;
+
+	while (list) {
+		fd = list->fd;
+		file = rest = NULL;
+		file_tail = &file;
+		rest_tail = &rest;
+
+		for (cb = list; cb; cb = next) {
+			next = cb->next;
+			cb->next = NULL;
+			if (cb->fd == fd) {
+				*file_tail = cb;
+				file_tail = &cb->next;
+			}
+			else {
+				*rest_tail = cb;
+				rest_tail = &cb->next;
+			}
+		}
+
+		_DoFile(file);
+		list = rest;
+	}
+}
+
+static void _WorkerMain(void *arg)
+{
+	uffs_Device *dev = (uffs_Device *)arg;
+	struct uffs_AioWorkerSt *w = &dev->aio;
+	struct uffs_aiocb *list;
+	UBOOL quit;
+
+	do {
+		uffs_EventWait(w->req.ev);
+
+		uffs_SemWait(w->req.lock);
+		list = w->req.head;
+		w->req.head = w->req.tail = NULL;
+		quit = w->quit;
+		uffs_SemSignal(w->req.lock);
+
+		_DoRequests(list);
+	} while (!quit);
+}
+
+/**
+ * submit an asynchronous I/O request.
+ *
+ * \param[in] cb request, #op, #fd, #offset, #buf, #len
+ *				and #done or #cq must be set.
+ *
+ * \return 0 if the request is accepted and will be completed later,
+ *			-1 if the request is rejected, error code by uffs_get_error().
+ */
+int uffs_aio_submit(struct uffs_aiocb *cb)
+{
+	uffs_Device *dev;
+	struct uffs_AioWorkerSt *w;
+	int ret = -1;
+
+	if (cb == NULL ||
+		cb->op < UFFS_AIO_READ || cb->op > UFFS_AIO_CLOSE ||
+		(cb->done == NULL && cb->cq == NULL)) {
+		uffs_set_error(-UEINVAL);
+		return -1;
+	}
+
+	if ((cb->op == UFFS_AIO_READ || cb->op == UFFS_AIO_WRITE) &&
+		(cb->offset < 0 || cb->len < 0 || (cb->buf == NULL && cb->len > 0))) {
+		uffs_set_error(-UEINVAL);
+		return -1;
+	}
+
+	// the reference keeps the device (and its queue) until cb is queued,
+	// even if the fd is closed and the device unmounted meanwhile.
+	dev = uffs_GetDeviceFromFd(cb->fd);
+	if (dev == NULL)
+		return -1;		// error code is set by uffs_GetDeviceFromFd()
+
+	w = &dev->aio;
+	cb->result = 0;
+	cb->error = UENOERR;
+
+	uffs_SemWait(w->req.lock);
+	if (!w->quit && w->task != OSTASK_NOT_CREATED) {
+		_QueuePut(&w->req, cb);
+		ret = 0;
+	}
+	uffs_SemSignal(w->req.lock);
+
+	if (ret == 0)
+		uffs_EventSignal(w->req.ev);
+	else
+		uffs_set_error(-UEUNINITIALIZED);
+
+	uffs_PutDevice(dev);
+
+	return ret;
+}
+
+/** create and start the I/O worker task of the device */
+URET uffs_AioWorkerStart(uffs_Device *dev)
+{
+	struct uffs_AioWorkerSt *w = &dev->aio;
+
+	w->task = OSTASK_NOT_CREATED;
+	w->quit = U_FALSE;
+
+	if (uffs_aio_queue_init(&w->req) < 0) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "can't create aio request queue");
+		return U_FAIL;
+	}
+
+	// hold the lock so that uffs_aio_submit() sees the task created.
+	uffs_SemWait(w->req.lock);
+	if (uffs_OSTaskCreate(&w->task, _WorkerMain, dev) != 0) {
+		uffs_SemSignal(w->req.lock);
+		uffs_Perror(UFFS_MSG_SERIOUS, "can't create aio worker task");
+		uffs_aio_queue_release(&w->req);
+		return U_FAIL;
+	}
+	uffs_SemSignal(w->req.lock);
+
+	return U_SUCC;
+}
+
+/** stop the I/O worker task, requests already submitted are done before it quits */
+URET uffs_AioWorkerStop(uffs_Device *dev)
+{
+	struct uffs_AioWorkerSt *w = &dev->aio;
+
+	if (w->task == OSTASK_NOT_CREATED)
+		return U_SUCC;
+
+	uffs_SemWait(w->req.lock);
+	w->quit = U_TRUE;
+	uffs_SemSignal(w->req.lock);
+	uffs_EventSignal(w->req.ev);
+
+	if (uffs_OSTaskJoin(&w->task) < 0) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "fail to join aio worker task");
+		return U_FAIL;
+	}
+
+	uffs_aio_queue_release(&w->req);
+
+	return U_SUCC;
+}
+
+#endif
@@ -39,6 +39,8 @@
 #include "uffs/uffs_fs.h"
 #include "uffs/uffs_ecc.h"
 #include "uffs/uffs_badblock.h"
+#include "uffs/uffs_trace.h"
+#include "uffs/uffs_os.h"
 #include <string.h>
 
 #define PFX "bbl : "
@@ -56,9 +58,76 @@ static const char *uffs_BadBlockPendingTypeName(int mark)
 void uffs_BadBlockInit(uffs_Device *dev)
 {
 	dev->pending.count = 0;
+	dev->pending.size = CONFIG_MAX_PENDING_BLOCKS;
+	dev->pending.list = dev->pending.static_list;
 	dev->pending.block_in_recovery = UFFS_INVALID_BLOCK;
 }
 
+void uffs_BadBlockRelease(uffs_Device *dev)
+{
+	if (dev->pending.list != dev->pending.static_list && dev->mem.free)
+		dev->mem.free(dev, dev->pending.list);
+
+	uffs_BadBlockInit(dev);
+}
+
+/**
+ * \brief double the capacity of pending list
+ * \return U_TRUE if the list grows, U_FALSE if not (memory can't be freed or no memory).
+ */
+static UBOOL _PendingListGrow(uffs_Device *dev)
+{
+	struct uffs_PendingListSt *p = &dev->pending;
+	uffs_PendingBlock *list;
+	int size = p->size * 2;
+
+	// static memory allocator never free memory, keep the initial list.
+	if (dev->mem.malloc == NULL || dev->mem.free == NULL)
+		return U_FALSE;
+
+	list = (uffs_PendingBlock *) dev->mem.malloc(dev, sizeof(uffs_PendingBlock) * size);
+	if (list == NULL)
+		return U_FALSE;
+
+	memcpy(list, p->list, sizeof(uffs_PendingBlock) * p->count);
+	if (p->list != p->static_list)
+		dev->mem.free(dev, p->list);
+
+	p->list = list;
+	p->size = size;
+	uffs_Perror(UFFS_MSG_NOISY, "pending list grows to %d", size);
+
+	return U_TRUE;
+}
+
+/**
+ * \brief insert block to pending list, keep the list ordered by mark.
+ *		the last entry is the next one to be processed, blocks with the
+ *		same mark are processed in the order they were added.
+ * \note caller should make sure there is room in the list.
+ */
+static void _PendingListInsert(uffs_Device *dev, int block, u8 mark)
+{
+	struct uffs_PendingListSt *p = &dev->pending;
+	int i;
+
+	for (i = 0; i < p->count && p->list[i].mark < mark; i++)
+		;
+
+	memmove(&p->list[i + 1], &p->list[i], sizeof(uffs_PendingBlock) * (p->count - i));
+	p->list[i].block = block;
+	p->list[i].mark = mark;
+	p->count++;
+}
+
+static void _PendingListRemoveAt(uffs_Device *dev, int i)
+{
+	struct uffs_PendingListSt *p = &dev->pending;
+
+	memmove(&p->list[i], &p->list[i + 1], sizeof(uffs_PendingBlock) * (p->count - i - 1));
+	p->count--;
+}
+
 
 /** 
  * \brief process bad block: mark it as 'bad'
@@ -71,7 +140,8 @@ void uffs_BadBlockProcessNode(uffs_Device *dev, TreeNode *node)
 {
 	if (node) {
 		// mark bad block.
-		uffs_FlashMarkBadBlock(dev, node->u.list.block);
+		if (uffs_FlashMarkBadBlock(dev, node->u.list.block) != U_SUCC)
+			uffs_Perror(UFFS_MSG_SERIOUS, "mark bad block %d fail", node->u.list.block);
 
 		// and put it into bad block list
 		uffs_TreeInsertToBadBlockList(dev, node);
@@ -79,7 +149,11 @@ void uffs_BadBlockProcessNode(uffs_Device *dev, TreeNode *node)
 }
 
 
-static void process_pending_recover(uffs_Device *dev, uffs_PendingBlock *s)
+/**
+ * copy the pending block to a good block and process the pending block.
+ * \return U_SUCC if block is processed (or already been processed), U_FAIL otherwise.
+ */
+static URET process_pending_recover(uffs_Device *dev, uffs_PendingBlock *s)
 {
 	TreeNode *good, *bad;
 	uffs_Buf *buf;
@@ -98,17 +172,20 @@ static void process_pending_recover(uffs_Device *dev, uffs_PendingBlock *s)
 	bc = uffs_BlockInfoGet(dev, s->block);
 	if (bc == NULL) {
 		uffs_Perror(UFFS_MSG_SERIOUS, "can't get bad block info");
-		return;
+		return U_FAIL;
 	}
 
 	region = SEARCH_REGION_DIR|SEARCH_REGION_FILE|SEARCH_REGION_DATA;
+#ifdef CONFIG_UFFS_SMALL_FILE_PACK
+	region |= SEARCH_REGION_PACK;
+#endif
 	bad = uffs_TreeFindNodeByBlock(dev, s->block, &region);
 	if (bad == NULL) {
 		uffs_Perror(UFFS_MSG_SERIOUS,
 					"can't find the reported bad block(%d) in the tree ? probably already been processed.",
 					s->block);
 		uffs_BlockInfoPut(dev, bc);
-		return;
+		return U_SUCC;
 	}
 
 retry:
@@ -117,7 +194,7 @@ retry:
 	if (good == NULL) {
 		uffs_Perror(UFFS_MSG_SERIOUS, "no free block to replace bad block!");
 		uffs_BlockInfoPut(dev, bc);
-		return;
+		return U_FAIL;
 	}
 
 	goodBlockIsDirty = U_FALSE;
@@ -236,6 +313,15 @@ retry:
 		case SEARCH_REGION_DATA:
 			bad->u.data.block = good->u.list.block;
 			type = UFFS_TYPE_DATA;
+			break;
+#ifdef CONFIG_UFFS_SMALL_FILE_PACK
+		case SEARCH_REGION_PACK:
+			// record page_id is the page number, pages were copied in place.
+			uffs_PackMoveFiles(dev, bad->u.list.block, good->u.list.block);
+			bad->u.list.block = good->u.list.block;
+			type = UFFS_TYPE_PACK;
+			break;
+#endif
 		}
 			
 		//from now, the 'bad' is actually good block :)))
@@ -258,6 +344,7 @@ retry:
                 break;
             default:
                 uffs_Perror(UFFS_MSG_SERIOUS, "Unrecognized pending mark: %d", s->mark);
+                succRecov = U_FALSE;
                 break;
         }
 	}
@@ -269,7 +356,34 @@ retry:
 	}
 
 	uffs_BlockInfoPut(dev, bc);
-	
+
+	return succRecov == U_TRUE ? U_SUCC : U_FAIL;
+}
+
+/** 
+ * \brief process the pending block with highest priority
+ * \param[in] dev uffs device
+ */
+static void _ProcessPendingTop(uffs_Device *dev)
+{
+	uffs_PendingBlock s;
+	URET ret;
+#ifdef CONFIG_UFFS_TRACE
+	u32 trace_start;
+#endif
+
+	UFFS_TRACE_START(trace_start);
+
+	// take a copy, list may be reordered or reallocated by new pending block during recovery
+	s = dev->pending.list[--dev->pending.count];
+	uffs_Perror(UFFS_MSG_NOISY, "Process pending block %d - %s", 
+					s.block, uffs_BadBlockPendingTypeName(s.mark));
+	dev->pending.block_in_recovery = s.block;
+	ret = process_pending_recover(dev, &s);
+	if (ret != U_SUCC)
+		uffs_Perror(UFFS_MSG_NORMAL, "Process pending block %d fail", s.block);
+	UFFS_TRACE(dev, UFFS_TRACE_EV_BADBLOCK_RECOVER, s.block, UFFS_INVALID_PAGE,
+				INVALID_UFFS_SERIAL, s.mark, ret, trace_start);
 }
 
 /** 
@@ -278,19 +392,57 @@ retry:
  */
 void uffs_BadBlockRecover(uffs_Device *dev)
 {
-	uffs_PendingBlock *s;
+	while (dev->pending.count > 0)
+		_ProcessPendingTop(dev);
+
+	dev->pending.block_in_recovery = UFFS_INVALID_BLOCK;
+}
+
+/** 
+ * \brief process pending blocks on file operation path.
+ *		bad blocks are processed right now, refresh blocks are deferred,
+ *		only CONFIG_PENDING_REFRESH_PER_OP of them are processed.
+ * \param[in] dev uffs device
+ */
+void uffs_BadBlockRecoverUrgent(uffs_Device *dev)
+{
+	int refresh = 0;
 
 	while (dev->pending.count > 0) {
-		dev->pending.count--;
-		s = &dev->pending.list[dev->pending.count];
-		uffs_Perror(UFFS_MSG_NOISY, "Process pending block %d - %s", 
-						s->block, uffs_BadBlockPendingTypeName(s->mark));
-		dev->pending.block_in_recovery = s->block;
-		process_pending_recover(dev, s);
+		if (dev->pending.list[dev->pending.count - 1].mark == UFFS_PENDING_BLK_REFRESH) {
+			if (refresh >= CONFIG_PENDING_REFRESH_PER_OP)
+				break;
+			refresh++;
+		}
+		_ProcessPendingTop(dev);
 	}
+
 	dev->pending.block_in_recovery = UFFS_INVALID_BLOCK;
 }
 
+/** 
+ * \brief process pending blocks by priority until time budget is used up.
+ *		at least one pending block is processed.
+ * \param[in] dev uffs device
+ * \param[in] budget_ms time budget, in milli-seconds
+ * \return number of blocks still pending
+ */
+int uffs_BadBlockRecoverStep(uffs_Device *dev, int budget_ms)
+{
+	u32 start = uffs_OSGetTick();
+	u32 budget = (u32)budget_ms * UFFS_OS_TICKS_PER_MS;
+
+	while (dev->pending.count > 0) {
+		_ProcessPendingTop(dev);
+		if ((u32)(uffs_OSGetTick() - start) >= budget)
+			break;
+	}
+
+	dev->pending.block_in_recovery = UFFS_INVALID_BLOCK;
+
+	return dev->pending.count;
+}
+
 
 /** put a new block to the bad block pending list */
 void uffs_BadBlockAdd(uffs_Device *dev, int block, u8 mark)
@@ -308,25 +460,33 @@ void uffs_BadBlockAdd(uffs_Device *dev, int block, u8 mark)
 		if (s->block == block) {
 
 			if (s->mark < mark) { 	// RECOVER would overwrite REFRESH, MARKBAD would overwrite RECOVER/REFRESH
-				s->mark = mark;
+				// re-insert to the new priority position
+				_PendingListRemoveAt(dev, i);
+				_PendingListInsert(dev, block, mark);
 				uffs_Perror(UFFS_MSG_NOISY, "Change pending block %d - %s",
-								block, uffs_BadBlockPendingTypeName(s->mark));
+								block, uffs_BadBlockPendingTypeName(mark));
 			}
 			return;
 		}
 	}
 
 	// check if there is space in pending list		
-	if (dev->pending.count >= CONFIG_MAX_PENDING_BLOCKS) {
-		uffs_Perror(UFFS_MSG_SERIOUS, 
-					"Too many pending bad blocks, please increase CONFIG_MAX_PENDING_BLOCKS !");
-		return;
+	if (dev->pending.count >= dev->pending.size && _PendingListGrow(dev) == U_FALSE) {
+		s = &dev->pending.list[0];	// the lowest priority block
+		if (s->mark == UFFS_PENDING_BLK_REFRESH && mark > UFFS_PENDING_BLK_REFRESH) {
+			// refresh can be given up, block will be put back when it's read again.
+			uffs_Perror(UFFS_MSG_NORMAL, "Pending list full, drop refresh block %d", s->block);
+			_PendingListRemoveAt(dev, 0);
+		}
+		else {
+			uffs_Perror(UFFS_MSG_SERIOUS, 
+						"Too many pending bad blocks, please increase CONFIG_MAX_PENDING_BLOCKS !");
+			return;
+		}
 	}
 
 	// add new pending block
-	s = &dev->pending.list[dev->pending.count++];
-	s->block = block;
-	s->mark = mark;
+	_PendingListInsert(dev, block, mark);
 	uffs_Perror(UFFS_MSG_NOISY, "Add pending block %d - %s",
 					block, uffs_BadBlockPendingTypeName(mark));
 }
@@ -0,0 +1,433 @@
+/*
+  This file is part of UFFS, the Ultra-low-cost Flash File System.
+  
+  Copyright (C) 2005-2009 Ricky Zheng <ricky_gz_zheng@yahoo.co.nz>
+
+  UFFS is free software; you can redistribute it and/or modify it under
+  the GNU Library General Public License as published by the Free Software 
+  Foundation; either version 2 of the License, or (at your option) any
+  later version.
+
+  UFFS is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+  or GNU Library General Public License, as applicable, for more details.
+ 
+  You should have received a copy of the GNU General Public License
+  and GNU Library General Public License along with UFFS; if not, write
+  to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA  02110-1301, USA.
+
+  As a special exception, if other files instantiate templates or use
+  macros or inline functions from this file, or you compile this file
+  and link it with other works to produce a work based on this file,
+  this file does not by itself cause the resulting work to be covered
+  by the GNU General Public License. However the source code for this
+  file must still be made available in accordance with section (3) of
+  the GNU General Public License v2.
+ 
+  This exception does not invalidate any other reasons why a work based
+  on this file might be covered by the GNU General Public License.
+*/
+
+
+
+/**
+ * \file uffs_bbt.c
+ * \brief on-flash bad block table
+ * \author Ricky Zheng
+ */
+
+#include "uffs_config.h"
+#include "uffs/uffs_public.h"
+#include "uffs/uffs_device.h"
+#include "uffs/uffs_flash.h"
+#include "uffs/uffs_crc.h"
+#include "uffs/uffs_bbt.h"
+#include <string.h>
+
+#define PFX "bbt : "
+
+static void _MakeBbtTag(uffs_Tags *tag, u16 page, u32 len)
+{
+	memset(tag, 0xFF, sizeof(uffs_Tags));
+	TAG_TYPE(tag) = UFFS_TYPE_PACK;
+	TAG_BLOCK_TS(tag) = 0;
+	TAG_PAGE_ID(tag) = (u8)page;
+	TAG_SET_DATA_LEN(tag, len);
+}
+
+/**
+ * \brief is the tag a BBT record tag ?
+ * \note available without CONFIG_UFFS_BBT as well, so that tree building
+ *       can tell BBT blocks from pack blocks.
+ */
+UBOOL uffs_BbtIsTableTag(uffs_Tags *tag)
+{
+	uffs_Tags bbt_tag;
+
+	_MakeBbtTag(&bbt_tag, 0, 0);
+
+	return (TAG_IS_GOOD(tag) &&
+			TAG_TYPE(tag) == TAG_TYPE(&bbt_tag) &&
+			TAG_SERIAL(tag) == TAG_SERIAL(&bbt_tag) &&
+			TAG_PARENT(tag) == TAG_PARENT(&bbt_tag)) ? U_TRUE : U_FALSE;
+}
+
+#ifdef CONFIG_UFFS_BBT
+
+#define BBT_MAP_SIZE(count)		(((count) + 7) / 8)
+#define BBT_IS_SET(map, n)		((map)[(n) / 8] & (1 << ((n) % 8)))
+#define BBT_SET(map, n)			((map)[(n) / 8] |= (1 << ((n) % 8)))
+
+/* scan result of a BBT candidate block */
+#define BBT_BLK_TABLE		0	//!< block holds BBT records
+#define BBT_BLK_ERASED		1	//!< block is erased
+#define BBT_BLK_BAD			2	//!< bad block
+#define BBT_BLK_OTHER		3	//!< block is used by something else
+
+static u16 _BbtCrc(struct uffs_BbtHeaderSt *hdr, const u8 *map)
+{
+	u16 crc;
+
+	crc = uffs_crc16sum(hdr, (int)((u8 *)&hdr->crc - (u8 *)hdr));
+	return uffs_crc16update(map, BBT_MAP_SIZE(hdr->count), crc);
+}
+
+/**
+ * scan a BBT candidate block, load the newest valid record
+ * if it's newer than the table in memory.
+ *
+ * \param[in] count number of blocks the table should cover
+ * \param[out] next_page the first free page in the block
+ * \param[out] version version of the newest valid record in the block, 0 if none
+ * \return BBT_BLK_XXX
+ */
+static int _ScanBlock(uffs_Device *dev, int block, uffs_BlockNum count,
+					  uffs_Buf *buf, u16 *next_page, u32 *version)
+{
+	struct uffs_BbtSt *bbt = &(dev->bbt);
+	struct uffs_BbtHeaderSt *hdr = (struct uffs_BbtHeaderSt *)(buf->data);
+	uffs_Tags tag;
+	u16 page;
+	int ret;
+
+	*next_page = 0;
+	*version = 0;
+
+	if (uffs_FlashIsBadBlock(dev, block))
+		return BBT_BLK_BAD;
+
+	for (page = 0; page < dev->attr->pages_per_block; page++) {
+		ret = uffs_FlashReadPageTag(dev, block, page, &tag);
+		if (!UFFS_FLASH_HAVE_ERR(ret) && !TAG_IS_DIRTY(&tag))
+			break;	// free page
+
+		if (UFFS_FLASH_HAVE_ERR(ret) || !uffs_BbtIsTableTag(&tag)) {
+			if (page == 0)
+				return BBT_BLK_OTHER;
+			continue;	// damaged record
+		}
+
+		ret = uffs_FlashReadPage(dev, block, page, buf, U_FALSE);
+		if (UFFS_FLASH_HAVE_ERR(ret) ||
+			hdr->magic != UFFS_BBT_MAGIC ||
+			hdr->start != bbt->start ||
+			hdr->count != count ||
+			hdr->crc != _BbtCrc(hdr, (u8 *)(hdr + 1))) {
+			uffs_Perror(UFFS_MSG_NORMAL, "BBT block %d page %d is damaged", block, page);
+			continue;
+		}
+
+		if (hdr->version > bbt->version) {
+			memcpy(bbt->map, hdr + 1, BBT_MAP_SIZE(count));
+			bbt->version = hdr->version;
+		}
+		if (hdr->version > *version)
+			*version = hdr->version;
+	}
+
+	*next_page = page;
+
+	return page == 0 ? BBT_BLK_ERASED : BBT_BLK_TABLE;
+}
+
+/**
+ * append current table to BBT block bbt->blocks[idx],
+ * if writing fails, try once more on the next page (erase the block if it's full).
+ */
+static URET _WriteTable(uffs_Device *dev, int idx, uffs_Buf *buf)
+{
+	struct uffs_BbtSt *bbt = &(dev->bbt);
+	struct uffs_BbtHeaderSt *hdr = (struct uffs_BbtHeaderSt *)(buf->data);
+	int block = bbt->blocks[idx];
+	u16 page = bbt->next_page[idx];
+	uffs_Tags tag;
+	int ret, retry;
+
+	for (retry = 0; retry < 2; retry++) {
+		if (page >= dev->attr->pages_per_block) {
+			ret = uffs_FlashEraseBlock(dev, block);
+			if (UFFS_FLASH_HAVE_ERR(ret)) {
+				uffs_Perror(UFFS_MSG_SERIOUS, "erase BBT block %d fail, error = %d", block, ret);
+				return U_FAIL;
+			}
+			page = 0;
+		}
+
+		memset(buf->header, 0xFF, dev->com.pg_size);
+		hdr->magic = UFFS_BBT_MAGIC;
+		hdr->version = bbt->version;
+		hdr->start = bbt->start;
+		hdr->count = bbt->count;
+		memcpy(hdr + 1, bbt->map, BBT_MAP_SIZE(bbt->count));
+		hdr->crc = _BbtCrc(hdr, bbt->map);
+
+		_MakeBbtTag(&tag, page, sizeof(struct uffs_BbtHeaderSt) + BBT_MAP_SIZE(bbt->count));
+		ret = uffs_FlashWritePageCombine(dev, block, page, buf, &tag);
+		bbt->next_page[idx] = page + 1;
+
+		if (!UFFS_FLASH_HAVE_ERR(ret))
+			return U_SUCC;
+
+		uffs_Perror(UFFS_MSG_SERIOUS, "write BBT block %d page %d fail, error = %d", block, page, ret);
+		page++;
+	}
+
+	return U_FAIL;
+}
+
+/**
+ * write current table to all BBT blocks.
+ *
+ * If no mirror is written, the table on flash is out of date: bad block
+ * marks are still read until a later save succeeds, and the first mirror
+ * is erased so that the next mount sees the mirrors differ and checks the marks.
+ */
+static URET _SaveTable(uffs_Device *dev)
+{
+	struct uffs_BbtSt *bbt = &(dev->bbt);
+	uffs_Buf *buf;
+	int i, nsaved = 0;
+
+	buf = uffs_BufClone(dev, NULL);
+	if (buf == NULL) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "Insufficient buf, can't save BBT.");
+	}
+	else {
+		for (i = 0; i < UFFS_BBT_BLOCKS; i++) {
+			if (_WriteTable(dev, i, buf) == U_SUCC)
+				nsaved++;
+		}
+		uffs_BufFreeClone(dev, buf);
+	}
+
+	if (nsaved == 0) {
+		bbt->unsaved = U_TRUE;
+		if (!UFFS_FLASH_HAVE_ERR(uffs_FlashEraseBlock(dev, bbt->blocks[0])))
+			bbt->next_page[0] = 0;
+		return U_FAIL;
+	}
+
+	bbt->unsaved = U_FALSE;
+
+	return U_SUCC;
+}
+
+/** on-block bad block marks newer than a loaded table: set them in the table */
+static UBOOL _CheckMarks(uffs_Device *dev, uffs_BlockNum count)
+{
+	struct uffs_BbtSt *bbt = &(dev->bbt);
+	UBOOL changed = U_FALSE;
+	int i;
+
+	// BBT is not in use yet (bbt->count == 0), uffs_FlashIsBadBlock() reads the mark.
+	for (i = 0; i < (int)count; i++) {
+		if (!BBT_IS_SET(bbt->map, i) && uffs_FlashIsBadBlock(dev, bbt->start + i)) {
+			uffs_Perror(UFFS_MSG_NORMAL, "bad block %d is not in BBT, added", bbt->start + i);
+			BBT_SET(bbt->map, i);
+			changed = U_TRUE;
+		}
+	}
+
+	return changed;
+}
+
+/**
+ * \brief load the BBT from the partition tail, create it if not exist.
+ *
+ * If the tail blocks are used by something else (e.g. flash was formatted
+ * without BBT), BBT is not used until those blocks are erased.
+ *
+ * \param[in] dev uffs device, dev->par must be set
+ * \return U_SUCC if BBT is in use or not available,
+ *		U_FAIL if failed to allocate memory.
+ */
+URET uffs_BbtInit(uffs_Device *dev)
+{
+	struct uffs_BbtSt *bbt = &(dev->bbt);
+	uffs_Buf *buf;
+	u32 versions[UFFS_BBT_BLOCKS];
+	uffs_BlockNum count;
+	int block, n, size, ret, i;
+	u16 next_page;
+	u32 version;
+	UBOOL save;
+
+	memset(bbt, 0, sizeof(struct uffs_BbtSt));
+
+	bbt->start = dev->par.start;
+	count = dev->par.end - dev->par.start + 1;
+	size = BBT_MAP_SIZE(count);
+
+	if (sizeof(struct uffs_BbtHeaderSt) + size > (unsigned int)dev->com.pg_size - sizeof(struct uffs_MiniHeaderSt)) {
+		uffs_Perror(UFFS_MSG_NORMAL, "BBT doesn't fit in one page, not used.");
+		return U_SUCC;
+	}
+
+	if (dev->mem.bbt_pool_size == 0 && dev->mem.malloc) {
+		dev->mem.bbt_pool_buf = dev->mem.malloc(dev, size);
+		if (dev->mem.bbt_pool_buf)
+			dev->mem.bbt_pool_size = size;
+	}
+	if (dev->mem.bbt_pool_size < size) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "BBT buffer require %d but only %d available.",
+					size, dev->mem.bbt_pool_size);
+		return U_FAIL;
+	}
+
+	bbt->map = (u8 *)dev->mem.bbt_pool_buf;
+	memset(bbt->map, 0, size);
+
+	buf = uffs_BufClone(dev, NULL);
+	if (buf == NULL) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "Insufficient buf, BBT not used.");
+		return U_SUCC;
+	}
+
+	// locate BBT blocks from the partition tail, skip bad blocks.
+	// BBT is not in use (bbt->count == 0) until it's loaded,
+	// so far uffs_FlashIsBadBlock() still reads the bad block mark.
+	n = 0;
+	for (block = dev->par.end; n < UFFS_BBT_BLOCKS && block > dev->par.start; block--) {
+		ret = _ScanBlock(dev, block, count, buf, &next_page, &version);
+		if (ret == BBT_BLK_BAD)
+			continue;
+		if (ret == BBT_BLK_OTHER)
+			break;
+
+		bbt->blocks[n] = block;
+		bbt->next_page[n] = next_page;
+		versions[n] = version;
+		n++;
+	}
+
+	if (n < UFFS_BBT_BLOCKS) {
+		uffs_Perror(UFFS_MSG_NORMAL, "no room for BBT at partition tail, BBT not used.");
+		uffs_BufFreeClone(dev, buf);
+		bbt->count = 0;
+		return U_SUCC;
+	}
+
+	// BBT blocks found, from now on they are not part of the partition.
+	dev->par.end = bbt->blocks[UFFS_BBT_BLOCKS - 1] - 1;
+
+	save = U_FALSE;
+	if (bbt->version == 0) {
+		// no table yet, build it from bad block marks (the last time we read them)
+		for (i = 0; i < (int)count; i++) {
+			if (uffs_FlashIsBadBlock(dev, bbt->start + i))
+				BBT_SET(bbt->map, i);
+		}
+		bbt->version = 1;
+		save = U_TRUE;
+		uffs_Perror(UFFS_MSG_NORMAL, "create BBT at block %d", bbt->blocks[0]);
+	}
+	else {
+		for (i = 0; i < UFFS_BBT_BLOCKS; i++) {
+			if (versions[i] != bbt->version)
+				break;
+		}
+		// a mirror missed a save, a new bad block might be marked on the block only.
+		if (i < UFFS_BBT_BLOCKS && _CheckMarks(dev, count)) {
+			bbt->version++;
+			save = U_TRUE;
+		}
+	}
+
+	bbt->count = count;
+
+	// bring mirrors up to date
+	n = 0;
+	for (i = 0; i < UFFS_BBT_BLOCKS; i++) {
+		if ((save || versions[i] != bbt->version) && _WriteTable(dev, i, buf) != U_SUCC)
+			n++;
+	}
+	if (n == UFFS_BBT_BLOCKS) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "can't write BBT, bad block marks are still checked");
+		bbt->unsaved = U_TRUE;
+	}
+
+	uffs_BufFreeClone(dev, buf);
+
+	uffs_Perror(UFFS_MSG_NOISY, "BBT version %d loaded", bbt->version);
+
+	return U_SUCC;
+}
+
+/** release BBT memory */
+void uffs_BbtRelease(uffs_Device *dev)
+{
+	if (dev->mem.bbt_pool_buf && dev->mem.free) {
+		dev->mem.free(dev, dev->mem.bbt_pool_buf);
+		dev->mem.bbt_pool_buf = NULL;
+		dev->mem.bbt_pool_size = 0;
+	}
+	memset(&(dev->bbt), 0, sizeof(struct uffs_BbtSt));
+}
+
+/** is the block bad by BBT ? the block must be covered by BBT */
+UBOOL uffs_BbtIsBad(uffs_Device *dev, int block)
+{
+	return BBT_IS_SET(dev->bbt.map, block - dev->bbt.start) ? U_TRUE : U_FALSE;
+}
+
+/**
+ * \brief add a new bad block to BBT, and save a new version of the table
+ * \param[in] dev uffs device
+ * \param[in] block the new bad block
+ * \return U_SUCC if the table is saved (or nothing to do), otherwise U_FAIL
+ * \note a table failed to be saved before is saved again.
+ */
+URET uffs_BbtMarkBad(uffs_Device *dev, int block)
+{
+	struct uffs_BbtSt *bbt = &(dev->bbt);
+
+	if (!UFFS_BBT_COVERS(dev, block))
+		return U_SUCC;
+
+	if (!uffs_BbtIsBad(dev, block)) {
+		BBT_SET(bbt->map, block - bbt->start);
+		bbt->version++;
+	}
+	else if (!bbt->unsaved) {
+		return U_SUCC;
+	}
+
+	return _SaveTable(dev);
+}
+
+/**
+ * \brief save the table again if it failed to be saved before
+ * \param[in] dev uffs device
+ * \return U_SUCC if the table is on flash, otherwise U_FAIL
+ */
+URET uffs_BbtSync(uffs_Device *dev)
+{
+	if (dev->bbt.count == 0 || !dev->bbt.unsaved)
+		return U_SUCC;
+
+	return _SaveTable(dev);
+}
+
+#endif // CONFIG_UFFS_BBT
@@ -62,6 +62,7 @@ URET uffs_BlockInfoInitCache(uffs_Device *dev, int maxCachedBlocks)
 {
 	uffs_BlockInfo * blockInfos = NULL;
 	uffs_PageSpare * pageSpares = NULL;
+	u16 * pageMaps = NULL;
 	void * buf = NULL;
 	uffs_BlockInfo *work = NULL;
 	int size, i, j;
@@ -75,7 +76,8 @@ URET uffs_BlockInfoInitCache(uffs_Device *dev, int maxCachedBlocks)
 
 	size = ( 
 			sizeof(uffs_BlockInfo) +
-			sizeof(uffs_PageSpare) * dev->attr->pages_per_block
+			sizeof(uffs_PageSpare) * dev->attr->pages_per_block +
+			sizeof(u16) * dev->attr->pages_per_block
 			) * maxCachedBlocks;
 
 	if (dev->mem.blockinfo_pool_size == 0) {
@@ -105,6 +107,9 @@ URET uffs_BlockInfoInitCache(uffs_Device *dev, int maxCachedBlocks)
 	size += sizeof(uffs_BlockInfo) * maxCachedBlocks;
 
 	pageSpares = (uffs_PageSpare *)((char *)buf + size);
+	size += sizeof(uffs_PageSpare) * dev->attr->pages_per_block * maxCachedBlocks;
+
+	pageMaps = (u16 *)((char *)buf + size);
 
 	//initialize block info
 	work = &(blockInfos[0]);
@@ -137,6 +142,8 @@ URET uffs_BlockInfoInitCache(uffs_Device *dev, int maxCachedBlocks)
 			work->spares[j].expired = 1;
 		}
 		work->expired_count = dev->attr->pages_per_block;
+		work->page_map = &(pageMaps[i*dev->attr->pages_per_block]);
+		work->map_pages = UFFS_INVALID_PAGE;
 		work = work->next;
 	}
 	return U_SUCC;
@@ -244,6 +251,21 @@ URET uffs_BlockInfoFindFirstFreePage(uffs_Device *dev, uffs_BlockInfo *work, u16
 	while (1) {
 		// first_page is always dirty
 		// last_page is always clean
+
+		if (UFFS_FLASH_CAN_BATCH_READ_SPARE(dev) &&
+			last_page - first_page <= UFFS_TAG_BATCH_PAGES) {
+			// cheaper to load the rest in one batch than to bisect
+			if (uffs_BlockInfoLoadPageRange(dev, work, first_page + 1, last_page) != U_SUCC) {
+				return U_FAIL;
+			}
+			for (current_page = first_page + 1; current_page < last_page; current_page++) {
+				if (!TAG_IS_DIRTY(GET_TAG(work, current_page)))
+					break;
+			}
+			*first_free_page = current_page;
+			return U_SUCC;
+		}
+
 		// This algorithm divides [first_page, last_page] segment in half until last_page is the first clean page
 		current_page = first_page + (last_page - first_page) / 2;
 		spare = &(work->spares[current_page]);
@@ -275,6 +297,59 @@ URET uffs_BlockInfoFindFirstFreePage(uffs_Device *dev, uffs_BlockInfo *work, u16
 }
 
 
+/**
+ * \brief find the newest page with given page_id in block
+ *
+ * The page_id -> page map is built on first use, and extended by
+ * the pages written since then (pages in a block are only appended,
+ * any other change of the cached tags expires the map).
+ *
+ * \param[in] dev uffs device
+ * \param[in] work block info
+ * \param[in] page_id page_id to be found
+ * \return the page number
+ * \retval UFFS_INVALID_PAGE page not found, or fail to load spares
+ */
+u16 uffs_BlockInfoFindPageById(uffs_Device *dev, uffs_BlockInfo *work, u16 page_id)
+{
+	u16 page, end;
+	uffs_Tags *tag;
+
+	if (page_id >= dev->attr->pages_per_block)
+		return UFFS_INVALID_PAGE;
+
+	if (work->map_pages == UFFS_INVALID_PAGE) {
+		for (page = 0; page < dev->attr->pages_per_block; page++)
+			work->page_map[page] = UFFS_INVALID_PAGE;
+		work->map_pages = 0;
+	}
+
+	if (work->map_pages < dev->attr->pages_per_block) {
+		if (uffs_BlockInfoFindFirstFreePage(dev, work, work->map_pages,
+				dev->attr->pages_per_block, &end) != U_SUCC) {
+			work->map_pages = UFFS_INVALID_PAGE;
+			return UFFS_INVALID_PAGE;
+		}
+
+		if (end > work->map_pages) {
+			if (uffs_BlockInfoLoadPageRange(dev, work, work->map_pages, end) != U_SUCC) {
+				work->map_pages = UFFS_INVALID_PAGE;
+				return UFFS_INVALID_PAGE;
+			}
+
+			for (page = work->map_pages; page < end; page++) {
+				tag = GET_TAG(work, page);
+				if (TAG_IS_GOOD(tag) && TAG_PAGE_ID(tag) < dev->attr->pages_per_block)
+					work->page_map[TAG_PAGE_ID(tag)] = page;
+			}
+			work->map_pages = end;
+		}
+	}
+
+	return work->page_map[page_id];
+}
+
+
 /** 
  * \brief load page's spares data to given block info structure
  *			in given page range
@@ -289,28 +364,43 @@ URET uffs_BlockInfoFindFirstFreePage(uffs_Device *dev, uffs_BlockInfo *work, u16
  */
 URET uffs_BlockInfoLoadPageRange(uffs_Device *dev, uffs_BlockInfo *work, u16 first_page, u16 page_after_last)
 {
-	int i, ret, nfailed;
+	int i, n, k, nfailed;
 	uffs_PageSpare *spare;
+	uffs_Tags *tags[UFFS_TAG_BATCH_PAGES];
+	int results[UFFS_TAG_BATCH_PAGES];
 
 	nfailed = 0;
-	for (i = first_page; i < page_after_last; i++) {
-		spare = &(work->spares[i]);
-		if (spare->expired == 0) {
+	i = first_page;
+	while (i < page_after_last) {
+		if (work->spares[i].expired == 0) {
+			i++;
 			continue;
 		}
 
-		ret = uffs_FlashReadPageTag(dev, work->block, i, &(spare->tag));
+		// read a run of expired pages in one go
+		for (n = 0; n < UFFS_TAG_BATCH_PAGES && i + n < page_after_last; n++) {
+			spare = &(work->spares[i + n]);
+			if (spare->expired == 0)
+				break;
+			tags[n] = &(spare->tag);
+		}
 
-		uffs_BadBlockAddByFlashResult(dev, work->block, ret);
+		n = uffs_FlashReadPageTags(dev, work->block, i, n, tags, results);
 
-		if (UFFS_FLASH_HAVE_ERR(ret)) {
-			uffs_Perror(UFFS_MSG_SERIOUS, "load block %d page %d spare fail.", work->block, i);
-			TAG_VALID_BIT(&(spare->tag)) = TAG_INVALID;
-			nfailed++;
-		}
+		for (k = 0; k < n; k++, i++) {
+			spare = &(work->spares[i]);
 
-		spare->expired = 0;
-		work->expired_count--;
+			uffs_BadBlockAddByFlashResult(dev, work->block, results[k]);
+
+			if (UFFS_FLASH_HAVE_ERR(results[k])) {
+				uffs_Perror(UFFS_MSG_SERIOUS, "load block %d page %d spare fail.", work->block, i);
+				TAG_VALID_BIT(&(spare->tag)) = TAG_INVALID;
+				nfailed++;
+			}
+
+			spare->expired = 0;
+			work->expired_count--;
+		}
 	}
 
 	if (nfailed > 0) {
@@ -434,6 +524,7 @@ uffs_BlockInfo * uffs_BlockInfoGet(uffs_Device *dev, int block)
 
 	work->block = block;
 	work->expired_count = dev->attr->pages_per_block;
+	work->map_pages = UFFS_INVALID_PAGE;
 	for (i = 0; i < dev->attr->pages_per_block; i++) {
 		work->spares[i].expired = 1;
 
@@ -485,6 +576,7 @@ void uffs_BlockInfoExpireAllPages(uffs_Device *dev, uffs_BlockInfo *p)
 			p->expired_count++;
 		}
 	}
+	p->map_pages = UFFS_INVALID_PAGE;
 }
 
 /** 
@@ -503,6 +595,7 @@ void uffs_BlockInfoExpire(uffs_Device *dev, uffs_BlockInfo *p, u16 page)
 			spare->expired = 1;
 			p->expired_count++;
 		}
+		p->map_pages = UFFS_INVALID_PAGE;
 	}
 }
 
@@ -547,5 +640,6 @@ void uffs_BlockInfoInitErased(uffs_Device *dev, uffs_BlockInfo *p)
 		memset(&(spare->tag), 0xFF, sizeof(struct uffs_TagsSt));
 	}
 	p->expired_count = 0;
+	p->map_pages = UFFS_INVALID_PAGE;
 }
 
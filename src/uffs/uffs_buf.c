@@ -44,6 +44,7 @@
 #include "uffs/uffs_pool.h"
 #include "uffs/uffs_ecc.h"
 #include "uffs/uffs_badblock.h"
+#include "uffs/uffs_trace.h"
 #include <string.h>
 
 #define PFX "pbuf: "
@@ -169,6 +170,112 @@ static void _MoveNodeToHead(uffs_Device *dev, uffs_Buf *p)
 }
 
 
+#ifdef CONFIG_UFFS_BUF_2Q
+
+/** DIR/FILE header page, keep it in Am segment */
+#define IS_HEADER_BUF(buf) \
+	((buf)->page_id == 0 && \
+	 ((buf)->type == UFFS_TYPE_DIR || (buf)->type == UFFS_TYPE_FILE))
+
+/**
+ * \brief set 2Q segment of a buffer
+ */
+static void _SetBufSeg(uffs_Device *dev, uffs_Buf *buf, u8 seg)
+{
+	if (buf->seg != seg) {
+		if (seg == UFFS_BUF_SEG_A1)
+			dev->buf.a1_count++;
+		else
+			dev->buf.a1_count--;
+		buf->seg = seg;
+	}
+}
+
+/**
+ * \brief clear all ghost entries
+ */
+static void _ClearGhost(uffs_Device *dev)
+{
+	int i;
+
+	for (i = 0; i < UFFS_BUF_GHOST_MAX; i++)
+		dev->buf.ghost[i].page_id = UFFS_INVALID_PAGE;
+	dev->buf.ghost_next = 0;
+}
+
+/**
+ * \brief remember a page which is going to be recycled from A1 segment
+ */
+static void _AddGhost(uffs_Device *dev, uffs_Buf *buf)
+{
+	struct uffs_PageBufDescSt *pb = &dev->buf;
+	struct uffs_BufGhostSt *g;
+
+	if (pb->ghost_max == 0)
+		return;
+
+	g = &pb->ghost[pb->ghost_next];
+	g->parent = buf->parent;
+	g->serial = buf->serial;
+	g->page_id = buf->page_id;
+	pb->ghost_next = (pb->ghost_next + 1) % pb->ghost_max;
+}
+
+/**
+ * \brief check and remove a page from ghost entries
+ * \return U_TRUE if the page was recently recycled from A1 segment
+ */
+static UBOOL _TakeGhost(uffs_Device *dev, uffs_Buf *buf)
+{
+	struct uffs_PageBufDescSt *pb = &dev->buf;
+	struct uffs_BufGhostSt *g;
+	int i;
+
+	for (i = 0; i < pb->ghost_max; i++) {
+		g = &pb->ghost[i];
+		if (g->page_id == buf->page_id &&
+			g->serial == buf->serial &&
+			g->parent == buf->parent) {
+			g->page_id = UFFS_INVALID_PAGE;
+			return U_TRUE;
+		}
+	}
+
+	return U_FALSE;
+}
+
+#endif
+
+/**
+ * \brief a buffer in the list is accessed again
+ */
+static void _BufTouch(uffs_Device *dev, uffs_Buf *buf)
+{
+#ifdef CONFIG_UFFS_BUF_2Q
+	// A1 is a FIFO, re-access in A1 doesn't change the order nor promote
+	// the page: a sequential read/write hits the same page several times.
+	// Pages get to Am only when re-read after recycled (see _BufFill()).
+	if (buf->seg == UFFS_BUF_SEG_A1 && !IS_HEADER_BUF(buf))
+		return;
+	_SetBufSeg(dev, buf, UFFS_BUF_SEG_AM);
+#endif
+	_MoveNodeToHead(dev, buf);
+}
+
+/**
+ * \brief a free buffer is filled with a new page
+ */
+static void _BufFill(uffs_Device *dev, uffs_Buf *buf)
+{
+#ifdef CONFIG_UFFS_BUF_2Q
+	if (IS_HEADER_BUF(buf) || _TakeGhost(dev, buf))
+		_SetBufSeg(dev, buf, UFFS_BUF_SEG_AM);
+	else
+		_SetBufSeg(dev, buf, UFFS_BUF_SEG_A1);
+#endif
+	_MoveNodeToHead(dev, buf);
+}
+
 /**
  * \brief put the buffer in clone buffers list
  * \param[in] dev uffs device
@@ -290,6 +397,18 @@ URET uffs_BufInit(uffs_Device *dev, int buf_max, int dirty_buf_max)
 		_InsertToCloneBufList(dev, buf);
 	}
 
+#ifdef CONFIG_UFFS_BUF_2Q
+	// all buffers start in A1 segment
+	dev->buf.a1_count = buf_max - CLONE_BUFFERS_THRESHOLD;
+	dev->buf.a1_max = dev->buf.a1_count * UFFS_BUF_A1_PERCENT / 100;
+	if (dev->buf.a1_max < 1)
+		dev->buf.a1_max = 1;
+	dev->buf.ghost_max = dev->buf.a1_count / 2;
+	if (dev->buf.ghost_max > UFFS_BUF_GHOST_MAX)
+		dev->buf.ghost_max = UFFS_BUF_GHOST_MAX;
+	_ClearGhost(dev);
+#endif
+
 	return U_SUCC;
 }
 
@@ -390,7 +509,32 @@ static uffs_Buf * _FindFreeBuf(uffs_Device *dev)
 {
 	uffs_Buf *buf;
 
-#if 0
+#ifdef CONFIG_UFFS_BUF_2Q
+	u8 seg;
+
+	// recycle from A1 if it's over the limit, otherwise from Am.
+	// empty buffers are always taken first.
+	seg = (dev->buf.a1_count > dev->buf.a1_max ?
+			UFFS_BUF_SEG_A1 : UFFS_BUF_SEG_AM);
+
+	for (buf = dev->buf.tail; buf; buf = buf->prev) {
+		if (buf->ref_count == 0 &&
+			(buf->mark == UFFS_BUF_EMPTY ||
+			 (buf->mark == UFFS_BUF_VALID && buf->seg == seg)))
+			break;
+	}
+
+	if (buf == NULL) {
+		for (buf = dev->buf.tail; buf; buf = buf->prev) {
+			if (buf->ref_count == 0 && buf->mark != UFFS_BUF_DIRTY)
+				break;
+		}
+	}
+
+	if (buf && buf->mark == UFFS_BUF_VALID && buf->seg == UFFS_BUF_SEG_A1)
+		_AddGhost(dev, buf);
+
+#elif 0
 	buf = dev->buf.head;
 	while (buf) {
 
@@ -643,15 +787,21 @@ static URET uffs_BufFlush_Exist_With_BlockRecover(
 	TreeNode *newNode;
 	uffs_BlockInfo *newBc;
 	uffs_Tags *tag, *oldTag;
-	u16 newBlock;
+	uffs_BlockNum newBlock;
 	UBOOL succRecover;			// U_TRUE: recover successful, erase old block,
 								// U_FALSE: fail to recover, erase new block
 	int flash_op_new;			// flash operation (write) result for new block
 	int flash_op_old;			// flash operation (read) result for old block
 	u16 data_sum = 0xFFFF;
+#ifdef CONFIG_UFFS_TRACE
+	u32 trace_start;
+	u16 dirty_count = dev->buf.dirtyGroup[slot].count;
+#endif
 
 	UBOOL useCloneBuf;
 
+	UFFS_TRACE_START(trace_start);
+
 	type = dev->buf.dirtyGroup[slot].dirty->type;
 	parent = dev->buf.dirtyGroup[slot].dirty->parent;
 	serial = dev->buf.dirtyGroup[slot].dirty->serial;
@@ -663,7 +813,7 @@ retry:
 	flash_op_old = UFFS_FLASH_NO_ERR;
 	succRecover = U_FALSE;
 
-	newNode = uffs_TreeGetErasedNode(dev);
+	newNode = uffs_TreeGetErasedNodeFor(dev, (type == UFFS_TYPE_DATA ? parent : serial));
 	if (newNode == NULL) {
 		uffs_Perror(UFFS_MSG_NOISY, "no enough erased block!");
 		goto ext;
@@ -711,7 +861,7 @@ retry:
 			if (i == 0)
 				data_sum = _GetDirOrFileNameSum(dev, buf);
 
-			TAG_DATA_LEN(tag) = buf->data_len;
+			TAG_SET_DATA_LEN(tag, buf->data_len);
 
 			if (buf->data_len == 0 || (buf->ext_mark & UFFS_BUF_EXT_MARK_TRUNC_TAIL)) { // this only happen when truncating a file
 
@@ -804,7 +954,7 @@ retry:
 				// this could be some error on flash ? we can't do more about it for now ...
 			}
 
-			TAG_DATA_LEN(tag) = buf->data_len;
+			TAG_SET_DATA_LEN(tag, buf->data_len);
 
 			if (i == 0)
 				data_sum = _GetDirOrFileNameSum(dev, buf);
@@ -923,11 +1073,14 @@ retry:
 		else {
 			// Only erase the 'to be recovered block' when it's not empty.
 			// When flush buffers to a new created block, we passe an empty 'node' and we don't need to erase it in that case.
-			if (uffs_IsThisBlockUsed(dev, bc)) {
-				// erase recovered block
-				uffs_TreeEraseNode(dev, newNode);
+			if (uffs_IsThisBlockUsed(dev, bc) &&
+				uffs_TreeEraseNode(dev, newNode) != U_SUCC) {	// erase recovered block
+				uffs_TreeInsertToErasedListTail(dev, newNode);
+			}
+			else {
+				// block is clean now, give it back to the file's reserved blocks if it has.
+				uffs_TreePutErasedNodeFor(dev, (type == UFFS_TYPE_DATA ? parent : serial), newNode);
 			}
-			uffs_TreeInsertToErasedListTail(dev, newNode);
 		}
 	}
 	else {
@@ -951,6 +1104,9 @@ retry:
 	uffs_BlockInfoPut(dev, newBc);
 
 ext:
+	UFFS_TRACE(dev, UFFS_TRACE_EV_BLOCK_RECOVER, bc->block, dirty_count, serial, type,
+				(succRecover == U_TRUE ? U_SUCC : U_FAIL), trace_start);
+
 	return (succRecover == U_TRUE ? U_SUCC : U_FAIL);
 
 }
@@ -965,7 +1121,11 @@ ext:
  *		2. write pages in dirty list to new block, sorted by page_id
  *		3. insert new block to tree
  */
-static URET _BufFlush_NewBlock(uffs_Device *dev, int slot)
+/**
+ * flush dirty group to a new (erased) block.
+ * \param[out] block the block written to, UFFS_INVALID_BLOCK if no block available
+ */
+static URET _BufFlush_NewBlock(uffs_Device *dev, int slot, int *block)
 {
 	u8 type;
 	TreeNode *node;
@@ -973,8 +1133,14 @@ static URET _BufFlush_NewBlock(uffs_Device *dev, int slot)
 	URET ret;
 
 	ret = U_FAIL;
+	*block = UFFS_INVALID_BLOCK;
 
-	node = uffs_TreeGetErasedNode(dev);
+	type = dev->buf.dirtyGroup[slot].dirty->type;
+
+	// use the block reserved for this file if any
+	node = uffs_TreeGetErasedNodeFor(dev, (type == UFFS_TYPE_DATA ?
+											dev->buf.dirtyGroup[slot].dirty->parent :
+											dev->buf.dirtyGroup[slot].dirty->serial));
 	if (node == NULL) {
 		uffs_Perror(UFFS_MSG_NOISY, "no erased block!");
 		goto ext;
@@ -985,8 +1151,7 @@ static URET _BufFlush_NewBlock(uffs_Device *dev, int slot)
 		uffs_InsertToErasedListHead(dev, node); //put node back to erased list
 		goto ext;
 	}
-
-	type = dev->buf.dirtyGroup[slot].dirty->type;
+	*block = bc->block;
 	
 	ret = uffs_BufFlush_Exist_With_BlockRecover(dev, slot, node, bc, U_FALSE);
 
@@ -1055,7 +1220,7 @@ URET
 		TAG_DIRTY_BIT(tag) = TAG_DIRTY;
 		TAG_VALID_BIT(tag) = TAG_VALID;
 		TAG_BLOCK_TS(tag) = uffs_GetBlockTimeStamp(dev, bc);
-		TAG_DATA_LEN(tag) = buf->data_len;
+		TAG_SET_DATA_LEN(tag, buf->data_len);
 		TAG_TYPE(tag) = buf->type;
 		TAG_PARENT(tag) = buf->parent;
 		TAG_SERIAL(tag) = buf->serial;
@@ -1094,6 +1259,55 @@ ext:
 	return ret;
 }
 
+#ifdef CONFIG_UFFS_SMALL_FILE_PACK
+/** can the dirty pages of a new file go to pack block ? */
+static UBOOL _BufCanFlushToPack(uffs_Device *dev, int slot)
+{
+	uffs_Buf *dirty;
+
+	if (!uffs_PackCanAddFile(dev))
+		return U_FALSE;
+
+	for (dirty = dev->buf.dirtyGroup[slot].dirty; dirty; dirty = dirty->next_dirty) {
+		if (dirty->page_id > 1 || (dirty->page_id == 1 && !FIT_IN_PACK(dev, dirty->data_len)))
+			return U_FALSE;
+	}
+
+	return U_TRUE;
+}
+
+/** 
+ * \brief flush buffer of small file to pack block
+ * \param[in] node file node, NULL for a new file
+ */
+static URET _BufFlush_Pack(uffs_Device *dev, int slot, TreeNode *node)
+{
+	uffs_Buf *dirty = dev->buf.dirtyGroup[slot].dirty;
+	uffs_Buf *info, *data;
+	URET ret;
+
+	info = _FindBufInDirtyList(dirty, 0);
+	data = _FindBufInDirtyList(dirty, 1);
+
+	if (dev->buf.dirtyGroup[slot].count != (info ? 1 : 0) + (data ? 1 : 0)) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "packed file %d has dirty page beyond page_id 1 ?", dirty->serial);
+		return U_FAIL;
+	}
+
+	ret = uffs_PackWriteFile(dev, node, dirty->parent, dirty->serial, info, data);
+	if (ret == U_SUCC) {
+		while ((dirty = dev->buf.dirtyGroup[slot].dirty) != NULL) {
+			if (_BreakFromDirty(dev, dirty) != U_SUCC)
+				return U_FAIL;
+			dirty->mark = UFFS_BUF_VALID;
+			dirty->ext_mark &= ~UFFS_BUF_EXT_MARK_TRUNC_TAIL;
+			_MoveNodeToHead(dev, dirty);
+		}
+	}
+
+	return ret;
+}
+#endif
 
 URET _BufFlush(struct uffs_DeviceSt *dev,
 			   UBOOL force_block_recover, int slot)
@@ -1107,11 +1321,17 @@ URET _BufFlush(struct uffs_DeviceSt *dev,
 	u16 parent;
 	u16 serial;
 	int block;
+#ifdef CONFIG_UFFS_TRACE
+	u32 trace_start;
+	u16 dirty_count = dev->buf.dirtyGroup[slot].count;
+#endif
 	
 	if (dev->buf.dirtyGroup[slot].count == 0) {
 		return U_SUCC;
 	}
 
+	UFFS_TRACE_START(trace_start);
+
 	dirty = dev->buf.dirtyGroup[slot].dirty;
 
 	if (_CheckDirtyList(dirty) == U_FAIL)
@@ -1136,9 +1356,19 @@ URET _BufFlush(struct uffs_DeviceSt *dev,
 		return U_FAIL;
 	}
 
+#ifdef CONFIG_UFFS_SMALL_FILE_PACK
+	if (type == UFFS_TYPE_FILE &&
+		(node ? IS_PACKED_FILE(dev, serial) : _BufCanFlushToPack(dev, slot))) {
+		block = (node ? node->u.file.block : UFFS_INVALID_BLOCK);
+		ret = _BufFlush_Pack(dev, slot, node);
+		UFFS_TRACE(dev, UFFS_TRACE_EV_BUF_FLUSH, block, dirty_count, serial, type, ret, trace_start);
+		return ret;
+	}
+#endif
+
 	if (node == NULL) {
 		//not found in the tree, need to generate a new block
-		ret = _BufFlush_NewBlock(dev, slot);
+		ret = _BufFlush_NewBlock(dev, slot, &block);
 	}
 	else {
 		switch (type) {
@@ -1177,6 +1407,8 @@ URET _BufFlush(struct uffs_DeviceSt *dev,
 		uffs_BlockInfoPut(dev, bc);
 	}
 
+	UFFS_TRACE(dev, UFFS_TRACE_EV_BUF_FLUSH, block, dirty_count, serial, type, ret, trace_start);
+
 	return ret;
 }
 
@@ -1412,7 +1644,8 @@ uffs_Buf * uffs_BufGet(struct uffs_DeviceSt *dev,
 
 	if (p) {
 		p->ref_count++;
-		_MoveNodeToHead(dev, p);
+		dev->st.page_buf_hit++;
+		_BufTouch(dev, p);
 	}
 
 	return p;
@@ -1436,7 +1669,6 @@ uffs_Buf *uffs_BufNew(struct uffs_DeviceSt *dev,
 		else {
 			buf->data_len = 0;
 		}
-		_MoveNodeToHead(dev, buf);
 		return buf;
 	}
 
@@ -1459,7 +1691,7 @@ uffs_Buf *uffs_BufNew(struct uffs_DeviceSt *dev,
 	buf->ref_count++;
 	memset(buf->data, 0xff, dev->com.pg_data_size);
 
-	_MoveNodeToHead(dev, buf);
+	_BufFill(dev, buf);
 	
 	return buf;	
 }
@@ -1481,7 +1713,8 @@ uffs_Buf *uffs_BufGetEx(struct uffs_DeviceSt *dev,
 						u8 type, TreeNode *node, u16 page_id, int oflag)
 {
 	uffs_Buf *buf;
-	u16 parent, serial, block, page;
+	u16 parent, serial, page;
+	uffs_BlockNum block;
 	uffs_BlockInfo *bc;
 	int ret, pending_type;
 
@@ -1509,6 +1742,8 @@ uffs_Buf *uffs_BufGetEx(struct uffs_DeviceSt *dev,
 	buf = uffs_BufFindPage(dev, parent, serial, page_id);
 	if (buf) {
 		buf->ref_count++;
+		dev->st.page_buf_hit++;
+		_BufTouch(dev, buf);
 		return buf;
 	}
 
@@ -1541,6 +1776,26 @@ uffs_Buf *uffs_BufGetEx(struct uffs_DeviceSt *dev,
 		}
 	}
 
+#ifdef CONFIG_UFFS_SMALL_FILE_PACK
+	if (type == UFFS_TYPE_FILE && IS_PACKED_FILE(dev, serial)) {
+		buf->mark = UFFS_BUF_EMPTY;
+		buf->type = type;
+		buf->parent = parent;
+		buf->serial = serial;
+		buf->page_id = page_id;
+
+		if (uffs_PackLoadBuf(dev, block, buf) != U_SUCC)
+			return NULL;
+
+		buf->mark = UFFS_BUF_VALID;
+		buf->ref_count++;
+		dev->st.page_buf_miss++;
+		_BufFill(dev, buf);
+
+		return buf;
+	}
+#endif
+
 	bc = uffs_BlockInfoGet(dev, block);
 	if (bc == NULL) {
 		uffs_Perror(UFFS_MSG_SERIOUS, "Can't get block info!");
@@ -1584,8 +1839,9 @@ uffs_Buf *uffs_BufGetEx(struct uffs_DeviceSt *dev,
 	buf->data_len = TAG_DATA_LEN(GET_TAG(bc, page));
 	buf->mark = UFFS_BUF_VALID;
 	buf->ref_count++;
+	dev->st.page_buf_miss++;
 
-	_MoveNodeToHead(dev, buf);
+	_BufFill(dev, buf);
 	
 	return buf;
 
@@ -1721,6 +1977,9 @@ URET uffs_BufSetAllEmpty(struct uffs_DeviceSt *dev)
 		buf->mark = UFFS_BUF_EMPTY;
 		buf = buf->next;
 	}
+#ifdef CONFIG_UFFS_BUF_2Q
+	_ClearGhost(dev);
+#endif
 	return U_SUCC;
 }
 
@@ -80,6 +80,11 @@ URET uffs_InitDebugMessageOutput(struct uffs_DebugMsgOutputSt *ops, int msg_leve
 	return U_SUCC;
 }
 
+/**
+ * \brief set runtime message level
+ * \note messages below #CONFIG_UFFS_MIN_MSG_LEVEL are not compiled in,
+ *		 lowering the runtime level won't bring them back.
+ */
 void uffs_DebugSetMessageLevel(int msg_level)
 {
 	m_msg_level = msg_level;
@@ -147,7 +152,7 @@ void uffs_AssertCall(const char *file, int line, const char *msg, ...)
 void uffs_Perror(int level, const char *fmt, ...)
 {
 	va_list args;
-	if (m_ops && level >= m_msg_level) {
+	if (m_ops && level >= m_msg_level && level >= UFFS_MIN_MSG_LEVEL) {
 		va_start(args, fmt);
 		m_ops->vprintf(fmt, args);
 		va_end(args);
@@ -158,7 +163,7 @@ void uffs_Perror(int level, const char *fmt, ...)
 void uffs_PerrorRaw(int level, const char *fmt, ...)
 {
 	va_list args;
-	if (m_ops && level >= m_msg_level) {
+	if (m_ops && level >= m_msg_level && level >= UFFS_MIN_MSG_LEVEL) {
 		va_start(args, fmt);
 		m_ops->vprintf(fmt, args);
 		va_end(args);
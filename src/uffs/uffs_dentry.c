@@ -0,0 +1,337 @@
+/*
+  This file is part of UFFS, the Ultra-low-cost Flash File System.
+  
+  Copyright (C) 2005-2009 Ricky Zheng <ricky_gz_zheng@yahoo.co.nz>
+
+  UFFS is free software; you can redistribute it and/or modify it under
+  the GNU Library General Public License as published by the Free Software 
+  Foundation; either version 2 of the License, or (at your option) any
+  later version.
+
+  UFFS is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+  or GNU Library General Public License, as applicable, for more details.
+ 
+  You should have received a copy of the GNU General Public License
+  and GNU Library General Public License along with UFFS; if not, write
+  to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA  02110-1301, USA.
+
+  As a special exception, if other files instantiate templates or use
+  macros or inline functions from this file, or you compile this file
+  and link it with other works to produce a work based on this file,
+  this file does not by itself cause the resulting work to be covered
+  by the GNU General Public License. However the source code for this
+  file must still be made available in accordance with section (3) of
+  the GNU General Public License v2.
+ 
+  This exception does not invalidate any other reasons why a work based
+  on this file might be covered by the GNU General Public License.
+*/
+
+
+/**
+ * \file uffs_dentry.c
+ * \brief path component lookup cache (dentry cache)
+ * \author Ricky Zheng
+ */
+
+#include "uffs_config.h"
+#include "uffs/uffs_public.h"
+#include "uffs/uffs_device.h"
+#include "uffs/uffs_dentry.h"
+#include <string.h>
+
+#define PFX "dent: "
+
+#ifdef CONFIG_UFFS_DENTRY_CACHE
+
+/** take entry out of LRU list */
+static void _Unlink(struct uffs_DentryCacheSt *dc, uffs_DentryEntry *e)
+{
+	if (e->prev)
+		e->prev->next = e->next;
+	else
+		dc->head = e->next;
+
+	if (e->next)
+		e->next->prev = e->prev;
+	else
+		dc->tail = e->prev;
+}
+
+/** put entry to the head (most recently used) of LRU list */
+static void _MoveToHead(struct uffs_DentryCacheSt *dc, uffs_DentryEntry *e)
+{
+	if (dc->head == e)
+		return;
+
+	_Unlink(dc, e);
+	e->prev = NULL;
+	e->next = dc->head;
+	if (dc->head)
+		dc->head->prev = e;
+	dc->head = e;
+	if (dc->tail == NULL)
+		dc->tail = e;
+}
+
+/** put entry to the tail (reused first) of LRU list */
+static void _MoveToTail(struct uffs_DentryCacheSt *dc, uffs_DentryEntry *e)
+{
+	if (dc->tail == e)
+		return;
+
+	_Unlink(dc, e);
+	e->next = NULL;
+	e->prev = dc->tail;
+	if (dc->tail)
+		dc->tail->next = e;
+	dc->tail = e;
+	if (dc->head == NULL)
+		dc->head = e;
+}
+
+/** take entry out of hash bucket and put it to LRU tail as a free entry */
+static void _Free(struct uffs_DentryCacheSt *dc, uffs_DentryEntry *e)
+{
+	uffs_DentryEntry **pp;
+
+	for (pp = &dc->hash[UFFS_DENTRY_HASH(e->parent, e->sum)]; *pp; pp = &(*pp)->hash_next) {
+		if (*pp == e) {
+			*pp = e->hash_next;
+			break;
+		}
+	}
+
+	e->hash_next = NULL;
+	e->name_len = 0;
+	e->type = UFFS_TYPE_INVALID;
+	e->absent = 0;
+	_MoveToTail(dc, e);
+}
+
+static uffs_DentryEntry * _Find(struct uffs_DentryCacheSt *dc,
+								u16 parent, const char *name, int len, u16 sum)
+{
+	uffs_DentryEntry *e;
+
+	for (e = dc->hash[UFFS_DENTRY_HASH(parent, sum)]; e; e = e->hash_next) {
+		if (e->parent == parent && e->sum == sum && e->name_len == len &&
+			memcmp(e->name, name, len) == 0)
+			return e;
+	}
+
+	return NULL;
+}
+
+/** get the entry for name, reuse the least recently used one if not exist */
+static uffs_DentryEntry * _Get(struct uffs_DentryCacheSt *dc,
+								u16 parent, const char *name, int len, u16 sum)
+{
+	uffs_DentryEntry *e;
+
+	e = _Find(dc, parent, name, len, sum);
+	if (e == NULL) {
+		e = dc->tail;
+		if (e == NULL)
+			return NULL;
+		if (e->name_len > 0)
+			_Free(dc, e);
+		e->parent = parent;
+		e->sum = sum;
+		e->name_len = (u8)len;
+		memcpy(e->name, name, len);
+		e->hash_next = dc->hash[UFFS_DENTRY_HASH(parent, sum)];
+		dc->hash[UFFS_DENTRY_HASH(parent, sum)] = e;
+	}
+	_MoveToHead(dc, e);
+
+	return e;
+}
+
+/**
+ * \brief initialize dentry cache
+ * \param[in] dev uffs device
+ * \return U_SUCC or U_FAIL
+ */
+URET uffs_DentryCacheInit(uffs_Device *dev)
+{
+	int size = sizeof(uffs_DentryEntry) * UFFS_DENTRY_CACHE_ENTRIES;
+	uffs_DentryEntry *entries;
+	int i;
+
+	if (dev->mem.dentry_cache_pool_size == 0 && dev->mem.malloc) {
+		dev->mem.dentry_cache_pool_buf = dev->mem.malloc(dev, size);
+		if (dev->mem.dentry_cache_pool_buf)
+			dev->mem.dentry_cache_pool_size = size;
+	}
+	if (dev->mem.dentry_cache_pool_size < size) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "dentry cache require %d but only %d available.",
+					size, dev->mem.dentry_cache_pool_size);
+		return U_FAIL;
+	}
+
+	memset(&(dev->dentry_cache), 0, sizeof(struct uffs_DentryCacheSt));
+	entries = (uffs_DentryEntry *)dev->mem.dentry_cache_pool_buf;
+	for (i = 0; i < UFFS_DENTRY_CACHE_ENTRIES; i++) {
+		entries[i].hash_next = NULL;
+		entries[i].name_len = 0;
+		entries[i].type = UFFS_TYPE_INVALID;
+		entries[i].absent = 0;
+		entries[i].prev = (i > 0 ? &entries[i - 1] : NULL);
+		entries[i].next = (i < UFFS_DENTRY_CACHE_ENTRIES - 1 ? &entries[i + 1] : NULL);
+	}
+	dev->dentry_cache.head = &entries[0];
+	dev->dentry_cache.tail = &entries[UFFS_DENTRY_CACHE_ENTRIES - 1];
+
+	return U_SUCC;
+}
+
+/**
+ * \brief release dentry cache memory
+ * \param[in] dev uffs device
+ */
+void uffs_DentryCacheRelease(uffs_Device *dev)
+{
+	if (dev->mem.dentry_cache_pool_buf && dev->mem.free) {
+		dev->mem.free(dev, dev->mem.dentry_cache_pool_buf);
+		dev->mem.dentry_cache_pool_buf = NULL;
+		dev->mem.dentry_cache_pool_size = 0;
+	}
+	memset(&(dev->dentry_cache), 0, sizeof(struct uffs_DentryCacheSt));
+}
+
+/**
+ * \brief drop all entries, e.g. after device is formatted
+ * \param[in] dev uffs device
+ */
+void uffs_DentryCacheClear(uffs_Device *dev)
+{
+	struct uffs_DentryCacheSt *dc = &dev->dentry_cache;
+	uffs_DentryEntry *e;
+	int i;
+
+	for (e = dc->head; e != NULL; e = e->next) {
+		e->hash_next = NULL;
+		e->name_len = 0;
+		e->type = UFFS_TYPE_INVALID;
+		e->absent = 0;
+	}
+	for (i = 0; i < UFFS_DENTRY_HASH_SIZE; i++)
+		dc->hash[i] = NULL;
+}
+
+/**
+ * \brief lookup name under parent dir
+ * \param[in] dev uffs device
+ * \param[in] parent parent dir serial
+ * \param[in] name object name (not null terminated)
+ * \param[in] len name length
+ * \param[in] sum name sum
+ * \param[in] type UFFS_TYPE_DIR or UFFS_TYPE_FILE
+ * \param[out] serial serial of the object if #UFFS_DENTRY_HIT
+ * \return #UFFS_DENTRY_HIT, #UFFS_DENTRY_NEGATIVE or #UFFS_DENTRY_MISS
+ * \note caller should hold the device lock.
+ */
+int uffs_DentryCacheLookup(uffs_Device *dev, u16 parent, const char *name,
+							int len, u16 sum, int type, u16 *serial)
+{
+	struct uffs_DentryCacheSt *dc = &dev->dentry_cache;
+	uffs_DentryEntry *e;
+
+	e = _Find(dc, parent, name, len, sum);
+	if (e) {
+		if (e->type == type) {
+			dc->hit++;
+			_MoveToHead(dc, e);
+			*serial = e->serial;
+			return UFFS_DENTRY_HIT;
+		}
+		// dir and file can't have the same name
+		if (e->type != UFFS_TYPE_INVALID || (e->absent & (1 << type))) {
+			dc->hit++;
+			_MoveToHead(dc, e);
+			return UFFS_DENTRY_NEGATIVE;
+		}
+	}
+	dc->miss++;
+
+	return UFFS_DENTRY_MISS;
+}
+
+/**
+ * \brief name under parent is found or created
+ * \param[in] dev uffs device
+ * \param[in] parent parent dir serial
+ * \param[in] name object name (not null terminated)
+ * \param[in] len name length
+ * \param[in] sum name sum
+ * \param[in] type UFFS_TYPE_DIR or UFFS_TYPE_FILE
+ * \param[in] serial serial of the object
+ */
+void uffs_DentryCacheAdd(uffs_Device *dev, u16 parent, const char *name,
+							int len, u16 sum, int type, u16 serial)
+{
+	uffs_DentryEntry *e;
+
+	if (len <= 0 || len > UFFS_DENTRY_NAME_MAX)
+		return;
+
+	e = _Get(&dev->dentry_cache, parent, name, len, sum);
+	if (e) {
+		e->type = (u8)type;
+		e->serial = serial;
+		e->absent = 0;
+	}
+}
+
+/**
+ * \brief name under parent is not found as given type
+ * \param[in] dev uffs device
+ * \param[in] parent parent dir serial
+ * \param[in] name object name (not null terminated)
+ * \param[in] len name length
+ * \param[in] sum name sum
+ * \param[in] type UFFS_TYPE_DIR or UFFS_TYPE_FILE
+ */
+void uffs_DentryCacheAddNegative(uffs_Device *dev, u16 parent, const char *name,
+							int len, u16 sum, int type)
+{
+	uffs_DentryEntry *e;
+
+	if (len <= 0 || len > UFFS_DENTRY_NAME_MAX)
+		return;
+
+	e = _Get(&dev->dentry_cache, parent, name, len, sum);
+	if (e) {
+		if (e->type != UFFS_TYPE_INVALID) {
+			e->type = UFFS_TYPE_INVALID;
+			e->absent = 0;
+		}
+		e->absent |= (1 << type);
+	}
+}
+
+/**
+ * \brief object is deleted or renamed, drop entries
+ *			of the object and entries under it (if it's a dir).
+ * \param[in] dev uffs device
+ * \param[in] serial serial of the object
+ */
+void uffs_DentryCacheDrop(uffs_Device *dev, u16 serial)
+{
+	struct uffs_DentryCacheSt *dc = &dev->dentry_cache;
+	uffs_DentryEntry *e, *next;
+
+	// free entries are at the tail, stop at the first one.
+	for (e = dc->head; e != NULL && e->name_len > 0; e = next) {
+		next = e->next;
+		if (e->parent == serial ||
+			(e->type != UFFS_TYPE_INVALID && e->serial == serial))
+			_Free(dc, e);
+	}
+}
+
+#endif
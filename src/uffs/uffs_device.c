@@ -60,6 +60,17 @@ void uffs_DeviceReleaseLock(uffs_Device *dev)
 
 void uffs_DeviceLock(uffs_Device *dev)
 {
+	int task_id = uffs_OSGetTaskId();
+
+	// best-effort diagnostic: task_id is read without the lock (we'd block
+	// on it if we are the owner), so another task's lock/unlock may race
+	// with it. Our own id is only written by ourselves, so a stale value
+	// can only make it miss the dead lock, never affects locking itself.
+	if (dev->lock.task_id == task_id) {
+		uffs_Perror(UFFS_MSG_SERIOUS,
+					"Task %d lock device again, dead lock !", task_id);
+	}
+
 	uffs_SemWait(dev->lock.sem);
 	
 	if (dev->lock.counter != 0) {
@@ -68,10 +79,12 @@ void uffs_DeviceLock(uffs_Device *dev)
 	}
 
 	dev->lock.counter++;
+	dev->lock.task_id = task_id;
 }
 
 void uffs_DeviceUnLock(uffs_Device *dev)
 {
+	dev->lock.task_id = UFFS_TASK_ID_NOT_EXIST;
 	dev->lock.counter--;
 
 	if (dev->lock.counter != 0) {
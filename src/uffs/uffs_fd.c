@@ -45,6 +45,7 @@
 #include "uffs/uffs_mtb.h"
 #include "uffs/uffs_public.h"
 #include "uffs/uffs_find.h"
+#include "uffs/uffs_badblock.h"
 
 #define PFX "fd  : "
 
@@ -91,8 +92,8 @@ struct uffs_dirSt {
 		fd = fd & ((1 << FD_SIGNATURE_SHIFT) - 1); \
 		obj = (uffs_Object *)uffs_PoolGetBufByIndex(uffs_GetObjectPool(), fd); \
 		if ((obj) == NULL || \
-				uffs_PoolVerify(uffs_GetObjectPool(), (obj)) == U_FALSE || \
-				uffs_PoolCheckFreeList(uffs_GetObjectPool(), (obj)) == U_TRUE) { \
+				uffs_PoolCheckFreeList(uffs_GetObjectPool(), (obj)) == U_TRUE || \
+				(obj)->open_succ != U_TRUE) { \
 			uffs_set_error(-UEBADF); \
 			uffs_Perror(UFFS_MSG_NOISY, "invalid obj"); \
 			uffs_GlobalFsLockUnlock(); \
@@ -144,8 +145,11 @@ struct uffs_dirSt {
 
 
 static int _dir_pool_data[sizeof(uffs_DIR) * MAX_DIR_HANDLE / sizeof(int)];
+static u32 _dir_pool_map[UFFS_POOL_MAP_SIZE(MAX_DIR_HANDLE)];
 static uffs_Pool _dir_pool;
+#ifndef CONFIG_UFFS_PER_TASK_ERRNO
 static int _uffs_errno = 0;
+#endif
 
 
 //
@@ -171,9 +175,12 @@ void uffs_FdSignatureIncrease(void)
  */
 URET uffs_DirEntryBufInit(void)
 {
-	return uffs_PoolInit(&_dir_pool, _dir_pool_data,
+	if (uffs_PoolInit(&_dir_pool, _dir_pool_data,
 							sizeof(_dir_pool_data),
-							sizeof(uffs_DIR), MAX_DIR_HANDLE, U_FALSE);
+							sizeof(uffs_DIR), MAX_DIR_HANDLE, UFFS_HANDLE_POOL_LOCK) == U_FAIL)
+		return U_FAIL;
+
+	return uffs_PoolSetAllocMap(&_dir_pool, _dir_pool_map, sizeof(_dir_pool_map));
 }
 
 /**
@@ -181,6 +188,9 @@ URET uffs_DirEntryBufInit(void)
  */
 URET uffs_DirEntryBufRelease(void)
 {
+#ifdef CONFIG_UFFS_GROWABLE_HANDLES
+	uffs_PoolReleaseGrown(&_dir_pool);
+#endif
 	return uffs_PoolRelease(&_dir_pool);
 }
 
@@ -196,7 +206,7 @@ int uffs_DirEntryBufPutAll(uffs_Device *dev)
 		dirp = (uffs_DIR *) uffs_PoolFindNextAllocated(&_dir_pool, dirp);
 		if (dirp && dirp->obj && dirp->obj->dev &&
 				dirp->obj->dev->dev_num == dev->dev_num) {
-			uffs_PoolPut(&_dir_pool, dirp);
+			uffs_HandlePoolPut(&_dir_pool, dirp);
 			count++;
 		}
 	} while (dirp);
@@ -212,7 +222,11 @@ uffs_Pool * uffs_DirEntryBufGetPool(void)
 
 static uffs_DIR * GetDirEntry(void)
 {
-	uffs_DIR *dirp = (uffs_DIR *) uffs_PoolGet(&_dir_pool);
+#ifdef CONFIG_UFFS_GROWABLE_HANDLES
+	uffs_DIR *dirp = (uffs_DIR *) uffs_PoolGetGrow(&_dir_pool, MAX_DIR_HANDLE_LIMIT);
+#else
+	uffs_DIR *dirp = (uffs_DIR *) uffs_HandlePoolGet(&_dir_pool);
+#endif
 
 	if (dirp)
 		memset(dirp, 0, sizeof(uffs_DIR));
@@ -222,9 +236,27 @@ static uffs_DIR * GetDirEntry(void)
 
 static void PutDirEntry(uffs_DIR *p)
 {
-	uffs_PoolPut(&_dir_pool, p);
+	uffs_HandlePoolPut(&_dir_pool, p);
+}
+
+
+#ifdef CONFIG_UFFS_PER_TASK_ERRNO
+
+/** get errno of current task
+ */
+int uffs_get_error(void)
+{
+	return *uffs_OSGetTaskErrno();
+}
+
+/** set errno of current task
+ */
+int uffs_set_error(int err)
+{
+	return (*uffs_OSGetTaskErrno() = err);
 }
 
+#else
 
 /** get global errno
  */
@@ -240,6 +272,8 @@ int uffs_set_error(int err)
 	return (_uffs_errno = err);
 }
 
+#endif
+
 /* POSIX compliant file system APIs */
 
 int uffs_open(const char *name, int oflag, ...)
@@ -321,7 +355,7 @@ int uffs_openindir(const char *name, uffs_DIR* dir, int oflag)
 	}
 	else {
 		
-		dir->obj->dev->ref_count++;
+		uffs_GetDevice(dir->obj->dev);
 		if (uffs_OpenObjectEx(obj, dir->obj->dev, dir->f.serial, name, strlen(name), oflag) == U_FAIL) {			
 			int openError = uffs_GetObjectErr(obj);
 
@@ -393,6 +427,177 @@ int uffs_write(int fd, const void *data, int len)
 	return ret;
 }
 
+/**
+ * read from #offset of the file, file pointer is not changed.
+ */
+int uffs_pread(int fd, void *data, int len, long offset)
+{
+	int ret;
+	uffs_Object *obj;
+
+	if (offset < 0) {
+		uffs_set_error(-UEINVAL);
+		return -1;
+	}
+
+	CHK_OBJ_LOCK(fd, obj, -1);
+	uffs_ClearObjectErr(obj);
+	ret = uffs_ReadObjectAt(obj, (u32)offset, data, len);
+	uffs_set_error(-uffs_GetObjectErr(obj));
+
+	uffs_GlobalFsLockUnlock();
+
+	return ret;
+}
+
+/**
+ * write to #offset of the file, file pointer is not changed.
+ * \note if the file is opened with #UO_APPEND, data is appended to the end of file.
+ */
+int uffs_pwrite(int fd, const void *data, int len, long offset)
+{
+	int ret;
+	uffs_Object *obj;
+
+	if (offset < 0) {
+		uffs_set_error(-UEINVAL);
+		return -1;
+	}
+
+	CHK_OBJ_LOCK(fd, obj, -1);
+	uffs_ClearObjectErr(obj);
+	ret = uffs_WriteObjectAt(obj, (u32)offset, data, len);
+	uffs_set_error(-uffs_GetObjectErr(obj));
+
+	uffs_GlobalFsLockUnlock();
+
+	return ret;
+}
+
+/**
+ * read into #iovcnt segments from current file pointer,
+ * all segments are filled under one lock.
+ */
+int uffs_readv(int fd, const struct uffs_iovec *iov, int iovcnt)
+{
+	int ret;
+	uffs_Object *obj;
+
+	if (iov == NULL || iovcnt < 0) {
+		uffs_set_error(-UEINVAL);
+		return -1;
+	}
+
+	CHK_OBJ_LOCK(fd, obj, -1);
+	uffs_ClearObjectErr(obj);
+	ret = uffs_ReadObjectV(obj, iov, iovcnt);
+	uffs_set_error(-uffs_GetObjectErr(obj));
+
+	uffs_GlobalFsLockUnlock();
+
+	return ret;
+}
+
+/**
+ * write #iovcnt segments to current file pointer,
+ * all segments are written under one lock.
+ */
+int uffs_writev(int fd, const struct uffs_iovec *iov, int iovcnt)
+{
+	int ret;
+	uffs_Object *obj;
+
+	if (iov == NULL || iovcnt < 0) {
+		uffs_set_error(-UEINVAL);
+		return -1;
+	}
+
+	CHK_OBJ_LOCK(fd, obj, -1);
+	uffs_ClearObjectErr(obj);
+	ret = uffs_WriteObjectV(obj, iov, iovcnt);
+	uffs_set_error(-uffs_GetObjectErr(obj));
+
+	uffs_GlobalFsLockUnlock();
+
+	return ret;
+}
+
+/**
+ * read #iovcnt segments from #offset of the file under one lock,
+ * file pointer is not changed.
+ */
+int uffs_preadv(int fd, const struct uffs_iovec *iov, int iovcnt, long offset)
+{
+	int ret;
+	uffs_Object *obj;
+
+	if (iov == NULL || iovcnt < 0 || offset < 0) {
+		uffs_set_error(-UEINVAL);
+		return -1;
+	}
+
+	CHK_OBJ_LOCK(fd, obj, -1);
+	uffs_ClearObjectErr(obj);
+	ret = uffs_ReadObjectAtV(obj, (u32)offset, iov, iovcnt);
+	uffs_set_error(-uffs_GetObjectErr(obj));
+
+	uffs_GlobalFsLockUnlock();
+
+	return ret;
+}
+
+/**
+ * write #iovcnt segments to #offset of the file under one lock,
+ * file pointer is not changed.
+ * \note if the file is opened with #UO_APPEND, data is appended to the end of file.
+ */
+int uffs_pwritev(int fd, const struct uffs_iovec *iov, int iovcnt, long offset)
+{
+	int ret;
+	uffs_Object *obj;
+
+	if (iov == NULL || iovcnt < 0 || offset < 0) {
+		uffs_set_error(-UEINVAL);
+		return -1;
+	}
+
+	CHK_OBJ_LOCK(fd, obj, -1);
+	uffs_ClearObjectErr(obj);
+	ret = uffs_WriteObjectAtV(obj, (u32)offset, iov, iovcnt);
+	uffs_set_error(-uffs_GetObjectErr(obj));
+
+	uffs_GlobalFsLockUnlock();
+
+	return ret;
+}
+
+/**
+ * reserve erased blocks for appending #len bytes to the file,
+ * so that later writes don't spend time on picking/checking erased blocks.
+ * Unused reserved blocks are returned when the file is closed.
+ *
+ * \return 0 if succ, -1 if fail (not enough erased blocks, error code UENOMEM).
+ */
+int uffs_fallocate(int fd, long len)
+{
+	int ret;
+	uffs_Object *obj;
+
+	if (len < 0) {
+		uffs_set_error(-UEINVAL);
+		return -1;
+	}
+
+	CHK_OBJ_LOCK(fd, obj, -1);
+	uffs_ClearObjectErr(obj);
+	ret = (uffs_PreallocObject(obj, (u32)len) == U_SUCC ? 0 : -1);
+	uffs_set_error(-uffs_GetObjectErr(obj));
+
+	uffs_GlobalFsLockUnlock();
+
+	return ret;
+}
+
 long uffs_seek(int fd, long offset, int origin)
 {
 	int ret;
@@ -453,6 +658,25 @@ int uffs_flush(int fd)
 	return ret;
 }
 
+/**
+ * get the device where the file is on.
+ * \return device, or NULL if #fd is invalid.
+ * \note a device reference is taken while #fd can't be closed,
+ *		 caller should put it by uffs_PutDevice().
+ */
+uffs_Device * uffs_GetDeviceFromFd(int fd)
+{
+	uffs_Device *dev;
+	uffs_Object *obj;
+
+	CHK_OBJ_LOCK(fd, obj, NULL);
+	dev = obj->dev;
+	uffs_GetDevice(dev);
+	uffs_GlobalFsLockUnlock();
+
+	return dev;
+}
+
 int uffs_rename(const char *old_name, const char *new_name)
 {
 	int err = 0;
@@ -585,6 +809,25 @@ int uffs_ftruncate(int fd, long remain)
 	return ret;
 }
 
+static void fill_stat(uffs_Device *dev, uffs_ObjectInfo *info, struct uffs_stat *buf)
+{
+	buf->st_dev = dev->dev_num;
+	buf->st_ino = info->serial;
+	buf->st_nlink = 0;
+	buf->st_uid = 0;
+	buf->st_gid = 0;
+	buf->st_rdev = 0;
+	buf->st_size = info->len;
+	buf->st_blksize = dev->com.pg_data_size;
+	buf->st_blocks = 0;
+	buf->st_atime = info->info.last_modify;
+	buf->st_mtime = info->info.last_modify;
+	buf->st_ctime = info->info.create_time;
+	buf->st_mode = (info->info.attr & FILE_ATTR_DIR ? US_IFDIR : US_IFREG);
+	if (info->info.attr & FILE_ATTR_WRITE)
+		buf->st_mode |= US_IRWXU;
+}
+
 static int do_stat(uffs_Object *obj, struct uffs_stat *buf)
 {
 	uffs_ObjectInfo info;
@@ -595,21 +838,7 @@ static int do_stat(uffs_Object *obj, struct uffs_stat *buf)
 		ret = -1;
 	}
 	else {
-		buf->st_dev = obj->dev->dev_num;
-		buf->st_ino = info.serial;
-		buf->st_nlink = 0;
-		buf->st_uid = 0;
-		buf->st_gid = 0;
-		buf->st_rdev = 0;
-		buf->st_size = info.len;
-		buf->st_blksize = obj->dev->com.pg_data_size;
-		buf->st_blocks = 0;
-		buf->st_atime = info.info.last_modify;
-		buf->st_mtime = info.info.last_modify;
-		buf->st_ctime = info.info.create_time;
-		buf->st_mode = (info.info.attr & FILE_ATTR_DIR ? US_IFDIR : US_IFREG);
-		if (info.info.attr & FILE_ATTR_WRITE)
-			buf->st_mode |= US_IRWXU;
+		fill_stat(obj->dev, &info, buf);
 	}
 
 	uffs_set_error(-err);
@@ -737,6 +966,19 @@ ext:
 	return ret;
 }
 
+static void fill_dirent(uffs_ObjectInfo *info, int pos, struct uffs_dirent *ent)
+{
+	ent->d_ino = info->serial;
+	ent->d_namelen = info->info.name_len < (sizeof(ent->d_name) - 1) ? info->info.name_len : (sizeof(ent->d_name) - 1);
+	memcpy(ent->d_name, info->info.name, ent->d_namelen);
+	ent->d_name[ent->d_namelen] = '\0';
+	ent->d_off = pos;
+	ent->d_reclen = sizeof(struct uffs_dirent);
+	ent->d_type = info->info.attr;
+	ent->d_size = info->len;
+	ent->d_ctime = info->info.create_time;
+}
+
 struct uffs_dirent * uffs_readdir(uffs_DIR *dirp)
 {
 	struct uffs_dirent *ent = NULL;
@@ -745,21 +987,64 @@ struct uffs_dirent * uffs_readdir(uffs_DIR *dirp)
 
 	if (uffs_FindObjectNext(&dirp->info, &dirp->f) == U_SUCC) {
 		ent = &dirp->dirent;
-		ent->d_ino = dirp->info.serial;
-		ent->d_namelen = dirp->info.info.name_len < (sizeof(ent->d_name) - 1) ? dirp->info.info.name_len : (sizeof(ent->d_name) - 1);
-		memcpy(ent->d_name, dirp->info.info.name, ent->d_namelen);
-		ent->d_name[ent->d_namelen] = '\0';
-		ent->d_off = dirp->f.pos;
-		ent->d_reclen = sizeof(struct uffs_dirent);
-		ent->d_type = dirp->info.info.attr;
-		ent->d_size = dirp->info.len;
-		ent->d_ctime = dirp->info.info.create_time;
+		fill_dirent(&dirp->info, dirp->f.pos, ent);
 	}
 	uffs_GlobalFsLockUnlock();
 
 	return ent;
 }
 
+struct readdirplus_ctx {
+	uffs_Device *dev;
+	struct uffs_direntplus *ents;
+	int n;
+};
+
+static void readdirplus_cb(uffs_ObjectInfo *info, int pos, void *arg)
+{
+	struct readdirplus_ctx *ctx = (struct readdirplus_ctx *)arg;
+	struct uffs_direntplus *ent = &ctx->ents[ctx->n++];
+
+	fill_dirent(info, pos, &ent->d);
+	fill_stat(ctx->dev, info, &ent->st);
+}
+
+/**
+ * read up to count entries with their stat in one call.
+ * \param[in] dirp opened dir
+ * \param[out] ents entries
+ * \param[in] count size of ents
+ * \param[in] flags UFFS_READDIR_BLOCK_ORDER or 0
+ * \return number of entries, 0 if no more entries, -1 on error.
+ * \note entries whose stat can't be loaded are skipped, the error is set
+ *		 (even if other entries are returned) and the next call goes on after them.
+ */
+int uffs_readdirplus(uffs_DIR *dirp, struct uffs_direntplus *ents, int count, int flags)
+{
+	struct readdirplus_ctx ctx;
+	int ret, err;
+
+	CHK_DIR_LOCK(dirp, -1);
+
+	if (ents == NULL || count <= 0) {
+		uffs_set_error(-UEINVAL);
+		uffs_GlobalFsLockUnlock();
+		return -1;
+	}
+
+	ctx.dev = dirp->obj->dev;
+	ctx.ents = ents;
+	ctx.n = 0;
+
+	ret = uffs_FindObjectBulk(&dirp->f, &dirp->info, count,
+							  (flags & UFFS_READDIR_BLOCK_ORDER) ? U_TRUE : U_FALSE,
+							  readdirplus_cb, &ctx, &err);
+	uffs_set_error(-err);
+	uffs_GlobalFsLockUnlock();
+
+	return ret;
+}
+
 void uffs_rewinddir(uffs_DIR *dirp)
 {
 	CHK_DIR_VOID_LOCK(dirp);
@@ -934,3 +1219,28 @@ void uffs_flush_all(const char *mount_point)
 	uffs_GlobalFsLockUnlock();
 }
 
+int uffs_process_pending(const char *mount_point, int budget_ms)
+{
+	uffs_Device *dev = NULL;
+	int remain = 0;
+
+	if (uffs_GlobalFsLockLock() == UEUNINITIALIZED)	{
+		return -1;
+	}
+	dev = uffs_GetDeviceFromMountPoint(mount_point);
+	if (!dev) {
+		uffs_GlobalFsLockUnlock();
+		return -1;
+	}
+
+	uffs_DeviceLock(dev);
+	if (HAVE_BADBLOCK(dev))
+		remain = uffs_BadBlockRecoverStep(dev, budget_ms);
+	uffs_DeviceUnLock(dev);
+
+	uffs_PutDevice(dev);
+	uffs_GlobalFsLockUnlock();
+
+	return remain;
+}
+
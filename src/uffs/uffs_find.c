@@ -57,6 +57,18 @@ static URET _LoadObjectInfo(uffs_Device *dev,
 							int type,
 							int *err)
 {
+#ifdef CONFIG_UFFS_INFO_CACHE
+	const uffs_FileInfo *fi;
+
+	fi = uffs_InfoCacheGet(dev, type, node);
+	if (fi == NULL) {
+		if (err)
+			*err = UENOMEM;
+		return U_FAIL;
+	}
+
+	memcpy(&(info->info), fi, sizeof(uffs_FileInfo));
+#else
 	uffs_Buf *buf;
 
 	buf = uffs_BufGetEx(dev, (u8)type, node, 0, 0);
@@ -68,18 +80,18 @@ static URET _LoadObjectInfo(uffs_Device *dev,
 	}
 
 	memcpy(&(info->info), buf->data, sizeof(uffs_FileInfo));
+	uffs_BufPut(dev, buf);
+#endif
 
 	if (type == UFFS_TYPE_DIR) {
 		info->len = 0;
 		info->serial = node->u.dir.serial;
 	}
 	else {
-		info->len = node->u.file.len;
+		info->len = FILE_NODE_LEN(dev, node);
 		info->serial = node->u.file.serial;
 	}
 
-	uffs_BufPut(dev, buf);
-
 	return U_SUCC;
 }
 
@@ -177,7 +189,7 @@ URET uffs_FindObjectOpenEx(uffs_FindInfo *f, uffs_Device *dev, int dir)
 }
 
 
-static URET do_FindObject(uffs_FindInfo *f, uffs_ObjectInfo *info, u16 x)
+static URET do_FindObject(uffs_FindInfo *f, uffs_ObjectInfo *info, uffs_NodeIndex x)
 {
 	URET ret = U_SUCC;
 	TreeNode *node;
@@ -313,6 +325,102 @@ URET uffs_FindObjectNext(uffs_ObjectInfo *info, uffs_FindInfo * f)
 	return ret;
 }
 
+/** number of objects collected (and sorted) at a time by uffs_FindObjectBulk() */
+#define FIND_BULK_CHUNK		16
+
+struct FindBulkEntrySt {
+	TreeNode *node;
+	int type;
+	int pos;
+};
+
+static uffs_BlockNum _GetBulkEntryBlock(struct FindBulkEntrySt *e)
+{
+	return (e->type == UFFS_TYPE_DIR ? e->node->u.dir.block : e->node->u.file.block);
+}
+
+/**
+ * Find next objects in bulk, the device is locked only once.
+ *
+ * \param[in] f uffs_FindInfo structure, openned by uffs_FindObjectOpen().
+ * \param[out] info buffer for loading object information, passed to cb.
+ * \param[in] count maximum objects to be found.
+ * \param[in] block_order if U_TRUE, objects are reported in on-flash block order
+ *				(every FIND_BULK_CHUNK objects), so that objects sharing a block
+ *				are loaded together.
+ * \param[in] cb callback for each object found.
+ * \param[in] arg argument for cb.
+ * \param[out] err error code if some object information can't be loaded, 0 if no error.
+ *
+ * \return number of objects found, 0 if no more objects,
+ *			-1 if failed to load any object information.
+ *
+ * \note objects are collected ahead of loading their information, an object
+ *		 whose information can't be loaded is skipped (the same as
+ *		 uffs_FindObjectNext()), the rest of the chunk is still reported
+ *		 and the call returns after that chunk with *err set.
+ */
+int uffs_FindObjectBulk(uffs_FindInfo *f, uffs_ObjectInfo *info, int count,
+						UBOOL block_order, uffs_FindObjectCB cb, void *arg, int *err)
+{
+	uffs_Device *dev = f->dev;
+	struct FindBulkEntrySt chunk[FIND_BULK_CHUNK];
+	struct FindBulkEntrySt tmp;
+	uffs_NodeIndex x;
+	URET ret = U_SUCC;
+	int n = 0;
+	int len, i, j;
+
+	*err = UENOERR;
+
+	if (dev == NULL || info == NULL || cb == NULL) {
+		*err = UEINVAL;
+		return -1;
+	}
+
+	uffs_DeviceLock(dev);
+
+	while (n < count && f->step <= 1 && ret == U_SUCC) {
+		// collect objects without loading the information
+		for (len = 0; len < FIND_BULK_CHUNK && n + len < count; len++) {
+			if (f->work == NULL) {
+				ResetFindInfo(f);
+				x = dev->tree.dir_entry[0];
+			}
+			else {
+				x = f->work->hash_next;
+			}
+			if (do_FindObject(f, NULL, x) != U_SUCC)
+				break;
+			chunk[len].node = f->work;
+			chunk[len].type = (f->step == 0 ? UFFS_TYPE_DIR : UFFS_TYPE_FILE);
+			chunk[len].pos = f->pos;
+		}
+
+		if (block_order) {
+			for (i = 1; i < len; i++) {
+				tmp = chunk[i];
+				for (j = i; j > 0 && _GetBulkEntryBlock(&chunk[j - 1]) > _GetBulkEntryBlock(&tmp); j--)
+					chunk[j] = chunk[j - 1];
+				chunk[j] = tmp;
+			}
+		}
+
+		for (i = 0; i < len; i++) {
+			if (_LoadObjectInfo(dev, chunk[i].node, info, chunk[i].type, err) != U_SUCC) {
+				ret = U_FAIL;
+				continue;
+			}
+			cb(info, chunk[i].pos, arg);
+			n++;
+		}
+	}
+
+	uffs_DeviceUnLock(dev);
+
+	return (ret != U_SUCC && n == 0) ? -1 : n;
+}
+
 /**
  * Rewind a find object process.
  *
@@ -56,6 +56,10 @@
 
 #define SEAL_BYTE(dev, spare)  spare[(dev)->mem.spare_data_size - 1]	// seal byte is the last byte of spare data
 
+// page data ECC scratch buffers follow the spare data in a spare buffer (see UFFS_SPARE_BUFFER_UNIT_SIZE)
+#define ECC_BUF(spare)		((spare) + UFFS_MAX_SPARE_SIZE)
+#define ECC_STORE(spare)	((spare) + UFFS_MAX_SPARE_SIZE + UFFS_MAX_ECC_SIZE)
+
 #if defined(CONFIG_UFFS_AUTO_LAYOUT_USE_MTD_SCHEME)
 /** Linux MTD spare layout for 512 and 2K page size */
 static const u8 MTD512_LAYOUT_ECC[] =	{0, 4, 6, 2, 0xFF, 0};
@@ -187,51 +191,20 @@ static int CalculateSpareDataSize(uffs_Device *dev)
 
 
 /**
- * Initialize UFFS flash interface
+ * Check storage attributes and set up spare layout.
+ *
+ * \note called by uffs_FlashInterfaceInit(). Partitions may share one storage
+ *		 attribute, the attributes are filled only if they are not set yet,
+ *		 so that calling it again (from another partition) only reads them.
  */
-URET uffs_FlashInterfaceInit(uffs_Device *dev)
+URET uffs_FlashInitLayout(uffs_Device *dev)
 {
-	URET ret = U_FAIL;
 	struct uffs_StorageAttrSt *attr = dev->attr;
-	uffs_Pool *pool = SPOOL(dev);
 
-	if (dev->mem.spare_pool_size == 0) {
-		if (dev->mem.malloc) {
-			dev->mem.spare_pool_buf = dev->mem.malloc(dev, UFFS_SPARE_BUFFER_SIZE);
-			if (dev->mem.spare_pool_buf)
-				dev->mem.spare_pool_size = UFFS_SPARE_BUFFER_SIZE;
-		}
-	}
-
-	if (UFFS_SPARE_BUFFER_SIZE > dev->mem.spare_pool_size) {
-		uffs_Perror(UFFS_MSG_DEAD,
-					"Spare buffer require %d but only %d available.",
-					UFFS_SPARE_BUFFER_SIZE, dev->mem.spare_pool_size);
-		memset(pool, 0, sizeof(uffs_Pool));
-		goto ext;
-	}
-
-	uffs_Perror(UFFS_MSG_NOISY,
-					"alloc spare buffers %d bytes.",
-					UFFS_SPARE_BUFFER_SIZE);
-	uffs_PoolInit(pool, dev->mem.spare_pool_buf,
-					dev->mem.spare_pool_size,
-					UFFS_MAX_SPARE_SIZE, MAX_SPARE_BUFFERS, U_FALSE);
-
-	// init flash driver
-	if (dev->ops->InitFlash) {
-		if (dev->ops->InitFlash(dev) < 0)
-			goto ext;
-	}
-
-	if (dev->ops->WritePage == NULL && dev->ops->WritePageWithLayout == NULL) {
-		uffs_Perror(UFFS_MSG_SERIOUS, "Flash driver must provide 'WritePage' or 'WritePageWithLayout' function!");
-		goto ext;
-	}
-
-	if (dev->ops->ReadPage == NULL && dev->ops->ReadPageWithLayout == NULL) {
-		uffs_Perror(UFFS_MSG_SERIOUS, "Flash driver must provide 'ReadPage' or 'ReadPageWithLayout' function!");
-		goto ext;
+	if (attr->page_data_size > UFFS_MAX_PAGE_SIZE || attr->spare_size > UFFS_MAX_SPARE_SIZE) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "Page %d/%d exceeds UFFS_MAX_PAGE_SIZE/UFFS_MAX_SPARE_SIZE (%d/%d) !",
+					attr->page_data_size, attr->spare_size, UFFS_MAX_PAGE_SIZE, UFFS_MAX_SPARE_SIZE);
+		return U_FAIL;
 	}
 
 	if (dev->attr->layout_opt == UFFS_LAYOUT_UFFS) {
@@ -243,12 +216,18 @@ URET uffs_FlashInterfaceInit(uffs_Device *dev)
 
 		uffs_Perror(UFFS_MSG_NORMAL, "ECC size %d", dev->attr->ecc_size);
 
+		if (dev->attr->ecc_size > UFFS_MAX_ECC_SIZE ||
+			TAG_STORE_SIZE + dev->attr->ecc_size + 2 > 0xFF) {	// spare layout offsets are u8
+			uffs_Perror(UFFS_MSG_SERIOUS, "ECC size %d is too big !", dev->attr->ecc_size);
+			return U_FAIL;
+		}
+
 		if ((dev->attr->data_layout && !dev->attr->ecc_layout) ||
 			(!dev->attr->data_layout && dev->attr->ecc_layout)) {
 			uffs_Perror(UFFS_MSG_SERIOUS,
 						"Please setup data_layout and ecc_layout, "
 						"or leave them all NULL !");
-			goto ext;
+			return U_FAIL;
 		}
 
 		if (!attr->data_layout && !attr->ecc_layout) {
@@ -275,14 +254,67 @@ URET uffs_FlashInterfaceInit(uffs_Device *dev)
 		if (dev->ops->WritePageWithLayout == NULL || dev->ops->ReadPageWithLayout == NULL) {
 			uffs_Perror(UFFS_MSG_SERIOUS, "When using UFFS_LAYOUT_FLASH option, "
 				"flash driver must provide 'WritePageWithLayout' and 'ReadPageWithLayout' function!");
-			goto ext;
+			return U_FAIL;
 		}
 	}
 	else {
 		uffs_Perror(UFFS_MSG_SERIOUS, "Invalid layout_opt: %d", dev->attr->layout_opt);
+		return U_FAIL;
+	}
+
+	return U_SUCC;
+}
+
+/**
+ * Initialize UFFS flash interface
+ */
+URET uffs_FlashInterfaceInit(uffs_Device *dev)
+{
+	URET ret = U_FAIL;
+	uffs_Pool *pool = SPOOL(dev);
+
+	if (dev->mem.spare_pool_size == 0) {
+		if (dev->mem.malloc) {
+			dev->mem.spare_pool_buf = dev->mem.malloc(dev, UFFS_SPARE_BUFFER_SIZE);
+			if (dev->mem.spare_pool_buf)
+				dev->mem.spare_pool_size = UFFS_SPARE_BUFFER_SIZE;
+		}
+	}
+
+	if (UFFS_SPARE_BUFFER_SIZE > dev->mem.spare_pool_size) {
+		uffs_Perror(UFFS_MSG_DEAD,
+					"Spare buffer require %d but only %d available.",
+					UFFS_SPARE_BUFFER_SIZE, dev->mem.spare_pool_size);
+		memset(pool, 0, sizeof(uffs_Pool));
 		goto ext;
 	}
 
+	uffs_Perror(UFFS_MSG_NOISY,
+					"alloc spare buffers %d bytes.",
+					UFFS_SPARE_BUFFER_SIZE);
+	uffs_PoolInit(pool, dev->mem.spare_pool_buf,
+					dev->mem.spare_pool_size,
+					UFFS_SPARE_BUFFER_UNIT_SIZE, MAX_SPARE_BUFFERS, U_FALSE);
+
+	// init flash driver
+	if (dev->ops->InitFlash) {
+		if (dev->ops->InitFlash(dev) < 0)
+			goto ext;
+	}
+
+	if (dev->ops->WritePage == NULL && dev->ops->WritePageWithLayout == NULL) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "Flash driver must provide 'WritePage' or 'WritePageWithLayout' function!");
+		goto ext;
+	}
+
+	if (dev->ops->ReadPage == NULL && dev->ops->ReadPageWithLayout == NULL) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "Flash driver must provide 'ReadPage' or 'ReadPageWithLayout' function!");
+		goto ext;
+	}
+
+	if (uffs_FlashInitLayout(dev) != U_SUCC)
+		goto ext;
+
 	if (dev->ops->EraseBlock == NULL) {
 		uffs_Perror(UFFS_MSG_SERIOUS, "Flash driver MUST implement 'EraseBlock()' function !");
 		goto ext;
@@ -365,32 +397,46 @@ void uffs_FlashUnloadSpare(uffs_Device *dev,
 }
 
 /**
- * Read tag from page spare
+ * check tag ecc after tag is loaded from spare
  *
  * \param[in] dev uffs device
- * \param[in] block flash block num
- * \param[in] page flash page num
- * \param[out] tag tag to be filled
- *
- * \return	#UFFS_FLASH_NO_ERR: success and has no flip bits
- *			#UFFS_FLASH_ECC_OK: spare data has flip bits and corrected by ecc
- *			#UFFS_FLASH_IO_ERR: I/O error, expect retry ?
- *			#UFFS_FLASH_ECC_FAIL: spare data has flip bits and ecc correct failed
- *			#UFFS_FLASH_BAD_BLK: this is a bad block
- *			#UFFS_FLASH_CRC_ERR: CRC verification failed
- *			#UFFS_FLASH_UNKNOWN_ERR: memory allocation failure, etc.
-*/
-int uffs_FlashReadPageTag(uffs_Device *dev,
-							int block, int page, uffs_Tags *tag)
+ * \param[in|out] tag loaded tag
+ * \param[in] ret flash result of loading the tag
+ * \return the final result
+ */
+static int _CheckPageTag(uffs_Device *dev, uffs_Tags *tag, int ret)
 {
-	uffs_FlashOps *ops = dev->ops;
-	u8 * spare_buf;
-	int ret = UFFS_FLASH_UNKNOWN_ERR;
 	int ret_tmp;
 
-	spare_buf = (u8 *) uffs_PoolGet(SPOOL(dev));
-	if (spare_buf == NULL)
-		goto ext;
+	if (UFFS_FLASH_HAVE_ERR(ret) || tag == NULL)
+		return ret;
+
+	if (!TAG_IS_SEALED(tag))	// not sealed ? don't try tag ECC correction
+		return ret;
+
+	// do tag ecc correction
+	if (dev->attr->ecc_opt != UFFS_ECC_NONE) {
+		ret_tmp = TagEccCorrect(&tag->s);
+		ret_tmp = (ret_tmp < 0 ? UFFS_FLASH_ECC_FAIL :
+				(ret_tmp > 0 ? UFFS_FLASH_ECC_OK : UFFS_FLASH_NO_ERR));
+
+		if (UFFS_FLASH_HAVE_ERR(ret_tmp) || ret_tmp == UFFS_FLASH_ECC_OK) {
+			// overwrite ret with ret_tmp only when tag ECC failed or corrected bit flip(s),
+			// so that if flash driver has the capability of ECC, the result will propagete to upper level.
+			ret = ret_tmp;
+		}
+	}
+
+	return ret;
+}
+
+/**
+ * read tag from page spare with given spare buffer
+ */
+static int _ReadPageTag(uffs_Device *dev, int block, int page, uffs_Tags *tag, u8 *spare_buf)
+{
+	uffs_FlashOps *ops = dev->ops;
+	int ret;
 
 	if (ops->ReadPageWithLayout) {
 		ret = ops->ReadPageWithLayout(dev, block, page, NULL, 0, NULL, tag ? &tag->s : NULL, NULL);
@@ -411,32 +457,11 @@ int uffs_FlashReadPageTag(uffs_Device *dev,
 		}
 	}
 
+	return _CheckPageTag(dev, tag, ret);
+}
 
-	if (UFFS_FLASH_HAVE_ERR(ret))
-		goto ext;
-
-	if (tag) {
-		if (!TAG_IS_SEALED(tag))	// not sealed ? don't try tag ECC correction
-			goto ext;
-
-		// do tag ecc correction
-		if (dev->attr->ecc_opt != UFFS_ECC_NONE) {
-			ret_tmp = TagEccCorrect(&tag->s);
-			ret_tmp = (ret_tmp < 0 ? UFFS_FLASH_ECC_FAIL :
-					(ret_tmp > 0 ? UFFS_FLASH_ECC_OK : UFFS_FLASH_NO_ERR));
-
-			if (UFFS_FLASH_HAVE_ERR(ret_tmp) || ret_tmp == UFFS_FLASH_ECC_OK) {
-				// overwrite ret with ret_tmp only when tag ECC failed or corrected bit flip(s),
-				// so that if flash driver has the capability of ECC, the result will propagete to upper level.
-				ret = ret_tmp;
-			}
-		}
-	}
-
-ext:
-	if (spare_buf)
-		uffs_PoolPut(SPOOL(dev), spare_buf);
-
+static void _ReportReadTagResult(int block, int page, int ret)
+{
 	if (UFFS_FLASH_IS_BAD_BLOCK(ret)) {
 		uffs_Perror(UFFS_MSG_NORMAL, "new bad block %d found while reading page %d tag", block, page);
 	}
@@ -446,10 +471,109 @@ ext:
 	else if (UFFS_FLASH_HAVE_ERR(ret)) {
 		uffs_Perror(UFFS_MSG_NORMAL, "read block %d page %d tag failed, error = %d", block, page, ret);
 	}
+}
+
+/**
+ * Read tag from page spare
+ *
+ * \param[in] dev uffs device
+ * \param[in] block flash block num
+ * \param[in] page flash page num
+ * \param[out] tag tag to be filled
+ *
+ * \return	#UFFS_FLASH_NO_ERR: success and has no flip bits
+ *			#UFFS_FLASH_ECC_OK: spare data has flip bits and corrected by ecc
+ *			#UFFS_FLASH_IO_ERR: I/O error, expect retry ?
+ *			#UFFS_FLASH_ECC_FAIL: spare data has flip bits and ecc correct failed
+ *			#UFFS_FLASH_BAD_BLK: this is a bad block
+ *			#UFFS_FLASH_CRC_ERR: CRC verification failed
+ *			#UFFS_FLASH_UNKNOWN_ERR: memory allocation failure, etc.
+*/
+int uffs_FlashReadPageTag(uffs_Device *dev,
+							int block, int page, uffs_Tags *tag)
+{
+	u8 * spare_buf;
+	int ret = UFFS_FLASH_UNKNOWN_ERR;
+
+	spare_buf = (u8 *) uffs_PoolGet(SPOOL(dev));
+	if (spare_buf) {
+		ret = _ReadPageTag(dev, block, page, tag, spare_buf);
+		uffs_PoolPut(SPOOL(dev), spare_buf);
+	}
+
+	_ReportReadTagResult(block, page, ret);
 
 	return ret;
 }
 
+/**
+ * Read tags from spares of a range of pages
+ *
+ * If flash driver provides 'ReadPageSpares()', spares are read in one driver call,
+ * otherwise pages are read one by one, sharing one spare buffer.
+ *
+ * \param[in] dev uffs device
+ * \param[in] block flash block num
+ * \param[in] page the first page num
+ * \param[in] n_pages number of pages, no more than #UFFS_TAG_BATCH_PAGES
+ * \param[out] tags tags to be filled, tags[i] for page (page + i)
+ * \param[out] results read result of each page, see uffs_FlashReadPageTag()
+ *
+ * \return number of pages read, could be less than n_pages
+ *		(limited by spare buffer size), always > 0 if n_pages > 0.
+ */
+int uffs_FlashReadPageTags(uffs_Device *dev, int block, int page,
+							int n_pages, uffs_Tags **tags, int *results)
+{
+	uffs_FlashOps *ops = dev->ops;
+	u8 * spare_buf;
+	u8 * p;
+	int i, n;
+
+	if (n_pages > UFFS_TAG_BATCH_PAGES)
+		n_pages = UFFS_TAG_BATCH_PAGES;
+
+	spare_buf = (u8 *) uffs_PoolGet(SPOOL(dev));
+	if (spare_buf == NULL) {
+		for (i = 0; i < n_pages; i++) {
+			results[i] = UFFS_FLASH_UNKNOWN_ERR;
+			_ReportReadTagResult(block, page + i, results[i]);
+		}
+		return n_pages;
+	}
+
+	n = 0;
+	if (UFFS_FLASH_CAN_BATCH_READ_SPARE(dev)) {
+		// spares are read to the spare buffer side by side
+		n = UFFS_SPARE_BUFFER_UNIT_SIZE / dev->mem.spare_data_size;
+		n = (n > n_pages ? n_pages : n);
+		if (ops->ReadPageSpares(dev, block, page, n, spare_buf, dev->mem.spare_data_size, results) == 0) {
+			for (i = 0, p = spare_buf; i < n; i++, p += dev->mem.spare_data_size) {
+				tags[i]->seal_byte = SEAL_BYTE(dev, p);
+				if (!UFFS_FLASH_HAVE_ERR(results[i]))
+					uffs_FlashUnloadSpare(dev, p, &tags[i]->s, NULL);
+				results[i] = _CheckPageTag(dev, tags[i], results[i]);
+			}
+		}
+		else {
+			n = 0;
+		}
+	}
+
+	if (n == 0) {
+		n = n_pages;
+		for (i = 0; i < n; i++)
+			results[i] = _ReadPageTag(dev, block, page + i, tags[i], spare_buf);
+	}
+
+	uffs_PoolPut(SPOOL(dev), spare_buf);
+
+	for (i = 0; i < n; i++)
+		_ReportReadTagResult(block, page + i, results[i]);
+
+	return n;
+}
+
 /**
  * Read page data to buf (do ECC error correction if needed)
  * \param[in] dev uffs device
@@ -473,8 +597,8 @@ int uffs_FlashReadPage(uffs_Device *dev, int block, int page, uffs_Buf *buf, UBO
 	uffs_FlashOps *ops = dev->ops;
 	struct uffs_StorageAttrSt *attr = dev->attr;
 	int size = dev->com.pg_size;
-	u8 ecc_buf[UFFS_MAX_ECC_SIZE];
-	u8 ecc_store[UFFS_MAX_ECC_SIZE];
+	u8 *ecc_buf;
+	u8 *ecc_store;
 #ifdef CONFIG_ENABLE_PAGE_DATA_CRC
 	UBOOL crc_ok = U_TRUE;
 #endif
@@ -487,6 +611,9 @@ int uffs_FlashReadPage(uffs_Device *dev, int block, int page, uffs_Buf *buf, UBO
 	if (spare == NULL)
 		goto ext;
 
+	ecc_buf = ECC_BUF(spare);
+	ecc_store = ECC_STORE(spare);
+
 	if (ops->ReadPageWithLayout) {
 		if (skip_ecc)
 			ret = ops->ReadPageWithLayout(dev, block, page, buf->header, size, NULL, NULL, NULL);
@@ -657,7 +784,7 @@ int uffs_FlashWritePageCombine(uffs_Device *dev,
 {
 	uffs_FlashOps *ops = dev->ops;
 	int size = dev->com.pg_size;
-	u8 ecc_buf[UFFS_MAX_ECC_SIZE];
+	u8 *ecc_buf;
 	u8 *ecc = NULL;
 	u8 *spare;
 	struct uffs_MiniHeaderSt *header;
@@ -672,6 +799,8 @@ int uffs_FlashWritePageCombine(uffs_Device *dev,
 	if (spare == NULL)
 		goto ext;
 
+	ecc_buf = ECC_BUF(spare);
+
 	// setup header
 	header = HEADER(buf);
 	memset(header, 0xFF, sizeof(struct uffs_MiniHeaderSt));
@@ -773,6 +902,7 @@ ext:
 URET uffs_FlashMarkBadBlock(uffs_Device *dev, int block)
 {
 	int ret;
+	URET bbt_ret = U_SUCC;
 	uffs_BlockInfo *bc;
 
 	uffs_Perror(UFFS_MSG_NORMAL, "Mark bad block: %d", block);
@@ -786,8 +916,15 @@ URET uffs_FlashMarkBadBlock(uffs_Device *dev, int block)
 		uffs_BlockInfoPut(dev, bc);
 	}
 
+#ifdef CONFIG_UFFS_BBT
+	// keep the bad block mark on the block as well, in case BBT is lost.
+	bbt_ret = uffs_BbtMarkBad(dev, block);
+	if (bbt_ret != U_SUCC)
+		uffs_Perror(UFFS_MSG_SERIOUS, "can't save BBT for bad block %d", block);
+#endif
+
 	if (dev->ops->MarkBadBlock)
-		return dev->ops->MarkBadBlock(dev, block) == 0 ? U_SUCC : U_FAIL;
+		return (dev->ops->MarkBadBlock(dev, block) == 0 && bbt_ret == U_SUCC) ? U_SUCC : U_FAIL;
 
 #ifdef CONFIG_ERASE_BLOCK_BEFORE_MARK_BAD
 	dev->ops->EraseBlock(dev, block);	// ignore the return value, we are going to mark it as 'bad' anyway ...
@@ -798,7 +935,7 @@ URET uffs_FlashMarkBadBlock(uffs_Device *dev, int block)
 	else
 		ret = dev->ops->WritePage(dev, block, 0, NULL, 0, NULL, 0);
 
-	return ret == UFFS_FLASH_NO_ERR ? U_SUCC : U_FAIL;
+	return (ret == UFFS_FLASH_NO_ERR && bbt_ret == U_SUCC) ? U_SUCC : U_FAIL;
 }
 
 /** Is this block a bad block ? */
@@ -807,6 +944,12 @@ UBOOL uffs_FlashIsBadBlock(uffs_Device *dev, int block)
 	struct uffs_FlashOpsSt *ops = dev->ops;
 	UBOOL ret = U_FALSE;
 
+#ifdef CONFIG_UFFS_BBT
+	// the bad block mark might be newer than the table if the table failed to be saved.
+	if (UFFS_BBT_COVERS(dev, block) && (uffs_BbtIsBad(dev, block) || !dev->bbt.unsaved))
+		return uffs_BbtIsBad(dev, block);
+#endif
+
 	if (ops->IsBadBlock) {
 		/* if flash driver provide 'IsBadBlock' function, call it */
 		ret = (ops->IsBadBlock(dev, block) == 0 ? U_FALSE : U_TRUE);
@@ -879,7 +1022,7 @@ URET uffs_FlashCheckErasedBlock(uffs_Device *dev, int block)
 	int ret = U_SUCC;
 	int page;
 	int flash_ret;
-	u8 ecc_store[UFFS_MAX_ECC_SIZE];
+	u8 *ecc_store;
 	uffs_TagStore ts;
 	uffs_Buf *buf = NULL;
 	int size = dev->com.pg_size;
@@ -895,6 +1038,7 @@ URET uffs_FlashCheckErasedBlock(uffs_Device *dev, int block)
 		uffs_Perror(UFFS_MSG_SERIOUS, "Can't allocate spare buf.");
 		goto ext;
 	}
+	ecc_store = ECC_STORE(spare);
 	
 	buf = uffs_BufClone(dev, NULL);
 	
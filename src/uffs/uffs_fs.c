@@ -85,6 +85,7 @@ static URET do_TruncateObject(uffs_Object *obj, u32 remain, RunOptionE run_opt);
 
 static int _object_data[(sizeof(struct uffs_ObjectSt) * MAX_OBJECT_HANDLE) / sizeof(int)];
 
+static u32 _object_map[UFFS_POOL_MAP_SIZE(MAX_OBJECT_HANDLE)];
 static uffs_Pool _object_pool;
 
 
@@ -98,8 +99,11 @@ uffs_Pool * uffs_GetObjectPool(void)
  */
 URET uffs_InitObjectBuf(void)
 {
-	return uffs_PoolInit(&_object_pool, _object_data, sizeof(_object_data),
-			sizeof(uffs_Object), MAX_OBJECT_HANDLE, U_FALSE);
+	if (uffs_PoolInit(&_object_pool, _object_data, sizeof(_object_data),
+			sizeof(uffs_Object), MAX_OBJECT_HANDLE, UFFS_HANDLE_POOL_LOCK) == U_FAIL)
+		return U_FAIL;
+
+	return uffs_PoolSetAllocMap(&_object_pool, _object_map, sizeof(_object_map));
 }
 
 /**
@@ -107,6 +111,9 @@ URET uffs_InitObjectBuf(void)
  */
 URET uffs_ReleaseObjectBuf(void)
 {
+#ifdef CONFIG_UFFS_GROWABLE_HANDLES
+	uffs_PoolReleaseGrown(&_object_pool);
+#endif
 	return uffs_PoolRelease(&_object_pool);
 }
 
@@ -154,7 +161,11 @@ uffs_Object * uffs_GetObject(void)
 {
 	uffs_Object * obj;
 
-	obj = (uffs_Object *) uffs_PoolGet(&_object_pool);
+#ifdef CONFIG_UFFS_GROWABLE_HANDLES
+	obj = (uffs_Object *) uffs_PoolGetGrow(&_object_pool, MAX_OBJECT_HANDLE_LIMIT);
+#else
+	obj = (uffs_Object *) uffs_HandlePoolGet(&_object_pool);
+#endif
 	if (obj) {
 		memset(obj, 0, sizeof(uffs_Object));
 		obj->attr_loaded = U_FALSE;
@@ -189,8 +200,10 @@ URET uffs_ReInitObject(uffs_Object *obj)
  */
 void uffs_PutObject(uffs_Object *obj)
 {
-	if (obj)
-		uffs_PoolPut(&_object_pool, obj);
+	if (obj) {
+		obj->open_succ = U_FALSE;	// fd of this object is no longer valid
+		uffs_HandlePoolPut(&_object_pool, obj);
+	}
 }
 
 /**
@@ -286,6 +299,58 @@ static int GetDirLengthFromPath(const char *path, int path_len)
 	return p - path;
 }
 
+/**
+ * find DIR or FILE object by name.
+ *
+ * \param[in] dev uffs device
+ * \param[in] type UFFS_TYPE_DIR or UFFS_TYPE_FILE
+ * \param[in] parent parent dir serial
+ * \param[in] name object name
+ * \param[in] len name length
+ * \param[in] sum name sum
+ *
+ * \return tree node of the object, NULL if not found.
+ *
+ * \note with CONFIG_UFFS_DENTRY_CACHE, the result (include 'not found')
+ *		is cached, so repeated lookup of the same name doesn't search the tree.
+ */
+static TreeNode * do_FindObjectByName(uffs_Device *dev, int type, u16 parent,
+									  const char *name, int len, u16 sum)
+{
+	TreeNode *node;
+#ifdef CONFIG_UFFS_DENTRY_CACHE
+	u16 serial;
+
+	switch (uffs_DentryCacheLookup(dev, parent, name, len, sum, type, &serial)) {
+	case UFFS_DENTRY_HIT:
+		node = (type == UFFS_TYPE_DIR ?
+				uffs_TreeFindDirNode(dev, serial) : uffs_TreeFindFileNode(dev, serial));
+		if (node)
+			return node;
+		break;
+	case UFFS_DENTRY_NEGATIVE:
+		return NULL;
+	default:
+		break;
+	}
+#endif
+
+	if (type == UFFS_TYPE_DIR)
+		node = uffs_TreeFindDirNodeByName(dev, name, len, sum, parent);
+	else
+		node = uffs_TreeFindFileNodeByName(dev, name, len, sum, parent);
+
+#ifdef CONFIG_UFFS_DENTRY_CACHE
+	if (node)
+		uffs_DentryCacheAdd(dev, parent, name, len, sum, type,
+					(type == UFFS_TYPE_DIR ? node->u.dir.serial : node->u.file.serial));
+	else
+		uffs_DentryCacheAddNegative(dev, parent, name, len, sum, type);
+#endif
+
+	return node;
+}
+
 /**
  * Create an object under the given dir.
  *
@@ -333,17 +398,15 @@ URET uffs_CreateObjectEx(uffs_Object *obj, uffs_Device *dev,
 
 	if (obj->type == UFFS_TYPE_DIR) {
 		//find out whether have file with the same name
-		node = uffs_TreeFindFileNodeByName(obj->dev, obj->name,
-											obj->name_len, obj->sum,
-											obj->parent);
+		node = do_FindObjectByName(obj->dev, UFFS_TYPE_FILE, obj->parent,
+									obj->name, obj->name_len, obj->sum);
 		if (node != NULL) {
 			obj->err = UEEXIST;	// we can't create a dir has the
 								// same name with exist file.
 			goto ext_1;
 		}
-		obj->node = uffs_TreeFindDirNodeByName(obj->dev, obj->name,
-												obj->name_len, obj->sum,
-												obj->parent);
+		obj->node = do_FindObjectByName(obj->dev, UFFS_TYPE_DIR, obj->parent,
+										obj->name, obj->name_len, obj->sum);
 		if (obj->node != NULL) {
 			obj->err = UEEXIST; // we can't create a dir already exist.
 			goto ext_1;
@@ -351,16 +414,14 @@ URET uffs_CreateObjectEx(uffs_Object *obj, uffs_Device *dev,
 	}
 	else {
 		//find out whether have dir with the same name
-		node = uffs_TreeFindDirNodeByName(obj->dev, obj->name,
-											obj->name_len, obj->sum,
-											obj->parent);
+		node = do_FindObjectByName(obj->dev, UFFS_TYPE_DIR, obj->parent,
+									obj->name, obj->name_len, obj->sum);
 		if (node != NULL) {
 			obj->err = UEEXIST;
 			goto ext_1;
 		}
-		obj->node = uffs_TreeFindFileNodeByName(obj->dev, obj->name,
-												obj->name_len, obj->sum,
-												obj->parent);
+		obj->node = do_FindObjectByName(obj->dev, UFFS_TYPE_FILE, obj->parent,
+										obj->name, obj->name_len, obj->sum);
 		if (obj->node) {
 			/* file already exist, truncate it to zero length */
 			obj->serial = GET_OBJ_NODE_SERIAL(obj);
@@ -409,6 +470,9 @@ URET uffs_CreateObjectEx(uffs_Object *obj, uffs_Device *dev,
 
 	uffs_BufWrite(obj->dev, buf, &fi, 0, sizeof(uffs_FileInfo));
 	uffs_BufPut(obj->dev, buf);
+#ifdef CONFIG_UFFS_INFO_CACHE
+	uffs_InfoCacheUpdate(obj->dev, obj->type, obj->serial, &fi);
+#endif
 
 	// flush buffer immediately,
 	// so that the new node will be inserted into the tree
@@ -424,14 +488,25 @@ URET uffs_CreateObjectEx(uffs_Object *obj, uffs_Device *dev,
 	if (obj->node == NULL) {
 		uffs_Perror(UFFS_MSG_NOISY, "Can't find the node in the tree ?");
 		obj->err = UEIOERR;
+#ifdef CONFIG_UFFS_DENTRY_CACHE
+		// the name might still turn up when the buffer is flushed later,
+		// don't trust the 'not found' cached by the existence check above.
+		uffs_DentryCacheClear(obj->dev);
+#endif
 		goto ext_1;
 	}
 
+#ifdef CONFIG_UFFS_DENTRY_CACHE
+	// only now the serial is in the tree, overwrite the 'not found' entry
+	uffs_DentryCacheAdd(obj->dev, obj->parent, obj->name, obj->name_len,
+						obj->sum, obj->type, obj->serial);
+#endif
+
 	if (obj->type == UFFS_TYPE_FILE)
-		obj->node->u.file.len = 0;	//init the length to 0
+		FILE_NODE_LEN(obj->dev, obj->node) = 0;	//init the length to 0
 
 	if (HAVE_BADBLOCK(obj->dev))
-		uffs_BadBlockRecover(obj->dev);
+		uffs_BadBlockRecoverUrgent(obj->dev);
 
 	obj->open_succ = U_TRUE;
 
@@ -512,16 +587,8 @@ URET uffs_OpenObjectEx(uffs_Object *obj, uffs_Device *dev,
 
 	uffs_ObjectDevLock(obj);
 
-	if (obj->type == UFFS_TYPE_DIR) {
-		obj->node = uffs_TreeFindDirNodeByName(obj->dev, obj->name,
-												obj->name_len, obj->sum,
-												obj->parent);
-	}
-	else {
-		obj->node = uffs_TreeFindFileNodeByName(obj->dev, obj->name,
-												obj->name_len, obj->sum,
-												obj->parent);
-	}
+	obj->node = do_FindObjectByName(obj->dev, obj->type, obj->parent,
+									obj->name, obj->name_len, obj->sum);
 
 	if (obj->node == NULL) {			// dir or file not exist
 		if (obj->oflag & UO_CREATE) {	// expect to create a new one
@@ -678,20 +745,20 @@ URET uffs_ParseObject(uffs_Object *obj, const char *name)
 		else {
 			dir = ROOT_DIR_SERIAL;
 			dname = start;
+			uffs_DeviceLock(dev);
 			while (p - start < d_len) {
 				while (*p != '/') p++;
 				sum = uffs_MakeSum16(dname, p - dname);
-				node = uffs_TreeFindDirNodeByName(dev, dname, p - dname, sum, dir);
+				node = do_FindObjectByName(dev, UFFS_TYPE_DIR, dir, dname, p - dname, sum);
 				if (node == NULL) {
 					obj->err = UENOENT;
 					break;
 				}
-				else {
-					dir = node->u.dir.serial;
-					p++; // skip the '/'
-					dname = p;
-				}
+				dir = node->u.dir.serial;
+				p++; // skip the '/'
+				dname = p;
 			}
+			uffs_DeviceUnLock(dev);
 			obj->parent = dir;
 			obj->name = start + (d_len > 0 ? d_len + 1 : 0);
 			obj->name_len = len - (d_len > 0 ? d_len + 1 : 0) - m_len;
@@ -714,8 +781,12 @@ static void do_ReleaseObjectResource(uffs_Object *obj)
 {
 	if (obj) {
 		if (obj->dev) {
+#ifdef CONFIG_UFFS_OBJ_FDN_MAP
+			uffs_TreeFdnMapPut(obj->dev, obj->fdn_map);
+			obj->fdn_map = NULL;
+#endif
 			if (HAVE_BADBLOCK(obj->dev))
-				uffs_BadBlockRecover(obj->dev);
+				uffs_BadBlockRecoverUrgent(obj->dev);
 			if (obj->dev_lock_count > 0) {
 				uffs_ObjectDevUnLock(obj);
 			}
@@ -844,11 +915,18 @@ URET uffs_CloseObject(uffs_Object *obj)
 			fi.last_modify = uffs_GetCurDateTime();
 			uffs_BufWrite(dev, buf, &fi, 0, sizeof(uffs_FileInfo));
 			uffs_BufPut(dev, buf);
+#ifdef CONFIG_UFFS_INFO_CACHE
+			uffs_InfoCacheUpdate(dev, obj->type, obj->serial, &fi);
+#endif
 		}
 #endif
 		do_FlushObject(obj);
 	}
 
+	// return unused reserved blocks made by this object
+	if (obj->type == UFFS_TYPE_FILE && obj->dev->tree.prealloc_holder == obj)
+		uffs_TreeReleasePrealloc(obj->dev);
+
 	uffs_ObjectDevUnLock(obj);
 
 ext:
@@ -857,7 +935,7 @@ ext:
 	return (obj->err == UENOERR ? U_SUCC : U_FAIL);
 }
 
-static u16 GetFdnByOfs(uffs_Object *obj, u32 ofs)
+static u32 GetFdnByOfs(uffs_Object *obj, u32 ofs)
 {
 	uffs_Device *dev = obj->dev;
 
@@ -916,7 +994,7 @@ static int do_WriteNewBlock(uffs_Object *obj,
 			break;
 		}
 		wroteSize += size;
-		obj->node->u.file.len += size;
+		FILE_NODE_LEN(obj->dev, obj->node) += size;
 	}
 
 	return wroteSize;
@@ -971,8 +1049,8 @@ static int do_WriteInternalBlock(uffs_Object *obj,
 		size = (len - wroteSize + pageOfs) > dev->com.pg_data_size ?
 					(dev->com.pg_data_size - pageOfs) : (len - wroteSize);
 
-		if ((obj->node->u.file.len % dev->com.pg_data_size) == 0 &&
-			(blockOfs + block_start) == obj->node->u.file.len) {
+		if ((FILE_NODE_LEN(obj->dev, obj->node) % dev->com.pg_data_size) == 0 &&
+			(blockOfs + block_start) == FILE_NODE_LEN(obj->dev, obj->node)) {
 
 			buf = uffs_BufNew(dev, type, parent, serial, page_id);
 
@@ -1002,8 +1080,8 @@ static int do_WriteInternalBlock(uffs_Object *obj,
 		wroteSize += size;
 		blockOfs += size;
 
-		if (block_start + blockOfs > obj->node->u.file.len)
-			obj->node->u.file.len = block_start + blockOfs;
+		if (block_start + blockOfs > FILE_NODE_LEN(obj->dev, obj->node))
+			FILE_NODE_LEN(obj->dev, obj->node) = block_start + blockOfs;
 
 	}
 
@@ -1012,9 +1090,24 @@ static int do_WriteInternalBlock(uffs_Object *obj,
 
 
 /**
- * write data to obj, return remain data (0 if all data been written).
+ * find DATA node #fdn of file #obj, through the object's fdn map if possible.
  */
-static int do_WriteObject(uffs_Object *obj, const void *data, int len)
+static TreeNode * _FindDataNode(uffs_Object *obj, u16 fdn)
+{
+#ifdef CONFIG_UFFS_OBJ_FDN_MAP
+	if (obj->fdn_map == NULL)
+		obj->fdn_map = uffs_TreeFdnMapGet(obj->dev, obj->serial);
+
+	return uffs_TreeFindDataNodeByMap(obj->dev, obj->fdn_map, obj->serial, fdn);
+#else
+	return uffs_TreeFindDataNode(obj->dev, obj->serial, fdn);
+#endif
+}
+
+/**
+ * write data to obj from position #pos, return remain data (0 if all data been written).
+ */
+static int do_WriteObject(uffs_Object *obj, u32 pos, const void *data, int len)
 {
 	uffs_Device *dev = obj->dev;
 	TreeNode *fnode = obj->node;
@@ -1024,18 +1117,35 @@ static int do_WriteObject(uffs_Object *obj, const void *data, int len)
 	TreeNode *dnode;
 	u32 size;
 
+#ifdef CONFIG_UFFS_SMALL_FILE_PACK
+	if (IS_PACKED_FILE(dev, fnode->u.file.serial) && !FIT_IN_PACK(dev, pos + len)) {
+		// file grows out of pack block, move it to a block of its own.
+		if (!HAVE_PREALLOC_BLOCK(dev, fnode->u.file.serial) &&
+			dev->tree.erased_count < dev->cfg.reserved_free_blocks) {
+			uffs_Perror(UFFS_MSG_NOISY, "insufficient block in write obj, promote packed file");
+			return remain;
+		}
+		uffs_BufFlushGroup(dev, fnode->u.file.parent, fnode->u.file.serial);
+		if (uffs_PackPromoteFile(dev, fnode) != U_SUCC) {
+			obj->err = UEIOERR;
+			return remain;
+		}
+	}
+#endif
+
 	while (remain > 0) {
-		write_start = obj->pos + len - remain;
-		if (write_start > fnode->u.file.len) {
+		write_start = pos + len - remain;
+		if (write_start > FILE_NODE_LEN(obj->dev, fnode)) {
 			uffs_Perror(UFFS_MSG_SERIOUS, "write point out of file ?");
 			break;
 		}
 
 		fdn = GetFdnByOfs(obj, write_start);
 
-		if (write_start == fnode->u.file.len && fdn > 0 &&
+		if (write_start == FILE_NODE_LEN(obj->dev, fnode) && fdn > 0 &&
 			write_start == GetStartOfDataBlock(obj, fdn)) {
-			if (dev->tree.erased_count < dev->cfg.reserved_free_blocks) {
+			if (!HAVE_PREALLOC_BLOCK(dev, fnode->u.file.serial) &&
+				dev->tree.erased_count < dev->cfg.reserved_free_blocks) {
 				uffs_Perror(UFFS_MSG_NOISY, "insufficient block in write obj, new block");
 				break;
 			}
@@ -1068,7 +1178,7 @@ static int do_WriteObject(uffs_Object *obj, const void *data, int len)
 			if(fdn == 0)
 				dnode = obj->node;
 			else
-				dnode = uffs_TreeFindDataNode(dev, fnode->u.file.serial, fdn);
+				dnode = _FindDataNode(obj, fdn);
 
 			if(dnode == NULL) {
 				uffs_Perror(UFFS_MSG_SERIOUS, "can't find data node in tree ?");
@@ -1098,21 +1208,19 @@ static int do_WriteObject(uffs_Object *obj, const void *data, int len)
 
 
 /**
- * write data to obj, from obj->pos
- *
- * \param[in] obj file obj
- * \param[in] data data pointer
- * \param[in] len length of data to be write
- *
- * \return bytes wrote to obj
+ * write data segments #iov[0..iovcnt-1] to obj at #ofs,
+ * or at obj->pos if #use_obj_pos is U_TRUE.
+ * obj->pos is updated only when #use_obj_pos is U_TRUE.
  */
-int uffs_WriteObject(uffs_Object *obj, const void *data, int len)
+static int do_WriteObjectAt(uffs_Object *obj, const struct uffs_iovec *iov, int iovcnt,
+							UBOOL use_obj_pos, u32 ofs)
 {
 	uffs_Device *dev = obj->dev;
 	TreeNode *fnode = NULL;
 	int remain;
 	u32 pos;
 	int wrote = 0;
+	int i;
 
 	if (obj == NULL) 
 		return 0;
@@ -1133,31 +1241,47 @@ int uffs_WriteObject(uffs_Object *obj, const void *data, int len)
 		return 0;
 	}
 
+	for (i = 0; i < iovcnt; i++) {
+		if (iov[i].iov_len < 0) {
+			obj->err = UEINVAL;
+			return 0;
+		}
+	}
+
 	fnode = obj->node;
 
 	uffs_ObjectDevLock(obj);
 
+	pos = (use_obj_pos ? obj->pos : ofs);
+
 	if (obj->oflag & UO_APPEND)
-		obj->pos = fnode->u.file.len;
+		pos = FILE_NODE_LEN(obj->dev, fnode);
 	else {
-		if (obj->pos > fnode->u.file.len) {
-			// current pos pass over the end of file, need to fill the gap with '\0'
-			pos = obj->pos;	// save desired pos
-			obj->pos = fnode->u.file.len; // filling gap from the end of the file.
-			remain = do_WriteObject(obj, NULL, pos - fnode->u.file.len);  // Write filling bytes. Note: the filling data does not count as 'wrote' in this write operation.
-			obj->pos = pos - remain;
+		if (pos > FILE_NODE_LEN(obj->dev, fnode)) {
+			// pos pass over the end of file, need to fill the gap with '\0', from the end of the file.
+			remain = do_WriteObject(obj, FILE_NODE_LEN(obj->dev, fnode), NULL, pos - FILE_NODE_LEN(obj->dev, fnode));  // Write filling bytes. Note: the filling data does not count as 'wrote' in this write operation.
+			pos -= remain;
 			if (remain > 0)	// fail to fill the gap ? stop.
 				goto ext;
 		}
 	}
 
-	remain = do_WriteObject(obj, data, len);
-	wrote = len - remain;
-	obj->pos += wrote;
+	for (i = 0; i < iovcnt; i++) {
+		if (iov[i].iov_len == 0)
+			continue;
+		remain = do_WriteObject(obj, pos, iov[i].iov_base, iov[i].iov_len);
+		wrote += iov[i].iov_len - remain;
+		pos += iov[i].iov_len - remain;
+		if (remain > 0)		// short write, stop here.
+			break;
+	}
 
 ext:
+	if (use_obj_pos)
+		obj->pos = pos;
+
 	if (HAVE_BADBLOCK(dev))
-		uffs_BadBlockRecover(dev);
+		uffs_BadBlockRecoverUrgent(dev);
 
 	uffs_ObjectDevUnLock(obj);
 
@@ -1167,18 +1291,84 @@ ext:
 }
 
 /**
- * read data from obj
+ * write data to obj, from obj->pos
  *
- * \param[in] obj uffs object
- * \param[out] data output data buffer
- * \param[in] len required length of data to be read from object->pos
+ * \param[in] obj file obj
+ * \param[in] data data pointer
+ * \param[in] len length of data to be write
  *
- * \return return bytes of data have been read
+ * \return bytes wrote to obj
  */
-int uffs_ReadObject(uffs_Object *obj, void *data, int len)
+int uffs_WriteObject(uffs_Object *obj, const void *data, int len)
+{
+	struct uffs_iovec iov;
+
+	iov.iov_base = (void *)data;
+	iov.iov_len = len;
+
+	return do_WriteObjectAt(obj, &iov, 1, U_TRUE, 0);
+}
+
+/**
+ * write data to obj at given offset, obj->pos is not changed.
+ *
+ * \param[in] obj file obj
+ * \param[in] ofs offset in the file where data to be written
+ * \param[in] data data pointer
+ * \param[in] len length of data to be write
+ *
+ * \return bytes wrote to obj
+ *
+ * \note if obj is opened with #UO_APPEND, data is appended to the end of file regardless of #ofs.
+ */
+int uffs_WriteObjectAt(uffs_Object *obj, u32 ofs, const void *data, int len)
+{
+	struct uffs_iovec iov;
+
+	iov.iov_base = (void *)data;
+	iov.iov_len = len;
+
+	return do_WriteObjectAt(obj, &iov, 1, U_FALSE, ofs);
+}
+
+/**
+ * write data segments to obj, from obj->pos, in one critical section.
+ *
+ * \param[in] obj file obj
+ * \param[in] iov data segments, written in array order
+ * \param[in] iovcnt number of segments in #iov
+ *
+ * \return bytes wrote to obj
+ */
+int uffs_WriteObjectV(uffs_Object *obj, const struct uffs_iovec *iov, int iovcnt)
+{
+	return do_WriteObjectAt(obj, iov, iovcnt, U_TRUE, 0);
+}
+
+/**
+ * write data segments to obj at given offset, in one critical section.
+ * obj->pos is not changed.
+ *
+ * \param[in] obj file obj
+ * \param[in] ofs offset in the file where the first segment to be written
+ * \param[in] iov data segments, written in array order
+ * \param[in] iovcnt number of segments in #iov
+ *
+ * \return bytes wrote to obj
+ */
+int uffs_WriteObjectAtV(uffs_Object *obj, u32 ofs, const struct uffs_iovec *iov, int iovcnt)
+{
+	return do_WriteObjectAt(obj, iov, iovcnt, U_FALSE, ofs);
+}
+
+/**
+ * read data from obj from position #pos, return remain data
+ * (0 if all data been read, > 0 if reach the end of file or error occur).
+ */
+static int do_ReadObject(uffs_Object *obj, u32 pos, void *data, int len)
 {
 	uffs_Device *dev = obj->dev;
-	TreeNode *fnode = NULL;
+	TreeNode *fnode = obj->node;
 	u32 remain = len;
 	u16 fdn;
 	u32 read_start;
@@ -1190,36 +1380,9 @@ int uffs_ReadObject(uffs_Object *obj, void *data, int len)
 	u8 type;
 	u32 pageOfs;
 
-	if (obj == NULL)
-		return 0;
-
-	fnode = obj->node;
-
-	if (obj->dev == NULL || obj->open_succ == U_FALSE) {
-		obj->err = UEBADF;
-		return 0;
-	}
-
-	if (obj->type == UFFS_TYPE_DIR) {
-		uffs_Perror(UFFS_MSG_NOISY, "Can't read data from a dir object!");
-		obj->err = UEBADF;
-		return 0;
-	}
-
-	if (obj->pos > fnode->u.file.len) {
-		return 0; //can't read file out of range
-	}
-
-	if (obj->oflag & UO_WRONLY) {
-		obj->err = UEACCES;
-		return 0;
-	}
-
-	uffs_ObjectDevLock(obj);
-
 	while (remain > 0) {
-		read_start = obj->pos + len - remain;
-		if (read_start >= fnode->u.file.len) {
+		read_start = pos + len - remain;
+		if (read_start >= FILE_NODE_LEN(obj->dev, fnode)) {
 			//uffs_Perror(UFFS_MSG_NOISY, "read point out of file ?");
 			break;
 		}
@@ -1231,7 +1394,7 @@ int uffs_ReadObject(uffs_Object *obj, void *data, int len)
 		}
 		else {
 			type = UFFS_TYPE_DATA;
-			dnode = uffs_TreeFindDataNode(dev, fnode->u.file.serial, fdn);
+			dnode = _FindDataNode(obj, fdn);
 			if (dnode == NULL) {
 				uffs_Perror(UFFS_MSG_SERIOUS, "can't get data node in entry!");
 				obj->err = UEUNKNOWN_ERR;
@@ -1272,16 +1435,251 @@ int uffs_ReadObject(uffs_Object *obj, void *data, int len)
 		remain -= size;
 	}
 
-	obj->pos += (len - remain);
+	return remain;
+}
+
+/**
+ * read data segments #iov[0..iovcnt-1] from obj at #ofs,
+ * or at obj->pos if #use_obj_pos is U_TRUE.
+ * obj->pos is updated only when #use_obj_pos is U_TRUE.
+ */
+static int do_ReadObjectAt(uffs_Object *obj, const struct uffs_iovec *iov, int iovcnt,
+							UBOOL use_obj_pos, u32 ofs)
+{
+	uffs_Device *dev = obj->dev;
+	TreeNode *fnode = NULL;
+	int remain;
+	int read = 0;
+	u32 pos;
+	int i;
+
+	if (obj == NULL)
+		return 0;
+
+	fnode = obj->node;
+
+	if (obj->dev == NULL || obj->open_succ == U_FALSE) {
+		obj->err = UEBADF;
+		return 0;
+	}
+
+	if (obj->type == UFFS_TYPE_DIR) {
+		uffs_Perror(UFFS_MSG_NOISY, "Can't read data from a dir object!");
+		obj->err = UEBADF;
+		return 0;
+	}
+
+	if (obj->oflag & UO_WRONLY) {
+		obj->err = UEACCES;
+		return 0;
+	}
+
+	for (i = 0; i < iovcnt; i++) {
+		if (iov[i].iov_len < 0) {
+			obj->err = UEINVAL;
+			return 0;
+		}
+	}
+
+	uffs_ObjectDevLock(obj);
+
+	pos = (use_obj_pos ? obj->pos : ofs);
+
+	if (pos > FILE_NODE_LEN(obj->dev, fnode)) {
+		uffs_ObjectDevUnLock(obj);
+		return 0; //can't read file out of range
+	}
+
+	for (i = 0; i < iovcnt; i++) {
+		if (iov[i].iov_len == 0)
+			continue;
+		remain = do_ReadObject(obj, pos, iov[i].iov_base, iov[i].iov_len);
+		read += iov[i].iov_len - remain;
+		pos += iov[i].iov_len - remain;
+		if (remain > 0)		// end of file or error, stop here.
+			break;
+	}
+
+	if (use_obj_pos)
+		obj->pos = pos;
 
 	if (HAVE_BADBLOCK(dev)) 
-		uffs_BadBlockRecover(dev);
+		uffs_BadBlockRecoverUrgent(dev);
 
 	uffs_ObjectDevUnLock(obj);
 
 	uffs_Assert(fnode == obj->node, "obj->node change!\n");
 
-	return len - remain;
+	return read;
+}
+
+/**
+ * read data from obj
+ *
+ * \param[in] obj uffs object
+ * \param[out] data output data buffer
+ * \param[in] len required length of data to be read from object->pos
+ *
+ * \return return bytes of data have been read
+ */
+int uffs_ReadObject(uffs_Object *obj, void *data, int len)
+{
+	struct uffs_iovec iov;
+
+	iov.iov_base = data;
+	iov.iov_len = len;
+
+	return do_ReadObjectAt(obj, &iov, 1, U_TRUE, 0);
+}
+
+/**
+ * read data from obj at given offset, obj->pos is not changed.
+ *
+ * \param[in] obj uffs object
+ * \param[in] ofs offset in the file where data to be read
+ * \param[out] data output data buffer
+ * \param[in] len required length of data to be read from #ofs
+ *
+ * \return return bytes of data have been read
+ */
+int uffs_ReadObjectAt(uffs_Object *obj, u32 ofs, void *data, int len)
+{
+	struct uffs_iovec iov;
+
+	iov.iov_base = data;
+	iov.iov_len = len;
+
+	return do_ReadObjectAt(obj, &iov, 1, U_FALSE, ofs);
+}
+
+/**
+ * read data from obj into segments, from obj->pos, in one critical section.
+ *
+ * \param[in] obj uffs object
+ * \param[in] iov output data segments, filled in array order
+ * \param[in] iovcnt number of segments in #iov
+ *
+ * \return return bytes of data have been read
+ */
+int uffs_ReadObjectV(uffs_Object *obj, const struct uffs_iovec *iov, int iovcnt)
+{
+	return do_ReadObjectAt(obj, iov, iovcnt, U_TRUE, 0);
+}
+
+/**
+ * read data from obj at given offset into segments, in one critical section.
+ * obj->pos is not changed.
+ *
+ * \param[in] obj uffs object
+ * \param[in] ofs offset in the file where data to be read
+ * \param[in] iov output data segments, filled in array order
+ * \param[in] iovcnt number of segments in #iov
+ *
+ * \return return bytes of data have been read
+ */
+int uffs_ReadObjectAtV(uffs_Object *obj, u32 ofs, const struct uffs_iovec *iov, int iovcnt)
+{
+	return do_ReadObjectAt(obj, iov, iovcnt, U_FALSE, ofs);
+}
+
+/**
+ * reserve erased blocks for appending #len bytes to the end of obj.
+ *
+ * The reserved blocks are checked (erased if necessary) here, later new
+ * blocks of this file are taken from the reservation so that the write
+ * path doesn't need to do the erase-check work when crossing block boundary.
+ * Unused reserved blocks are returned when the object is closed.
+ *
+ * \param[in] obj file object
+ * \param[in] len bytes to be appended
+ *
+ * \return U_SUCC if enough blocks been reserved, otherwise U_FAIL
+ *
+ * \note only one file can hold reserved blocks on a device at a time,
+ *		reserving for another file fails with #UEBUSY until the reservation
+ *		is used up or the holder is closed. The reservation belongs to the
+ *		object which made it last, closing other handles of the same file
+ *		keeps it. Appending past the maximum file size fails with #UEINVAL.
+ */
+URET uffs_PreallocObject(uffs_Object *obj, u32 len)
+{
+	uffs_Device *dev = obj->dev;
+	TreeNode *fnode;
+	u32 flen, end;
+	u32 last_fdn, end_fdn;
+	int count;
+	URET ret;
+
+	if (obj->dev == NULL || obj->open_succ != U_TRUE) {
+		obj->err = UEBADF;
+		return U_FAIL;
+	}
+
+	if (obj->type != UFFS_TYPE_FILE) {
+		obj->err = UEISDIR;
+		return U_FAIL;
+	}
+
+	if (obj->oflag == UO_RDONLY) {
+		obj->err = UEACCES;
+		return U_FAIL;
+	}
+
+	if (len == 0)
+		return U_SUCC;
+
+	fnode = obj->node;
+
+	uffs_ObjectDevLock(obj);
+
+	flen = FILE_NODE_LEN(obj->dev, fnode);
+	end = flen + len - 1;
+
+	// file can't grow past 4GB or the last data block serial
+	if (end < flen || GetFdnByOfs(obj, end) > MAX_UFFS_FDN) {
+		uffs_ObjectDevUnLock(obj);
+		obj->err = UEINVAL;
+		return U_FAIL;
+	}
+
+	// blocks already allocated: file head block + data block 1 .. last_fdn
+	last_fdn = (flen == 0 ? 0 : GetFdnByOfs(obj, flen - 1));
+	end_fdn = GetFdnByOfs(obj, end);
+	count = (int)(end_fdn - last_fdn);
+
+#ifdef CONFIG_UFFS_SMALL_FILE_PACK
+	// packed file needs a head block when it grows out of pack block
+	if (IS_PACKED_FILE(dev, fnode->u.file.serial) && !FIT_IN_PACK(dev, flen + len))
+		count++;
+#endif
+
+	if (count <= 0) {
+		ret = U_SUCC;	// blocks already allocated
+	}
+	else if (dev->tree.prealloc_count > 0 &&
+			dev->tree.prealloc_owner != fnode->u.file.serial) {
+		uffs_Perror(UFFS_MSG_NOISY, "blocks are reserved by file %d", dev->tree.prealloc_owner);
+		obj->err = UEBUSY;
+		ret = U_FAIL;
+	}
+	else {
+		ret = uffs_TreePreallocBlocks(dev, fnode->u.file.serial, count);
+		if (ret != U_SUCC) {
+			uffs_Perror(UFFS_MSG_NOISY, "insufficient block for preallocation");
+			obj->err = UENOMEM;
+		}
+		else {
+			// released when this object is closed, not other handles of the file
+			dev->tree.prealloc_holder = obj;
+		}
+	}
+
+	if (HAVE_BADBLOCK(dev))
+		uffs_BadBlockRecoverUrgent(dev);
+
+	uffs_ObjectDevUnLock(obj);
+
+	return ret;
 }
 
 /**
@@ -1321,11 +1719,11 @@ long uffs_SeekObject(uffs_Object *obj, long offset, int origin)
 				}
 				break;
 			case USEEK_END:
-				if ((long)obj->node->u.file.len + offset < 0) {
+				if ((long)FILE_NODE_LEN(obj->dev, obj->node) + offset < 0) {
 					obj->err = UEINVAL;
 				}
 				else {
-					obj->pos = obj->node->u.file.len + offset;
+					obj->pos = FILE_NODE_LEN(obj->dev, obj->node) + offset;
 				}
 				break;
 		}
@@ -1364,7 +1762,7 @@ int uffs_EndOfFile(uffs_Object *obj)
 {
 	if (obj) {
 		if (obj->dev && obj->type == UFFS_TYPE_FILE && obj->open_succ == U_TRUE) {
-			if (obj->pos >= obj->node->u.file.len) {
+			if (obj->pos >= FILE_NODE_LEN(obj->dev, obj->node)) {
 				return 1;
 			}
 			else {
@@ -1405,7 +1803,7 @@ static URET do_TruncateInternalWithBlockRecover(uffs_Object *obj,
 		block = node->u.file.block;
 	}
 	else {
-		node = uffs_TreeFindDataNode(dev, fnode->u.file.serial, fdn);
+		node = _FindDataNode(obj, fdn);
 		if (node == NULL) {
 			obj->err = UEIOERR;
 			uffs_Perror(UFFS_MSG_SERIOUS,
@@ -1555,18 +1953,18 @@ static URET do_TruncateObject(uffs_Object *obj, u32 remain, RunOptionE run_opt)
 		goto ext;
 	}
 
-	flen = fnode->u.file.len;
+	flen = FILE_NODE_LEN(obj->dev, fnode);
 
 	if (flen < remain) {
 		// file is shorter than 'reamin', fill the gap with '\0'
 		if (run_opt == eREAL_RUN) {
 			obj->pos = flen;  // move file pointer to the end
-			if (do_WriteObject(obj, NULL, remain - flen) > 0) {	// fill '\0' ...
+			if (do_WriteObject(obj, flen, NULL, remain - flen) > 0) {	// fill '\0' ...
 				uffs_Perror(UFFS_MSG_SERIOUS, "Write object not finished. expect %d but only %d wrote.",
-												remain - flen, fnode->u.file.len - flen);
+												remain - flen, FILE_NODE_LEN(obj->dev, fnode) - flen);
 				obj->err = UEIOERR;   // likely be an I/O error.
 			}
-			flen = obj->node->u.file.len;
+			flen = FILE_NODE_LEN(obj->dev, obj->node);
 		}
 	}
 	else {
@@ -1577,7 +1975,7 @@ static URET do_TruncateObject(uffs_Object *obj, u32 remain, RunOptionE run_opt)
 
 			block_start = GetStartOfDataBlock(obj, fdn);
 			if (remain <= block_start && fdn > 0) {
-				node = uffs_TreeFindDataNode(dev, obj->serial, fdn);
+				node = _FindDataNode(obj, fdn);
 				if (node == NULL) {
 					uffs_Perror(UFFS_MSG_SERIOUS,
 								"can't find data node when trancate obj.");
@@ -1613,7 +2011,7 @@ static URET do_TruncateObject(uffs_Object *obj, u32 remain, RunOptionE run_opt)
 					uffs_TreeEraseNode(dev, node);
 					uffs_TreeInsertToErasedListTail(dev, node);
 
-					fnode->u.file.len = block_start;
+					FILE_NODE_LEN(obj->dev, fnode) = block_start;
 				}
 
 				flen = block_start;
@@ -1623,7 +2021,7 @@ static URET do_TruncateObject(uffs_Object *obj, u32 remain, RunOptionE run_opt)
 				if (do_TruncateInternalWithBlockRecover(obj, fdn,
 														remain, run_opt) == U_SUCC) {
 					if (run_opt == eREAL_RUN)
-						fnode->u.file.len = remain;
+						FILE_NODE_LEN(obj->dev, fnode) = remain;
 					flen = remain;
 				}
 			}
@@ -1631,7 +2029,7 @@ static URET do_TruncateObject(uffs_Object *obj, u32 remain, RunOptionE run_opt)
 	}
 
 	if (HAVE_BADBLOCK(dev)) 
-		uffs_BadBlockRecover(dev);
+		uffs_BadBlockRecoverUrgent(dev);
 ext:
 	obj->pos = pos;  // keep file pointer offset not changed.
 
@@ -1674,10 +2072,10 @@ int _CheckObjBufRef(uffs_Object *obj)
 
 	if (buf == NULL || buf->ref_count == 0) {
 		// check the DATA block
-		if (obj->type == UFFS_TYPE_FILE && node->u.file.len > 0) {
+		if (obj->type == UFFS_TYPE_FILE && FILE_NODE_LEN(obj->dev, node) > 0) {
 
 			parent = obj->serial;
-			last_serial = GetFdnByOfs(obj, node->u.file.len - 1);
+			last_serial = GetFdnByOfs(obj, FILE_NODE_LEN(obj->dev, node) - 1);
 			for (serial = 1; serial <= last_serial; serial++) {
 
 				for (buf = uffs_BufFind(dev, parent, serial);
@@ -1760,7 +2158,7 @@ URET uffs_DeleteObjectDirect(uffs_Object *obj, int *err)
 	uffs_Object *work;
 	TreeNode *node, *d_node;
 	uffs_Device *dev = NULL;
-	u16 block;
+	uffs_BlockNum block;
 	u16 serial, parent, last_serial;
 	URET ret = U_FAIL;
 
@@ -1810,10 +2208,28 @@ URET uffs_DeleteObjectDirect(uffs_Object *obj, int *err)
 
 	node = obj->node;
 
+#ifdef CONFIG_UFFS_INFO_CACHE
+	uffs_InfoCacheDrop(dev, obj->type, obj->serial);
+#endif
+#ifdef CONFIG_UFFS_DENTRY_CACHE
+	uffs_DentryCacheDrop(dev, obj->serial);
+#endif
+
+#ifdef CONFIG_UFFS_SMALL_FILE_PACK
+	if (obj->type == UFFS_TYPE_FILE && IS_PACKED_FILE(dev, obj->serial)) {
+		// packed file doesn't own a block, drop it from pack block.
+		if (uffs_PackDeleteFile(dev, node) == U_SUCC)
+			ret = U_SUCC;
+		else if (err)
+			*err = UEIOERR;
+		goto ext_lock;
+	}
+#endif
+
 	// ok, now we are safe to erase DIR/FILE block :-)
 	block = GET_BLOCK_FROM_NODE(obj);
 	parent = obj->serial;
-	last_serial = (obj->type == UFFS_TYPE_FILE && node->u.file.len > 0 ? GetFdnByOfs(obj, node->u.file.len - 1) : 0);
+	last_serial = (obj->type == UFFS_TYPE_FILE && FILE_NODE_LEN(obj->dev, node) > 0 ? GetFdnByOfs(obj, FILE_NODE_LEN(obj->dev, node) - 1) : 0);
 
 	uffs_BreakFromEntry(dev, obj->type, node);
 	node->u.list.block = block;
@@ -1909,6 +2325,9 @@ URET uffs_MoveObjectEx(uffs_Object *obj,
 		buf->parent = new_parent;	// !! need to manually change the 'parent' !!
 		uffs_BufWrite(dev, buf, &fi, 0, sizeof(uffs_FileInfo));
 		uffs_BufPut(dev, buf);
+#ifdef CONFIG_UFFS_INFO_CACHE
+		uffs_InfoCacheUpdate(dev, obj->type, obj->serial, &fi);
+#endif
 
 		// !! force a block recover so that all old tag will be expired !!
 		// This is important so we only need to check
@@ -1930,6 +2349,13 @@ URET uffs_MoveObjectEx(uffs_Object *obj,
 		obj->node->u.file.parent = new_parent;
 	}
 
+#ifdef CONFIG_UFFS_DENTRY_CACHE
+	uffs_DentryCacheDrop(dev, obj->serial);
+	if (name_len > 0)
+		uffs_DentryCacheAdd(dev, new_parent, obj->name, obj->name_len,
+							obj->sum, obj->type, obj->serial);
+#endif
+
 ext_1:
 	uffs_ObjectDevUnLock(obj);
 ext:
@@ -0,0 +1,267 @@
+/*
+  This file is part of UFFS, the Ultra-low-cost Flash File System.
+  
+  Copyright (C) 2005-2009 Ricky Zheng <ricky_gz_zheng@yahoo.co.nz>
+
+  UFFS is free software; you can redistribute it and/or modify it under
+  the GNU Library General Public License as published by the Free Software 
+  Foundation; either version 2 of the License, or (at your option) any
+  later version.
+
+  UFFS is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+  or GNU Library General Public License, as applicable, for more details.
+ 
+  You should have received a copy of the GNU General Public License
+  and GNU Library General Public License along with UFFS; if not, write
+  to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA  02110-1301, USA.
+
+  As a special exception, if other files instantiate templates or use
+  macros or inline functions from this file, or you compile this file
+  and link it with other works to produce a work based on this file,
+  this file does not by itself cause the resulting work to be covered
+  by the GNU General Public License. However the source code for this
+  file must still be made available in accordance with section (3) of
+  the GNU General Public License v2.
+ 
+  This exception does not invalidate any other reasons why a work based
+  on this file might be covered by the GNU General Public License.
+*/
+
+
+
+/**
+ * \file uffs_infocache.c
+ * \brief in-RAM cache of file/dir info (uffs_FileInfo)
+ * \author Ricky Zheng
+ */
+
+#include "uffs_config.h"
+#include "uffs/uffs_public.h"
+#include "uffs/uffs_device.h"
+#include "uffs/uffs_buf.h"
+#include "uffs/uffs_infocache.h"
+#include <string.h>
+
+#define PFX "icac: "
+
+#ifdef CONFIG_UFFS_INFO_CACHE
+
+/** take entry out of LRU list */
+static void _Unlink(struct uffs_InfoCacheSt *ic, uffs_InfoCacheEntry *e)
+{
+	if (e->prev)
+		e->prev->next = e->next;
+	else
+		ic->head = e->next;
+
+	if (e->next)
+		e->next->prev = e->prev;
+	else
+		ic->tail = e->prev;
+}
+
+/** put entry to the head (most recently used) of LRU list */
+static void _MoveToHead(struct uffs_InfoCacheSt *ic, uffs_InfoCacheEntry *e)
+{
+	if (ic->head == e)
+		return;
+
+	_Unlink(ic, e);
+	e->prev = NULL;
+	e->next = ic->head;
+	if (ic->head)
+		ic->head->prev = e;
+	ic->head = e;
+	if (ic->tail == NULL)
+		ic->tail = e;
+}
+
+/** put entry to the tail (reused first) of LRU list */
+static void _MoveToTail(struct uffs_InfoCacheSt *ic, uffs_InfoCacheEntry *e)
+{
+	if (ic->tail == e)
+		return;
+
+	_Unlink(ic, e);
+	e->next = NULL;
+	e->prev = ic->tail;
+	if (ic->tail)
+		ic->tail->next = e;
+	ic->tail = e;
+	if (ic->head == NULL)
+		ic->head = e;
+}
+
+static uffs_InfoCacheEntry * _Find(struct uffs_InfoCacheSt *ic, int type, u16 serial)
+{
+	uffs_InfoCacheEntry *e;
+
+	// free entries are at the tail, stop at the first one.
+	for (e = ic->head; e != NULL && e->type != UFFS_TYPE_INVALID; e = e->next) {
+		if (e->serial == serial && e->type == type)
+			return e;
+	}
+
+	return NULL;
+}
+
+/** take the least recently used entry for (type, serial) */
+static uffs_InfoCacheEntry * _Alloc(struct uffs_InfoCacheSt *ic, int type, u16 serial)
+{
+	uffs_InfoCacheEntry *e = ic->tail;
+
+	if (e) {
+		e->type = (u8)type;
+		e->serial = serial;
+		_MoveToHead(ic, e);
+	}
+
+	return e;
+}
+
+/**
+ * \brief initialize info cache
+ * \param[in] dev uffs device
+ * \return U_SUCC or U_FAIL
+ */
+URET uffs_InfoCacheInit(uffs_Device *dev)
+{
+	int size = sizeof(uffs_InfoCacheEntry) * UFFS_INFO_CACHE_ENTRIES;
+	uffs_InfoCacheEntry *entries;
+	int i;
+
+	if (dev->mem.info_cache_pool_size == 0 && dev->mem.malloc) {
+		dev->mem.info_cache_pool_buf = dev->mem.malloc(dev, size);
+		if (dev->mem.info_cache_pool_buf)
+			dev->mem.info_cache_pool_size = size;
+	}
+	if (dev->mem.info_cache_pool_size < size) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "info cache require %d but only %d available.",
+					size, dev->mem.info_cache_pool_size);
+		return U_FAIL;
+	}
+
+	entries = (uffs_InfoCacheEntry *)dev->mem.info_cache_pool_buf;
+	for (i = 0; i < UFFS_INFO_CACHE_ENTRIES; i++) {
+		entries[i].type = UFFS_TYPE_INVALID;
+		entries[i].serial = INVALID_UFFS_SERIAL;
+		entries[i].prev = (i > 0 ? &entries[i - 1] : NULL);
+		entries[i].next = (i < UFFS_INFO_CACHE_ENTRIES - 1 ? &entries[i + 1] : NULL);
+	}
+	dev->info_cache.head = &entries[0];
+	dev->info_cache.tail = &entries[UFFS_INFO_CACHE_ENTRIES - 1];
+	dev->info_cache.hit = 0;
+	dev->info_cache.miss = 0;
+
+	return U_SUCC;
+}
+
+/**
+ * \brief release info cache memory
+ * \param[in] dev uffs device
+ */
+void uffs_InfoCacheRelease(uffs_Device *dev)
+{
+	if (dev->mem.info_cache_pool_buf && dev->mem.free) {
+		dev->mem.free(dev, dev->mem.info_cache_pool_buf);
+		dev->mem.info_cache_pool_buf = NULL;
+		dev->mem.info_cache_pool_size = 0;
+	}
+	memset(&(dev->info_cache), 0, sizeof(struct uffs_InfoCacheSt));
+}
+
+/**
+ * \brief drop all cached info, e.g. after device is formatted
+ * \param[in] dev uffs device
+ */
+void uffs_InfoCacheClear(uffs_Device *dev)
+{
+	uffs_InfoCacheEntry *e;
+
+	for (e = dev->info_cache.head; e != NULL; e = e->next) {
+		e->type = UFFS_TYPE_INVALID;
+		e->serial = INVALID_UFFS_SERIAL;
+	}
+}
+
+/**
+ * \brief get info of DIR/FILE object
+ * \param[in] dev uffs device
+ * \param[in] type UFFS_TYPE_DIR or UFFS_TYPE_FILE
+ * \param[in] node tree node of the object
+ * \return the info, or NULL if failed to load info from flash.
+ * \note the returned info is only valid before next info cache operation,
+ *		caller should hold the device lock.
+ */
+const uffs_FileInfo * uffs_InfoCacheGet(uffs_Device *dev, int type, TreeNode *node)
+{
+	struct uffs_InfoCacheSt *ic = &dev->info_cache;
+	u16 serial = (type == UFFS_TYPE_DIR ? node->u.dir.serial : node->u.file.serial);
+	uffs_InfoCacheEntry *e;
+	uffs_Buf *buf;
+
+	e = _Find(ic, type, serial);
+	if (e) {
+		ic->hit++;
+		_MoveToHead(ic, e);
+		return &e->info;
+	}
+
+	ic->miss++;
+	buf = uffs_BufGetEx(dev, (u8)type, node, 0, 0);
+	if (buf == NULL)
+		return NULL;
+
+	e = _Alloc(ic, type, serial);
+	if (e)
+		memcpy(&e->info, buf->data, sizeof(uffs_FileInfo));
+	uffs_BufPut(dev, buf);
+
+	return e ? &e->info : NULL;
+}
+
+/**
+ * \brief info of object is changed, update the cache
+ * \param[in] dev uffs device
+ * \param[in] type UFFS_TYPE_DIR or UFFS_TYPE_FILE
+ * \param[in] serial object serial
+ * \param[in] fi new info
+ */
+void uffs_InfoCacheUpdate(uffs_Device *dev, int type, u16 serial, const uffs_FileInfo *fi)
+{
+	struct uffs_InfoCacheSt *ic = &dev->info_cache;
+	uffs_InfoCacheEntry *e;
+
+	e = _Find(ic, type, serial);
+	if (e == NULL)
+		e = _Alloc(ic, type, serial);
+	else
+		_MoveToHead(ic, e);
+
+	if (e)
+		memcpy(&e->info, fi, sizeof(uffs_FileInfo));
+}
+
+/**
+ * \brief object is deleted, drop it from cache
+ * \param[in] dev uffs device
+ * \param[in] type UFFS_TYPE_DIR or UFFS_TYPE_FILE
+ * \param[in] serial object serial
+ */
+void uffs_InfoCacheDrop(uffs_Device *dev, int type, u16 serial)
+{
+	struct uffs_InfoCacheSt *ic = &dev->info_cache;
+	uffs_InfoCacheEntry *e;
+
+	e = _Find(ic, type, serial);
+	if (e) {
+		e->type = UFFS_TYPE_INVALID;
+		e->serial = INVALID_UFFS_SERIAL;
+		_MoveToTail(ic, e);
+	}
+}
+
+#endif
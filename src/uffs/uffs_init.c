@@ -124,12 +124,36 @@ uffs_DeviceMountStatus uffs_InitDevice(uffs_Device *dev)
 		goto fail;
 	}
 
+#ifdef CONFIG_UFFS_BBT
+	ret = uffs_BbtInit(dev);
+	if (ret != U_SUCC) {
+		uffs_Perror(UFFS_MSG_DEAD, "Initialize bad block table fail");
+		goto fail;
+	}
+#endif
+
 	ret = uffs_TreeInit(dev);
 	if (ret != U_SUCC) {
 		uffs_Perror(UFFS_MSG_SERIOUS, "fail to init tree buffers");
 		goto fail;
 	}
 
+#ifdef CONFIG_UFFS_INFO_CACHE
+	ret = uffs_InfoCacheInit(dev);
+	if (ret != U_SUCC) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "fail to init info cache");
+		goto fail;
+	}
+#endif
+
+#ifdef CONFIG_UFFS_DENTRY_CACHE
+	ret = uffs_DentryCacheInit(dev);
+	if (ret != U_SUCC) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "fail to init dentry cache");
+		goto fail;
+	}
+#endif
+
 	if (dev->serial_ops != NULL) {
 		ret = uffs_DeserializeState(dev);
 		result.device_state_serialization_status = ret;
@@ -149,6 +173,14 @@ uffs_DeviceMountStatus uffs_InitDevice(uffs_Device *dev)
 		goto fail;
 	}
 
+#ifdef CONFIG_UFFS_AIO
+	ret = uffs_AioWorkerStart(dev);
+	if (ret != U_SUCC) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "fail to start aio worker");
+		goto fail;
+	}
+#endif
+
 	result.mount_status = ret;
 	return result;
 
@@ -162,6 +194,14 @@ URET uffs_ReleaseDevice(uffs_Device *dev)
 {
 	URET ret;
 
+#ifdef CONFIG_UFFS_AIO
+	// finish submitted requests before anything is released
+	uffs_AioWorkerStop(dev);
+#endif
+
+	// reserved blocks are still erased on flash, put them back before saving the state.
+	uffs_TreeReleasePrealloc(dev);
+
 	if (dev->serial_ops != NULL) {
 		ret = uffs_SerializeState(dev);
 		if (ret != U_SUCC) {
@@ -169,6 +209,12 @@ URET uffs_ReleaseDevice(uffs_Device *dev)
 		}
 	}
 
+#ifdef CONFIG_UFFS_BBT
+	// last chance to save a table which failed to be saved
+	if (uffs_BbtSync(dev) != U_SUCC)
+		uffs_Perror(UFFS_MSG_SERIOUS, "BBT is not saved, it'll be checked on next mount");
+#endif
+
 	ret = uffs_BlockInfoReleaseCache(dev);
 	if (ret != U_SUCC) {
 		uffs_Perror(UFFS_MSG_SERIOUS,  "fail to release block info.");
@@ -187,6 +233,20 @@ URET uffs_ReleaseDevice(uffs_Device *dev)
 		goto ext;
 	}
 
+#ifdef CONFIG_UFFS_BBT
+	uffs_BbtRelease(dev);
+#endif
+
+#ifdef CONFIG_UFFS_INFO_CACHE
+	uffs_InfoCacheRelease(dev);
+#endif
+
+#ifdef CONFIG_UFFS_DENTRY_CACHE
+	uffs_DentryCacheRelease(dev);
+#endif
+
+	uffs_BadBlockRelease(dev);
+
 	ret = uffs_FlashInterfaceRelease(dev);
 	if (ret != U_SUCC) {
 		uffs_Perror(UFFS_MSG_SERIOUS, "fail to release tree buffers!");
@@ -51,6 +51,17 @@
 static struct uffs_MountTableEntrySt *m_head = NULL;		// list of mounted entries
 static struct uffs_MountTableEntrySt *m_free_head = NULL;	// list of unmounted entries
 
+#ifdef CONFIG_USE_PER_DEVICE_LOCK
+// without global lock, mount table lists and device ref_count are
+// protected by this lock, it's created by the first uffs_RegisterMountTable().
+static OSSEM m_lock = OSSEM_NOT_INITED;
+#define MTB_LOCK()		uffs_SemWait(m_lock)
+#define MTB_UNLOCK()	uffs_SemSignal(m_lock)
+#else
+#define MTB_LOCK()
+#define MTB_UNLOCK()
+#endif
+
 /** Return mounted entries header */
 uffs_MountTable * uffs_MtbGetMounted(void)
 {
@@ -77,14 +88,24 @@ int uffs_RegisterMountTable(uffs_MountTable *mtb)
 	if (mtb == NULL) 
 		return -1;
 
+#ifdef CONFIG_USE_PER_DEVICE_LOCK
+	if (m_lock == OSSEM_NOT_INITED && uffs_SemCreate(&m_lock) < 0)
+		return -1;
+#endif
+
+	MTB_LOCK();
 	for (work = m_head; work; work = work->next) {
-		if (work == mtb)
+		if (work == mtb) {
+			MTB_UNLOCK();
 			return -1; // already mounted ?
+		}
 	}
 
 	for (work = m_free_head; work; work = work->next) {
-		if (work == mtb)
+		if (work == mtb) {
+			MTB_UNLOCK();
 			return 0; // already registered.
+		}
 	}
 
 	/* replace the free head */
@@ -95,6 +116,7 @@ int uffs_RegisterMountTable(uffs_MountTable *mtb)
 	m_free_head = mtb;
 	
 	mtb->dev->dev_num = ++dev_num;
+	MTB_UNLOCK();
 
 	return 0;
 }
@@ -112,9 +134,12 @@ int uffs_UnRegisterMountTable(uffs_MountTable *mtb)
 	if (mtb == NULL)
 		return -1;
 
+	MTB_LOCK();
 	for (work = m_head; work; work = work->next) {
-		if (work == mtb)
+		if (work == mtb) {
+			MTB_UNLOCK();
 			return -1;	// in the mounted list ? busy, return
+		}
 	}
 
 	for (work = m_free_head; work; work = work->next) {
@@ -130,6 +155,7 @@ int uffs_UnRegisterMountTable(uffs_MountTable *mtb)
 			break;
 		}
 	}
+	MTB_UNLOCK();
 
 	return work ? 0 : -1;
 }
@@ -145,59 +171,50 @@ static uffs_MountTable * uffs_GetMountTableByMountPoint(const char *mount, uffs_
 	return work;
 }
 
-/**
- * \brief mount partition
- * \param[in] mount partition mount point
- * \return 0 succ
- *         <0 fail
- *
- * \note use uffs_RegisterMountTable() register mount entry before you can mount it.
- *       mount point should ended with '/', e.g. '/sys/'
- */
-uffs_DeviceMountStatus uffs_Mount(const char *mount)
+/** check mount table and initialize device driver, before scanning the partition */
+static URET MountPrepare(uffs_MountTable *mtb)
 {
-	uffs_DeviceMountStatus result = {U_FAIL, U_FAIL};
-	uffs_MountTable *mtb;
-
-	if (uffs_GetMountTableByMountPoint(mount, m_head) != NULL) {
-		uffs_Perror(UFFS_MSG_NOISY,	"'%s' already mounted", mount);
-		return result; // already mounted ?
-	}
-	
-	mtb = uffs_GetMountTableByMountPoint(mount, m_free_head);
-	if (mtb == NULL) {
-		uffs_Perror(UFFS_MSG_NOISY,	"'%s' not registered", mount);
-		return result;	// not registered ?
-	}
+	u32 end;
 
 	uffs_Perror(UFFS_MSG_NOISY,
 				"init device for mount point %s ...",
 				mtb->mount);
 
-	mtb->dev->par.start = mtb->start_block;
 	if (mtb->end_block < 0) {
-		mtb->dev->par.end = 
-			mtb->dev->attr->total_blocks + mtb->end_block;
+		end = mtb->dev->attr->total_blocks + mtb->end_block;
 	}
 	else {
-		mtb->dev->par.end = mtb->end_block;
+		end = mtb->end_block;
+	}
+
+	if (end >= UFFS_INVALID_BLOCK) {
+		// block number won't fit in uffs_BlockNum
+		uffs_Perror(UFFS_MSG_SERIOUS,
+					"partition end block %u out of range, "
+					"CONFIG_UFFS_WIDE_BLOCK_ADDR is required", end);
+		return U_FAIL;
 	}
 
+	mtb->dev->par.start = mtb->start_block;
+	mtb->dev->par.end = end;
+
 	if (mtb->dev->Init(mtb->dev) == U_FAIL) {
 		uffs_Perror(UFFS_MSG_SERIOUS,
 					"init device for mount point %s fail",
 					mtb->mount);
-		return result;
+		return U_FAIL;
 	}
 
 	uffs_Perror(UFFS_MSG_NOISY, "mount partiton: %d,%d",
 		mtb->dev->par.start, mtb->dev->par.end);
 
-	result = uffs_InitDevice(mtb->dev);
-	if (result.mount_status != U_SUCC) {
-		uffs_Perror(UFFS_MSG_SERIOUS, "init device fail !");
-		return result;
-	}
+	return U_SUCC;
+}
+
+/** move mount table entry from unmounted list to mounted list */
+static void MountLink(uffs_MountTable *mtb)
+{
+	MTB_LOCK();
 
 	/* now break it from unmounted list */
 	if (mtb->prev)
@@ -214,9 +231,120 @@ uffs_DeviceMountStatus uffs_Mount(const char *mount)
 		m_head->prev = mtb;
 	m_head = mtb;
 
+	MTB_UNLOCK();
+}
+
+/**
+ * \brief mount partition
+ * \param[in] mount partition mount point
+ * \return 0 succ
+ *         <0 fail
+ *
+ * \note use uffs_RegisterMountTable() register mount entry before you can mount it.
+ *       mount point should ended with '/', e.g. '/sys/'
+ */
+uffs_DeviceMountStatus uffs_Mount(const char *mount)
+{
+	uffs_DeviceMountStatus result = {U_FAIL, U_FAIL};
+	uffs_MountTable *mtb;
+
+	MTB_LOCK();
+	if (uffs_GetMountTableByMountPoint(mount, m_head) != NULL) {
+		MTB_UNLOCK();
+		uffs_Perror(UFFS_MSG_NOISY,	"'%s' already mounted", mount);
+		return result; // already mounted ?
+	}
+	
+	mtb = uffs_GetMountTableByMountPoint(mount, m_free_head);
+	MTB_UNLOCK();
+	if (mtb == NULL) {
+		uffs_Perror(UFFS_MSG_NOISY,	"'%s' not registered", mount);
+		return result;	// not registered ?
+	}
+
+	if (MountPrepare(mtb) != U_SUCC)
+		return result;
+
+	result = uffs_InitDevice(mtb->dev);
+	if (result.mount_status != U_SUCC) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "init device fail !");
+		return result;
+	}
+
+	MountLink(mtb);
+
 	return result;
 }
 
+#ifdef CONFIG_UFFS_PARALLEL_MOUNT
+static void MountTask(void *arg)
+{
+	uffs_MountTable *mtb = (uffs_MountTable *)arg;
+
+	mtb->status = uffs_InitDevice(mtb->dev);
+}
+#endif
+
+/**
+ * \brief mount all registered partitions
+ * \return number of partitions mounted
+ *
+ * \note with CONFIG_UFFS_PARALLEL_MOUNT, device drivers are initialized
+ *       (and storage attributes checked) one by one, then partitions are
+ *       scanned in parallel, one task per partition, so the mount time is
+ *       that of the largest partition instead of the sum of all.
+ *       Storage attributes must be set up before calling it, not by InitFlash().
+ *       Call it before other tasks use UFFS.
+ */
+int uffs_MountAll(void)
+{
+	uffs_MountTable *mtb, *next;
+	int count = 0;
+
+#ifdef CONFIG_UFFS_PARALLEL_MOUNT
+	for (mtb = m_free_head; mtb; mtb = mtb->next) {
+		mtb->status.mount_status = U_FAIL;
+		mtb->status.device_state_serialization_status = U_FAIL;
+		mtb->task = OSTASK_NOT_CREATED;
+
+		// partitions may share storage attributes, fill them in here
+		// before mount tasks of other partitions read them.
+		if (MountPrepare(mtb) != U_SUCC || uffs_FlashInitLayout(mtb->dev) != U_SUCC)
+			continue;
+
+		if (uffs_OSTaskCreate(&mtb->task, MountTask, mtb) != 0) {
+			uffs_Perror(UFFS_MSG_NORMAL,
+						"can't create mount task for %s", mtb->mount);
+			mtb->task = OSTASK_NOT_CREATED;
+			mtb->status = uffs_InitDevice(mtb->dev);
+		}
+	}
+
+	for (mtb = m_free_head; mtb; mtb = next) {
+		next = mtb->next;
+
+		if (mtb->task != OSTASK_NOT_CREATED)
+			uffs_OSTaskJoin(&mtb->task);
+
+		if (mtb->status.mount_status == U_SUCC) {
+			MountLink(mtb);
+			count++;
+		}
+		else {
+			uffs_Perror(UFFS_MSG_SERIOUS, "mount %s fail !", mtb->mount);
+		}
+	}
+#else
+	for (mtb = m_free_head; mtb; mtb = next) {
+		next = mtb->next;
+		if (uffs_Mount(mtb->mount).mount_status == U_SUCC)
+			count++;
+	}
+#endif
+
+	return count;
+}
+
 /**
  * \brief unmount parttion
  * \param[in] mount partition mount point
@@ -225,33 +353,30 @@ uffs_DeviceMountStatus uffs_Mount(const char *mount)
  */
 int uffs_UnMount(const char *mount)
 {
-	uffs_MountTable *mtb = uffs_GetMountTableByMountPoint(mount, m_head);
+	uffs_MountTable *mtb;
 
+	MTB_LOCK();
+	mtb = uffs_GetMountTableByMountPoint(mount, m_head);
 	if (mtb == NULL) {
+		MTB_UNLOCK();
 		uffs_Perror(UFFS_MSG_NOISY,	"'%s' not mounted ?", mount);
 		return -1;  // not mounted ?
 	}
 
 	if (uffs_GetMountTableByMountPoint(mount, m_free_head) != NULL) {
+		MTB_UNLOCK();
 		uffs_Perror(UFFS_MSG_NOISY,	"'%s' already unmounted ?", mount);
 		return -1;  // already unmounted ?
 	}
 
-	if (HAVE_BADBLOCK(mtb->dev))
-		uffs_BadBlockRecover(mtb->dev);
-
+	// uffs_GetDeviceFromMountPoint() takes the reference under MTB_LOCK,
+	// so once the entry is off the mounted list nobody can get the device.
 	if (mtb->dev->ref_count != 0) {
+		MTB_UNLOCK();
 		uffs_Perror(UFFS_MSG_NORMAL, "Can't unmount '%s' - busy", mount);
 		return -1;
 	}
 
-	if (uffs_ReleaseDevice(mtb->dev) == U_FAIL) {
-		uffs_Perror(UFFS_MSG_NORMAL, "Can't release device for mount point '%s'", mount);
-		return -1;
-	}
-
-	mtb->dev->Release(mtb->dev);
-
 	// break from mounted list
 	if (mtb->prev)
 		mtb->prev->next = mtb->next;
@@ -259,6 +384,21 @@ int uffs_UnMount(const char *mount)
 		mtb->next->prev = mtb->prev;
 	if (mtb == m_head)
 		m_head = mtb->next;
+	mtb->prev = mtb->next = NULL;
+	MTB_UNLOCK();
+
+	if (HAVE_BADBLOCK(mtb->dev))
+		uffs_BadBlockRecover(mtb->dev);
+
+	if (uffs_ReleaseDevice(mtb->dev) == U_FAIL) {
+		uffs_Perror(UFFS_MSG_NORMAL, "Can't release device for mount point '%s'", mount);
+		MountLink(mtb);		// still mounted, put it back
+		return -1;
+	}
+
+	mtb->dev->Release(mtb->dev);
+
+	MTB_LOCK();
 
 	// put to unmounted list
 	mtb->prev = NULL;
@@ -267,6 +407,8 @@ int uffs_UnMount(const char *mount)
 		m_free_head->prev = mtb;
 	m_free_head = mtb;
 
+	MTB_UNLOCK();
+
 	return 0;
 }
 
@@ -278,27 +420,24 @@ int uffs_UnMount(const char *mount)
  */
 int uffs_GetMatchedMountPointSize(const char *path)
 {
-	int pos;
-	uffs_Device *dev;
+	int len, pos = 0;
+	uffs_MountTable *work;
 
 	if (path[0] != '/')
 		return 0;
 
-	pos = strlen(path);
-
-	while (pos > 0) {
-		if ((dev = uffs_GetDeviceFromMountPointEx(path, pos)) != NULL ) {
-			uffs_PutDevice(dev);
-			return pos;
-		}
-		else {
-			if (path[pos-1] == '/') 
-				pos--;
-			//back forward search the next '/'
-			for (; pos > 0 && path[pos-1] != '/'; pos--)
-				;
+	// the longest mount point which is the whole path,
+	// or a prefix of path ending with '/'
+	MTB_LOCK();
+	for (work = m_head; work; work = work->next) {
+		len = strlen(work->mount);
+		if (len > pos &&
+			strncmp(path, work->mount, len) == 0 &&
+			(path[len] == '\0' || path[len - 1] == '/')) {
+			pos = len;
 		}
 	}
+	MTB_UNLOCK();
 
 	return pos;
 }
@@ -311,14 +450,15 @@ int uffs_GetMatchedMountPointSize(const char *path)
  */
 uffs_Device * uffs_GetDeviceFromMountPoint(const char *mount)
 {
-	uffs_MountTable *mtb = uffs_GetMountTableByMountPoint(mount, m_head);
+	uffs_MountTable *mtb;
 
-	if (mtb) {
+	MTB_LOCK();
+	mtb = uffs_GetMountTableByMountPoint(mount, m_head);
+	if (mtb)
 		mtb->dev->ref_count++;
-		return mtb->dev;
-	}
+	MTB_UNLOCK();
 
-	return NULL;
+	return mtb ? mtb->dev : NULL;
 }
 
 /**
@@ -332,15 +472,17 @@ uffs_Device * uffs_GetDeviceFromMountPointEx(const char *mount, int len)
 {
 	uffs_MountTable *work = NULL;
 
+	MTB_LOCK();
 	for (work = m_head; work; work = work->next) {
 		if (strlen(work->mount) == len &&
 				strncmp(mount, work->mount, len) == 0) {
 			work->dev->ref_count++;
-			return work->dev;
+			break;
 		}
 	}
+	MTB_UNLOCK();
 
-	return NULL;
+	return work ? work->dev : NULL;
 }
 
 
@@ -355,18 +497,28 @@ const char * uffs_GetDeviceMountPoint(uffs_Device *dev)
 {
 	uffs_MountTable *work = NULL;
 
+	MTB_LOCK();
 	for (work = m_head; work; work = work->next) {
-		if (work->dev == dev) {
-			return work->mount;
-		}
+		if (work->dev == dev)
+			break;
 	}
+	MTB_UNLOCK();
+
+	return work ? work->mount : NULL;
+}
 
-	return NULL;	
+void uffs_GetDevice(uffs_Device *dev)
+{
+	MTB_LOCK();
+	dev->ref_count++;
+	MTB_UNLOCK();
 }
 
 void uffs_PutDevice(uffs_Device *dev)
 {
+	MTB_LOCK();
 	dev->ref_count--;
+	MTB_UNLOCK();
 }
 
 
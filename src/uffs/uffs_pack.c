@@ -0,0 +1,1268 @@
+/*
+  This file is part of UFFS, the Ultra-low-cost Flash File System.
+  
+  Copyright (C) 2005-2009 Ricky Zheng <ricky_gz_zheng@yahoo.co.nz>
+
+  UFFS is free software; you can redistribute it and/or modify it under
+  the GNU Library General Public License as published by the Free Software 
+  Foundation; either version 2 of the License, or (at your option) any
+  later version.
+
+  UFFS is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+  or GNU Library General Public License, as applicable, for more details.
+ 
+  You should have received a copy of the GNU General Public License
+  and GNU Library General Public License along with UFFS; if not, write
+  to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA  02110-1301, USA.
+
+  As a special exception, if other files instantiate templates or use
+  macros or inline functions from this file, or you compile this file
+  and link it with other works to produce a work based on this file,
+  this file does not by itself cause the resulting work to be covered
+  by the GNU General Public License. However the source code for this
+  file must still be made available in accordance with section (3) of
+  the GNU General Public License v2.
+ 
+  This exception does not invalidate any other reasons why a work based
+  on this file might be covered by the GNU General Public License.
+*/
+
+
+/**
+ * \file uffs_pack.c
+ * \brief small file packing, many small files share one 'pack' block
+ * \author Ricky Zheng
+ */
+
+#include "uffs_config.h"
+#include "uffs/uffs_public.h"
+#include "uffs/uffs_device.h"
+#include "uffs/uffs_pool.h"
+#include "uffs/uffs_flash.h"
+#include "uffs/uffs_badblock.h"
+#include "uffs/uffs_pack.h"
+#include <string.h>
+
+#define PFX "pack: "
+#define TPOOL(dev) &((dev)->mem.tree_pool)
+
+#ifdef CONFIG_UFFS_SMALL_FILE_PACK
+
+#define PACK_INFO_SIZE		((u32)sizeof(uffs_FileInfo))
+
+#define PACK_MAP_SET(dev, serial) \
+	((dev)->pack.map[(serial) / 32] |= ((u32)1 << ((serial) % 32)))
+#define PACK_MAP_CLR(dev, serial) \
+	((dev)->pack.map[(serial) / 32] &= ~((u32)1 << ((serial) % 32)))
+
+#define IS_PACK_RECORD(tag)	(TAG_IS_GOOD(tag) && TAG_TYPE(tag) == UFFS_TYPE_PACK)
+
+/** marks a pack block which has unclean page when loading packed files */
+#define PACK_LIVE_UNCLEAN	0xFFFF
+
+/** live files of the pack block drop below UFFS_PACK_SPARSE_PERCENT of pages ? */
+#define PACK_IS_SPARSE(dev, pnode) \
+	((u32)(pnode)->u.list.u.live * 100 < (u32)(dev)->attr->pages_per_block * UFFS_PACK_SPARSE_PERCENT)
+
+/** 
+ * \brief initialize small file packing, called by uffs_TreeInit()
+ * \param[in] dev uffs device
+ */
+void uffs_PackInit(uffs_Device *dev)
+{
+	int max_size;
+
+	dev->pack.list = NULL;
+	dev->pack.count = 0;
+	memset(dev->pack.map, 0, sizeof(dev->pack.map));
+
+	// file info and file data must fit in one page
+	max_size = dev->com.pg_data_size - (int)PACK_INFO_SIZE;
+	if (max_size < 0)
+		max_size = 0;
+	if (max_size > UFFS_PACK_FILE_MAX_SIZE)
+		max_size = UFFS_PACK_FILE_MAX_SIZE;
+
+	dev->pack.max_size = (u16)max_size;
+}
+
+/** 
+ * \brief put a block node to pack block list
+ * \param[in] dev uffs device
+ * \param[in] node block node, node->u.list.block is the pack block
+ */
+void uffs_PackInsertBlock(uffs_Device *dev, TreeNode *node)
+{
+	node->u.list.u.live = 0;
+	LIST_SET_PREV(dev, node, NULL);
+	LIST_SET_NEXT(dev, node, dev->pack.list);
+	if (dev->pack.list)
+		LIST_SET_PREV(dev, dev->pack.list, node);
+	dev->pack.list = node;
+}
+
+static void _PackRemoveBlock(uffs_Device *dev, TreeNode *node)
+{
+	TreeNode *prev = LIST_PREV(dev, node);
+	TreeNode *next = LIST_NEXT(dev, node);
+
+	if (prev)
+		LIST_SET_NEXT(dev, prev, next);
+	else
+		dev->pack.list = next;
+
+	if (next)
+		LIST_SET_PREV(dev, next, prev);
+}
+
+/** 
+ * \brief find pack block node
+ * \param[in] dev uffs device
+ * \param[in] block block number
+ * \return pack block node, NULL if the block is not a pack block
+ */
+TreeNode * uffs_PackFindBlockNode(uffs_Device *dev, uffs_BlockNum block)
+{
+	TreeNode *node;
+
+	for (node = dev->pack.list; node != NULL; node = LIST_NEXT(dev, node)) {
+		if (node->u.list.block == block)
+			return node;
+	}
+
+	return NULL;
+}
+
+/** 
+ * \brief re-point packed files in block #from to block #to
+ * \note call this when the pack block is replaced by a new block
+ */
+void uffs_PackMoveFiles(uffs_Device *dev, uffs_BlockNum from, uffs_BlockNum to)
+{
+	int hash;
+	uffs_NodeIndex x;
+	TreeNode *node;
+
+	for (hash = 0; hash < FILE_NODE_ENTRY_LEN; hash++) {
+		x = dev->tree.file_entry[hash];
+		while (x != EMPTY_NODE) {
+			node = FROM_IDX(x, TPOOL(dev));
+			if (IS_PACKED_FILE(dev, node->u.file.serial) && node->u.file.block == from)
+				node->u.file.block = to;
+			x = node->hash_next;
+		}
+	}
+}
+
+/** count packed files in block #block */
+static u16 _PackCountFiles(uffs_Device *dev, uffs_BlockNum block)
+{
+	int hash;
+	uffs_NodeIndex x;
+	TreeNode *node;
+	u16 count = 0;
+
+	for (hash = 0; hash < FILE_NODE_ENTRY_LEN; hash++) {
+		x = dev->tree.file_entry[hash];
+		while (x != EMPTY_NODE) {
+			node = FROM_IDX(x, TPOOL(dev));
+			if (IS_PACKED_FILE(dev, node->u.file.serial) && node->u.file.block == block)
+				count++;
+			x = node->hash_next;
+		}
+	}
+
+	return count;
+}
+
+/** remove pack block from the list, erase it (or mark it bad) and put it back to erased list */
+static void _PackFreeBlock(uffs_Device *dev, TreeNode *pnode, UBOOL bad)
+{
+	_PackRemoveBlock(dev, pnode);
+
+	if (bad) {
+		uffs_BadBlockPendingRemove(dev, pnode->u.list.block);
+		uffs_BadBlockProcessNode(dev, pnode);
+	}
+	else {
+		uffs_TreeEraseNode(dev, pnode);
+		uffs_TreeInsertToErasedListTail(dev, pnode);
+	}
+}
+
+/** return the first free page of the pack block, pages_per_block if the block is full */
+static u16 _PackEndPage(uffs_Device *dev, uffs_BlockInfo *bc)
+{
+	u16 end = uffs_FindFirstFreePage(dev, bc, 0);
+
+	return (end == UFFS_INVALID_PAGE ? dev->attr->pages_per_block : end);
+}
+
+/** is the record at #page the last record of the file in block ? */
+static UBOOL _PackIsLatest(uffs_Device *dev, uffs_BlockInfo *bc, u16 page, u16 end)
+{
+	uffs_Tags *tag, *tag_later;
+	u16 i;
+
+	tag = GET_TAG(bc, page);
+	for (i = page + 1; i < end; i++) {
+		tag_later = GET_TAG(bc, i);
+		if (IS_PACK_RECORD(tag_later) && TAG_SERIAL(tag_later) == TAG_SERIAL(tag))
+			return U_FALSE;
+	}
+
+	return U_TRUE;
+}
+
+/** find the last record of file #serial in block, return UFFS_INVALID_PAGE if not found */
+static u16 _PackFindRecord(uffs_Device *dev, uffs_BlockInfo *bc, u16 serial, u16 end)
+{
+	uffs_Tags *tag;
+	u16 page;
+
+	for (page = end; page-- > 0; ) {
+		tag = GET_TAG(bc, page);
+		if (IS_PACK_RECORD(tag) && TAG_SERIAL(tag) == serial)
+			return page;
+	}
+
+	return UFFS_INVALID_PAGE;
+}
+
+/** is the record at #page the current record of a packed file living in this block ? */
+static UBOOL _PackIsLiveRecord(uffs_Device *dev, uffs_BlockInfo *bc, u16 page, u16 end)
+{
+	uffs_Tags *tag = GET_TAG(bc, page);
+	TreeNode *node;
+
+	if (!IS_PACK_RECORD(tag) || TAG_DATA_LEN(tag) < PACK_INFO_SIZE)
+		return U_FALSE;		// not a record, or tombstone
+
+	if (!_PackIsLatest(dev, bc, page, end))
+		return U_FALSE;
+
+	if (!IS_PACKED_FILE(dev, TAG_SERIAL(tag)))
+		return U_FALSE;
+
+	node = uffs_TreeFindFileNode(dev, TAG_SERIAL(tag));
+
+	return (node && node->u.file.block == bc->block) ? U_TRUE : U_FALSE;
+}
+
+/** 
+ * copy live records in pack block to a new block, then erase the old block
+ * (or mark it bad if #bad is U_TRUE). Pack block is released if no file lives in it.
+ */
+static URET _PackCompact(uffs_Device *dev, TreeNode *pnode, UBOOL bad)
+{
+	uffs_BlockInfo *bc, *newBc;
+	TreeNode *newNode;
+	uffs_BlockNum block, newBlock;
+	uffs_Tags *tag, *newTag;
+	uffs_Buf *buf;
+	u16 page, end, n;
+	u8 ts;
+	int ret;
+
+	if (pnode->u.list.u.live == 0) {
+		_PackFreeBlock(dev, pnode, bad);
+		return U_SUCC;
+	}
+
+	block = pnode->u.list.block;
+	bc = uffs_BlockInfoGet(dev, block);
+	if (bc == NULL) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "get block info fail.");
+		return U_FAIL;
+	}
+	if (uffs_BlockInfoLoadAllPages(dev, bc) != U_SUCC) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "can't load pack block %d info", block);
+		uffs_BlockInfoPut(dev, bc);
+		return U_FAIL;
+	}
+	end = _PackEndPage(dev, bc);
+	ts = uffs_GetNextBlockTimeStamp(uffs_GetBlockTimeStamp(dev, bc));
+
+retry:
+	newNode = uffs_TreeGetErasedNode(dev);
+	if (newNode == NULL) {
+		uffs_Perror(UFFS_MSG_NOISY, "no erased block for pack block compaction!");
+		uffs_BlockInfoPut(dev, bc);
+		return U_FAIL;
+	}
+	newBlock = newNode->u.list.block;
+	newBc = uffs_BlockInfoGet(dev, newBlock);
+	if (newBc == NULL) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "get block info fail.");
+		uffs_InsertToErasedListHead(dev, newNode);
+		uffs_BlockInfoPut(dev, bc);
+		return U_FAIL;
+	}
+	uffs_BlockInfoLoadAllPages(dev, newBc);
+
+	ret = UFFS_FLASH_NO_ERR;
+	for (page = 0, n = 0; page < end; page++) {
+		if (!_PackIsLiveRecord(dev, bc, page, end))
+			continue;
+
+		buf = uffs_BufClone(dev, NULL);
+		if (buf == NULL) {
+			uffs_Perror(UFFS_MSG_SERIOUS, "Can't clone a new buf!");
+			ret = UFFS_FLASH_MEM_ERR;
+			break;
+		}
+
+		ret = uffs_FlashReadPage(dev, block, page, buf, U_FALSE);
+		if (UFFS_FLASH_IS_BAD_BLOCK(ret)) {
+			// we can't do more for the record if the data is corrupted,
+			// copy it anyway and retire the old block.
+			uffs_Perror(UFFS_MSG_NORMAL, "read pack block %d page %d error (%d)", block, page, ret);
+			bad = U_TRUE;
+			ret = UFFS_FLASH_NO_ERR;
+		}
+
+		if (!UFFS_FLASH_HAVE_ERR(ret)) {
+			tag = GET_TAG(bc, page);
+			newTag = GET_TAG(newBc, n);
+			*newTag = *tag;
+			TAG_BLOCK_TS(newTag) = ts;
+			TAG_PAGE_ID(newTag) = (u8)n;
+			buf->data_len = TAG_DATA_LEN(tag);
+			ret = uffs_FlashWritePageCombine(dev, newBlock, n, buf, newTag);
+		}
+		uffs_BufFreeClone(dev, buf);
+
+		if (UFFS_FLASH_HAVE_ERR(ret) || UFFS_FLASH_IS_BAD_BLOCK(ret)) {
+			uffs_BlockInfoExpire(dev, newBc, n);
+			break;
+		}
+		n++;
+	}
+
+	if (UFFS_FLASH_IS_BAD_BLOCK(ret)) {
+		uffs_Perror(UFFS_MSG_NORMAL, "new bad block %d discovered.", newBlock);
+		uffs_BlockInfoPut(dev, newBc);
+		uffs_BadBlockProcessNode(dev, newNode);
+		goto retry;
+	}
+
+	if (UFFS_FLASH_HAVE_ERR(ret)) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "compact pack block %d fail (%d)", block, ret);
+		uffs_BlockInfoExpireAllPages(dev, newBc);
+		uffs_BlockInfoPut(dev, newBc);
+		uffs_TreeEraseNode(dev, newNode);
+		uffs_TreeInsertToErasedListTail(dev, newNode);
+		uffs_BlockInfoPut(dev, bc);
+		return U_FAIL;
+	}
+
+	// swap the blocks: pack block node keeps the new block,
+	// and the old block goes with newNode.
+	pnode->u.list.block = newBlock;
+	pnode->u.list.u.live = n;
+	uffs_PackMoveFiles(dev, block, newBlock);
+
+	uffs_BlockInfoExpireAllPages(dev, bc);
+	uffs_BlockInfoPut(dev, newBc);
+	uffs_BlockInfoPut(dev, bc);
+
+	newNode->u.list.block = block;
+	if (bad) {
+		uffs_BadBlockPendingRemove(dev, block);
+		uffs_BadBlockProcessNode(dev, newNode);
+	}
+	else {
+		uffs_TreeEraseNode(dev, newNode);
+		uffs_TreeInsertToErasedListTail(dev, newNode);
+	}
+
+	uffs_Perror(UFFS_MSG_NOISY, "pack block %d compacted to %d, %d files", block, newBlock, n);
+
+	return U_SUCC;
+}
+
+/** make sure there is a free page in pack block, compact the block if it's full */
+static URET _PackEnsureFreePage(uffs_Device *dev, TreeNode *pnode)
+{
+	uffs_BlockInfo *bc;
+	u16 page = UFFS_INVALID_PAGE;
+
+	bc = uffs_BlockInfoGet(dev, pnode->u.list.block);
+	if (bc == NULL) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "get block info fail.");
+		return U_FAIL;
+	}
+	if (uffs_BlockInfoLoadAllPages(dev, bc) == U_SUCC)
+		page = uffs_FindFirstFreePage(dev, bc, 0);
+	uffs_BlockInfoPut(dev, bc);
+
+	if (page != UFFS_INVALID_PAGE)
+		return U_SUCC;
+
+	if (_PackCompact(dev, pnode, U_FALSE) != U_SUCC)
+		return U_FAIL;
+
+	bc = uffs_BlockInfoGet(dev, pnode->u.list.block);
+	if (bc == NULL)
+		return U_FAIL;
+	page = _PackEndPage(dev, bc);
+	uffs_BlockInfoPut(dev, bc);
+
+	if (page == dev->attr->pages_per_block) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "pack block %d still full after compaction ?", pnode->u.list.block);
+		return U_FAIL;
+	}
+
+	return U_SUCC;
+}
+
+/** write record #buf to the first free page of pack block, return flash operation result */
+static int _PackWritePage(uffs_Device *dev, TreeNode *pnode, uffs_Buf *buf, u16 parent, u16 serial)
+{
+	uffs_BlockInfo *bc;
+	uffs_Tags *tag;
+	u16 page;
+	u8 ts;
+	int ret;
+
+	bc = uffs_BlockInfoGet(dev, pnode->u.list.block);
+	if (bc == NULL) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "get block info fail.");
+		return UFFS_FLASH_UNKNOWN_ERR;
+	}
+
+	page = uffs_FindFirstFreePage(dev, bc, 0);
+	if (page == UFFS_INVALID_PAGE) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "no free page in pack block %d ?", bc->block);
+		uffs_BlockInfoPut(dev, bc);
+		return UFFS_FLASH_UNKNOWN_ERR;
+	}
+
+	ts = uffs_GetBlockTimeStamp(dev, bc);	// get it before tag of page 0 is changed.
+
+	tag = GET_TAG(bc, page);
+	TAG_DIRTY_BIT(tag) = TAG_DIRTY;
+	TAG_VALID_BIT(tag) = TAG_VALID;
+	TAG_BLOCK_TS(tag) = ts;
+	TAG_SET_DATA_LEN(tag, buf->data_len);
+	TAG_TYPE(tag) = UFFS_TYPE_PACK;
+	TAG_PARENT(tag) = parent;
+	TAG_SERIAL(tag) = serial;
+	TAG_PAGE_ID(tag) = (u8)page;	// page_id = page in pack block
+
+	SEAL_TAG(tag);
+
+	ret = uffs_FlashWritePageCombine(dev, bc->block, page, buf, tag);
+	if (UFFS_FLASH_HAVE_ERR(ret))
+		uffs_BlockInfoExpire(dev, bc, page);
+
+	uffs_BlockInfoPut(dev, bc);
+
+	return ret;
+}
+
+/** read the current record of packed file #serial to #buf, return the record length, or -1 on error */
+static int _PackReadRecord(uffs_Device *dev, uffs_BlockNum block, u16 serial, uffs_Buf *buf)
+{
+	uffs_BlockInfo *bc;
+	u16 page = UFFS_INVALID_PAGE;
+	u32 len = 0;
+	int ret, pending_type;
+
+	bc = uffs_BlockInfoGet(dev, block);
+	if (bc == NULL) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "get block info fail.");
+		return -1;
+	}
+	if (uffs_BlockInfoLoadAllPages(dev, bc) == U_SUCC) {
+		page = _PackFindRecord(dev, bc, serial, _PackEndPage(dev, bc));
+		if (page != UFFS_INVALID_PAGE)
+			len = TAG_DATA_LEN(GET_TAG(bc, page));
+	}
+	uffs_BlockInfoPut(dev, bc);
+
+	if (page == UFFS_INVALID_PAGE || len < PACK_INFO_SIZE) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "can't find record of packed file %d in block %d", serial, block);
+		return -1;
+	}
+
+	ret = uffs_FlashReadPage(dev, block, page, buf, U_FALSE);
+	pending_type = uffs_BadBlockAddByFlashResult(dev, block, ret);
+	if (pending_type == UFFS_PENDING_BLK_MARKBAD ||
+		(pending_type == UFFS_PENDING_BLK_NONE && UFFS_FLASH_HAVE_ERR(ret))) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "can't read record from pack block %d page %d (%d)", block, page, ret);
+		return -1;
+	}
+
+	return (int)len;
+}
+
+/** 
+ * \brief load page buffer of a packed file from its record
+ * \param[in] dev uffs device
+ * \param[in] block pack block
+ * \param[in|out] buf page buffer, buf->serial and buf->page_id must be set
+ * \return U_SUCC or U_FAIL
+ */
+URET uffs_PackLoadBuf(uffs_Device *dev, uffs_BlockNum block, uffs_Buf *buf)
+{
+	int len;
+
+	if (buf->page_id > 1) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "packed file %d has no page_id %d", buf->serial, buf->page_id);
+		return U_FAIL;
+	}
+
+	len = _PackReadRecord(dev, block, buf->serial, buf);
+	if (len < 0)
+		return U_FAIL;
+
+	if (buf->page_id == 0) {
+		buf->data_len = PACK_INFO_SIZE;
+	}
+	else {
+		buf->data_len = len - PACK_INFO_SIZE;
+		memmove(buf->data, buf->data + PACK_INFO_SIZE, buf->data_len);
+	}
+
+	return U_SUCC;
+}
+
+/** can a new file be packed ? */
+UBOOL uffs_PackCanAddFile(uffs_Device *dev)
+{
+	return (dev->pack.count < UFFS_PACK_MAX_FILES && dev->pack.max_size > 0) ? U_TRUE : U_FALSE;
+}
+
+/** pick a pack block for a new file: the fullest block which is no more than half full */
+static TreeNode * _PackPickBlock(uffs_Device *dev)
+{
+	TreeNode *node, *best = NULL;
+
+	for (node = dev->pack.list; node != NULL; node = LIST_NEXT(dev, node)) {
+		if (node->u.list.u.live < dev->attr->pages_per_block / 2 &&
+			(best == NULL || node->u.list.u.live > best->u.list.u.live)) {
+			best = node;
+		}
+	}
+
+	if (best == NULL) {
+		best = uffs_TreeGetErasedNode(dev);
+		if (best)
+			uffs_PackInsertBlock(dev, best);
+	}
+
+	return best;
+}
+
+/** compose a record: file info from #info, file data from #data, or from the current record if not given */
+static URET _PackMakeRecord(uffs_Device *dev, TreeNode *node, uffs_Buf *rec, uffs_Buf *info, uffs_Buf *data)
+{
+	int len = 0;
+
+	if (node && (info == NULL || data == NULL)) {
+		len = _PackReadRecord(dev, node->u.file.block, node->u.file.serial, rec);
+		if (len < 0)
+			return U_FAIL;
+	}
+	else if (info == NULL) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "no file info for new packed file ?");
+		return U_FAIL;
+	}
+
+	if (info)
+		memcpy(rec->data, info->data, PACK_INFO_SIZE);
+
+	if (data) {
+		memcpy(rec->data + PACK_INFO_SIZE, data->data, data->data_len);
+		rec->data_len = PACK_INFO_SIZE + data->data_len;
+	}
+	else {
+		rec->data_len = (len > (int)PACK_INFO_SIZE ? len : PACK_INFO_SIZE);
+	}
+
+	return U_SUCC;
+}
+
+/** 
+ * \brief write packed file record
+ * \param[in] dev uffs device
+ * \param[in] node file node, NULL for a new file
+ * \param[in] parent parent serial of the file
+ * \param[in] serial file serial
+ * \param[in] info page buffer of file info (page_id 0), NULL if not changed
+ * \param[in] data page buffer of file data (page_id 1), NULL if not changed
+ * \return U_SUCC or U_FAIL
+ * \note a new file node is created and inserted into the tree for a new file.
+ */
+URET uffs_PackWriteFile(uffs_Device *dev, TreeNode *node, u16 parent, u16 serial,
+						uffs_Buf *info, uffs_Buf *data)
+{
+	TreeNode *pnode = NULL;
+	TreeNode *fnode = NULL;
+	uffs_FileInfo *fi;
+	uffs_Buf *rec;
+	u16 sum;
+	u32 len;
+	int ret;
+	URET result = U_FAIL;
+
+	if (data && data->data_len > dev->com.pg_data_size - PACK_INFO_SIZE) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "data of packed file %d is too long (%d)", serial, data->data_len);
+		return U_FAIL;
+	}
+
+	if (node == NULL) {
+		fnode = (TreeNode *)uffs_PoolGet(TPOOL(dev));
+		if (fnode == NULL) {
+			uffs_Perror(UFFS_MSG_SERIOUS, "insufficient tree node!");
+			return U_FAIL;
+		}
+	}
+
+retry:
+	pnode = (node ? uffs_PackFindBlockNode(dev, node->u.file.block) : _PackPickBlock(dev));
+	if (pnode == NULL) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "can't get pack block for file %d", serial);
+		goto ext;
+	}
+
+	// make room before taking the clone buffer, compaction needs one.
+	if (_PackEnsureFreePage(dev, pnode) != U_SUCC)
+		goto ext;
+
+	rec = uffs_BufClone(dev, NULL);
+	if (rec == NULL) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "Can't clone a new buf!");
+		goto ext;
+	}
+
+	if (_PackMakeRecord(dev, node, rec, info, data) != U_SUCC) {
+		uffs_BufFreeClone(dev, rec);
+		goto ext;
+	}
+
+	fi = (uffs_FileInfo *)(rec->data);
+	sum = uffs_MakeSum16(fi->name, fi->name_len);
+	len = rec->data_len - PACK_INFO_SIZE;
+
+	ret = _PackWritePage(dev, pnode, rec, parent, serial);
+	uffs_BufFreeClone(dev, rec);
+
+	if (UFFS_FLASH_HAVE_ERR(ret)) {
+		if (UFFS_FLASH_IS_BAD_BLOCK(ret)) {
+			uffs_Perror(UFFS_MSG_NORMAL, "bad block %d found, retry on compacted pack block", pnode->u.list.block);
+			if (_PackCompact(dev, pnode, U_TRUE) == U_SUCC)
+				goto retry;
+		}
+		goto ext;
+	}
+
+	if (node == NULL) {
+		node = fnode;
+		fnode = NULL;
+		node->u.file.block = pnode->u.list.block;
+		node->u.file.parent = parent;
+		node->u.file.serial = serial;
+		node->u.file.checksum = sum;
+		FILE_NODE_LEN(dev, node) = len;
+		uffs_InsertNodeToTree(dev, UFFS_TYPE_FILE, node);
+
+		PACK_MAP_SET(dev, serial);
+		dev->pack.count++;
+		pnode->u.list.u.live++;
+	}
+	else {
+		node->u.file.parent = parent;
+		node->u.file.checksum = sum;
+	}
+
+	if (UFFS_FLASH_IS_BAD_BLOCK(ret)) {
+		// record is written but the block should be retired.
+		_PackCompact(dev, pnode, U_TRUE);
+	}
+
+	pnode = NULL;
+	result = U_SUCC;
+
+ext:
+	if (fnode)
+		uffs_PoolPut(TPOOL(dev), fnode);
+
+	if (pnode && pnode->u.list.u.live == 0)
+		_PackFreeBlock(dev, pnode, U_FALSE);	// new pack block but nothing written
+
+	return result;
+}
+
+/** 
+ * move live records of sparse pack block #pnode to another pack block,
+ * release the sparse block once it's empty.
+ *
+ * The target is the fullest pack block which stays no more than half full
+ * with the records. Each moved record is followed by a tombstone in the
+ * sparse block, so a stale copy can't come back if the merge stops halfway
+ * and the file is rewritten later. If power is lost in between, the files
+ * have the same record in both blocks and uffs_PackLoad() keeps one of them.
+ */
+static void _PackMerge(uffs_Device *dev, TreeNode *pnode)
+{
+	TreeNode *node, *dst = NULL;
+	uffs_BlockInfo *bc;
+	uffs_BlockNum block = pnode->u.list.block;
+	uffs_Tags *tag;
+	uffs_Buf *buf;
+	UBOOL bad = U_FALSE;
+	UBOOL stale = U_FALSE;
+	u16 page, end;
+	int ret, ret_tomb;
+
+	for (node = dev->pack.list; node != NULL; node = LIST_NEXT(dev, node)) {
+		if (node != pnode &&
+			node->u.list.u.live + pnode->u.list.u.live <= dev->attr->pages_per_block / 2 &&
+			(dst == NULL || node->u.list.u.live > dst->u.list.u.live)) {
+			dst = node;
+		}
+	}
+	if (dst == NULL)
+		return;
+
+	// make room for the records, compaction leaves at least half of the block free.
+	bc = uffs_BlockInfoGet(dev, dst->u.list.block);
+	if (bc == NULL) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "get block info fail.");
+		return;
+	}
+	end = dev->attr->pages_per_block;
+	if (uffs_BlockInfoLoadAllPages(dev, bc) == U_SUCC)
+		end = _PackEndPage(dev, bc);
+	uffs_BlockInfoPut(dev, bc);
+
+	if (end + pnode->u.list.u.live > dev->attr->pages_per_block &&
+		_PackCompact(dev, dst, U_FALSE) != U_SUCC)
+		return;
+
+	bc = uffs_BlockInfoGet(dev, block);
+	if (bc == NULL) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "get block info fail.");
+		return;
+	}
+	if (uffs_BlockInfoLoadAllPages(dev, bc) != U_SUCC) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "can't load pack block %d info", block);
+		uffs_BlockInfoPut(dev, bc);
+		return;
+	}
+	end = _PackEndPage(dev, bc);
+
+	// need a free page for the tombstone of each moved record
+	if (end + pnode->u.list.u.live > dev->attr->pages_per_block) {
+		uffs_BlockInfoPut(dev, bc);
+		return;
+	}
+
+	ret = UFFS_FLASH_NO_ERR;
+	for (page = 0; page < end && pnode->u.list.u.live > 0; page++) {
+		if (!_PackIsLiveRecord(dev, bc, page, end))
+			continue;
+
+		buf = uffs_BufClone(dev, NULL);
+		if (buf == NULL) {
+			uffs_Perror(UFFS_MSG_SERIOUS, "Can't clone a new buf!");
+			break;
+		}
+
+		ret = uffs_FlashReadPage(dev, block, page, buf, U_FALSE);
+		if (UFFS_FLASH_IS_BAD_BLOCK(ret)) {
+			// same as compaction: move the record anyway and retire the block.
+			uffs_Perror(UFFS_MSG_NORMAL, "read pack block %d page %d error (%d)", block, page, ret);
+			bad = U_TRUE;
+			ret = UFFS_FLASH_NO_ERR;
+		}
+
+		tag = GET_TAG(bc, page);
+		if (!UFFS_FLASH_HAVE_ERR(ret)) {
+			buf->data_len = TAG_DATA_LEN(tag);
+			ret = _PackWritePage(dev, dst, buf, TAG_PARENT(tag), TAG_SERIAL(tag));
+		}
+
+		if (UFFS_FLASH_HAVE_ERR(ret)) {
+			uffs_BufFreeClone(dev, buf);
+			break;
+		}
+
+		node = uffs_TreeFindFileNode(dev, TAG_SERIAL(tag));
+		node->u.file.block = dst->u.list.block;
+		dst->u.list.u.live++;
+		pnode->u.list.u.live--;
+
+		// the sparse block is erased after the last record, no tombstone needed then.
+		if (pnode->u.list.u.live > 0) {
+			memset(buf->data, 0, dev->com.pg_data_size);
+			buf->data_len = 0;
+			ret_tomb = _PackWritePage(dev, pnode, buf, TAG_PARENT(tag), TAG_SERIAL(tag));
+			if (UFFS_FLASH_IS_BAD_BLOCK(ret_tomb))
+				bad = U_TRUE;		// compaction drops the moved records
+			else if (UFFS_FLASH_HAVE_ERR(ret_tomb))
+				stale = U_TRUE;
+		}
+		uffs_BufFreeClone(dev, buf);
+
+		if (UFFS_FLASH_IS_BAD_BLOCK(ret) || bad || stale)
+			break;
+	}
+	uffs_BlockInfoPut(dev, bc);
+
+	if (UFFS_FLASH_IS_BAD_BLOCK(ret)) {
+		// records of the moved files won't be copied by compaction.
+		uffs_Perror(UFFS_MSG_NORMAL, "new bad block %d discovered.", dst->u.list.block);
+		_PackCompact(dev, dst, U_TRUE);
+	}
+
+	if (pnode->u.list.u.live == 0) {
+		uffs_Perror(UFFS_MSG_NOISY, "sparse pack block %d merged to %d", block, dst->u.list.block);
+		_PackFreeBlock(dev, pnode, bad);
+	}
+	else if (bad || stale) {
+		// drop the stale copies of moved records which have no tombstone
+		if (_PackCompact(dev, pnode, bad) != U_SUCC)
+			uffs_Perror(UFFS_MSG_SERIOUS, "can't drop moved records from pack block %d", block);
+	}
+	else if (UFFS_FLASH_HAVE_ERR(ret)) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "merge pack block %d fail (%d)", block, ret);
+	}
+}
+
+/** 
+ * write a tombstone for file #serial in pack block, if the block still has a record of it.
+ * A detached file's record is dropped by compaction, an attached one's is copied.
+ */
+static URET _PackWriteTombstone(uffs_Device *dev, TreeNode *pnode, u16 parent, u16 serial)
+{
+	uffs_BlockInfo *bc;
+	uffs_Buf *buf;
+	u16 page;
+	int ret;
+
+retry:
+	if (_PackEnsureFreePage(dev, pnode) != U_SUCC)
+		return U_FAIL;
+
+	page = UFFS_INVALID_PAGE;
+	bc = uffs_BlockInfoGet(dev, pnode->u.list.block);
+	if (bc == NULL) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "get block info fail.");
+		return U_FAIL;
+	}
+	if (uffs_BlockInfoLoadAllPages(dev, bc) == U_SUCC) {
+		page = _PackFindRecord(dev, bc, serial, _PackEndPage(dev, bc));
+		if (page != UFFS_INVALID_PAGE && TAG_DATA_LEN(GET_TAG(bc, page)) == 0)
+			page = UFFS_INVALID_PAGE;
+	}
+	uffs_BlockInfoPut(dev, bc);
+
+	if (page != UFFS_INVALID_PAGE) {
+		buf = uffs_BufClone(dev, NULL);
+		if (buf == NULL) {
+			uffs_Perror(UFFS_MSG_SERIOUS, "Can't clone a new buf!");
+			return U_FAIL;
+		}
+		memset(buf->data, 0, dev->com.pg_data_size);
+		buf->data_len = 0;
+
+		ret = _PackWritePage(dev, pnode, buf, parent, serial);
+		uffs_BufFreeClone(dev, buf);
+
+		if (UFFS_FLASH_IS_BAD_BLOCK(ret)) {
+			uffs_Perror(UFFS_MSG_NORMAL, "bad block %d found, retry on compacted pack block", pnode->u.list.block);
+			if (_PackCompact(dev, pnode, U_TRUE) != U_SUCC)
+				return U_FAIL;
+			goto retry;
+		}
+		if (UFFS_FLASH_HAVE_ERR(ret))
+			return U_FAIL;
+	}
+
+	return U_SUCC;
+}
+
+/** a file has left pack block #pnode: release the block if it's empty, merge it if it's sparse */
+static void _PackCheckBlock(uffs_Device *dev, TreeNode *pnode)
+{
+	if (pnode->u.list.u.live == 0)
+		_PackFreeBlock(dev, pnode, U_FALSE);
+	else if (PACK_IS_SPARSE(dev, pnode))
+		_PackMerge(dev, pnode);
+}
+
+/** file #serial (already detached) leaves pack block, write a tombstone if needed */
+static URET _PackDropFile(uffs_Device *dev, TreeNode *pnode, u16 parent, u16 serial)
+{
+	pnode->u.list.u.live--;
+
+	// the tombstone must be on flash before the rest of sparse block is merged.
+	if (pnode->u.list.u.live > 0 &&
+		_PackWriteTombstone(dev, pnode, parent, serial) != U_SUCC)
+		return U_FAIL;
+
+	_PackCheckBlock(dev, pnode);
+
+	return U_SUCC;
+}
+
+/** 
+ * \brief delete packed file
+ * \param[in] dev uffs device
+ * \param[in] node file node, will be released
+ * \return U_SUCC or U_FAIL
+ */
+URET uffs_PackDeleteFile(uffs_Device *dev, TreeNode *node)
+{
+	TreeNode *pnode;
+	u16 parent = node->u.file.parent;
+	u16 serial = node->u.file.serial;
+
+	pnode = uffs_PackFindBlockNode(dev, node->u.file.block);
+
+	uffs_BreakFromEntry(dev, UFFS_TYPE_FILE, node);
+	PACK_MAP_CLR(dev, serial);
+	dev->pack.count--;
+	uffs_PoolPut(TPOOL(dev), node);
+
+	if (pnode == NULL) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "packed file %d is not in pack block ?", serial);
+		return U_FAIL;
+	}
+
+	return _PackDropFile(dev, pnode, parent, serial);
+}
+
+static void _PackSetFileTag(uffs_Tags *tag, u16 parent, u16 serial, u16 page_id, u32 len)
+{
+	TAG_DIRTY_BIT(tag) = TAG_DIRTY;
+	TAG_VALID_BIT(tag) = TAG_VALID;
+	TAG_BLOCK_TS(tag) = uffs_GetFirstBlockTimeStamp();
+	TAG_SET_DATA_LEN(tag, len);
+	TAG_TYPE(tag) = UFFS_TYPE_FILE;
+	TAG_PARENT(tag) = parent;
+	TAG_SERIAL(tag) = serial;
+	TAG_PAGE_ID(tag) = (u8)page_id;
+
+	SEAL_TAG(tag);
+}
+
+/** 
+ * \brief move packed file to a block of its own
+ * \param[in] dev uffs device
+ * \param[in] node file node
+ * \return U_SUCC or U_FAIL
+ * \note dirty buffers of the file must be flushed before calling this.
+ *		 Page buffers of the file are still valid after the move.
+ */
+URET uffs_PackPromoteFile(uffs_Device *dev, TreeNode *node)
+{
+	TreeNode *pnode, *enode;
+	uffs_BlockInfo *newBc;
+	uffs_Buf *buf;
+	u16 parent = node->u.file.parent;
+	u16 serial = node->u.file.serial;
+	int len;
+	int ret;
+
+	pnode = uffs_PackFindBlockNode(dev, node->u.file.block);
+	if (pnode == NULL) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "packed file %d is not in pack block ?", serial);
+		return U_FAIL;
+	}
+
+	enode = uffs_TreeGetErasedNodeFor(dev, serial);
+
+retry:
+	if (enode == NULL) {
+		uffs_Perror(UFFS_MSG_NOISY, "no erased block!");
+		return U_FAIL;
+	}
+
+	newBc = uffs_BlockInfoGet(dev, enode->u.list.block);
+	if (newBc == NULL) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "get block info fail.");
+		uffs_InsertToErasedListHead(dev, enode);
+		return U_FAIL;
+	}
+	uffs_BlockInfoLoadAllPages(dev, newBc);
+
+	buf = uffs_BufClone(dev, NULL);
+	if (buf == NULL) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "Can't clone a new buf!");
+		uffs_BlockInfoPut(dev, newBc);
+		uffs_InsertToErasedListHead(dev, enode);
+		return U_FAIL;
+	}
+
+	len = _PackReadRecord(dev, pnode->u.list.block, serial, buf);
+	if (len < 0) {
+		uffs_BufFreeClone(dev, buf);
+		uffs_BlockInfoPut(dev, newBc);
+		uffs_InsertToErasedListHead(dev, enode);
+		return U_FAIL;
+	}
+
+	// page 0: file info
+	buf->data_len = PACK_INFO_SIZE;
+	_PackSetFileTag(GET_TAG(newBc, 0), parent, serial, 0, buf->data_len);
+	ret = uffs_FlashWritePageCombine(dev, enode->u.list.block, 0, buf, GET_TAG(newBc, 0));
+
+	// page 1: file data
+	if (!UFFS_FLASH_HAVE_ERR(ret) && !UFFS_FLASH_IS_BAD_BLOCK(ret) && len > (int)PACK_INFO_SIZE) {
+		buf->data_len = len - PACK_INFO_SIZE;
+		memmove(buf->data, buf->data + PACK_INFO_SIZE, buf->data_len);
+		_PackSetFileTag(GET_TAG(newBc, 1), parent, serial, 1, buf->data_len);
+		ret = uffs_FlashWritePageCombine(dev, enode->u.list.block, 1, buf, GET_TAG(newBc, 1));
+	}
+	uffs_BufFreeClone(dev, buf);
+
+	if (UFFS_FLASH_HAVE_ERR(ret) || UFFS_FLASH_IS_BAD_BLOCK(ret))
+		uffs_BlockInfoExpireAllPages(dev, newBc);
+	uffs_BlockInfoPut(dev, newBc);
+
+	if (UFFS_FLASH_IS_BAD_BLOCK(ret)) {
+		uffs_Perror(UFFS_MSG_NORMAL, "new bad block %d discovered.", enode->u.list.block);
+		uffs_BadBlockProcessNode(dev, enode);
+		enode = uffs_TreeGetErasedNodeFor(dev, serial);
+		goto retry;
+	}
+
+	if (UFFS_FLASH_HAVE_ERR(ret)) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "write block %d fail (%d)", enode->u.list.block, ret);
+		uffs_TreeEraseNode(dev, enode);
+		uffs_TreeInsertToErasedListTail(dev, enode);
+		return U_FAIL;
+	}
+
+	// drop the record before switching: if both were left on flash, the next mount
+	// takes the move as unfinished and erases the new block with all data written to it.
+	// The pack block is erased instead if the file is the only one in it.
+	if (pnode->u.list.u.live > 1 &&
+		_PackWriteTombstone(dev, pnode, parent, serial) != U_SUCC) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "can't drop record of packed file %d, file stays packed", serial);
+		uffs_TreeEraseNode(dev, enode);
+		uffs_TreeInsertToErasedListTail(dev, enode);
+		return U_FAIL;
+	}
+
+	// the file owns the new block now, the spare erased node goes back to pool.
+	node->u.file.block = enode->u.list.block;
+	PACK_MAP_CLR(dev, serial);
+	dev->pack.count--;
+	uffs_PoolPut(TPOOL(dev), enode);
+
+	uffs_Perror(UFFS_MSG_NOISY, "packed file %d moved to block %d", serial, node->u.file.block);
+
+	// recount: compaction while writing the tombstone may have left the record out already.
+	pnode->u.list.u.live = _PackCountFiles(dev, pnode->u.list.block);
+	_PackCheckBlock(dev, pnode);
+
+	return U_SUCC;
+}
+
+/** 
+ * \brief check pending block when building tree
+ *
+ * An unclean page (interrupted record writing) in pack block should not
+ * cause the whole block being erased, remove it from pending list and
+ * uffs_PackLoad() will compact the block.
+ */
+void uffs_PackCheckPendingBlock(uffs_Device *dev, uffs_BlockInfo *bc)
+{
+	uffs_PendingBlock *pending;
+	uffs_Tags *tag;
+
+	pending = uffs_BadBlockPendingNodeGet(dev, bc->block);
+	if (pending == NULL || pending->mark != UFFS_PENDING_BLK_CLEANUP)
+		return;
+
+	if (uffs_BlockInfoLoadPage(dev, bc, 0) != U_SUCC)
+		return;
+
+	tag = GET_TAG(bc, 0);
+	if (IS_PACK_RECORD(tag))
+		uffs_BadBlockPendingRemove(dev, bc->block);
+}
+
+/** does the pack block end with an unclean page ? */
+static UBOOL _PackIsUnclean(uffs_Device *dev, uffs_BlockInfo *bc, u16 end)
+{
+	struct uffs_MiniHeaderSt header;
+	int ret;
+
+	if (end > 0 && !TAG_IS_GOOD(GET_TAG(bc, end - 1)))
+		return U_TRUE;
+
+	if (end < dev->attr->pages_per_block) {
+		ret = uffs_LoadMiniHeaderAndTag(dev, bc, end, &header);
+		if (UFFS_FLASH_HAVE_ERR(ret) || header.status != 0xFF)
+			return U_TRUE;
+	}
+
+	return U_FALSE;
+}
+
+/** load packed file from record at #page */
+static URET _PackLoadRecord(uffs_Device *dev, uffs_BlockInfo *bc, u16 page)
+{
+	uffs_Tags *tag = GET_TAG(bc, page);
+	u16 serial = TAG_SERIAL(tag);
+	TreeNode *node;
+	uffs_BlockInfo *bc_alt;
+	uffs_FileInfo *fi;
+	uffs_Buf *buf;
+	UBOOL is_new = U_FALSE;
+	u8 ts, ts_alt;
+	int ret;
+
+#ifdef CONFIG_UFFS_COMPACT_TREE_NODE
+	if (serial >= dev->tree.file_len_num) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "packed file %d out of file length table", serial);
+		return U_FAIL;
+	}
+#endif
+
+	node = uffs_TreeFindFileNode(dev, serial);
+	if (node && IS_PACKED_FILE(dev, serial)) {
+		// the file is in another pack block as well. Compaction was interrupted:
+		// the older one wins. Merge was interrupted before the tombstone was
+		// written: both records are the same, keep the one already loaded.
+		bc_alt = uffs_BlockInfoGet(dev, node->u.file.block);
+		if (bc_alt == NULL) {
+			uffs_Perror(UFFS_MSG_SERIOUS, "get block info fail.");
+			return U_FAIL;
+		}
+		uffs_BlockInfoLoadPage(dev, bc_alt, 0);
+		ts = TAG_BLOCK_TS(GET_TAG(bc, 0));
+		ts_alt = TAG_BLOCK_TS(GET_TAG(bc_alt, 0));
+		uffs_BlockInfoPut(dev, bc_alt);
+		if (ts == ts_alt || uffs_IsSrcNewerThanObj(ts, ts_alt) == U_TRUE)
+			return U_SUCC;
+	}
+	else if (node) {
+		// a regular file with the same serial: the file was being moved out
+		// of pack block but not finished, the record is still the valid one.
+		uffs_Perror(UFFS_MSG_NORMAL, "unfinished promotion of file %d, block %d will be erased", serial, node->u.file.block);
+		uffs_BreakFromEntry(dev, UFFS_TYPE_FILE, node);
+		node->u.list.block = node->u.file.block;
+		uffs_TreeEraseNode(dev, node);
+		uffs_TreeInsertToErasedListTail(dev, node);
+		node = NULL;
+	}
+
+	if (node == NULL) {
+		node = (TreeNode *)uffs_PoolGet(TPOOL(dev));
+		if (node == NULL) {
+			uffs_Perror(UFFS_MSG_SERIOUS, "insufficient tree node for packed files!");
+			return U_FAIL;
+		}
+		is_new = U_TRUE;
+	}
+
+	// load the file info for name check sum
+	buf = uffs_BufClone(dev, NULL);
+	if (buf == NULL) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "Can't clone a new buf!");
+		if (is_new)
+			uffs_PoolPut(TPOOL(dev), node);
+		return U_FAIL;
+	}
+	ret = uffs_FlashReadPage(dev, bc->block, page, buf, U_FALSE);
+	if (uffs_BadBlockAddByFlashResult(dev, bc->block, ret) == UFFS_PENDING_BLK_NONE && UFFS_FLASH_HAVE_ERR(ret)) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "I/O error ?");
+		uffs_BufFreeClone(dev, buf);
+		if (is_new)
+			uffs_PoolPut(TPOOL(dev), node);
+		return U_FAIL;
+	}
+	fi = (uffs_FileInfo *)(buf->data);
+
+	node->u.file.block = bc->block;
+	node->u.file.checksum = uffs_MakeSum16(fi->name, fi->name_len);
+	node->u.file.parent = TAG_PARENT(tag);
+	node->u.file.serial = serial;
+	FILE_NODE_LEN(dev, node) = TAG_DATA_LEN(tag) - PACK_INFO_SIZE;
+	uffs_BufFreeClone(dev, buf);
+
+	if (is_new) {
+		uffs_InsertNodeToTree(dev, UFFS_TYPE_FILE, node);
+		PACK_MAP_SET(dev, serial);
+		dev->pack.count++;
+	}
+
+	return U_SUCC;
+}
+
+/** 
+ * \brief load packed files from pack blocks
+ * \param[in] dev uffs device
+ * \return U_SUCC or U_FAIL
+ * \note called by uffs_BuildTree() after DIR/FILE/DATA nodes are built.
+ */
+URET uffs_PackLoad(uffs_Device *dev)
+{
+	TreeNode *pnode, *next;
+	uffs_BlockInfo *bc;
+	uffs_Tags *tag;
+	u16 page, end, found;
+	URET ret = U_SUCC;
+
+	uffs_Perror(UFFS_MSG_NOISY, "load packed files");
+
+	for (pnode = dev->pack.list; ret == U_SUCC && pnode != NULL; pnode = LIST_NEXT(dev, pnode)) {
+		bc = uffs_BlockInfoGet(dev, pnode->u.list.block);
+		if (bc == NULL) {
+			uffs_Perror(UFFS_MSG_SERIOUS, "get block info fail.");
+			return U_FAIL;
+		}
+		if (uffs_BlockInfoLoadAllPages(dev, bc) != U_SUCC) {
+			uffs_Perror(UFFS_MSG_SERIOUS, "can't load pack block %d info", bc->block);
+			uffs_BlockInfoPut(dev, bc);
+			return U_FAIL;
+		}
+		end = _PackEndPage(dev, bc);
+
+		// the last record of a file is the current one
+		found = 0;
+		for (page = end; ret == U_SUCC && page-- > 0; ) {
+			tag = GET_TAG(bc, page);
+			if (!IS_PACK_RECORD(tag) || TAG_DATA_LEN(tag) < PACK_INFO_SIZE ||
+				!_PackIsLatest(dev, bc, page, end))
+				continue;
+			found++;
+			ret = _PackLoadRecord(dev, bc, page);
+		}
+
+		// keep the number of records for now, compare with live files later.
+		pnode->u.list.u.live = (_PackIsUnclean(dev, bc, end) ? PACK_LIVE_UNCLEAN : found);
+		uffs_BlockInfoPut(dev, bc);
+	}
+
+	// count files really live in pack blocks, release empty blocks and
+	// compact blocks which have stale records or unclean page.
+	for (pnode = dev->pack.list; ret == U_SUCC && pnode != NULL; pnode = next) {
+		next = LIST_NEXT(dev, pnode);
+		found = pnode->u.list.u.live;
+		pnode->u.list.u.live = _PackCountFiles(dev, pnode->u.list.block);
+		if (pnode->u.list.u.live == 0) {
+			_PackFreeBlock(dev, pnode, U_FALSE);
+		}
+		else if (pnode->u.list.u.live != found) {
+			uffs_Perror(UFFS_MSG_NORMAL, "compact pack block %d", pnode->u.list.block);
+			_PackCompact(dev, pnode, U_FALSE);
+		}
+	}
+
+	uffs_Perror(UFFS_MSG_NORMAL, "packed files: %d", dev->pack.count);
+
+	return ret;
+}
+
+#endif
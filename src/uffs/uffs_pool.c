@@ -41,6 +41,11 @@
 #include "uffs/uffs_os.h"
 #include "uffs/uffs_public.h"
 #include "uffs/uffs_pool.h"
+#include "uffs/uffs_mem.h"
+
+#include <string.h>
+
+#define PFX "pool: "
 
 /*
 
@@ -64,8 +69,62 @@
 	uffs_PoolInit will assert when NUM_BUFS is not at least 1, or BUF_SIZE is
 	not	aligned to the platforms pointer size.
 
+	uffs_PoolGrow adds another NUM_BUFS buffers to the pool, buffers never
+	move so pointers got from the pool stay valid. Buffer index counts
+	through all chunks in the order they are added.
+
+	uffs_PoolSetAllocMap gives the pool an allocation bitmap
+	(UFFS_POOL_MAP_SIZE(NUM_BUFS) words), which makes uffs_PoolCheckFreeList
+	O(1) and uffs_PoolFindNextAllocated a bit scan, instead of walking
+	the free list. Use it for pools which are checked or iterated often.
+
 */
 
+/** \return index of the lowest set bit of non-zero x */
+static int _LowestBit(u32 x)
+{
+	static const u8 debruijn[32] = {
+		0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+		31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+	};
+
+	return debruijn[((x & (0 - x)) * 0x077CB531U) >> 27];
+}
+
+/** \return memory chunk holding p, or -1 if p is not in the pool */
+static int _FindChunk(uffs_Pool *pool, void *p)
+{
+	u32 i;
+	u32 chunk_size = pool->chunk_bufs * pool->buf_size;
+
+	for (i = 0; i < pool->num_chunks; i++) {
+		if ((u8 *)p >= pool->chunks[i] && (u8 *)p < pool->chunks[i] + chunk_size)
+			return (int)i;
+	}
+
+	return -1;
+}
+
+/** mark buffer p as allocated or free in the allocation bitmap */
+static void _UpdateMap(uffs_Pool *pool, void *p, UBOOL allocated)
+{
+	int chunk;
+	u32 i;
+
+	if (pool->maps[0] == NULL)
+		return;
+
+	chunk = _FindChunk(pool, p);
+	if (chunk < 0)
+		return;
+
+	i = ((u8 *)p - pool->chunks[chunk]) / pool->buf_size;
+	if (allocated)
+		pool->maps[chunk][i / 32] |= (1U << (i % 32));
+	else
+		pool->maps[chunk][i / 32] &= ~(1U << (i % 32));
+}
+
 
 /**
  * \brief Initializes the memory pool.
@@ -97,6 +156,10 @@ URET uffs_PoolInit(uffs_Pool *pool,
 	pool->mem = (u8 *)mem;
 	pool->buf_size = buf_size;
 	pool->num_bufs = num_bufs;
+	pool->chunk_bufs = num_bufs;
+	pool->num_chunks = 1;
+	pool->chunks[0] = pool->mem;
+	memset(pool->maps, 0, sizeof(pool->maps));
 
 	pool->sem = OSSEM_NOT_INITED;
 	if (lock) {
@@ -125,12 +188,164 @@ URET uffs_PoolInit(uffs_Pool *pool,
  */
 UBOOL uffs_PoolVerify(uffs_Pool *pool, void *p)
 {
-	return p &&
-		(u8 *)p >= pool->mem &&
-		(u8 *)p < pool->mem + (pool->buf_size * pool->num_bufs) &&
-		(((u8 *)p - pool->mem) % pool->buf_size) == 0 ? U_TRUE : U_FALSE;
+	int chunk;
+
+	if (p == NULL)
+		return U_FALSE;
+
+	chunk = _FindChunk(pool, p);
+
+	return chunk >= 0 &&
+		(((u8 *)p - pool->chunks[chunk]) % pool->buf_size) == 0 ? U_TRUE : U_FALSE;
+}
+
+/**
+ * \brief Set allocation bitmap of the memory pool.
+ * \param[in] pool memory pool
+ * \param[in] map bitmap memory
+ * \param[in] map_size size of bitmap memory in bytes,
+ *				at least UFFS_POOL_MAP_SIZE(num_bufs) * sizeof(u32)
+ * \return Returns U_SUCC if successful.
+ * \note call it right after uffs_PoolInit(), before any buffer is taken.
+ */
+URET uffs_PoolSetAllocMap(uffs_Pool *pool, u32 *map, u32 map_size)
+{
+	if (!uffs_Assert(pool != NULL, "pool missing") ||
+		!uffs_Assert(map != NULL, "bitmap memory missing") ||
+		!uffs_Assert(pool->num_chunks == 1, "pool already grown") ||
+		!uffs_Assert(map_size >= UFFS_POOL_MAP_SIZE(pool->chunk_bufs) * sizeof(u32),
+					"bitmap memory size is wrong"))
+	{
+		return U_FAIL;
+	}
+
+	memset(map, 0, UFFS_POOL_MAP_SIZE(pool->chunk_bufs) * sizeof(u32));
+	pool->maps[0] = map;
+
+	return U_SUCC;
+}
+
+/** add chunk #mem to #pool unless it has no chunk slot left or would exceed #max_bufs */
+static URET _PoolGrow(uffs_Pool *pool, void *mem, u32 mem_size, u32 *map, u32 max_bufs)
+{
+	u32 i;
+	uffs_PoolEntry *e;
+
+	if (!uffs_Assert(pool != NULL, "pool missing") ||
+		!uffs_Assert(mem != NULL, "pool memory missing") ||
+		!uffs_Assert(mem_size == pool->chunk_bufs * pool->buf_size,
+					"pool memory size is wrong") ||
+		!uffs_Assert(pool->maps[0] == NULL || map != NULL,
+					"bitmap memory missing"))
+	{
+		return U_FAIL;
+	}
+
+	// buffers never handed out read as zero, like the static pool memory
+	memset(mem, 0, mem_size);
+
+	if (pool->sem != OSSEM_NOT_INITED)
+		uffs_SemWait(pool->sem);
+
+	// limits are checked under the lock, another task may have grown the pool
+	if (pool->num_chunks >= UFFS_POOL_MAX_CHUNKS ||
+		pool->num_bufs + pool->chunk_bufs > max_bufs) {
+		if (pool->sem != OSSEM_NOT_INITED)
+			uffs_SemSignal(pool->sem);
+		return U_FAIL;
+	}
+
+	if (pool->maps[0]) {
+		memset(map, 0, UFFS_POOL_MAP_SIZE(pool->chunk_bufs) * sizeof(u32));
+		pool->maps[pool->num_chunks] = map;
+	}
+	pool->chunks[pool->num_chunks++] = (u8 *)mem;
+	pool->num_bufs += pool->chunk_bufs;
+
+	for (i = pool->chunk_bufs; i > 0; i--) {
+		e = (uffs_PoolEntry *)((u8 *)mem + (i - 1) * pool->buf_size);
+		e->next = pool->free_list;
+		pool->free_list = e;
+	}
+
+	if (pool->sem != OSSEM_NOT_INITED)
+		uffs_SemSignal(pool->sem);
+
+	return U_SUCC;
+}
+
+/**
+ * \brief Add a memory chunk to the pool.
+ * \param[in] pool memory pool
+ * \param[in] mem chunk memory, same size as the pool memory given to uffs_PoolInit()
+ * \param[in] mem_size size of chunk memory
+ * \param[in] map bitmap of the chunk, UFFS_POOL_MAP_SIZE(num_bufs) words,
+ *				required if the pool has allocation bitmap, otherwise ignored.
+ * \return Returns U_SUCC if successful.
+ * \note new buffers are zeroed and put to the free list, in index order.
+ */
+URET uffs_PoolGrow(uffs_Pool *pool, void *mem, u32 mem_size, u32 *map)
+{
+	return _PoolGrow(pool, mem, mem_size, map, 0xFFFFFFFF);
+}
+
+#ifdef CONFIG_UFFS_GROWABLE_HANDLES
+
+static uffs_MemAllocator _grow_allocator = { NULL };
+
+/**
+ * \brief Get a buffer, grow the pool from system memory if it's empty.
+ * \param[in] pool memory pool
+ * \param[in] max_bufs don't grow the pool over this number of buffers
+ * \return Returns a pointer to the buffer or NULL if none is available.
+ */
+void * uffs_PoolGetGrow(uffs_Pool *pool, u32 max_bufs)
+{
+	void *p;
+	u32 size = pool->chunk_bufs * pool->buf_size;
+	u32 map_size = (pool->maps[0] ? UFFS_POOL_MAP_SIZE(pool->chunk_bufs) * sizeof(u32) : 0);
+
+	p = (pool->sem != OSSEM_NOT_INITED ? uffs_PoolGetLocked(pool) : uffs_PoolGet(pool));
+	// quick check before allocating, _PoolGrow() checks again under the lock
+	if (p == NULL && pool->num_bufs + pool->chunk_bufs <= max_bufs &&
+			pool->num_chunks < UFFS_POOL_MAX_CHUNKS) {
+		if (_grow_allocator.malloc == NULL)
+			uffs_MemSetupSystemAllocator(&_grow_allocator);
+
+		// the chunk bitmap is placed right after the buffers
+		p = _grow_allocator.malloc(NULL, size + map_size);
+		if (p) {
+			if (_PoolGrow(pool, p, size,
+					map_size > 0 ? (u32 *)((u8 *)p + size) : NULL, max_bufs) == U_SUCC) {
+				uffs_Perror(UFFS_MSG_NOISY, "pool grows to %d buffers", pool->num_bufs);
+			}
+			else {
+				_grow_allocator.free(NULL, p);
+			}
+			p = (pool->sem != OSSEM_NOT_INITED ? uffs_PoolGetLocked(pool) : uffs_PoolGet(pool));
+		}
+	}
+
+	return p;
+}
+
+/**
+ * \brief Free memory chunks got by uffs_PoolGetGrow().
+ * \note buffers in those chunks must not be used any more.
+ */
+void uffs_PoolReleaseGrown(uffs_Pool *pool)
+{
+	while (pool->num_chunks > 1) {
+		pool->num_chunks--;
+		_grow_allocator.free(NULL, pool->chunks[pool->num_chunks]);
+		pool->chunks[pool->num_chunks] = NULL;
+		pool->maps[pool->num_chunks] = NULL;
+	}
+	pool->num_bufs = pool->chunk_bufs;
 }
 
+#endif
+
 /**
  * \brief Releases the memory pool.
  * \param[in] pool memory pool
@@ -162,8 +377,10 @@ void *uffs_PoolGet(uffs_Pool *pool)
 		return NULL;
 
 	e = pool->free_list;
-	if (e)
+	if (e) {
 		pool->free_list = e->next;
+		_UpdateMap(pool, e, U_TRUE);
+	}
 
 	return e;
 }
@@ -188,8 +405,10 @@ void *uffs_PoolGetLocked(uffs_Pool *pool)
 	uffs_SemWait(pool->sem);
 
 	e = pool->free_list;
-	if (e)
+	if (e) {
 		pool->free_list = e->next;
+		_UpdateMap(pool, e, U_TRUE);
+	}
 
 	uffs_SemSignal(pool->sem);
 
@@ -212,6 +431,7 @@ int uffs_PoolPut(uffs_Pool *pool, void *p)
 	if (e) {
 		e->next = pool->free_list;
 		pool->free_list = e;
+		_UpdateMap(pool, e, U_FALSE);
 		return 0;
 	}
 
@@ -240,6 +460,7 @@ int uffs_PoolPutLocked(uffs_Pool *pool, void *p)
 		uffs_SemWait(pool->sem);
 		e->next = pool->free_list;
 		pool->free_list = e;
+		_UpdateMap(pool, e, U_FALSE);
 		uffs_SemSignal(pool->sem);
 		return 0;
 	}
@@ -263,7 +484,8 @@ void *uffs_PoolGetBufByIndex(uffs_Pool *pool, u32 index)
 		return NULL;
 	}
 
-	return (u8 *) pool->mem + index * pool->buf_size;
+	return pool->chunks[index / pool->chunk_bufs] +
+				(index % pool->chunk_bufs) * pool->buf_size;
 }
 
 /**
@@ -275,15 +497,17 @@ void *uffs_PoolGetBufByIndex(uffs_Pool *pool, u32 index)
  */
 u32 uffs_PoolGetIndex(uffs_Pool *pool, void *p)
 {
+	int chunk = -1;
+
 	if (!uffs_Assert(pool != NULL, "pool missing") ||
-		!uffs_Assert(p >= (void *) pool->mem &&
-			p < (void *) (pool->mem + pool->num_bufs * pool->buf_size),
+		!uffs_Assert((chunk = _FindChunk(pool, p)) >= 0,
 			"pointer out of range"))
 	{
 		uffs_Panic();
 	}
 
-	return ((u8 *) p - pool->mem) / pool->buf_size;
+	return chunk * pool->chunk_bufs +
+				((u8 *) p - pool->chunks[chunk]) / pool->buf_size;
 }
 
 /**
@@ -293,6 +517,17 @@ u32 uffs_PoolGetIndex(uffs_Pool *pool, void *p)
 UBOOL uffs_PoolCheckFreeList(uffs_Pool *pool, void *p)
 {
 	uffs_PoolEntry *e;
+	int chunk;
+	u32 i;
+
+	if (pool->maps[0]) {
+		chunk = _FindChunk(pool, p);
+		if (chunk < 0)
+			return U_FALSE;
+		i = ((u8 *)p - pool->chunks[chunk]) / pool->buf_size;
+		return (pool->maps[chunk][i / 32] & (1U << (i % 32))) ? U_FALSE : U_TRUE;
+	}
+
 	for (e = pool->free_list; e; e = e->next) {
 		if ((void *)e == p)
 			return U_TRUE;
@@ -303,7 +538,7 @@ UBOOL uffs_PoolCheckFreeList(uffs_Pool *pool, void *p)
 /**
  * \brief this is more efficient version for small nodes number memory pool (< 32)
  */
-static void * FindNextAllocatedInSmallPool(uffs_Pool *pool, void *from)
+static void * FindNextAllocatedInSmallPool(uffs_Pool *pool, u32 start)
 {
 	u32 map = 0;
 	uffs_PoolEntry *e;
@@ -312,8 +547,8 @@ static void * FindNextAllocatedInSmallPool(uffs_Pool *pool, void *from)
 	for (e = pool->free_list; e; e = e->next)
 		map |= (1 << uffs_PoolGetIndex(pool, e));
 
-	for (i = uffs_PoolGetIndex(pool, from);
-			(map & (1 << i)) && i < 32 && i < pool->num_bufs;
+	for (i = start;
+			i < 32 && i < pool->num_bufs && (map & (1 << i));
 				i++);
 
 	return i < 32 && i < pool->num_bufs ?
@@ -321,48 +556,67 @@ static void * FindNextAllocatedInSmallPool(uffs_Pool *pool, void *from)
 }
 
 
+/**
+ * \brief scan allocation bitmap for the next allocated block from index start
+ */
+static void * FindNextAllocatedInMap(uffs_Pool *pool, u32 start)
+{
+	u32 chunk, i, word;
+
+	for (chunk = start / pool->chunk_bufs; chunk < pool->num_chunks; chunk++) {
+		i = (chunk == start / pool->chunk_bufs ? start % pool->chunk_bufs : 0);
+		while (i < pool->chunk_bufs) {
+			word = pool->maps[chunk][i / 32] & (0xFFFFFFFFU << (i % 32));
+			if (word) {
+				i = (i & ~31U) + _LowestBit(word);
+				return i < pool->chunk_bufs ?
+						pool->chunks[chunk] + i * pool->buf_size : NULL;
+			}
+			i = (i & ~31U) + 32;
+		}
+	}
+
+	return NULL;
+}
+
 /**
  * \brief Find next allocated memory block
  *
  * \param[in] pool memory pool
- * \param[in] from search start address, if NULL, from pool->mem
+ * \param[in] from search start after this block, if NULL, from the first block
  *
  * \return next allocated memory block, NULL if not found.
  *
- * \note This is NOT efficient, don't do it on a pool with large free nodes !
+ * \note This is NOT efficient on a large pool without allocation bitmap,
+ *		see uffs_PoolSetAllocMap().
  */
 void * uffs_PoolFindNextAllocated(uffs_Pool *pool, void *from)
 {
-	uffs_PoolEntry *e = NULL;
-	u8 *p = (u8 *)from;
+	uffs_PoolEntry *e;
+	u32 i;
+	u8 *p;
 
-	if (p == NULL)
-		p = pool->mem;
-	else
-		p += pool->buf_size;
+	i = (from == NULL ? 0 : uffs_PoolGetIndex(pool, from) + 1);
+
+	if (pool->maps[0])
+		return FindNextAllocatedInMap(pool, i);
 
 	if (pool->num_bufs < 32)
-		return FindNextAllocatedInSmallPool(pool, p);
+		return FindNextAllocatedInSmallPool(pool, i);
 
 	// work through the free list, stop if not in free list,
 	// otherwise move to next entry and search free list again.
-
-	if (pool->free_list) {
-		while (uffs_PoolVerify(pool, p)) {
-			e = pool->free_list;
-			while (e) {
-				if (p == (u8 *)e) {
-					p += pool->buf_size; // in free list, move to next entry
-					break;
-				}
-				e = e->next;
-			}
-			if (e == NULL)	// not in free_list, gotcha
+	for (; i < pool->num_bufs; i++) {
+		p = (u8 *)uffs_PoolGetBufByIndex(pool, i);
+		for (e = pool->free_list; e; e = e->next) {
+			if (p == (u8 *)e)
 				break;
-		}	
+		}
+		if (e == NULL)	// not in free_list, gotcha
+			return p;
 	}
 
-	return uffs_PoolVerify(pool, p) ? p : NULL ;
+	return NULL;
 }
 
 /**
@@ -115,6 +115,17 @@ u16 uffs_FindBestPageInBlock(uffs_Device *dev, uffs_BlockInfo *bc, u16 page)
 		return UFFS_INVALID_PAGE;
 	}
 
+	// look up the page_id map first, the newest page with the same page_id
+	// is the best page if it belongs to the same object.
+	i = uffs_BlockInfoFindPageById(dev, bc, TAG_PAGE_ID(tag_old));
+	if (i != UFFS_INVALID_PAGE && i >= page) {
+		tag = GET_TAG(bc, i);
+		if (TAG_PARENT(tag) == TAG_PARENT(tag_old) &&
+			TAG_SERIAL(tag) == TAG_SERIAL(tag_old)) {
+			return i;
+		}
+	}
+
 	if (uffs_BlockInfoFindFirstFreePage(dev, bc, 0, dev->attr->pages_per_block, &first_free_page) != U_SUCC) {
 		return page;
 	}
@@ -159,27 +170,12 @@ u16 uffs_FindBestPageInBlock(uffs_Device *dev, uffs_BlockInfo *bc, u16 page)
  * \return the valid page number which has given page_id
  * \retval >=0 page number
  * \retval UFFS_INVALID_PAGE page not found
+ * \note the page is looked up from block info's page_id map,
+ *		so it's already the newest page with given page_id.
  */
 u16 uffs_FindPageInBlockWithPageId(uffs_Device *dev, uffs_BlockInfo *bc, u16 page_id)
 {
-	u16 page;
-	u16 first_free_page;
-	uffs_Tags *tag;
-
-	if (uffs_BlockInfoFindFirstFreePage(dev, bc, page_id, dev->attr->pages_per_block, &first_free_page) != U_SUCC) {
-		return UFFS_INVALID_PAGE;
-	}
-
-	// The best page which has page_id, should be ahead of page indexed with page_id
-	for (page = page_id; page < first_free_page; page++) {
-		uffs_BlockInfoLoadPage(dev, bc, page);
-		tag = &(bc->spares[page].tag);
-		if (TAG_IS_GOOD(tag) && TAG_PAGE_ID(tag) == page_id) {
-			return page;
-		}
-	}
-
-	return UFFS_INVALID_PAGE;
+	return uffs_BlockInfoFindPageById(dev, bc, page_id);
 }
 
 /** 
@@ -299,7 +295,7 @@ URET uffs_CreateNewFile(uffs_Device *dev,
 	tag = GET_TAG(bc, 0);
 	TAG_PARENT(tag) = parent;
 	TAG_SERIAL(tag) = serial;
-	TAG_DATA_LEN(tag) = sizeof(uffs_FileInfo);
+	TAG_SET_DATA_LEN(tag, sizeof(uffs_FileInfo));
 
 	buf = uffs_BufGet(dev, parent, serial, 0);
 	if (buf == NULL) {
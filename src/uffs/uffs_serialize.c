@@ -30,17 +30,46 @@ static UBOOL IsValidTreeAddress(uffs_Device *dev, void *address) {
 	return U_TRUE;
 }
 
-static URET SerializeIndex(uffs_Device *dev, void *address) {
-	uffs_SerializeOps *ops;
+/* block numbers and tree node indexes are 32 bits with CONFIG_UFFS_WIDE_BLOCK_ADDR */
+static int WriteNodeIndex(uffs_Device *dev, uffs_NodeIndex index) {
+#ifdef CONFIG_UFFS_WIDE_BLOCK_ADDR
+	return dev->serial_ops->WriteU32(dev, index);
+#else
+	return dev->serial_ops->WriteU16(dev, index);
+#endif
+}
 
-	ops = dev->serial_ops;
+static int ReadNodeIndex(uffs_Device *dev, uffs_NodeIndex *index) {
+#ifdef CONFIG_UFFS_WIDE_BLOCK_ADDR
+	return dev->serial_ops->ReadU32(dev, index);
+#else
+	return dev->serial_ops->ReadU16(dev, index);
+#endif
+}
+
+static int WriteBlockNum(uffs_Device *dev, uffs_BlockNum block) {
+#ifdef CONFIG_UFFS_WIDE_BLOCK_ADDR
+	return dev->serial_ops->WriteU32(dev, block);
+#else
+	return dev->serial_ops->WriteU16(dev, block);
+#endif
+}
 
+static int ReadBlockNum(uffs_Device *dev, uffs_BlockNum *block) {
+#ifdef CONFIG_UFFS_WIDE_BLOCK_ADDR
+	return dev->serial_ops->ReadU32(dev, block);
+#else
+	return dev->serial_ops->ReadU16(dev, block);
+#endif
+}
+
+static URET SerializeIndex(uffs_Device *dev, void *address) {
 	if (address == NULL) {
-		if (ops->WriteU16(dev, (u16)(-1)) < 0) {
+		if (WriteNodeIndex(dev, EMPTY_NODE) < 0) {
 	        return U_FAIL;
 		}
 	} else {
-		if (ops->WriteU16(dev, (u16)TO_POOL_INDEX(address, &dev->mem.tree_pool)) < 0) {
+		if (WriteNodeIndex(dev, (uffs_NodeIndex)TO_POOL_INDEX(address, &dev->mem.tree_pool)) < 0) {
 	        return U_FAIL;
 		}
 	}
@@ -49,16 +78,13 @@ static URET SerializeIndex(uffs_Device *dev, void *address) {
 }
 
 static URET DeserializeIndex(uffs_Device *dev, void **address) {
-	u16 index;
-	uffs_SerializeOps *ops;
-
-	ops = dev->serial_ops;
+	uffs_NodeIndex index;
 
-	if (ops->ReadU16(dev, &index) < 0) {
+	if (ReadNodeIndex(dev, &index) < 0) {
 		return U_FAIL;
 	}
 
-	if (index == (u16)-1) {
+	if (index == EMPTY_NODE) {
 		*address = NULL;
 	} else {
 		*address = FROM_POOL_INDEX(index, &dev->mem.tree_pool);
@@ -125,7 +151,7 @@ static URET SerializeErasedBlocks(uffs_Device *dev) {
 			return U_FAIL;
 		}
 
-		if (ops->WriteU16(dev, node->u.list.block) < 0) {
+		if (WriteBlockNum(dev, node->u.list.block) < 0) {
 			uffs_Perror(UFFS_MSG_SERIOUS, "cannot write block number");
 		}
 
@@ -133,7 +159,7 @@ static URET SerializeErasedBlocks(uffs_Device *dev) {
 			uffs_Perror(UFFS_MSG_SERIOUS, "cannot write need check flag");
 		}
 
-		node = node->u.list.next;
+		node = LIST_NEXT(dev, node);
 	}
 
 	if (SerializeIndex(dev, node) != U_SUCC) {
@@ -146,6 +172,7 @@ static URET SerializeErasedBlocks(uffs_Device *dev) {
 
 static URET DeserializeErasedBlocks(uffs_Device *dev) {
 	TreeNode *node;
+	TreeNode *next;
 	uffs_SerializeOps *ops;
 
 	ops = dev->serial_ops;
@@ -158,8 +185,10 @@ static URET DeserializeErasedBlocks(uffs_Device *dev) {
 	dev->tree.erased_count = 0;
 	dev->tree.erased_tail = dev->tree.erased;
 	node = dev->tree.erased;
+	if (node != NULL)
+		LIST_SET_PREV(dev, node, NULL);
 	while (node != NULL) {
-		if (ops->ReadU16(dev, &node->u.list.block) < 0) {
+		if (ReadBlockNum(dev, &node->u.list.block) < 0) {
 			uffs_Perror(UFFS_MSG_SERIOUS, "cannot read block number");
 		}
 
@@ -167,18 +196,19 @@ static URET DeserializeErasedBlocks(uffs_Device *dev) {
 			uffs_Perror(UFFS_MSG_SERIOUS, "cannot read need check flag");
 		}
 
-		if (DeserializeIndex(dev, (void**)&node->u.list.next) != U_SUCC) {
+		if (DeserializeIndex(dev, (void**)&next) != U_SUCC) {
 			uffs_Perror(UFFS_MSG_SERIOUS, "cannot read next erased block index");
 			return U_FAIL;
 		}
+		LIST_SET_NEXT(dev, node, next);
 
-		if (node->u.list.next != NULL) {
-			node->u.list.next->u.list.prev = node;
+		if (next != NULL) {
+			LIST_SET_PREV(dev, next, node);
 		}
 
 		dev->tree.erased_tail = node;
 		dev->tree.erased_count++;
-		node = node->u.list.next;
+		node = LIST_NEXT(dev, node);
 	}
 
 	return U_SUCC;
@@ -186,9 +216,6 @@ static URET DeserializeErasedBlocks(uffs_Device *dev) {
 
 static URET SerializeBadBlocks(uffs_Device *dev) {
 	TreeNode *node;
-	uffs_SerializeOps *ops;
-
-	ops = dev->serial_ops;
 
 	node = dev->tree.bad;
 	while (node != NULL) {
@@ -197,12 +224,12 @@ static URET SerializeBadBlocks(uffs_Device *dev) {
 			return U_FAIL;
 		}
 
-		if (ops->WriteU16(dev, node->u.list.block) < 0) {
+		if (WriteBlockNum(dev, node->u.list.block) < 0) {
 			uffs_Perror(UFFS_MSG_SERIOUS, "cannot write block number");
 			return U_FAIL;
 		}
 
-		node = node->u.list.next;
+		node = LIST_NEXT(dev, node);
 	}
 
 	if (SerializeIndex(dev, node) != U_SUCC) {
@@ -215,9 +242,7 @@ static URET SerializeBadBlocks(uffs_Device *dev) {
 
 static URET DeserializeBadBlocks(uffs_Device *dev) {
 	TreeNode *node;
-	uffs_SerializeOps *ops;
-
-	ops = dev->serial_ops;
+	TreeNode *next;
 
 	if (DeserializeIndex(dev, (void**)&dev->tree.bad) != U_SUCC) {
 		uffs_Perror(UFFS_MSG_SERIOUS, "cannot read bad block index");
@@ -226,23 +251,26 @@ static URET DeserializeBadBlocks(uffs_Device *dev) {
 
 	dev->tree.bad_count = 0;
 	node = dev->tree.bad;
+	if (node != NULL)
+		LIST_SET_PREV(dev, node, NULL);
 	while (node != NULL) {
-		if (ops->ReadU16(dev, &node->u.list.block) < 0) {
+		if (ReadBlockNum(dev, &node->u.list.block) < 0) {
 			uffs_Perror(UFFS_MSG_SERIOUS, "cannot read block number");
 			return U_FAIL;
 		}
 
-		if (DeserializeIndex(dev, (void**)&node->u.list.next) != U_SUCC) {
+		if (DeserializeIndex(dev, (void**)&next) != U_SUCC) {
 			uffs_Perror(UFFS_MSG_SERIOUS, "cannot read next bad block index");
 			return U_FAIL;
 		}
+		LIST_SET_NEXT(dev, node, next);
 
-		if (node->u.list.next != NULL) {
-			node->u.list.next->u.list.prev = node;
+		if (next != NULL) {
+			LIST_SET_PREV(dev, next, node);
 		}
 
 		dev->tree.bad_count++;
-		node = node->u.list.next;
+		node = LIST_NEXT(dev, node);
 	}
 
 	return U_SUCC;
@@ -250,8 +278,8 @@ static URET DeserializeBadBlocks(uffs_Device *dev) {
 
 static URET SerializeDirNodes(uffs_Device *dev) {
 	u16 hash;
-	u16 index;
-	u16 nodes_count;
+	uffs_NodeIndex index;
+	uffs_NodeIndex nodes_count;
 	TreeNode *node;
 	uffs_SerializeOps *ops;
 
@@ -259,7 +287,7 @@ static URET SerializeDirNodes(uffs_Device *dev) {
 
 	nodes_count = 0;
 	for (hash = 0; hash < DIR_NODE_ENTRY_LEN; hash++) {
-		if (ops->WriteU16(dev, dev->tree.dir_entry[hash]) < 0) {
+		if (WriteNodeIndex(dev, dev->tree.dir_entry[hash]) < 0) {
 			uffs_Perror(UFFS_MSG_SERIOUS, "cannot write dir hash");
 			return U_FAIL;
 		}
@@ -272,7 +300,7 @@ static URET SerializeDirNodes(uffs_Device *dev) {
 		}
 	}
 
-	if (ops->WriteU16(dev, nodes_count) < 0) {
+	if (WriteNodeIndex(dev, nodes_count) < 0) {
 		uffs_Perror(UFFS_MSG_SERIOUS, "cannot write dir nodes count");
 		return U_FAIL;
 	}
@@ -286,17 +314,17 @@ static URET SerializeDirNodes(uffs_Device *dev) {
 				return U_FAIL;
 			}
 
-			if (ops->WriteU16(dev, node->hash_next) < 0) {
+			if (WriteNodeIndex(dev, node->hash_next) < 0) {
 				uffs_Perror(UFFS_MSG_SERIOUS, "cannot write next hash");
 				return U_FAIL;
 			}
 
-			if (ops->WriteU16(dev, node->hash_prev) < 0) {
+			if (WriteNodeIndex(dev, node->hash_prev) < 0) {
 				uffs_Perror(UFFS_MSG_SERIOUS, "cannot write prev hash");
 				return U_FAIL;
 			}
 
-			if (ops->WriteU16(dev, node->u.dir.block) < 0) {
+			if (WriteBlockNum(dev, node->u.dir.block) < 0) {
 				uffs_Perror(UFFS_MSG_SERIOUS, "cannot write dir block number");
 				return U_FAIL;
 			}
@@ -324,8 +352,8 @@ static URET SerializeDirNodes(uffs_Device *dev) {
 }
 
 static URET DeserializeDirNodes(uffs_Device *dev) {
-	u16 index;
-	u16 nodes_count;
+	uffs_NodeIndex index;
+	uffs_NodeIndex nodes_count;
 	TreeNode *node;
 	uffs_SerializeOps *ops;
 
@@ -333,13 +361,13 @@ static URET DeserializeDirNodes(uffs_Device *dev) {
 
 	nodes_count = 0;
 	for (index = 0; index < DIR_NODE_ENTRY_LEN; index++) {
-		if (ops->ReadU16(dev, &dev->tree.dir_entry[index]) < 0) {
+		if (ReadNodeIndex(dev, &dev->tree.dir_entry[index]) < 0) {
 			uffs_Perror(UFFS_MSG_SERIOUS, "cannot read dir hash");
 			return U_FAIL;
 		}
 	}
 
-	if (ops->ReadU16(dev, &nodes_count) < 0) {
+	if (ReadNodeIndex(dev, &nodes_count) < 0) {
 		uffs_Perror(UFFS_MSG_SERIOUS, "cannot read dir nodes count");
 		return U_FAIL;
 	}
@@ -350,17 +378,17 @@ static URET DeserializeDirNodes(uffs_Device *dev) {
 			return U_FAIL;
 		}
 
-		if (ops->ReadU16(dev, &node->hash_next) < 0) {
+		if (ReadNodeIndex(dev, &node->hash_next) < 0) {
 			uffs_Perror(UFFS_MSG_SERIOUS, "cannot read next hash");
 			return U_FAIL;
 		}
 
-		if (ops->ReadU16(dev, &node->hash_prev) < 0) {
+		if (ReadNodeIndex(dev, &node->hash_prev) < 0) {
 			uffs_Perror(UFFS_MSG_SERIOUS, "cannot read prev hash");
 			return U_FAIL;
 		}
 
-		if (ops->ReadU16(dev, &node->u.dir.block) < 0) {
+		if (ReadBlockNum(dev, &node->u.dir.block) < 0) {
 			uffs_Perror(UFFS_MSG_SERIOUS, "cannot read dir block number");
 			return U_FAIL;
 		}
@@ -386,8 +414,8 @@ static URET DeserializeDirNodes(uffs_Device *dev) {
 
 static URET SerializeFileNodes(uffs_Device *dev) {
 	u16 hash;
-	u16 index;
-	u16 nodes_count;
+	uffs_NodeIndex index;
+	uffs_NodeIndex nodes_count;
 	TreeNode *node;
 	uffs_SerializeOps *ops;
 
@@ -395,7 +423,7 @@ static URET SerializeFileNodes(uffs_Device *dev) {
 
 	nodes_count = 0;
 	for (hash = 0; hash < FILE_NODE_ENTRY_LEN; hash++) {
-		if (ops->WriteU16(dev, dev->tree.file_entry[hash]) < 0) {
+		if (WriteNodeIndex(dev, dev->tree.file_entry[hash]) < 0) {
 			uffs_Perror(UFFS_MSG_SERIOUS, "cannot write file hash");
 			return U_FAIL;
 		}
@@ -408,7 +436,7 @@ static URET SerializeFileNodes(uffs_Device *dev) {
 		}
 	}
 
-	if (ops->WriteU16(dev, nodes_count) < 0) {
+	if (WriteNodeIndex(dev, nodes_count) < 0) {
 		uffs_Perror(UFFS_MSG_SERIOUS, "cannot write file nodes count");
 		return U_FAIL;
 	}
@@ -422,17 +450,17 @@ static URET SerializeFileNodes(uffs_Device *dev) {
 				return U_FAIL;
 			}
 
-			if (ops->WriteU16(dev, node->hash_next) < 0) {
+			if (WriteNodeIndex(dev, node->hash_next) < 0) {
 				uffs_Perror(UFFS_MSG_SERIOUS, "cannot write next hash");
 				return U_FAIL;
 			}
 
-			if (ops->WriteU16(dev, node->hash_prev) < 0) {
+			if (WriteNodeIndex(dev, node->hash_prev) < 0) {
 				uffs_Perror(UFFS_MSG_SERIOUS, "cannot write prev hash");
 				return U_FAIL;
 			}
 
-			if (ops->WriteU16(dev, node->u.file.block) < 0) {
+			if (WriteBlockNum(dev, node->u.file.block) < 0) {
 				uffs_Perror(UFFS_MSG_SERIOUS, "cannot write file block number");
 				return U_FAIL;
 			}
@@ -452,7 +480,7 @@ static URET SerializeFileNodes(uffs_Device *dev) {
 				return U_FAIL;
 			}
 
-			if (ops->WriteU32(dev, node->u.file.len) < 0) {
+			if (ops->WriteU32(dev, FILE_NODE_LEN(dev, node)) < 0) {
 				uffs_Perror(UFFS_MSG_SERIOUS, "cannot write file len");
 				return U_FAIL;
 			}
@@ -465,8 +493,8 @@ static URET SerializeFileNodes(uffs_Device *dev) {
 }
 
 static URET DeserializeFileNodes(uffs_Device *dev) {
-	u16 index;
-	u16 nodes_count;
+	uffs_NodeIndex index;
+	uffs_NodeIndex nodes_count;
 	TreeNode *node;
 	uffs_SerializeOps *ops;
 
@@ -474,13 +502,13 @@ static URET DeserializeFileNodes(uffs_Device *dev) {
 
 	nodes_count = 0;
 	for (index = 0; index < FILE_NODE_ENTRY_LEN; index++) {
-		if (ops->ReadU16(dev, &dev->tree.file_entry[index]) < 0) {
+		if (ReadNodeIndex(dev, &dev->tree.file_entry[index]) < 0) {
 			uffs_Perror(UFFS_MSG_SERIOUS, "cannot read file hash");
 			return U_FAIL;
 		}
 	}
 
-	if (ops->ReadU16(dev, &nodes_count) < 0) {
+	if (ReadNodeIndex(dev, &nodes_count) < 0) {
 		uffs_Perror(UFFS_MSG_SERIOUS, "cannot read file nodes count");
 		return U_FAIL;
 	}
@@ -491,17 +519,17 @@ static URET DeserializeFileNodes(uffs_Device *dev) {
 			return U_FAIL;
 		}
 
-		if (ops->ReadU16(dev, &node->hash_next) < 0) {
+		if (ReadNodeIndex(dev, &node->hash_next) < 0) {
 			uffs_Perror(UFFS_MSG_SERIOUS, "cannot read next hash");
 			return U_FAIL;
 		}
 
-		if (ops->ReadU16(dev, &node->hash_prev) < 0) {
+		if (ReadNodeIndex(dev, &node->hash_prev) < 0) {
 			uffs_Perror(UFFS_MSG_SERIOUS, "cannot read prev hash");
 			return U_FAIL;
 		}
 
-		if (ops->ReadU16(dev, &node->u.file.block) < 0) {
+		if (ReadBlockNum(dev, &node->u.file.block) < 0) {
 			uffs_Perror(UFFS_MSG_SERIOUS, "cannot read file block number");
 			return U_FAIL;
 		}
@@ -521,7 +549,14 @@ static URET DeserializeFileNodes(uffs_Device *dev) {
 			return U_FAIL;
 		}
 
-		if (ops->ReadU32(dev, &node->u.file.len) < 0) {
+#ifdef CONFIG_UFFS_COMPACT_TREE_NODE
+		if (node->u.file.serial >= dev->tree.file_len_num) {
+			uffs_Perror(UFFS_MSG_SERIOUS, "file serial %d out of file length table", node->u.file.serial);
+			return U_FAIL;
+		}
+#endif
+
+		if (ops->ReadU32(dev, &FILE_NODE_LEN(dev, node)) < 0) {
 			uffs_Perror(UFFS_MSG_SERIOUS, "cannot read file len");
 			return U_FAIL;
 		}
@@ -532,8 +567,8 @@ static URET DeserializeFileNodes(uffs_Device *dev) {
 
 static URET SerializeDataNodes(uffs_Device *dev) {
 	u16 hash;
-	u16 index;
-	u16 nodes_count;
+	uffs_NodeIndex index;
+	uffs_NodeIndex nodes_count;
 	TreeNode *node;
 	uffs_SerializeOps *ops;
 
@@ -541,7 +576,7 @@ static URET SerializeDataNodes(uffs_Device *dev) {
 
 	nodes_count = 0;
 	for (hash = 0; hash < DATA_NODE_ENTRY_LEN; hash++) {
-		if (ops->WriteU16(dev, dev->tree.data_entry[hash]) < 0) {
+		if (WriteNodeIndex(dev, dev->tree.data_entry[hash]) < 0) {
 			uffs_Perror(UFFS_MSG_SERIOUS, "cannot write data hash");
 			return U_FAIL;
 		}
@@ -554,7 +589,7 @@ static URET SerializeDataNodes(uffs_Device *dev) {
 		}
 	}
 
-	if (ops->WriteU16(dev, nodes_count) < 0) {
+	if (WriteNodeIndex(dev, nodes_count) < 0) {
 		uffs_Perror(UFFS_MSG_SERIOUS, "cannot write data nodes count");
 		return U_FAIL;
 	}
@@ -568,17 +603,17 @@ static URET SerializeDataNodes(uffs_Device *dev) {
 				return U_FAIL;
 			}
 
-			if (ops->WriteU16(dev, node->hash_next) < 0) {
+			if (WriteNodeIndex(dev, node->hash_next) < 0) {
 				uffs_Perror(UFFS_MSG_SERIOUS, "cannot write next hash");
 				return U_FAIL;
 			}
 
-			if (ops->WriteU16(dev, node->hash_prev) < 0) {
+			if (WriteNodeIndex(dev, node->hash_prev) < 0) {
 				uffs_Perror(UFFS_MSG_SERIOUS, "cannot write prev hash");
 				return U_FAIL;
 			}
 
-			if (ops->WriteU16(dev, node->u.data.block) < 0) {
+			if (WriteBlockNum(dev, node->u.data.block) < 0) {
 				uffs_Perror(UFFS_MSG_SERIOUS, "cannot write data block number");
 				return U_FAIL;
 			}
@@ -593,7 +628,11 @@ static URET SerializeDataNodes(uffs_Device *dev) {
 				return U_FAIL;
 			}
 
+#ifdef CONFIG_UFFS_COMPACT_TREE_NODE
+			if (ops->WriteU32(dev, 0) < 0) {		// not kept in compact node
+#else
 			if (ops->WriteU32(dev, node->u.data.len) < 0) {
+#endif
 				uffs_Perror(UFFS_MSG_SERIOUS, "cannot write data len");
 				return U_FAIL;
 			}
@@ -606,22 +645,25 @@ static URET SerializeDataNodes(uffs_Device *dev) {
 }
 
 static URET DeserializeDataNodes(uffs_Device *dev) {
-	u16 index;
-	u16 nodes_count;
+	uffs_NodeIndex index;
+	uffs_NodeIndex nodes_count;
 	TreeNode *node;
+#ifdef CONFIG_UFFS_COMPACT_TREE_NODE
+	u32 data_len;
+#endif
 	uffs_SerializeOps *ops;
 
 	ops = dev->serial_ops;
 
 	nodes_count = 0;
 	for (index = 0; index < DATA_NODE_ENTRY_LEN; index++) {
-		if (ops->ReadU16(dev, &dev->tree.data_entry[index]) < 0) {
+		if (ReadNodeIndex(dev, &dev->tree.data_entry[index]) < 0) {
 			uffs_Perror(UFFS_MSG_SERIOUS, "cannot read data hash");
 			return U_FAIL;
 		}
 	}
 
-	if (ops->ReadU16(dev, &nodes_count) < 0) {
+	if (ReadNodeIndex(dev, &nodes_count) < 0) {
 		uffs_Perror(UFFS_MSG_SERIOUS, "cannot read data nodes count");
 		return U_FAIL;
 	}
@@ -632,17 +674,17 @@ static URET DeserializeDataNodes(uffs_Device *dev) {
 			return U_FAIL;
 		}
 
-		if (ops->ReadU16(dev, &node->hash_next) < 0) {
+		if (ReadNodeIndex(dev, &node->hash_next) < 0) {
 			uffs_Perror(UFFS_MSG_SERIOUS, "cannot read next hash");
 			return U_FAIL;
 		}
 
-		if (ops->ReadU16(dev, &node->hash_prev) < 0) {
+		if (ReadNodeIndex(dev, &node->hash_prev) < 0) {
 			uffs_Perror(UFFS_MSG_SERIOUS, "cannot read prev hash");
 			return U_FAIL;
 		}
 
-		if (ops->ReadU16(dev, &node->u.data.block) < 0) {
+		if (ReadBlockNum(dev, &node->u.data.block) < 0) {
 			uffs_Perror(UFFS_MSG_SERIOUS, "cannot write data block number");
 			return U_FAIL;
 		}
@@ -657,7 +699,11 @@ static URET DeserializeDataNodes(uffs_Device *dev) {
 			return U_FAIL;
 		}
 
+#ifdef CONFIG_UFFS_COMPACT_TREE_NODE
+		if (ops->ReadU32(dev, &data_len) < 0) {		// not kept in compact node
+#else
 		if (ops->ReadU32(dev, &node->u.data.len) < 0) {
+#endif
 			uffs_Perror(UFFS_MSG_SERIOUS, "cannot write data len");
 			return U_FAIL;
 		}
@@ -669,6 +715,11 @@ static URET DeserializeDataNodes(uffs_Device *dev) {
 URET uffs_SerializeState(uffs_Device *dev) {
 	uffs_SerializeOps *ops;
 
+#ifdef CONFIG_UFFS_SMALL_FILE_PACK
+	uffs_Perror(UFFS_MSG_NORMAL, "tree state serialization is not supported with small file packing");
+	return U_FAIL;
+#endif
+
 	ops = dev->serial_ops;
 	if (ops == NULL) {
 		uffs_Perror(UFFS_MSG_NORMAL, "serialization operations are not set");
@@ -776,13 +827,17 @@ static URET DeserializeState(uffs_Device *dev) {
 }
 
 static void ResetState(uffs_Device *dev) {
-	u16 index;
+	uffs_NodeIndex index;
 
 	memset(dev->mem.tree_pool.mem, 0, dev->mem.tree_pool.buf_size * dev->mem.tree_pool.num_bufs);
 
 	dev->tree.erased = NULL;
 	dev->tree.erased_tail = NULL;
 	dev->tree.erased_count = 0;
+	dev->tree.prealloc = NULL;
+	dev->tree.prealloc_count = 0;
+	dev->tree.prealloc_owner = INVALID_UFFS_SERIAL;
+	dev->tree.prealloc_holder = NULL;
 	dev->tree.bad = NULL;
 	dev->tree.bad_count = 0;
 
@@ -807,10 +862,17 @@ static void ResetState(uffs_Device *dev) {
 }
 
 URET uffs_DeserializeState(uffs_Device *dev) {
+#ifdef CONFIG_UFFS_SMALL_FILE_PACK
+	uffs_Perror(UFFS_MSG_NORMAL, "tree state serialization is not supported with small file packing");
+	return U_FAIL;
+#endif
+
 	if (DeserializeState(dev) != U_SUCC) {
 		ResetState(dev);
 		return U_FAIL;
 	}
 
+	uffs_TreeResetFsnMap(dev);
+
 	return U_SUCC;
 }
@@ -0,0 +1,187 @@
+/*
+  This file is part of UFFS, the Ultra-low-cost Flash File System.
+  
+  Copyright (C) 2005-2009 Ricky Zheng <ricky_gz_zheng@yahoo.co.nz>
+
+  UFFS is free software; you can redistribute it and/or modify it under
+  the GNU Library General Public License as published by the Free Software 
+  Foundation; either version 2 of the License, or (at your option) any
+  later version.
+
+  UFFS is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+  or GNU Library General Public License, as applicable, for more details.
+ 
+  You should have received a copy of the GNU General Public License
+  and GNU Library General Public License along with UFFS; if not, write
+  to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA  02110-1301, USA.
+
+  As a special exception, if other files instantiate templates or use
+  macros or inline functions from this file, or you compile this file
+  and link it with other works to produce a work based on this file,
+  this file does not by itself cause the resulting work to be covered
+  by the GNU General Public License. However the source code for this
+  file must still be made available in accordance with section (3) of
+  the GNU General Public License v2.
+ 
+  This exception does not invalidate any other reasons why a work based
+  on this file might be covered by the GNU General Public License.
+*/
+
+
+/** 
+ * \file uffs_trace.c
+ * \brief low overhead tracepoints and ring buffer trace consumer
+ * \author Ricky Zheng
+ */
+
+#include "uffs_config.h"
+#include "uffs/uffs_public.h"
+#include "uffs/uffs_device.h"
+#include "uffs/uffs_utils.h"
+#include "uffs/uffs_trace.h"
+#include <string.h>
+
+#define PFX "trac: "
+
+#ifdef CONFIG_UFFS_TRACE
+
+uffs_TraceSink *uffs_trace_sink = NULL;
+static uffs_TraceSink m_trace_sink = { NULL, NULL };
+static OSSEM m_trace_lock = OSSEM_NOT_INITED;
+
+/**
+ * install trace hook, pass NULL to stop tracing.
+ * \note a hook may still be running on other tasks when this returns,
+ *		 the caller must quiesce them before releasing the hook's ctx.
+ */
+void uffs_TraceSetHook(uffs_TraceHook hook, void *ctx)
+{
+	if (m_trace_lock == OSSEM_NOT_INITED && uffs_SemCreate(&m_trace_lock) < 0) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "can't create trace lock");
+		return;
+	}
+
+	uffs_SemWait(m_trace_lock);
+	m_trace_sink.hook = hook;
+	m_trace_sink.ctx = ctx;
+	uffs_trace_sink = (hook ? &m_trace_sink : NULL);
+	uffs_SemSignal(m_trace_lock);
+}
+
+/** build a record and deliver it to the trace hook */
+void uffs_TraceEmit(uffs_Device *dev, u8 event, u32 block, u16 page,
+					u16 serial, u8 arg, URET ret, u32 start)
+{
+	uffs_TraceRecord rec;
+	uffs_TraceSink sink = { NULL, NULL };
+
+	if (m_trace_lock == OSSEM_NOT_INITED)
+		return;
+
+	// take hook and ctx as a pair, uffs_TraceSetHook() may be changing them
+	uffs_SemWait(m_trace_lock);
+	if (uffs_trace_sink)
+		sink = *uffs_trace_sink;
+	uffs_SemSignal(m_trace_lock);
+
+	if (sink.hook == NULL)
+		return;
+
+	rec.start = start;
+	rec.duration = uffs_OSGetTick() - start;
+	rec.block = block;
+	rec.page = page;
+	rec.serial = serial;
+	rec.event = event;
+	rec.dev = (u8)(dev ? dev->dev_num : 0);
+	rec.arg = arg;
+	rec.result = (ret == U_SUCC ? UFFS_TRACE_OK : UFFS_TRACE_FAIL);
+
+	sink.hook(&rec, sink.ctx);
+}
+
+/** initialize ring buffer consumer with caller's record buffer */
+URET uffs_TraceRingInit(uffs_TraceRing *ring, uffs_TraceRecord *recs, int size)
+{
+	ring->recs = recs;
+	ring->size = (size > 0 ? size : 0);
+	ring->head = 0;
+	ring->count = 0;
+	ring->lost = 0;
+	ring->lock = OSSEM_NOT_INITED;
+
+	if (uffs_SemCreate(&ring->lock) < 0) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "can't create trace ring lock");
+		ring->size = 0;
+		return U_FAIL;
+	}
+
+	return U_SUCC;
+}
+
+/**
+ * release ring buffer consumer.
+ * \note the ring hook must be uninstalled before, and the caller must make
+ *		 sure no task is still inside uffs_TraceRingHook() (e.g. all devices
+ *		 idle or locked), since the hook may have been picked up just before.
+ */
+void uffs_TraceRingRelease(uffs_TraceRing *ring)
+{
+	if (ring->lock != OSSEM_NOT_INITED)
+		uffs_SemDelete(&ring->lock);
+	ring->size = 0;
+	ring->count = 0;
+}
+
+/**
+ * trace hook storing records to ring buffer, ctx is the (uffs_TraceRing *).
+ * when the ring is full, the oldest record will be overwritten.
+ */
+void uffs_TraceRingHook(const uffs_TraceRecord *rec, void *ctx)
+{
+	uffs_TraceRing *ring = (uffs_TraceRing *)ctx;
+
+	if (ring == NULL || ring->size == 0)
+		return;
+
+	uffs_SemWait(ring->lock);
+	memcpy(&ring->recs[ring->head], rec, sizeof(uffs_TraceRecord));
+	ring->head = (ring->head + 1) % ring->size;
+
+	if (ring->count < ring->size)
+		ring->count++;
+	else
+		ring->lost++;
+	uffs_SemSignal(ring->lock);
+}
+
+/**
+ * read the oldest records from ring buffer
+ * \param[in] ring ring buffer
+ * \param[out] recs records buffer
+ * \param[in] max maximum number of records to read
+ * \return number of records copied to recs
+ */
+int uffs_TraceRingRead(uffs_TraceRing *ring, uffs_TraceRecord *recs, int max)
+{
+	int n = 0;
+	u32 tail;
+
+	if (ring->size == 0)
+		return 0;
+
+	uffs_SemWait(ring->lock);
+	while (n < max && ring->count > 0) {
+		tail = (ring->head + ring->size - ring->count) % ring->size;
+		memcpy(&recs[n++], &ring->recs[tail], sizeof(uffs_TraceRecord));
+		ring->count--;
+	}
+	uffs_SemSignal(ring->lock);
+
+	return n;
+}
+
+#endif
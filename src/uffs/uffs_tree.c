@@ -42,6 +42,7 @@
 #include "uffs/uffs_pool.h"
 #include "uffs/uffs_flash.h"
 #include "uffs/uffs_badblock.h"
+#include "uffs/uffs_bbt.h"
 
 #include <string.h>
 
@@ -54,6 +55,11 @@ static void uffs_InsertToDirEntry(uffs_Device *dev, TreeNode *node);
 static void uffs_InsertToDataEntry(uffs_Device *dev, TreeNode *node);
 
 static TreeNode * uffs_TreeGetErasedNodeNoCheck(uffs_Device *dev);
+static void _FsnMapSet(uffs_Device *dev, u16 serial);
+static void _FsnMapClear(uffs_Device *dev, u16 serial);
+#ifdef CONFIG_UFFS_OBJ_FDN_MAP
+static void _FdnMapInit(uffs_Device *dev);
+#endif
 
 
 struct BlockTypeStatSt {
@@ -73,8 +79,11 @@ URET uffs_TreeInit(uffs_Device *dev)
 	uffs_Pool *pool;
 	int i;
 
-	size = sizeof(TreeNode);
+	size = TREE_NODE_BUF_SIZE;
 	num = dev->par.end - dev->par.start + 1;
+#ifdef CONFIG_UFFS_SMALL_FILE_PACK
+	num += UFFS_PACK_MAX_FILES;		// packed files don't own a block
+#endif
 	
 	pool = &(dev->mem.tree_pool);
 
@@ -97,9 +106,33 @@ URET uffs_TreeInit(uffs_Device *dev)
 	uffs_PoolInit(pool, dev->mem.tree_nodes_pool_buf,
 					dev->mem.tree_nodes_pool_size, size, num, U_FALSE);
 
+#ifdef CONFIG_UFFS_COMPACT_TREE_NODE
+	num = FILE_LEN_TABLE_LEN(dev->par.end - dev->par.start + 1);
+	size = sizeof(u32) * num;
+	if (dev->mem.file_len_pool_size == 0 && dev->mem.malloc) {
+		dev->mem.file_len_pool_buf = dev->mem.malloc(dev, size);
+		if (dev->mem.file_len_pool_buf)
+			dev->mem.file_len_pool_size = size;
+	}
+	if (dev->mem.file_len_pool_size < size) {
+		uffs_Perror(UFFS_MSG_DEAD,
+					"File length table require %d but only %d available.",
+					size, dev->mem.file_len_pool_size);
+		uffs_TreeRelease(dev);
+		return U_FAIL;
+	}
+	dev->tree.file_len = (u32 *)dev->mem.file_len_pool_buf;
+	dev->tree.file_len_num = num;
+	memset(dev->tree.file_len, 0, size);
+#endif
+
 	dev->tree.erased = NULL;
 	dev->tree.erased_tail = NULL;
 	dev->tree.erased_count = 0;
+	dev->tree.prealloc = NULL;
+	dev->tree.prealloc_count = 0;
+	dev->tree.prealloc_owner = INVALID_UFFS_SERIAL;
+	dev->tree.prealloc_holder = NULL;
 	dev->tree.bad = NULL;
 	dev->tree.bad_count = 0;
 
@@ -116,6 +149,13 @@ URET uffs_TreeInit(uffs_Device *dev)
 	}
 
 	dev->tree.max_serial = ROOT_DIR_SERIAL;
+	uffs_TreeResetFsnMap(dev);
+#ifdef CONFIG_UFFS_OBJ_FDN_MAP
+	_FdnMapInit(dev);
+#endif
+#ifdef CONFIG_UFFS_SMALL_FILE_PACK
+	uffs_PackInit(dev);
+#endif
 	
 	return U_SUCC;
 }
@@ -136,6 +176,25 @@ URET uffs_TreeRelease(uffs_Device *dev)
 	uffs_PoolRelease(pool);
 	memset(pool, 0, sizeof(uffs_Pool));
 
+#ifdef CONFIG_UFFS_OBJ_FDN_MAP
+	if (dev->mem.fdn_map_pool_buf && dev->mem.free) {
+		dev->mem.free(dev, dev->mem.fdn_map_pool_buf);
+		dev->mem.fdn_map_pool_buf = NULL;
+		dev->mem.fdn_map_pool_size = 0;
+	}
+	dev->tree.fdn_map_len = 0;
+#endif
+
+#ifdef CONFIG_UFFS_COMPACT_TREE_NODE
+	if (dev->mem.file_len_pool_buf && dev->mem.free) {
+		dev->mem.free(dev, dev->mem.file_len_pool_buf);
+		dev->mem.file_len_pool_buf = NULL;
+		dev->mem.file_len_pool_size = 0;
+	}
+	dev->tree.file_len = NULL;
+	dev->tree.file_len_num = 0;
+#endif
+
 	return U_SUCC;
 }
 
@@ -176,7 +235,7 @@ static UBOOL uffs_TreeProcessPendingBadBlock(uffs_Device *dev, TreeNode *node, i
     return U_FALSE;
 }
 
-static u16 _GetBlockFromNode(u8 type, TreeNode *node)
+static uffs_BlockNum _GetBlockFromNode(u8 type, TreeNode *node)
 {
 	switch (type) {
 	case UFFS_TYPE_DIR:
@@ -278,7 +337,8 @@ static URET _BuildValidTreeNode(uffs_Device *dev,
 {
 	uffs_Tags *tag;
 	TreeNode *node_alt;
-	u16 block, parent, serial, block_alt;
+	uffs_BlockNum block, block_alt;
+	u16 parent, serial;
 	uffs_BlockInfo *bc_alt;
 	u8 type;
 	int page;
@@ -321,6 +381,32 @@ static URET _BuildValidTreeNode(uffs_Device *dev,
 	serial = TAG_SERIAL(tag);
 	type = TAG_TYPE(tag);
 
+	if (uffs_BbtIsTableTag(tag)) {
+		// BBT blocks are taken out of the partition when BBT is in use,
+		// this one is left by a build with CONFIG_UFFS_BBT: not a pack block.
+		uffs_Perror(UFFS_MSG_NORMAL, "block %d holds a bad block table, will be erased now!", bc->block);
+		goto process_invalid_block;
+	}
+
+#ifdef CONFIG_UFFS_SMALL_FILE_PACK
+	if (type == UFFS_TYPE_PACK) {
+		// packed files are loaded by uffs_PackLoad() after the tree is built.
+		node->u.list.block = block;
+		uffs_PackInsertBlock(dev, node);
+		return U_SUCC;
+	}
+#endif
+
+#ifdef CONFIG_UFFS_COMPACT_TREE_NODE
+	if ((type == UFFS_TYPE_FILE && serial >= dev->tree.file_len_num) ||
+		(type == UFFS_TYPE_DATA && parent >= dev->tree.file_len_num)) {
+		uffs_Perror(UFFS_MSG_SERIOUS,
+					"block %d: file serial out of file length table (%d entries)",
+					block, dev->tree.file_len_num);
+		return U_FAIL;
+	}
+#endif
+
 	// check if there is an 'alternative block' 
 	// (node which has the same serial number) in tree ?
 	node_alt = uffs_FindFromTree(dev, type, parent, serial); 
@@ -333,7 +419,7 @@ static URET _BuildValidTreeNode(uffs_Device *dev,
 		uffs_Perror(UFFS_MSG_NORMAL,
 					"Process unclean block (%d vs %d)", block, block_alt);
 
-		if (block_alt == INVALID_UFFS_SERIAL) {
+		if (block_alt == UFFS_INVALID_BLOCK) {
 			uffs_Perror(UFFS_MSG_SERIOUS, "invalid block ?");
 			return U_FAIL;
 		}
@@ -365,6 +451,13 @@ static URET _BuildValidTreeNode(uffs_Device *dev,
 			//the node is older than node_alt, so keep node, and erase node_alt
 			//then re-point node to node_alt.
 
+#ifdef CONFIG_UFFS_COMPACT_TREE_NODE
+			// node_alt's data length was already accounted, take it back.
+			if (type == UFFS_TYPE_FILE)
+				FILE_NODE_LEN(dev, node_alt) -= uffs_GetBlockFileDataLength(dev, bc_alt, type);
+			else if (type == UFFS_TYPE_DATA)
+				dev->tree.file_len[node_alt->u.data.parent] -= uffs_GetBlockFileDataLength(dev, bc_alt, type);
+#endif
 			node->u.list.block = block_alt;
 			ret = uffs_FlashEraseBlock(dev, block_alt);
 
@@ -440,14 +533,24 @@ static URET _BuildValidTreeNode(uffs_Device *dev,
 		node->u.file.checksum = data_sum;
 		node->u.file.parent = TAG_PARENT(tag);
 		node->u.file.serial = TAG_SERIAL(tag);
+#ifdef CONFIG_UFFS_COMPACT_TREE_NODE
+		// data blocks may come first, so accumulate.
+		FILE_NODE_LEN(dev, node) += uffs_GetBlockFileDataLength(dev, bc, UFFS_TYPE_FILE);
+#else
 		node->u.file.len = uffs_GetBlockFileDataLength(dev, bc, UFFS_TYPE_FILE);  
+#endif
 		st->file++;
 		break;
 	case UFFS_TYPE_DATA:
 		node->u.data.block = bc->block;
 		node->u.data.parent = TAG_PARENT(tag);
 		node->u.data.serial = TAG_SERIAL(tag);
+#ifdef CONFIG_UFFS_COMPACT_TREE_NODE
+		// data length is not kept in node, add it to file length directly.
+		dev->tree.file_len[node->u.data.parent] += uffs_GetBlockFileDataLength(dev, bc, UFFS_TYPE_DATA);
+#else
 		node->u.data.len = uffs_GetBlockFileDataLength(dev, bc, UFFS_TYPE_DATA); 
+#endif
 		st->data++;
 		break;
 	}
@@ -473,7 +576,7 @@ process_invalid_block:
 
 static void _ScanAndFixUnCleanPage(uffs_Device *dev, uffs_BlockInfo *bc)
 {
-	int page;
+	int page, first;
 	int flash_ret;
 	uffs_Tags *tag;
 	struct uffs_MiniHeaderSt header;
@@ -489,6 +592,16 @@ static void _ScanAndFixUnCleanPage(uffs_Device *dev, uffs_BlockInfo *bc)
 		most case: read one spare.
 	*/
 	for (page = dev->attr->pages_per_block - 1; page > 0; page--) {
+		if (UFFS_FLASH_CAN_BATCH_READ_SPARE(dev) && bc->spares[page].expired) {
+			// prefetch spares of the pages ahead in one batch. If it fails, expire them
+			// again so that the error will be reported on the exact page below.
+			first = (page + 1 > UFFS_TAG_BATCH_PAGES ? page + 1 - UFFS_TAG_BATCH_PAGES : 1);
+			if (uffs_BlockInfoLoadPageRange(dev, bc, first, page + 1) != U_SUCC) {
+				for (; first <= page; first++)
+					uffs_BlockInfoExpire(dev, bc, first);
+			}
+		}
+
 		flash_ret = uffs_LoadMiniHeaderAndTag(dev, bc, page, &header);
 		uffs_BadBlockAddByFlashResult(dev, bc->block, flash_ret);
 		if (UFFS_FLASH_HAVE_ERR(flash_ret)) {
@@ -565,6 +678,13 @@ static URET _BuildTreeStepOne(uffs_Device *dev)
 	tree->erased = NULL;
 	tree->erased_tail = NULL;
 	tree->erased_count = 0;
+	tree->prealloc = NULL;
+	tree->prealloc_count = 0;
+	tree->prealloc_owner = INVALID_UFFS_SERIAL;
+	tree->prealloc_holder = NULL;
+#ifdef CONFIG_UFFS_COMPACT_TREE_NODE
+	memset(tree->file_len, 0, sizeof(u32) * tree->file_len_num);
+#endif
 
 	uffs_Perror(UFFS_MSG_NOISY, "build tree step one");
 
@@ -631,6 +751,9 @@ static URET _BuildTreeStepOne(uffs_Device *dev)
 
 					// this block have valid data page(s).
 					_ScanAndFixUnCleanPage(dev, bc);
+#ifdef CONFIG_UFFS_SMALL_FILE_PACK
+					uffs_PackCheckPendingBlock(dev, bc);
+#endif
 
 					// _ScanAndFixUnCleanPage() might add new pending block, we need to process it first.
 					if (uffs_TreeProcessPendingBadBlock(dev, node, block) == U_FALSE) {
@@ -680,7 +803,7 @@ static URET _BuildTreeStepTwo(uffs_Device *dev)
 TreeNode * uffs_TreeFindFileNode(uffs_Device *dev, u16 serial)
 {
 	int hash;
-	u16 x;
+	uffs_NodeIndex x;
 	TreeNode *node;
 	struct uffs_TreeSt *tree = &(dev->tree);
 
@@ -701,12 +824,14 @@ TreeNode * uffs_TreeFindFileNode(uffs_Device *dev, u16 serial)
 /** add a node into suspend list */
 void uffs_TreeSuspendAdd(uffs_Device *dev, TreeNode *node)
 {
-	node->u.list.next = dev->tree.suspend;
-	node->u.list.prev = NULL;
+	LIST_SET_NEXT(dev, node, dev->tree.suspend);
+	LIST_SET_PREV(dev, node, NULL);
 
 	if (dev->tree.suspend)
-		dev->tree.suspend->u.list.prev = node;
+		LIST_SET_PREV(dev, dev->tree.suspend, node);
 	dev->tree.suspend = node;
+
+	_FsnMapSet(dev, node->u.list.u.serial);
 }
 
 /** search suspend list */
@@ -717,7 +842,7 @@ TreeNode * uffs_TreeFindSuspendNode(uffs_Device *dev, u16 serial)
 		if (node->u.list.u.serial == serial)
 			break;
 		
-		node = node->u.list.next;
+		node = LIST_NEXT(dev, node);
 	}
 
 	return node;
@@ -726,18 +851,20 @@ TreeNode * uffs_TreeFindSuspendNode(uffs_Device *dev, u16 serial)
 /** remove a node from suspend list */
 void uffs_TreeRemoveSuspendNode(uffs_Device *dev, TreeNode *node)
 {
-	if (node->u.list.prev)
-		node->u.list.prev->u.list.next = node->u.list.next;
-	if (node->u.list.next)
-		node->u.list.next->u.list.prev = node->u.list.prev;
+	if (LIST_PREV(dev, node))
+		LIST_SET_NEXT(dev, LIST_PREV(dev, node), LIST_NEXT(dev, node));
+	if (LIST_NEXT(dev, node))
+		LIST_SET_PREV(dev, LIST_NEXT(dev, node), LIST_PREV(dev, node));
 	if (node == dev->tree.suspend)
 		dev->tree.suspend = NULL;
+
+	_FsnMapClear(dev, node->u.list.u.serial);
 }
 
 TreeNode * uffs_TreeFindFileNodeWithParent(uffs_Device *dev, u16 parent)
 {
 	int hash;
-	u16 x;
+	uffs_NodeIndex x;
 	TreeNode *node;
 	struct uffs_TreeSt *tree = &(dev->tree);
 
@@ -760,7 +887,7 @@ TreeNode * uffs_TreeFindFileNodeWithParent(uffs_Device *dev, u16 parent)
 TreeNode * uffs_TreeFindDirNode(uffs_Device *dev, u16 serial)
 {
 	int hash;
-	u16 x;
+	uffs_NodeIndex x;
 	TreeNode *node;
 	struct uffs_TreeSt *tree = &(dev->tree);
 
@@ -781,7 +908,7 @@ TreeNode * uffs_TreeFindDirNode(uffs_Device *dev, u16 serial)
 TreeNode * uffs_TreeFindDirNodeWithParent(uffs_Device *dev, u16 parent)
 {
 	int hash;
-	u16 x;
+	uffs_NodeIndex x;
 	TreeNode *node;
 	struct uffs_TreeSt *tree = &(dev->tree);
 
@@ -807,7 +934,7 @@ TreeNode * uffs_TreeFindFileNodeByName(uffs_Device *dev,
 										u16 sum, u16 parent)
 {
 	int i;
-	u16 x;
+	uffs_NodeIndex x;
 	TreeNode *node;
 	struct uffs_TreeSt *tree = &(dev->tree);
 	
@@ -835,7 +962,7 @@ TreeNode * uffs_TreeFindDataNode(uffs_Device *dev, u16 parent, u16 serial)
 	int hash;
 	TreeNode *node;
 	struct uffs_TreeSt *tree = &(dev->tree);
-	u16 x;
+	uffs_NodeIndex x;
 
 	hash = GET_DATA_HASH(parent, serial);
 	x = tree->data_entry[hash];
@@ -852,12 +979,121 @@ TreeNode * uffs_TreeFindDataNode(uffs_Device *dev, u16 parent, u16 serial)
 	return NULL;
 }
 
-TreeNode * uffs_TreeFindDirNodeByBlock(uffs_Device *dev, u16 block)
+#ifdef CONFIG_UFFS_OBJ_FDN_MAP
+static void _FdnMapInit(uffs_Device *dev)
+{
+	int len = dev->par.end - dev->par.start + 1;
+	int size = sizeof(uffs_NodeIndex) * len * UFFS_FDN_MAP_NUM;
+	uffs_NodeIndex *buf;
+	int i;
+
+	if (dev->mem.fdn_map_pool_size == 0 && dev->mem.malloc) {
+		dev->mem.fdn_map_pool_buf = dev->mem.malloc(dev, size);
+		if (dev->mem.fdn_map_pool_buf)
+			dev->mem.fdn_map_pool_size = size;
+	}
+	if (dev->mem.fdn_map_pool_size < size) {
+		uffs_Perror(UFFS_MSG_NORMAL, "no buffer for fdn maps, fall back to hash lookup.");
+		len = 0;
+	}
+
+	buf = (uffs_NodeIndex *)dev->mem.fdn_map_pool_buf;
+	for (i = 0; i < UFFS_FDN_MAP_NUM; i++) {
+		dev->tree.fdn_map[i].serial = INVALID_UFFS_SERIAL;
+		dev->tree.fdn_map[i].ref_count = 0;
+		dev->tree.fdn_map[i].gen = 0;
+		dev->tree.fdn_map[i].idx = (len > 0 ? buf + i * len : NULL);
+	}
+	dev->tree.fdn_map_len = len;
+	dev->tree.data_gen = 0;
+}
+
+static void _FdnMapReset(uffs_Device *dev, struct uffs_FdnMapSt *map)
+{
+	int i;
+
+	for (i = 0; i < dev->tree.fdn_map_len; i++)
+		map->idx[i] = EMPTY_NODE;
+	map->gen = dev->tree.data_gen;
+}
+
+/** 
+ * \brief get fdn map for file #serial
+ * \return the map shared by objects of the same file, or NULL if no map is available.
+ */
+struct uffs_FdnMapSt * uffs_TreeFdnMapGet(uffs_Device *dev, u16 serial)
+{
+	struct uffs_FdnMapSt *map, *free_map = NULL;
+	int i;
+
+	if (dev->tree.fdn_map_len == 0)
+		return NULL;
+
+	for (i = 0; i < UFFS_FDN_MAP_NUM; i++) {
+		map = &dev->tree.fdn_map[i];
+		if (map->serial == serial) {
+			map->ref_count++;
+			return map;
+		}
+		if (free_map == NULL && map->serial == INVALID_UFFS_SERIAL)
+			free_map = map;
+	}
+
+	if (free_map) {
+		free_map->serial = serial;
+		free_map->ref_count = 1;
+		_FdnMapReset(dev, free_map);
+	}
+
+	return free_map;
+}
+
+/** put back fdn map got from uffs_TreeFdnMapGet() */
+void uffs_TreeFdnMapPut(uffs_Device *dev, struct uffs_FdnMapSt *map)
+{
+	if (map && map->ref_count > 0) {
+		map->ref_count--;
+		if (map->ref_count == 0)
+			map->serial = INVALID_UFFS_SERIAL;
+	}
+}
+
+/** 
+ * \brief find DATA node, resolve through fdn #map when possible
+ * \param[in] map fdn map of file #parent, could be NULL
+ * \param[in] parent file serial
+ * \param[in] serial fdn
+ */
+TreeNode * uffs_TreeFindDataNodeByMap(uffs_Device *dev, struct uffs_FdnMapSt *map, u16 parent, u16 serial)
+{
+	TreeNode *node;
+	uffs_NodeIndex *x;
+
+	if (map == NULL || map->serial != parent || serial == 0 || serial > dev->tree.fdn_map_len)
+		return uffs_TreeFindDataNode(dev, parent, serial);
+
+	// DATA node(s) left the tree since the map was filled, entries might be stale.
+	if (map->gen != dev->tree.data_gen)
+		_FdnMapReset(dev, map);
+
+	x = &map->idx[serial - 1];
+	if (*x != EMPTY_NODE)
+		return FROM_IDX(*x, TPOOL(dev));
+
+	node = uffs_TreeFindDataNode(dev, parent, serial);
+	if (node)
+		*x = TO_IDX(node, TPOOL(dev));
+
+	return node;
+}
+#endif
+
+TreeNode * uffs_TreeFindDirNodeByBlock(uffs_Device *dev, uffs_BlockNum block)
 {
 	int hash;
 	TreeNode *node;
 	struct uffs_TreeSt *tree = &(dev->tree);
-	u16 x;
+	uffs_NodeIndex x;
 
 	for (hash = 0; hash < DIR_NODE_ENTRY_LEN; hash++) {
 		x = tree->dir_entry[hash];
@@ -872,7 +1108,7 @@ TreeNode * uffs_TreeFindDirNodeByBlock(uffs_Device *dev, u16 block)
 	return NULL;
 }
 
-TreeNode * uffs_TreeFindErasedNodeByBlock(uffs_Device *dev, u16 block)
+TreeNode * uffs_TreeFindErasedNodeByBlock(uffs_Device *dev, uffs_BlockNum block)
 {
 	TreeNode *node;
 	node = dev->tree.erased;
@@ -880,13 +1116,13 @@ TreeNode * uffs_TreeFindErasedNodeByBlock(uffs_Device *dev, u16 block)
 	while (node) {
 		if (node->u.list.block == block) 
 			return node;
-		node = node->u.list.next;
+		node = LIST_NEXT(dev, node);
 	}
 		
 	return NULL;
 }
 
-TreeNode * uffs_TreeFindBadNodeByBlock(uffs_Device *dev, u16 block)
+TreeNode * uffs_TreeFindBadNodeByBlock(uffs_Device *dev, uffs_BlockNum block)
 {
 	TreeNode *node;
 	node = dev->tree.bad;
@@ -894,18 +1130,18 @@ TreeNode * uffs_TreeFindBadNodeByBlock(uffs_Device *dev, u16 block)
 	while (node) {
 		if (node->u.list.block == block) 
 			return node;
-		node = node->u.list.next;
+		node = LIST_NEXT(dev, node);
 	}
 		
 	return NULL;
 }
 
-TreeNode * uffs_TreeFindFileNodeByBlock(uffs_Device *dev, u16 block)
+TreeNode * uffs_TreeFindFileNodeByBlock(uffs_Device *dev, uffs_BlockNum block)
 {
 	int hash;
 	TreeNode *node;
 	struct uffs_TreeSt *tree = &(dev->tree);
-	u16 x;
+	uffs_NodeIndex x;
 
 	for (hash = 0; hash < FILE_NODE_ENTRY_LEN; hash++) {
 		x = tree->file_entry[hash];
@@ -920,12 +1156,12 @@ TreeNode * uffs_TreeFindFileNodeByBlock(uffs_Device *dev, u16 block)
 	return NULL;
 }
 
-TreeNode * uffs_TreeFindDataNodeByBlock(uffs_Device *dev, u16 block)
+TreeNode * uffs_TreeFindDataNodeByBlock(uffs_Device *dev, uffs_BlockNum block)
 {
 	int hash;
 	TreeNode *node;
 	struct uffs_TreeSt *tree = &(dev->tree);
-	u16 x;
+	uffs_NodeIndex x;
 
 	for (hash = 0; hash < DATA_NODE_ENTRY_LEN; hash++) {
 		x = tree->data_entry[hash];
@@ -940,10 +1176,19 @@ TreeNode * uffs_TreeFindDataNodeByBlock(uffs_Device *dev, u16 block)
 	return NULL;
 }
 
-TreeNode * uffs_TreeFindNodeByBlock(uffs_Device *dev, u16 block, int *region)
+TreeNode * uffs_TreeFindNodeByBlock(uffs_Device *dev, uffs_BlockNum block, int *region)
 {
 	TreeNode *node = NULL;
 
+#ifdef CONFIG_UFFS_SMALL_FILE_PACK
+	if (*region & SEARCH_REGION_PACK) {
+		node = uffs_PackFindBlockNode(dev, block);
+		if (node) {
+			*region &= SEARCH_REGION_PACK;
+			return node;
+		}
+	}
+#endif
 	if (*region & SEARCH_REGION_DATA) {
 		node = uffs_TreeFindDataNodeByBlock(dev, block);
 		if (node) {
@@ -988,7 +1233,7 @@ TreeNode * uffs_TreeFindDirNodeByName(uffs_Device *dev,
 									  u16 sum, u16 parent)
 {
 	int i;
-	u16 x;
+	uffs_NodeIndex x;
 	TreeNode *node;
 	struct uffs_TreeSt *tree = &(dev->tree);
 	
@@ -1030,16 +1275,28 @@ UBOOL uffs_TreeCompareFileName(uffs_Device *dev,
 							   TreeNode *node, int type)
 {
 	UBOOL matched = U_FALSE;
+#ifdef CONFIG_UFFS_INFO_CACHE
+	const uffs_FileInfo *fi;
+#else
 	uffs_FileInfo *fi;
 	uffs_Buf *buf;
+#endif
 	u16 data_sum;
 
+#ifdef CONFIG_UFFS_INFO_CACHE
+	fi = uffs_InfoCacheGet(dev, type, node);
+	if (fi == NULL) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "can't get file info !");
+		goto ext;
+	}
+#else
 	buf = uffs_BufGetEx(dev, type, node, 0, 0);
 	if (buf == NULL) {
 		uffs_Perror(UFFS_MSG_SERIOUS, "can't get buf !\n ");
 		goto ext;
 	}
 	fi = (uffs_FileInfo *)(buf->data);
+#endif
 	data_sum = uffs_MakeSum16(fi->name, fi->name_len);
 
 	if (data_sum != sum) {
@@ -1054,8 +1311,10 @@ UBOOL uffs_TreeCompareFileName(uffs_Device *dev,
 		}
 	}
 ext:
+#ifndef CONFIG_UFFS_INFO_CACHE
 	if (buf)
 		uffs_BufPut(dev, buf);
+#endif
 
 	return matched;
 }
@@ -1065,12 +1324,12 @@ ext:
 static URET _BuildTreeStepThree(uffs_Device *dev)
 {
 	int i;
-	u16 x;
+	uffs_NodeIndex x;
 	TreeNode *work;
 	TreeNode *node;
 	struct uffs_TreeSt *tree;
 	uffs_Pool *pool;
-	u16 blockSave;
+	uffs_BlockNum blockSave;
 	int ret;
 
 	TreeNode *cache = NULL;
@@ -1113,7 +1372,9 @@ static URET _BuildTreeStepThree(uffs_Device *dev)
 					uffs_TreeInsertToErasedListTail(dev, work);
 			}
 			else {
+#ifndef CONFIG_UFFS_COMPACT_TREE_NODE
 				node->u.file.len += work->u.data.len;
+#endif
 				x = work->hash_next;
 			}
 		}
@@ -1162,6 +1423,15 @@ URET uffs_BuildTree(uffs_Device *dev)
 		uffs_Perror(UFFS_MSG_SERIOUS, "build tree step three fail!");
 		return ret;
 	}
+
+#ifdef CONFIG_UFFS_SMALL_FILE_PACK
+	/***** step four: load packed files from pack blocks *****/
+	ret = uffs_PackLoad(dev);
+	if (ret != U_SUCC) {
+		uffs_Perror(UFFS_MSG_SERIOUS, "build tree step four fail!");
+		return ret;
+	}
+#endif
 	
 	/* process pending bad block */
 	if (HAVE_BADBLOCK(dev))
@@ -1170,30 +1440,87 @@ URET uffs_BuildTree(uffs_Device *dev)
 	return U_SUCC;
 }
 
+#define FSN_BIT(serial)		((u32)1 << ((serial) % 32))
+
+static void _FsnMapSet(uffs_Device *dev, u16 serial)
+{
+	if (serial <= MAX_UFFS_FSN)
+		dev->tree.fsn_map[serial / 32] |= FSN_BIT(serial);
+}
+
+static void _FsnMapClear(uffs_Device *dev, u16 serial)
+{
+	int w = serial / 32;
+
+	if (serial != ROOT_DIR_SERIAL && serial < MAX_UFFS_FSN) {
+		dev->tree.fsn_map[w] &= ~FSN_BIT(serial);
+		if (w < dev->tree.fsn_free_word)
+			dev->tree.fsn_free_word = w;
+	}
+}
+
+/**
+ * rebuild dir|file serial allocation bitmap from the tree
+ * \param[in] dev uffs device
+ */
+void uffs_TreeResetFsnMap(uffs_Device *dev)
+{
+	struct uffs_TreeSt *tree = &(dev->tree);
+	uffs_NodeIndex x;
+	TreeNode *node;
+	int i;
+
+	memset(tree->fsn_map, 0, sizeof(tree->fsn_map));
+
+	// root dir serial and serials from MAX_UFFS_FSN are never given out
+	_FsnMapSet(dev, ROOT_DIR_SERIAL);
+	for (i = MAX_UFFS_FSN; i < FSN_MAP_WORDS * 32; i++)
+		tree->fsn_map[i / 32] |= FSN_BIT(i);
+
+	for (i = 0; i < DIR_NODE_ENTRY_LEN; i++) {
+		for (x = tree->dir_entry[i]; x != EMPTY_NODE; x = node->hash_next) {
+			node = FROM_IDX(x, TPOOL(dev));
+			_FsnMapSet(dev, node->u.dir.serial);
+		}
+	}
+
+	for (i = 0; i < FILE_NODE_ENTRY_LEN; i++) {
+		for (x = tree->file_entry[i]; x != EMPTY_NODE; x = node->hash_next) {
+			node = FROM_IDX(x, TPOOL(dev));
+			_FsnMapSet(dev, node->u.file.serial);
+		}
+	}
+
+	for (node = tree->suspend; node != NULL; node = LIST_NEXT(dev, node))
+		_FsnMapSet(dev, node->u.list.u.serial);
+
+	tree->fsn_free_word = 0;
+}
+
 /** 
  * find a free file or dir serial NO
  * \param[in] dev uffs device
  * \return if no free serial found, return #INVALID_UFFS_SERIAL
+ *
+ * \note serials in use are tracked by uffs_TreeSt#fsn_map, a serial is
+ *       marked when the dir|file node is inserted to the tree.
  */
 u16 uffs_FindFreeFsnSerial(uffs_Device *dev)
 {
-	u16 i;
-	TreeNode *node;
-
-	//TODO!! Do we need a faster serial number generating method?
-	//		 it depends on how often creating files or directories
-
-	for (i = ROOT_DIR_SERIAL + 1; i < MAX_UFFS_FSN; i++) {
-		node = uffs_TreeFindDirNode(dev, i);
-		if (node == NULL) {
-			node = uffs_TreeFindFileNode(dev, i);
-			if (node == NULL) {
-				node = uffs_TreeFindSuspendNode(dev, i);
-				if (node == NULL)
-					return i;
-			}
+	struct uffs_TreeSt *tree = &(dev->tree);
+	int w, i;
+	u32 bits;
+
+	for (w = tree->fsn_free_word; w < FSN_MAP_WORDS; w++) {
+		bits = ~tree->fsn_map[w];
+		if (bits) {
+			for (i = 0; (bits & 1) == 0; i++)
+				bits >>= 1;
+			tree->fsn_free_word = w;
+			return (u16)(w * 32 + i);
 		}
 	}
+	tree->fsn_free_word = FSN_MAP_WORDS;
 
 	return INVALID_UFFS_SERIAL;
 }
@@ -1203,8 +1530,8 @@ static TreeNode * uffs_TreeGetErasedNodeNoCheck(uffs_Device *dev)
 	TreeNode *node = NULL;
 	if (dev->tree.erased) {
 		node = dev->tree.erased;
-		dev->tree.erased->u.list.prev = NULL;
-		dev->tree.erased = dev->tree.erased->u.list.next;
+		LIST_SET_PREV(dev, dev->tree.erased, NULL);
+		dev->tree.erased = LIST_NEXT(dev, dev->tree.erased);
 		if(dev->tree.erased == NULL) 
 			dev->tree.erased_tail = NULL;
 		dev->tree.erased_count--;
@@ -1213,11 +1540,25 @@ static TreeNode * uffs_TreeGetErasedNodeNoCheck(uffs_Device *dev)
 	return node;
 }
 
+/**
+ * prepare block info cache for erased block
+ * - we don't need to load tag from flash for erased block
+ */
+static void _PrepareErasedBlockInfo(uffs_Device *dev, TreeNode *node)
+{
+	uffs_BlockInfo *bc;
+
+	bc = uffs_BlockInfoGet(dev, node->u.list.block);
+	if (bc) {
+		uffs_BlockInfoInitErased(dev, bc);
+		uffs_BlockInfoPut(dev, bc);
+	}
+}
+
 TreeNode * uffs_TreeGetErasedNode(uffs_Device *dev)
 {
 	TreeNode *node = uffs_TreeGetErasedNodeNoCheck(dev);
-	u16 block;
-	uffs_BlockInfo *bc;
+	uffs_BlockNum block;
 	
 	if (node) {
 		if (node->u.list.u.need_check) {
@@ -1230,16 +1571,121 @@ TreeNode * uffs_TreeGetErasedNode(uffs_Device *dev)
 				node->u.list.u.need_check = 0;
 			}
 		}
-		// prepare block info cache for erased block - we don't need to load tag from flash for erased block
-		bc = uffs_BlockInfoGet(dev, node->u.list.block);
-		if (bc) {
-			uffs_BlockInfoInitErased(dev, bc);
-			uffs_BlockInfoPut(dev, bc);
-		}
+		_PrepareErasedBlockInfo(dev, node);
 	}
 	return node;
 }
 
+/**
+ * get an erased node for file #owner: take from the reserved blocks if
+ * #owner has any, otherwise from the erased list.
+ *
+ * \param[in] dev uffs device
+ * \param[in] owner serial of the file which will use the block
+ */
+TreeNode * uffs_TreeGetErasedNodeFor(uffs_Device *dev, u16 owner)
+{
+	TreeNode *node;
+
+	if (dev->tree.prealloc == NULL || dev->tree.prealloc_owner != owner)
+		return uffs_TreeGetErasedNode(dev);
+
+	node = dev->tree.prealloc;
+	dev->tree.prealloc = LIST_NEXT(dev, node);
+	dev->tree.prealloc_count--;
+
+	LIST_SET_NEXT(dev, node, NULL);
+	LIST_SET_PREV(dev, node, NULL);
+
+	// reserved block was checked when reserving, only need to prepare block info.
+	_PrepareErasedBlockInfo(dev, node);
+
+	return node;
+}
+
+/**
+ * put back an unused, clean erased node got from uffs_TreeGetErasedNodeFor():
+ * to #owner's reserved blocks if #owner holds the reservation, otherwise
+ * to the erased list.
+ */
+void uffs_TreePutErasedNodeFor(uffs_Device *dev, u16 owner, TreeNode *node)
+{
+	if (dev->tree.prealloc_owner != owner) {
+		uffs_TreeInsertToErasedListTailEx(dev, node, 0);
+	}
+	else {
+		node->u.list.u.need_check = 0;
+		LIST_SET_NEXT(dev, node, dev->tree.prealloc);
+		LIST_SET_PREV(dev, node, NULL);
+		dev->tree.prealloc = node;
+		dev->tree.prealloc_count++;
+	}
+}
+
+/**
+ * reserve erased blocks for file #owner, so that later new blocks of
+ * this file are taken without the erase-check work on the write path.
+ *
+ * Blocks are checked (and erased if necessary) here and moved out of the
+ * erased list, #dev->cfg.reserved_free_blocks are always left in the erased list.
+ *
+ * \param[in] dev uffs device
+ * \param[in] owner serial of the file
+ * \param[in] count total reserved blocks wanted for #owner
+ *
+ * \return U_SUCC if #owner has at least #count reserved blocks,
+ *			U_FAIL if no enough erased blocks (blocks reserved so far are kept),
+ *			or blocks are reserved by another file.
+ *
+ * \note only one file can hold reserved blocks on a device, reserving for
+ *		another file fails until the holder's reservation is used up or released.
+ */
+URET uffs_TreePreallocBlocks(uffs_Device *dev, u16 owner, int count)
+{
+	TreeNode *node;
+
+	if (dev->tree.prealloc_owner != owner) {
+		if (dev->tree.prealloc_count > 0)
+			return U_FAIL;
+		uffs_TreeReleasePrealloc(dev);
+	}
+
+	while (dev->tree.prealloc_count < count) {
+		if (dev->tree.erased_count <= dev->cfg.reserved_free_blocks)
+			return U_FAIL;
+
+		node = uffs_TreeGetErasedNode(dev);
+		if (node == NULL)
+			return U_FAIL;
+
+		LIST_SET_NEXT(dev, node, dev->tree.prealloc);
+		LIST_SET_PREV(dev, node, NULL);
+		dev->tree.prealloc = node;
+		dev->tree.prealloc_count++;
+		dev->tree.prealloc_owner = owner;
+	}
+
+	return U_SUCC;
+}
+
+/**
+ * return unused reserved blocks to the erased list.
+ */
+void uffs_TreeReleasePrealloc(uffs_Device *dev)
+{
+	TreeNode *node;
+
+	while (dev->tree.prealloc) {
+		node = dev->tree.prealloc;
+		dev->tree.prealloc = LIST_NEXT(dev, node);
+		// the block was checked when reserving, no need to check again.
+		uffs_TreeInsertToErasedListTailEx(dev, node, 0);
+	}
+	dev->tree.prealloc_count = 0;
+	dev->tree.prealloc_owner = INVALID_UFFS_SERIAL;
+	dev->tree.prealloc_holder = NULL;
+}
+
 /**
  * Erase a flash block and check the bad block.
  * If the block is 'bad', then swap it with a good block and put the bad block into bad block list.
@@ -1277,7 +1723,7 @@ URET uffs_TreeEraseNode(uffs_Device *dev, TreeNode *node)
 	}
 }
 
-static void _InsertToEntry(uffs_Device *dev, u16 *entry,
+static void _InsertToEntry(uffs_Device *dev, uffs_NodeIndex *entry,
 						   int hash, TreeNode *node)
 {
 	node->hash_next = entry[hash];
@@ -1294,7 +1740,7 @@ static void _InsertToEntry(uffs_Device *dev, u16 *entry,
  */
 void uffs_BreakFromEntry(uffs_Device *dev, u8 type, TreeNode *node)
 {
-	u16 *entry;
+	uffs_NodeIndex *entry;
 	int hash;
 	TreeNode *work;
 
@@ -1328,6 +1774,15 @@ void uffs_BreakFromEntry(uffs_Device *dev, u8 type, TreeNode *node)
 	if (*entry == TO_IDX(node, &(dev->mem.tree_pool))) {
 		*entry = node->hash_next;
 	}
+
+	if (type == UFFS_TYPE_DIR)
+		_FsnMapClear(dev, node->u.dir.serial);
+	else if (type == UFFS_TYPE_FILE)
+		_FsnMapClear(dev, node->u.file.serial);
+#ifdef CONFIG_UFFS_OBJ_FDN_MAP
+	else
+		dev->tree.data_gen++;	// node index cached in fdn maps might be reused
+#endif
 }
 
 static void uffs_InsertToFileEntry(uffs_Device *dev, TreeNode *node)
@@ -1335,6 +1790,7 @@ static void uffs_InsertToFileEntry(uffs_Device *dev, TreeNode *node)
 	_InsertToEntry(dev, dev->tree.file_entry,
 					GET_FILE_HASH(node->u.file.serial),
 					node);
+	_FsnMapSet(dev, node->u.file.serial);
 }
 
 static void uffs_InsertToDirEntry(uffs_Device *dev, TreeNode *node)
@@ -1342,6 +1798,7 @@ static void uffs_InsertToDirEntry(uffs_Device *dev, TreeNode *node)
 	_InsertToEntry(dev, dev->tree.dir_entry,
 					GET_DIR_HASH(node->u.dir.serial),
 					node);
+	_FsnMapSet(dev, node->u.dir.serial);
 }
 
 static void uffs_InsertToDataEntry(uffs_Device *dev, TreeNode *node)
@@ -1356,15 +1813,15 @@ void uffs_InsertToErasedListHead(uffs_Device *dev, TreeNode *node)
 	struct uffs_TreeSt *tree;
 	tree = &(dev->tree);
 
-	node->u.list.next = tree->erased;
-	node->u.list.prev = NULL;
+	LIST_SET_NEXT(dev, node, tree->erased);
+	LIST_SET_PREV(dev, node, NULL);
 
 	if (tree->erased) {
-		tree->erased->u.list.prev = node;
+		LIST_SET_PREV(dev, tree->erased, node);
 	}
 
 	tree->erased = node;
-	if (node->u.list.next == tree->erased_tail) {
+	if (LIST_NEXT(dev, node) == tree->erased_tail) {
 		tree->erased_tail = node;
 	}
 	tree->erased_count++;
@@ -1384,10 +1841,10 @@ void uffs_TreeInsertToErasedListTailEx(uffs_Device *dev, TreeNode *node, int nee
 	if (need_check >= 0)
 		node->u.list.u.need_check = need_check;
 	
-	node->u.list.next = NULL;
-	node->u.list.prev = tree->erased_tail;
+	LIST_SET_NEXT(dev, node, NULL);
+	LIST_SET_PREV(dev, node, tree->erased_tail);
 	if (tree->erased_tail) {
-		tree->erased_tail->u.list.next = node;
+		LIST_SET_NEXT(dev, tree->erased_tail, node);
 	}
 
 	tree->erased_tail = node;
@@ -1408,11 +1865,11 @@ void uffs_TreeInsertToBadBlockList(uffs_Device *dev, TreeNode *node)
 	struct uffs_TreeSt *tree;
 
 	tree = &(dev->tree);
-	node->u.list.prev = NULL;
-	node->u.list.next = tree->bad;
+	LIST_SET_PREV(dev, node, NULL);
+	LIST_SET_NEXT(dev, node, tree->bad);
 
 	if (tree->bad) {
-		tree->bad->u.list.prev = node;
+		LIST_SET_PREV(dev, tree->bad, node);
 	}
 
 	tree->bad = node;
@@ -1422,7 +1879,7 @@ void uffs_TreeInsertToBadBlockList(uffs_Device *dev, TreeNode *node)
 /** 
  * set tree node block value
  */
-void uffs_TreeSetNodeBlock(u8 type, TreeNode *node, u16 block)
+void uffs_TreeSetNodeBlock(u8 type, TreeNode *node, uffs_BlockNum block)
 {
 	switch (type) {
 	case UFFS_TYPE_FILE:
@@ -80,7 +80,7 @@ void uffs_GlobalFsLockUnlock(void)
 
 void uffs_InitGlobalFsLock(void) {}
 void uffs_ReleaseGlobalFsLock(void) {}
-int uffs_GlobalFsLockLock(void) {}
+int uffs_GlobalFsLockLock(void) { return 0; }
 void uffs_GlobalFsLockUnlock(void) {}
 
 #endif
@@ -211,7 +211,8 @@ ext:
 
 URET uffs_FormatDeviceEx(uffs_Device *dev, UBOOL force, UBOOL lock)
 {
-	u16 i, slot;
+	uffs_BlockNum i;
+	u16 slot;
 	URET ret = U_SUCC;
 	
 	if (dev == NULL)
@@ -293,6 +294,16 @@ URET uffs_FormatDeviceEx(uffs_Device *dev, UBOOL force, UBOOL lock)
 		ret = U_FAIL;
 	}
 
+#ifdef CONFIG_UFFS_INFO_CACHE
+	if (ret == U_SUCC)
+		uffs_InfoCacheClear(dev);
+#endif
+
+#ifdef CONFIG_UFFS_DENTRY_CACHE
+	if (ret == U_SUCC)
+		uffs_DentryCacheClear(dev);
+#endif
+
 	if (ret == U_SUCC && uffs_BuildTree(dev) == U_FAIL) {
 		ret = U_FAIL;
 	}
@@ -160,9 +160,7 @@ static int init_uffs_fs(void)
 	}
 
 	// mount partitions
-	for (mtbl = &(conf_mounts[0]); mtbl->mount != NULL; mtbl++) {
-		uffs_Mount(mtbl->mount);
-	}
+	uffs_MountAll();
 
 	return uffs_InitFileSystemObjects() == U_SUCC ? 0 : -1;
 }
@@ -285,8 +283,10 @@ static int parse_options(int argc, char *argv[])
 					usage++;
                 else if (sscanf(argv[iarg], "%i", &conf_pages_per_block) < 1)
 					usage++;
-				if (conf_pages_per_block < 2)
+				if (conf_pages_per_block < 2 || conf_pages_per_block > UFFS_MAX_PAGES_PER_BLOCK) {
+					MSGLN("ERROR: Invalid pages per block");
 					usage++;
+				}
             }
             else if (!strcmp(arg, "-t") || !strcmp(arg, "--total-blocks")) {
                 if (++iarg >= argc)
@@ -357,10 +357,10 @@ static int parse_options(int argc, char *argv[])
         MSGLN("  -c  --command-line                        command line mode");
         MSGLN("  -v  --verbose                             verbose mode");
         MSGLN("  -f  --file           <file>               uffs image file");
-        MSGLN("  -p  --page-size      <n>                  page data size, default=%d", PAGE_DATA_SIZE_DEFAULT);
-        MSGLN("  -s  --spare-size     <n>                  page spare size, default=%d", PAGE_SPARE_SIZE_DEFAULT);
+        MSGLN("  -p  --page-size      <n>                  page data size, default=%d, max=%d", PAGE_DATA_SIZE_DEFAULT, UFFS_MAX_PAGE_SIZE);
+        MSGLN("  -s  --spare-size     <n>                  page spare size, default=%d, max=%d", PAGE_SPARE_SIZE_DEFAULT, UFFS_MAX_SPARE_SIZE);
 		MSGLN("  -o  --status-offset  <n>                  status byte offset, default=%d", STATUS_BYTE_OFFSET_DEFAULT);
-        MSGLN("  -b  --block-pages    <n>                  pages per block, default=%d", PAGES_PER_BLOCK_DEFAULT);
+        MSGLN("  -b  --block-pages    <n>                  pages per block, default=%d, max=%d", PAGES_PER_BLOCK_DEFAULT, UFFS_MAX_PAGES_PER_BLOCK);
         MSGLN("  -t  --total-blocks   <n>                  total blocks");
         MSGLN("  -m  --mount          <mount_point,start,end> , for example: -m /,0,-1");
 		MSGLN("  -x  --ecc-option     <none|soft|hw|auto>  ECC option, default=%s", g_ecc_option_strings[ECC_OPTION_DEFAULT]);
@@ -448,6 +448,16 @@ int main(int argc, char *argv[])
 		MSGLN("  struct uffs_TagStoreSt: %d", sizeof(struct uffs_TagStoreSt));
 		MSGLN("  uffs_Buf: %d", sizeof(uffs_Buf));
 		MSGLN("  struct uffs_BlockInfoSt: %d", sizeof(struct uffs_BlockInfoSt));
+		MSGLN("");
+		MSGLN("Tree memory footprint for %d blocks:", conf_total_blocks);
+		MSGLN("  tree nodes: %d bytes", UFFS_TREE_BUFFER_SIZE(conf_total_blocks));
+#ifdef CONFIG_UFFS_COMPACT_TREE_NODE
+		MSGLN("  file length table: %d bytes", (int)UFFS_FILE_LEN_BUFFER_SIZE(conf_total_blocks));
+		MSGLN("  (compact tree node)");
+#endif
+#ifdef CONFIG_UFFS_WIDE_BLOCK_ADDR
+		MSGLN("  (32-bit block address)");
+#endif
 		MSGLN("");
 		#endif
 		print_params();